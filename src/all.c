@@ -0,0 +1,396 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "all.h"
+#include "full.h"
+#include "helpers.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+enum {
+    ALL_OK = 0,
+    ALL_OUT_OF_MEMORY,
+    ALL_INVALID_ENVELOPE,
+    ALL_INVALID_FULL,
+    ALL_INVALID_SUBSYSTEM,
+    ALL_DUPLICATE_SUBSYSTEM
+};
+
+typedef void* (*convert_fn_t)( const void *buf, size_t len );
+
+/* A kind of subsystem & where it goes in the all_t. */
+typedef struct {
+    const char *base;
+    convert_fn_t convert;
+    destroy_fn_t destroy;
+    size_t envelope;            /* offsetof() the envelope in all_t */
+    size_t data;                /* offsetof() the data in all_t */
+} kind_t;
+
+/* The decode of a single subsystem. */
+typedef struct {
+    const subsystem_t *in;
+    bool view;                  /* Reference the payload, don't copy it. */
+    cache_t *cache;             /* (optional) Where to take the results from. */
+    const kind_t *kind;         /* NULL if the subsystem is ignored. */
+    envelope_t *envelope;
+    void *data;
+    int err;
+} job_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const kind_t __kinds[] = {
+    { "dhcp",         (convert_fn_t) dhcp_convert,        (destroy_fn_t) dhcp_destroy,
+      offsetof(all_t, dhcp_envelope),        offsetof(all_t, dhcp) },
+    { "firewall",     (convert_fn_t) firewall_convert,    (destroy_fn_t) firewall_destroy,
+      offsetof(all_t, firewall_envelope),    offsetof(all_t, firewall) },
+    { "gre",          (convert_fn_t) gre_convert,         (destroy_fn_t) gre_destroy,
+      offsetof(all_t, gre_envelope),         offsetof(all_t, gre) },
+    { "port-mapping", (convert_fn_t) portmapping_convert, (destroy_fn_t) portmapping_destroy,
+      offsetof(all_t, portmapping_envelope), offsetof(all_t, portmapping) },
+    { "wifi",         (convert_fn_t) wifi_convert,        (destroy_fn_t) wifi_destroy,
+      offsetof(all_t, wifi_envelope),        offsetof(all_t, wifi) },
+    { "xdns",         (convert_fn_t) xdns_convert,        (destroy_fn_t) xdns_destroy,
+      offsetof(all_t, xdns_envelope),        offsetof(all_t, xdns) },
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static all_t* __convert( const void *buf, size_t len, pool_t *pool, cache_t *cache,
+                         bool view );
+static all_t* __subsystems( all_t *all, pool_t *pool, cache_t *cache, bool view );
+static void __decode( void *arg, size_t i );
+static void __drop( cache_t *cache, const kind_t *kind, envelope_t *env, void *data );
+static const kind_t* __kind( const envelope_t *e );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See all.h for details. */
+all_t* all_convert( const void *buf, size_t len, pool_t *pool, cache_t *cache )
+{
+    return __convert( buf, len, pool, cache, false );
+}
+
+/* See all.h for details. */
+all_t* all_convert_view( const void *buf, size_t len, pool_t *pool, cache_t *cache )
+{
+    return __convert( buf, len, pool, cache, true );
+}
+
+/* See all.h for details. */
+all_t* all_convert_envelope( envelope_t *full, pool_t *pool, cache_t *cache )
+{
+    all_t *all;
+
+    if( NULL == full ) {
+        errno = ALL_INVALID_ENVELOPE;
+        return NULL;
+    }
+
+    all = (all_t*) calloc( 1, sizeof(all_t) );
+    if( NULL == all ) {
+        envelope_destroy( full );
+        errno = ALL_OUT_OF_MEMORY;
+        return NULL;
+    }
+    all->full_envelope = full;
+
+    return __subsystems( all, pool, cache, true );
+}
+
+/* See all.h for details. */
+void all_destroy( all_t *all )
+{
+    size_t i;
+
+    if( NULL == all ) {
+        return;
+    }
+
+    for( i = 0; i < sizeof(__kinds) / sizeof(__kinds[0]); i++ ) {
+        envelope_t **env = (envelope_t**) ((uint8_t*) all + __kinds[i].envelope);
+        void **data = (void**) ((uint8_t*) all + __kinds[i].data);
+
+        __drop( all->cache, &__kinds[i], *env, *data );
+    }
+    envelope_destroy( all->full_envelope );
+    if( NULL != all->view_release ) {
+        (all->view_release)( all->view, all->view_len );
+    }
+    free( all );
+}
+
+/* See all.h for details. */
+const char* all_strerror( int errnum )
+{
+    struct error_map {
+        int v;
+        const char *txt;
+    } map[] = {
+        { .v = ALL_OK,                  .txt = "No errors." },
+        { .v = ALL_OUT_OF_MEMORY,       .txt = "Out of memory." },
+        { .v = ALL_INVALID_ENVELOPE,    .txt = "Invalid envelope." },
+        { .v = ALL_INVALID_FULL,        .txt = "Invalid 'full' payload." },
+        { .v = ALL_INVALID_SUBSYSTEM,   .txt = "Invalid subsystem." },
+        { .v = ALL_DUPLICATE_SUBSYSTEM, .txt = "Duplicate subsystem." },
+        { .v = 0, .txt = NULL }
+    };
+    int i = 0;
+
+    while( (map[i].v != errnum) && (NULL != map[i].txt) ) { i++; }
+
+    if( NULL == map[i].txt ) {
+        return "Unknown error.";
+    }
+
+    return map[i].txt;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Decodes a full envelope & its subsystems.
+ *
+ *  @param buf   the buffer to convert
+ *  @param len   the length of the buffer in bytes
+ *  @param pool  the pool to decode on, NULL decodes in the calling thread
+ *  @param cache the cache to take the subsystems from, or NULL
+ *  @param view  true to reference the envelope payloads in buf
+ *
+ *  @return NULL on error, success otherwise
+ */
+static all_t* __convert( const void *buf, size_t len, pool_t *pool, cache_t *cache,
+                         bool view )
+{
+    all_t *all;
+
+    all = (all_t*) calloc( 1, sizeof(all_t) );
+    if( NULL == all ) {
+        errno = ALL_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    if( view ) {
+        all->full_envelope = envelope_convert_view( buf, len );
+    } else {
+        all->full_envelope = envelope_convert( buf, len );
+    }
+    if( NULL == all->full_envelope ) {
+        free( all );
+        errno = ALL_INVALID_ENVELOPE;
+        return NULL;
+    }
+
+    return __subsystems( all, pool, cache, view );
+}
+
+/**
+ *  Decodes the subsystems of the full envelope of an all_t.
+ *
+ *  @param all   the all_t with its full envelope, destroyed on error
+ *  @param pool  the pool to decode on, NULL decodes in the calling thread
+ *  @param cache the cache to take the subsystems from, or NULL
+ *  @param view  true to reference the envelope payloads in the full one
+ *
+ *  @return NULL on error, all otherwise
+ */
+static all_t* __subsystems( all_t *all, pool_t *pool, cache_t *cache, bool view )
+{
+    full_t *full;
+    job_t *jobs = NULL;
+    size_t i;
+    int err = ALL_OK;
+
+    all->cache = cache;
+
+    /* The subsystems reference the full envelope's payload, which outlives
+     * the decode. */
+    full = full_convert_view( all->full_envelope->payload, all->full_envelope->len );
+    if( NULL == full ) {
+        all_destroy( all );
+        errno = ALL_INVALID_FULL;
+        return NULL;
+    }
+
+    if( 0 < full->subsystems_count ) {
+        jobs = (job_t*) calloc( full->subsystems_count, sizeof(job_t) );
+        if( NULL == jobs ) {
+            full_destroy( full );
+            all_destroy( all );
+            errno = ALL_OUT_OF_MEMORY;
+            return NULL;
+        }
+    }
+
+    for( i = 0; i < full->subsystems_count; i++ ) {
+        jobs[i].in = &full->subsystems[i];
+        jobs[i].view = view;
+        jobs[i].cache = cache;
+    }
+
+    pool_run( pool, full->subsystems_count, __decode, jobs );
+
+    /* Join the results in order, so the first error found is reported. */
+    for( i = 0; i < full->subsystems_count; i++ ) {
+        job_t *job = &jobs[i];
+        envelope_t **env;
+        void **data;
+
+        if( (ALL_OK == err) && (ALL_OK != job->err) ) {
+            err = job->err;
+        }
+
+        if( (ALL_OK != err) || (NULL == job->kind) ) {
+            __drop( cache, job->kind, job->envelope, job->data );
+            continue;
+        }
+
+        env = (envelope_t**) ((uint8_t*) all + job->kind->envelope);
+        data = (void**) ((uint8_t*) all + job->kind->data);
+        if( NULL != *env ) {
+            err = ALL_DUPLICATE_SUBSYSTEM;
+            __drop( cache, job->kind, job->envelope, job->data );
+            continue;
+        }
+        *env = job->envelope;
+        *data = job->data;
+    }
+
+    free( jobs );
+    full_destroy( full );
+
+    if( ALL_OK != err ) {
+        all_destroy( all );
+        errno = err;
+        return NULL;
+    }
+
+    errno = ALL_OK;
+    return all;
+}
+
+/**
+ *  Decodes a single subsystem: the envelope & then its payload.  This runs
+ *  on the pool, so it only touches its own job.
+ *
+ *  @param arg the jobs
+ *  @param i   the job to run
+ */
+static void __decode( void *arg, size_t i )
+{
+    job_t *job = &((job_t*) arg)[i];
+
+    /* A subsystem seen before is neither verified nor decoded again. */
+    if( NULL != job->cache ) {
+        job->envelope = cache_envelope( job->cache, job->in->payload, job->in->payload_len );
+        if( NULL == job->envelope ) {
+            job->err = ALL_INVALID_SUBSYSTEM;
+            return;
+        }
+
+        job->kind = __kind( job->envelope );
+        if( NULL != job->kind ) {
+            job->data = cache_payload( job->cache, job->envelope,
+                                       job->kind->convert, job->kind->destroy );
+            if( NULL == job->data ) {
+                job->err = ALL_INVALID_SUBSYSTEM;
+            }
+        }
+        return;
+    }
+
+    if( job->view ) {
+        job->envelope = envelope_convert_view( job->in->payload, job->in->payload_len );
+    } else {
+        job->envelope = envelope_convert( job->in->payload, job->in->payload_len );
+    }
+    if( NULL == job->envelope ) {
+        job->err = ALL_INVALID_SUBSYSTEM;
+        return;
+    }
+
+    job->kind = __kind( job->envelope );
+    if( NULL == job->kind ) {
+        return;
+    }
+
+    job->data = job->kind->convert( job->envelope->payload, job->envelope->len );
+    if( NULL == job->data ) {
+        job->err = ALL_INVALID_SUBSYSTEM;
+    }
+}
+
+/**
+ *  Releases the envelope & data of a subsystem: to the cache they came from,
+ *  or by destroying them.
+ *
+ *  @param cache the cache, or NULL
+ *  @param kind  the kind of subsystem, NULL if it is unknown (& has no data)
+ *  @param env   the envelope, may be NULL
+ *  @param data  the data, may be NULL
+ */
+static void __drop( cache_t *cache, const kind_t *kind, envelope_t *env, void *data )
+{
+    if( NULL != cache ) {
+        cache_release( cache, data );
+        cache_release( cache, env );
+        return;
+    }
+
+    if( NULL != kind ) {
+        kind->destroy( data );
+    }
+    envelope_destroy( env );
+}
+
+/**
+ *  Finds the kind of subsystem from the schema base of its envelope.
+ *
+ *  @param e the envelope of the subsystem
+ *
+ *  @return the kind, or NULL if the subsystem is not known
+ */
+static const kind_t* __kind( const envelope_t *e )
+{
+    size_t i;
+
+    for( i = 0; i < sizeof(__kinds) / sizeof(__kinds[0]); i++ ) {
+        if( (strlen(__kinds[i].base) == e->schema.base_len) &&
+            (0 == memcmp(__kinds[i].base, e->schema.base, e->schema.base_len)) )
+        {
+            return &__kinds[i];
+        }
+    }
+
+    return NULL;
+}
@@ -18,10 +18,12 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include "cache.h"
 #include "dhcp.h"
 #include "envelope.h"
 #include "firewall.h"
 #include "gre.h"
+#include "pool.h"
 #include "portmapping.h"
 #include "wifi.h"
 #include "xdns.h"
@@ -46,6 +48,91 @@ typedef struct {
 
     envelope_t *xdns_envelope;
     xdns_t *xdns;
+
+    /* (optional) The buffer an all_convert_view() result references, which
+     * all_destroy() releases by calling view_release( view, view_len ). */
+    void *view;
+    size_t view_len;
+    void (*view_release)( void *view, size_t len );
+
+    /* (optional) The cache the subsystem envelopes & data came from, which
+     * all_destroy() releases them to. */
+    cache_t *cache;
 } all_t;
 
+/**
+ *  This function converts a full envelope into an all_t structure, decoding
+ *  the subsystem envelopes & their payloads in parallel on the pool.  Each
+ *  subsystem is identified by its schema base ("dhcp", "firewall", "gre",
+ *  "port-mapping", "wifi" or "xdns"); any others are ignored.
+ *
+ *  With a cache, a subsystem that was already decoded into the cache is
+ *  taken from it instead: an unchanged subsystem is the same pointer in
+ *  each all_t, and must not be changed.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         all_strerror().
+ *
+ *  @param buf   the buffer to convert
+ *  @param len   the length of the buffer in bytes
+ *  @param pool  the pool to decode on, NULL decodes in the calling thread
+ *  @param cache the cache to take the subsystems from, NULL decodes them
+ *
+ *  @return NULL on error, success otherwise
+ */
+all_t* all_convert( const void *buf, size_t len, pool_t *pool, cache_t *cache );
+
+/**
+ *  This function converts a full envelope into an all_t structure like
+ *  all_convert(), but the envelopes reference their payloads in buf instead
+ *  of copying them.  Only the decoded subsystems are allocated.  Subsystems
+ *  taken from a cache hold their own copy of their payload.
+ *
+ *  @note: buf must remain valid & unchanged until the all_t is destroyed;
+ *         set view, view_len & view_release to have all_destroy() release
+ *         it.
+ *
+ *  @param buf   the buffer to convert
+ *  @param len   the length of the buffer in bytes
+ *  @param pool  the pool to decode on, NULL decodes in the calling thread
+ *  @param cache the cache to take the subsystems from, NULL decodes them
+ *
+ *  @return NULL on error, success otherwise
+ */
+all_t* all_convert_view( const void *buf, size_t len, pool_t *pool, cache_t *cache );
+
+/**
+ *  This function decodes the subsystems of a full envelope that has already
+ *  been decoded & verified, for example by envelope_stream_finish_view() as
+ *  it was downloaded.  The subsystem envelopes reference their payloads in
+ *  it, as with all_convert_view().
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         all_strerror().
+ *
+ *  @param full  the full envelope, which the all_t takes (or destroys on
+ *               error)
+ *  @param pool  the pool to decode on, NULL decodes in the calling thread
+ *  @param cache the cache to take the subsystems from, NULL decodes them
+ *
+ *  @return NULL on error, success otherwise
+ */
+all_t* all_convert_envelope( envelope_t *full, pool_t *pool, cache_t *cache );
+
+/**
+ *  This function destroys an all_t object & everything it holds.
+ *
+ *  @param all the all_t to destroy
+ */
+void all_destroy( all_t *all );
+
+/**
+ *  This function returns a general reason why the conversion failed.
+ *
+ *  @param errnum the errno value to inspect
+ *
+ *  @return the constant string (do not alter or free) describing the error
+ */
+const char* all_strerror( int errnum );
+
 #endif
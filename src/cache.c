@@ -0,0 +1,386 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "cache.h"
+#include "helpers.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    uint8_t sha256[32];
+    const char *base;
+    size_t base_len;
+    uint64_t major;
+    uint64_t minor;
+    uint64_t patch;
+    cache_convert_fn convert;
+} cache_key_t;
+
+typedef struct cache_entry {
+    struct cache_entry *next;
+    cache_key_t key;            /* key.base points just past the entry. */
+    void *obj;
+    cache_destroy_fn destroy;
+    uint32_t refs;              /* Holders, including the cache while cached. */
+    bool cached;                /* false once evicted, waiting for release. */
+    uint64_t used;              /* When last returned, for eviction. */
+} cache_entry_t;
+
+struct cache {
+    pthread_mutex_t lock;
+    cache_entry_t *entries;
+    size_t count;               /* The entries still cached. */
+    size_t max;
+    uint64_t clock;
+    bool destroyed;             /* Freed once the last result is released. */
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void* __get( cache_t *c, const cache_key_t *key, const void *buf, size_t len,
+                    cache_destroy_fn destroy );
+static cache_entry_t* __find( cache_t *c, const cache_key_t *key );
+static void* __hit( cache_t *c, cache_entry_t *e );
+static void __insert( cache_t *c, cache_entry_t *e );
+static void __unref( cache_t *c, cache_entry_t *e );
+static void __unlock( cache_t *c );
+static void __key( cache_key_t *key, const schema_t *schema, const uint8_t sha256[32],
+                   cache_convert_fn convert );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See cache.h for details. */
+cache_t* cache_create( size_t max_entries )
+{
+    cache_t *c;
+
+    c = (cache_t*) malloc( sizeof(cache_t) );
+    if( NULL != c ) {
+        memset( c, 0, sizeof(cache_t) );
+        c->max = (0 < max_entries) ? max_entries : 1;
+        if( 0 != pthread_mutex_init(&c->lock, NULL) ) {
+            free( c );
+            c = NULL;
+        }
+    }
+
+    return c;
+}
+
+/* See cache.h for details. */
+void cache_destroy( cache_t *c )
+{
+    cache_entry_t *e, *next;
+
+    if( NULL == c ) {
+        return;
+    }
+
+    /* Drop what only the cache holds; the rest goes with its last release. */
+    pthread_mutex_lock( &c->lock );
+    c->destroyed = true;
+    for( e = c->entries; NULL != e; e = next ) {
+        next = e->next;
+        if( e->cached ) {
+            e->cached = false;
+            c->count--;
+            __unref( c, e );
+        }
+    }
+    __unlock( c );
+}
+
+/* See cache.h for details. */
+envelope_t* cache_envelope( cache_t *c, const void *buf, size_t len )
+{
+    cache_key_t key;
+    schema_t schema;
+    uint8_t sha256[32];
+
+    if( 0 != envelope_peek(buf, len, &schema, sha256) ) {
+        return NULL;
+    }
+
+    __key( &key, &schema, sha256, (cache_convert_fn) envelope_convert );
+
+    return (envelope_t*) __get( c, &key, buf, len, (cache_destroy_fn) envelope_destroy );
+}
+
+/* See cache.h for details. */
+void* cache_payload( cache_t *c, const envelope_t *env,
+                     cache_convert_fn convert, cache_destroy_fn destroy )
+{
+    cache_key_t key;
+
+    __key( &key, &env->schema, env->sha256, convert );
+
+    return __get( c, &key, env->payload, env->len, destroy );
+}
+
+/* See cache.h for details. */
+void* cache_retain( cache_t *c, void *p )
+{
+    cache_entry_t *e;
+
+    pthread_mutex_lock( &c->lock );
+    for( e = c->entries; NULL != e; e = e->next ) {
+        if( e->obj == p ) {
+            e->refs++;
+            break;
+        }
+    }
+    pthread_mutex_unlock( &c->lock );
+
+    return p;
+}
+
+/* See cache.h for details. */
+void cache_release( cache_t *c, void *p )
+{
+    cache_entry_t *e;
+
+    if( NULL == p ) {
+        return;
+    }
+
+    pthread_mutex_lock( &c->lock );
+    for( e = c->entries; NULL != e; e = e->next ) {
+        if( e->obj == p ) {
+            __unref( c, e );
+            break;
+        }
+    }
+    __unlock( c );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Returns the cached result for the key, or converts the buffer & caches
+ *  the result.
+ *
+ *  @param c       the cache
+ *  @param key     the key
+ *  @param buf     the buffer to convert on a miss
+ *  @param len     the length of the buffer in bytes
+ *  @param destroy the destroy function for the result
+ *
+ *  @return NULL on error, success otherwise
+ */
+static void* __get( cache_t *c, const cache_key_t *key, const void *buf, size_t len,
+                    cache_destroy_fn destroy )
+{
+    cache_entry_t *e;
+    void *obj;
+
+    pthread_mutex_lock( &c->lock );
+    e = __find( c, key );
+    if( NULL != e ) {
+        obj = __hit( c, e );
+        pthread_mutex_unlock( &c->lock );
+        return obj;
+    }
+    pthread_mutex_unlock( &c->lock );
+
+    /* Convert without the lock so other lookups are not held up. */
+    e = (cache_entry_t*) malloc( sizeof(cache_entry_t) + key->base_len + 1 );
+    if( NULL == e ) {
+        errno = HELPERS_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    obj = key->convert( buf, len );
+    if( NULL == obj ) {
+        free( e );
+        return NULL;
+    }
+
+    memset( e, 0, sizeof(cache_entry_t) );
+    memcpy( &e->key, key, sizeof(cache_key_t) );
+    e->key.base = (char*) memcpy( &e[1], key->base, key->base_len );
+    ((char*) &e[1])[key->base_len] = '\0';
+    e->obj = obj;
+    e->destroy = destroy;
+
+    pthread_mutex_lock( &c->lock );
+    {
+        /* Someone else may have converted the same content meanwhile. */
+        cache_entry_t *other = __find( c, key );
+
+        if( NULL != other ) {
+            obj = __hit( c, other );
+            pthread_mutex_unlock( &c->lock );
+            destroy( e->obj );
+            free( e );
+            return obj;
+        }
+    }
+    __insert( c, e );
+    obj = __hit( c, e );
+    pthread_mutex_unlock( &c->lock );
+
+    return obj;
+}
+
+/**
+ *  Finds the cached entry for a key.
+ *
+ *  @note the lock must be held.
+ */
+static cache_entry_t* __find( cache_t *c, const cache_key_t *key )
+{
+    cache_entry_t *e;
+
+    for( e = c->entries; NULL != e; e = e->next ) {
+        if( e->cached &&
+            (e->key.convert == key->convert) &&
+            (0 == memcmp(e->key.sha256, key->sha256, sizeof(key->sha256))) &&
+            (e->key.major == key->major) &&
+            (e->key.minor == key->minor) &&
+            (e->key.patch == key->patch) &&
+            (e->key.base_len == key->base_len) &&
+            (0 == memcmp(e->key.base, key->base, key->base_len)) )
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Hands out a reference to an entry.
+ *
+ *  @note the lock must be held.
+ */
+static void* __hit( cache_t *c, cache_entry_t *e )
+{
+    e->refs++;
+    e->used = ++c->clock;
+
+    return e->obj;
+}
+
+/**
+ *  Adds an entry to the cache, evicting the least recently used entry if the
+ *  cache is full.  Evicted entries live on until they are released.
+ *
+ *  @note the lock must be held.
+ */
+static void __insert( cache_t *c, cache_entry_t *e )
+{
+    if( c->max <= c->count ) {
+        cache_entry_t *lru = NULL;
+        cache_entry_t *i;
+
+        for( i = c->entries; NULL != i; i = i->next ) {
+            if( i->cached && ((NULL == lru) || (i->used < lru->used)) ) {
+                lru = i;
+            }
+        }
+        if( NULL != lru ) {
+            lru->cached = false;
+            c->count--;
+            __unref( c, lru );
+        }
+    }
+
+    e->cached = true;
+    e->refs = 1;
+    e->next = c->entries;
+    c->entries = e;
+    c->count++;
+}
+
+/**
+ *  Drops a reference to an entry, destroying it when it is no longer cached
+ *  or held.
+ *
+ *  @note the lock must be held.
+ */
+static void __unref( cache_t *c, cache_entry_t *e )
+{
+    cache_entry_t **prev;
+
+    if( 0 < e->refs ) {
+        e->refs--;
+    }
+    if( 0 < e->refs ) {
+        return;
+    }
+
+    for( prev = &c->entries; NULL != *prev; prev = &(*prev)->next ) {
+        if( *prev == e ) {
+            *prev = e->next;
+            break;
+        }
+    }
+    if( e->cached ) {
+        c->count--;
+    }
+    e->destroy( e->obj );
+    free( e );
+}
+
+/**
+ *  Builds a key.
+ */
+static void __key( cache_key_t *key, const schema_t *schema, const uint8_t sha256[32],
+                   cache_convert_fn convert )
+{
+    memcpy( key->sha256, sha256, sizeof(key->sha256) );
+    key->base = schema->base;
+    key->base_len = schema->base_len;
+    key->major = schema->major;
+    key->minor = schema->minor;
+    key->patch = schema->patch;
+    key->convert = convert;
+}
+
+/**
+ *  Releases the lock, & frees the cache if it has been destroyed & nothing
+ *  is left in it.
+ */
+static void __unlock( cache_t *c )
+{
+    bool done = c->destroyed && (NULL == c->entries);
+
+    pthread_mutex_unlock( &c->lock );
+    if( done ) {
+        pthread_mutex_destroy( &c->lock );
+        free( c );
+    }
+}
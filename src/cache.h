@@ -0,0 +1,120 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CACHE_H__
+#define __CACHE_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "envelope.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  A content addressed cache of decoded envelopes & payloads.  An entry is
+ *  found by the sha256 of the payload, the schema (base & version) and the
+ *  function that decoded it, so a byte identical config is never decoded
+ *  twice.  The cache is safe to use from several threads.
+ */
+typedef struct cache cache_t;
+
+typedef void* (*cache_convert_fn)( const void *buf, size_t len );
+typedef void (*cache_destroy_fn)( void *p );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function creates a cache.
+ *
+ *  @param max_entries the number of entries to keep, the least recently used
+ *                     entries are dropped beyond this
+ *
+ *  @return NULL on error, success otherwise
+ */
+cache_t* cache_create( size_t max_entries );
+
+/**
+ *  This function destroys the cache and everything in it.  Results that are
+ *  still held stay valid & are destroyed when they are released; the cache
+ *  itself is freed with the last of them.
+ *
+ *  @param c the cache to destroy
+ */
+void cache_destroy( cache_t *c );
+
+/**
+ *  This function converts a msgpack buffer into an envelope_t structure like
+ *  envelope_convert(), unless an envelope with the same sha256 & schema is
+ *  already in the cache.  Then the cached envelope is returned without
+ *  decoding or hashing the payload again.
+ *
+ *  Unchanged content is always returned as the same pointer, so comparing
+ *  it to the last one applied is enough to skip applying it again.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         envelope_strerror().  The envelope must not be changed & is
+ *         released with cache_release(), not envelope_destroy().
+ *
+ *  @param c   the cache
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_t* cache_envelope( cache_t *c, const void *buf, size_t len );
+
+/**
+ *  This function converts the payload of an envelope with convert (for
+ *  example dhcp_convert()), unless the same payload has already been
+ *  converted by it.  Then the cached result is returned.
+ *
+ *  @note: errno is set by convert on error.  The result must not be changed
+ *         & is released with cache_release(), not destroy.
+ *
+ *  @param c       the cache
+ *  @param env     the envelope holding the payload
+ *  @param convert the *_convert() function for the payload
+ *  @param destroy the *_destroy() function for the result
+ *
+ *  @return NULL on error, success otherwise
+ */
+void* cache_payload( cache_t *c, const envelope_t *env,
+                     cache_convert_fn convert, cache_destroy_fn destroy );
+
+/**
+ *  This function takes another reference to a result of the cache.
+ *
+ *  @param c the cache
+ *  @param p the result
+ *
+ *  @return p
+ */
+void* cache_retain( cache_t *c, void *p );
+
+/**
+ *  This function releases a result of the cache.  The result is destroyed
+ *  once it has been released by everyone & has left the cache.
+ *
+ *  @param c the cache
+ *  @param p the result to release
+ */
+void cache_release( cache_t *c, void *p );
+
+#endif
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "cursor.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __read( cursor_t *c, token_t *t );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See cursor.h for details. */
+void cursor_init( cursor_t *c, const void *buf, size_t len )
+{
+    c->next = (const uint8_t*) buf;
+    c->end = c->next + len;
+    c->pending = 0;
+}
+
+/* See cursor.h for details. */
+int cursor_next( cursor_t *c, token_t *t )
+{
+    if( 0 != cursor_skip(c, 0) ) {
+        memset( t, 0, sizeof(token_t) );
+        return -1;
+    }
+
+    if( 0 != __read(c, t) ) {
+        return -1;
+    }
+
+    c->pending = token_children( t );
+
+    return 0;
+}
+
+/* See cursor.h for details. */
+void cursor_enter( cursor_t *c )
+{
+    c->pending = 0;
+}
+
+/* See cursor.h for details. */
+int cursor_skip( cursor_t *c, uint64_t count )
+{
+    token_t t;
+
+    count += c->pending;
+    c->pending = 0;
+
+    while( 0 < count ) {
+        if( 0 != __read(c, &t) ) {
+            return -1;
+        }
+        count += token_children( &t ) - 1;
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Reads the next header and the data that follows it.
+ *
+ *  @param c the cursor
+ *  @param t the token to fill in
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __read( cursor_t *c, token_t *t )
+{
+    size_t left = (size_t) (c->end - c->next);
+    size_t size = 0;
+
+    if( 0 < left ) {
+        size = token_header_size( *c->next );
+    }
+
+    if( (0 < size) && (size <= left) ) {
+        token_decode( c->next, t );
+        c->next += size;
+        left -= size;
+
+        size = token_data_size( t );
+        if( size <= left ) {
+            t->ptr = (const char*) c->next;
+            c->next += size;
+            return 0;
+        }
+    }
+
+    memset( t, 0, sizeof(token_t) );
+    c->next = c->end;
+    c->pending = 0;
+
+    return -1;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __CURSOR_H__
+#define __CURSOR_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "token.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* A pull parser over a complete msgpack buffer.  Nothing is allocated; each
+ * token references the buffer for its data.
+ *
+ * When an array or map is returned its elements follow.  The caller either
+ * reads them after calling cursor_enter() or the next cursor_next() or
+ * cursor_skip() passes over them without decoding their contents. */
+typedef struct {
+    const uint8_t *next;        /* The next byte to decode. */
+    const uint8_t *end;         /* The end of the buffer. */
+    uint64_t pending;           /* Elements of the last container read that
+                                 * have not been entered. */
+} cursor_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Prepares a cursor to read the buffer.
+ *
+ *  @param c   the cursor
+ *  @param buf the msgpack buffer
+ *  @param len the length of the buffer in bytes
+ */
+void cursor_init( cursor_t *c, const void *buf, size_t len );
+
+/**
+ *  Reads the next element.  Strings, binary blobs and extensions are
+ *  returned with their data (t->ptr) in a single call.
+ *
+ *  @note: On error t is a TOKEN_NIL and the cursor is moved to the end of the
+ *         buffer, so every following read fails as well.
+ *
+ *  @param c the cursor
+ *  @param t the token to fill in
+ *
+ *  @return 0 on success, error otherwise (truncated or invalid msgpack)
+ */
+int cursor_next( cursor_t *c, token_t *t );
+
+/**
+ *  Descends into the array or map just returned by cursor_next() so the
+ *  following calls return its elements.
+ *
+ *  @param c the cursor
+ */
+void cursor_enter( cursor_t *c );
+
+/**
+ *  Skips elements (including everything inside them) by reading only their
+ *  headers.
+ *
+ *  @param c     the cursor
+ *  @param count the number of elements to skip
+ *
+ *  @return 0 on success, error otherwise (truncated or invalid msgpack)
+ */
+int cursor_skip( cursor_t *c, uint64_t count );
+
+#endif
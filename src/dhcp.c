@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "dhcp.h"
@@ -23,7 +22,8 @@
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+/* Fibonacci hashing: the top log2(slots) bits of the key times 2^64 / phi. */
+#define HASH_MULTIPLIER     0x9e3779b97f4a7c15ULL
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -44,19 +44,56 @@ enum {
     DHCP_INVALID_STATIC_IP,
     DHCP_INVALID_STATIC_MAC,
     DHCP_INVALID_STATIC_INVALID,
+    DHCP_DUPLICATE_STATIC_MAC,
+    DHCP_DUPLICATE_STATIC_IP,
+    DHCP_STATIC_IP_OUTSIDE_SUBNET,
+    DHCP_STATIC_IP_IN_POOL,
+    DHCP_STATIC_IP_IS_ROUTER,
+};
+
+enum {
+    KEY_ROUTER_IP = 1,
+    KEY_SUBNET_MASK,
+    KEY_LEASE_LENGTH,
+    KEY_STATIC,
+    KEY_POOL_RANGE,
+    KEY_IP,
+    KEY_MAC
 };
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __dhcp_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "router-ip",    'r', 'o', 'p', KEY_ROUTER_IP ),
+    HELPER_KEY( "subnet-mask",  's', 'u', 'k', KEY_SUBNET_MASK ),
+    HELPER_KEY( "lease-length", 'l', 'e', 'h', KEY_LEASE_LENGTH ),
+    HELPER_KEY( "static",       's', 't', 'c', KEY_STATIC ),
+    HELPER_KEY( "pool-range",   'p', 'o', 'e', KEY_POOL_RANGE ),
+};
+
+static const helper_key_t __static_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "ip",  'i', 'p', 'p', KEY_IP ),
+    HELPER_KEY( "mac", 'm', 'a', 'c', KEY_MAC ),
+};
+
+/* Each static lease; the hash tables are only built by dhcp_index(). */
+static const helper_array_t __dhcp_static = {
+    .key = "static",
+    .element_size = sizeof(dhcp_static_t),
+    .index_size = 0,
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_pool( dhcp_t *dhcp, msgpack_object_array *array );
-int process_static( dhcp_t *dhcp, msgpack_object_array *array );
-int process_dhcp( dhcp_t *dhcp, msgpack_object *obj );
+int process_pool( dhcp_t *dhcp, cursor_t *c, const token_t *array );
+int process_static( dhcp_t *dhcp, cursor_t *c, const token_t *array, helper_ctx_t *ctx );
+int process_dhcp( dhcp_t *dhcp, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+static size_t __hash_mac( const uint8_t mac[6], unsigned shift );
+static size_t __hash_ip( uint32_t ip, unsigned shift );
+static size_t __find_mac( const dhcp_t *dhcp, const uint8_t mac[6] );
+static size_t __find_ip( const dhcp_t *dhcp, uint32_t ip );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -66,7 +103,7 @@ int process_dhcp( dhcp_t *dhcp, msgpack_object *obj );
 dhcp_t* dhcp_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(dhcp_t), "dhcp",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, &__dhcp_static,
                            (process_fn_t) process_dhcp,
                            (destroy_fn_t) dhcp_destroy );
 }
@@ -74,12 +111,128 @@ dhcp_t* dhcp_convert( const void *buf, size_t len )
 /* See dhcp.h for details. */
 void dhcp_destroy( dhcp_t *dhcp )
 {
-    if( NULL != dhcp ) {
-        if( NULL != dhcp->fixed ) {
-            free( dhcp->fixed );
+    helper_free( dhcp );
+}
+
+/* See dhcp.h for details. */
+int dhcp_index( dhcp_t *dhcp )
+{
+    helper_ctx_t *ctx;
+    dhcp_index_t *idx;
+    size_t slots = 4;
+    unsigned shift = 64 - 2;
+    size_t i;
+
+    if( (0 == dhcp->fixed_count) || (NULL != dhcp->index) ) {
+        return 0;
+    }
+
+    while( slots < 2 * dhcp->fixed_count ) {
+        slots *= 2;
+        shift--;
+    }
+
+    ctx = helper_ctx( dhcp );
+    idx = (dhcp_index_t*) helper_alloc( ctx, sizeof(dhcp_index_t) );
+    if( NULL != idx ) {
+        idx->by_mac = (uint32_t*) helper_alloc( ctx, 2 * slots * sizeof(uint32_t) );
+    }
+    if( (NULL == idx) || (NULL == idx->by_mac) ) {
+        errno = DHCP_OUT_OF_MEMORY;
+        return -1;
+    }
+    memset( idx->by_mac, 0, 2 * slots * sizeof(uint32_t) );
+    idx->by_ip = &idx->by_mac[slots];
+    idx->mask = slots - 1;
+    idx->shift = shift;
+
+    for( i = 0; i < dhcp->fixed_count; i++ ) {
+        const dhcp_static_t *s = &dhcp->fixed[i];
+        size_t h;
+
+        for( h = __hash_mac(s->mac, shift); 0 != idx->by_mac[h]; h = (h + 1) & idx->mask ) {
+            if( 0 == memcmp(dhcp->fixed[idx->by_mac[h] - 1].mac, s->mac, 6) ) {
+                break;
+            }
+        }
+        if( 0 == idx->by_mac[h] ) {
+            idx->by_mac[h] = (uint32_t) (i + 1);
+        }
+
+        for( h = __hash_ip(s->ip, shift); 0 != idx->by_ip[h]; h = (h + 1) & idx->mask ) {
+            if( dhcp->fixed[idx->by_ip[h] - 1].ip == s->ip ) {
+                break;
+            }
+        }
+        if( 0 == idx->by_ip[h] ) {
+            idx->by_ip[h] = (uint32_t) (i + 1);
         }
-        free( dhcp );
     }
+
+    dhcp->index = idx;
+
+    return 0;
+}
+
+/* See dhcp.h for details. */
+const dhcp_static_t* dhcp_find_mac( const dhcp_t *dhcp, const uint8_t mac[6] )
+{
+    size_t i = __find_mac( dhcp, mac );
+
+    return (0 < i) ? &dhcp->fixed[i - 1] : NULL;
+}
+
+/* See dhcp.h for details. */
+const dhcp_static_t* dhcp_find_ip( const dhcp_t *dhcp, uint32_t ip )
+{
+    size_t i = __find_ip( dhcp, ip );
+
+    return (0 < i) ? &dhcp->fixed[i - 1] : NULL;
+}
+
+/* See dhcp.h for details. */
+int dhcp_validate( const dhcp_t *dhcp )
+{
+    uint32_t mask = dhcp->subnet_mask;
+    uint32_t net = dhcp->router_ip & mask;
+    size_t i;
+
+    if( (dhcp->pool_range[1] < dhcp->pool_range[0]) ||
+        (net != (dhcp->pool_range[0] & mask)) ||
+        (net != (dhcp->pool_range[1] & mask)) )
+    {
+        errno = DHCP_INVALID_POOL_RANGE;
+        return -1;
+    }
+
+    /* A lease that doesn't find itself shares its key with an earlier one. */
+    for( i = 0; i < dhcp->fixed_count; i++ ) {
+        uint32_t ip = dhcp->fixed[i].ip;
+
+        if( net != (ip & mask) ) {
+            errno = DHCP_STATIC_IP_OUTSIDE_SUBNET;
+            return -1;
+        }
+        if( ip == dhcp->router_ip ) {
+            errno = DHCP_STATIC_IP_IS_ROUTER;
+            return -1;
+        }
+        if( (dhcp->pool_range[0] <= ip) && (ip <= dhcp->pool_range[1]) ) {
+            errno = DHCP_STATIC_IP_IN_POOL;
+            return -1;
+        }
+        if( (i + 1) != __find_mac(dhcp, dhcp->fixed[i].mac) ) {
+            errno = DHCP_DUPLICATE_STATIC_MAC;
+            return -1;
+        }
+        if( (i + 1) != __find_ip(dhcp, ip) ) {
+            errno = DHCP_DUPLICATE_STATIC_IP;
+            return -1;
+        }
+    }
+
+    errno = DHCP_OK;
+    return 0;
 }
 
 /* See dhcp.h for details. */
@@ -104,6 +257,11 @@ const char* dhcp_strerror( int errnum )
         { .v = DHCP_INVALID_STATIC_IP,          .txt = "Invalid 'static.ip'." },
         { .v = DHCP_INVALID_STATIC_MAC,         .txt = "Invalid 'static.mac'." },
         { .v = DHCP_INVALID_STATIC_INVALID,     .txt = "Invalid 'static' array." },
+        { .v = DHCP_DUPLICATE_STATIC_MAC,       .txt = "Conflict: two 'static' entries have the same 'mac'." },
+        { .v = DHCP_DUPLICATE_STATIC_IP,        .txt = "Conflict: two 'static' entries have the same 'ip'." },
+        { .v = DHCP_STATIC_IP_OUTSIDE_SUBNET,   .txt = "Conflict: a 'static.ip' is outside the subnet." },
+        { .v = DHCP_STATIC_IP_IN_POOL,          .txt = "Conflict: a 'static.ip' is in the 'pool-range'." },
+        { .v = DHCP_STATIC_IP_IS_ROUTER,        .txt = "Conflict: a 'static.ip' is the 'router-ip'." },
         { .v = 0, .txt = NULL }
     };
     int i = 0;
@@ -124,21 +282,29 @@ const char* dhcp_strerror( int errnum )
  *  Converts the msgpack array into the pool_range values.
  *
  *  @param dhcp  dhcp pointer
- *  @param array the msgpack array pointer
+ *  @param c     the cursor at the array elements
+ *  @param array the array
  *
  *  @return 0 on success, error otherwise
  */
-int process_pool( dhcp_t *dhcp, msgpack_object_array *array )
+int process_pool( dhcp_t *dhcp, cursor_t *c, const token_t *array )
 {
-    if( (2 == array->size) &&
-        (MSGPACK_OBJECT_POSITIVE_INTEGER == array->ptr[0].type) &&
-        (MSGPACK_OBJECT_POSITIVE_INTEGER == array->ptr[1].type) &&
-        (array->ptr[0].via.u64 <= UINT32_MAX) &&
-        (array->ptr[1].via.u64 <= UINT32_MAX) )
-    {
-        dhcp->pool_range[0] = array->ptr[0].via.u64;
-        dhcp->pool_range[1] = array->ptr[1].via.u64;
-        return 0;
+    token_t start, end;
+
+    if( 2 == array->size ) {
+        cursor_enter( c );
+        cursor_next( c, &start );
+        cursor_next( c, &end );
+
+        if( (TOKEN_POSITIVE_INTEGER == start.type) &&
+            (TOKEN_POSITIVE_INTEGER == end.type) &&
+            (start.via.u64 <= UINT32_MAX) &&
+            (end.via.u64 <= UINT32_MAX) )
+        {
+            dhcp->pool_range[0] = start.via.u64;
+            dhcp->pool_range[1] = end.via.u64;
+            return 0;
+        }
     }
 
     errno = DHCP_INVALID_POOL_RANGE;
@@ -149,17 +315,21 @@ int process_pool( dhcp_t *dhcp, msgpack_object_array *array )
  *  Converts the msgpack array into the static values.
  *
  *  @param dhcp  dhcp pointer
- *  @param array the msgpack array pointer
+ *  @param c     the cursor at the array elements
+ *  @param array the array
+ *  @param ctx   the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_static( dhcp_t *dhcp, msgpack_object_array *array )
+int process_static( dhcp_t *dhcp, cursor_t *c, const token_t *array, helper_ctx_t *ctx )
 {
+    cursor_enter( c );
+
     if( 0 < array->size ) {
         uint32_t i;
 
         dhcp->fixed_count = array->size;
-        dhcp->fixed = (dhcp_static_t*) malloc( dhcp->fixed_count * sizeof(dhcp_static_t) );
+        dhcp->fixed = (dhcp_static_t*) helper_alloc( ctx, dhcp->fixed_count * sizeof(dhcp_static_t) );
         if( NULL == dhcp->fixed ) {
             errno = DHCP_OUT_OF_MEMORY;
             return -1;
@@ -168,43 +338,52 @@ int process_static( dhcp_t *dhcp, msgpack_object_array *array )
         memset( dhcp->fixed, 0, dhcp->fixed_count * sizeof(dhcp_static_t) );
 
         for( i = 0; i < array->size; i++ ) {
-            if( MSGPACK_OBJECT_MAP == array->ptr[i].type ) {
+            token_t item;
+
+            cursor_next( c, &item );
+            if( TOKEN_MAP == item.type ) {
                 uint8_t objects_left = 0x03;
-                msgpack_object_kv *p;
-                int left;
-
-                left = array->ptr[i].via.map.size;
-                p = array->ptr[i].via.map.ptr;
-                while( (0 < objects_left) && (0 < left--) ) {
-                    if( MSGPACK_OBJECT_STR == p->key.type ) {
-                        if( MSGPACK_OBJECT_POSITIVE_INTEGER == p->val.type ) {
-                            if( 0 == match(p, "ip") ) {
-                                if( UINT32_MAX < p->val.via.u64 ) {
+                uint32_t left = item.size;
+
+                cursor_enter( c );
+                while( (0 < objects_left) && (0 < left) ) {
+                    token_t key, val;
+
+                    left--;
+                    cursor_next( c, &key );
+                    cursor_next( c, &val );
+                    switch( helper_key(__static_keys, &key) ) {
+                        case KEY_IP:
+                            if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                                if( UINT32_MAX < val.via.u64 ) {
                                     errno = DHCP_INVALID_STATIC_IP;
                                     return -1;
                                 } else {
-                                    dhcp->fixed[i].ip = (uint32_t) p->val.via.u64;
+                                    dhcp->fixed[i].ip = (uint32_t) val.via.u64;
                                     objects_left &= ~(1 << 0);
                                 }
                             }
-                        } else if( MSGPACK_OBJECT_BIN == p->val.type ) {
-                            if( 0 == match(p, "mac") ) {
-                                if( 6 == p->val.via.bin.size ) {
-                                    memcpy( &dhcp->fixed[i].mac, p->val.via.bin.ptr, 6 );
+                            break;
+                        case KEY_MAC:
+                            if( TOKEN_BIN == val.type ) {
+                                if( 6 == val.size ) {
+                                    memcpy( &dhcp->fixed[i].mac, val.ptr, 6 );
                                     objects_left &= ~(1 << 1);
                                 } else {
                                     errno = DHCP_INVALID_STATIC_MAC;
                                     return -1;
                                 }
                             }
-                        }
+                            break;
+                        default:
+                            break;
                     }
-                    p++;
                 }
                 if( 0 != objects_left ) {
                     errno = DHCP_INVALID_STATIC_INVALID;
                     return -1;
                 }
+                cursor_skip( c, 2 * (uint64_t) left );
             } else {
                 errno = DHCP_INVALID_STATIC_INVALID;
                 return -1;
@@ -219,61 +398,75 @@ int process_static( dhcp_t *dhcp, msgpack_object_array *array )
  *  Convert the msgpack map into the dhcp_t structure.
  *
  *  @param dhcp dhcp pointer
- *  @param obj  the msgpack obj pointer that is a map
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_dhcp( dhcp_t *dhcp, msgpack_object *obj )
+int process_dhcp( dhcp_t *dhcp, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x1f;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_POSITIVE_INTEGER == p->val.type ) {
-                if( 0 == match(p, "router-ip") ) {
-                    if( UINT32_MAX < p->val.via.u64 ) {
+    token_t key, val;
+
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__dhcp_keys, &key) ) {
+            case KEY_ROUTER_IP:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    if( UINT32_MAX < val.via.u64 ) {
                         errno = DHCP_INVALID_ROUTER_ADDRESS;
                         return -1;
                     } else {
-                        dhcp->router_ip = (uint32_t) p->val.via.u64;
+                        dhcp->router_ip = (uint32_t) val.via.u64;
                     }
                     objects_left &= ~(1 << 0);
-                } else if( 0 == match(p, "subnet-mask") ) {
-                    if( UINT32_MAX < p->val.via.u64 ) {
+                }
+                break;
+            case KEY_SUBNET_MASK:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    if( UINT32_MAX < val.via.u64 ) {
                         errno = DHCP_INVALID_SUBNET_MASK;
                         return -1;
                     } else {
-                        dhcp->subnet_mask = (uint32_t) p->val.via.u64;
+                        dhcp->subnet_mask = (uint32_t) val.via.u64;
                     }
                     objects_left &= ~(1 << 1);
-                } else if( 0 == match(p, "lease-length") ) {
-                    if( UINT32_MAX < p->val.via.u64 ) {
+                }
+                break;
+            case KEY_LEASE_LENGTH:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    if( UINT32_MAX < val.via.u64 ) {
                         errno = DHCP_INVALID_LEASE_LENGTH;
                         return -1;
                     } else {
-                        dhcp->lease_length = (uint32_t) p->val.via.u64;
+                        dhcp->lease_length = (uint32_t) val.via.u64;
                     }
                     objects_left &= ~(1 << 2);
                 }
-            } else if( MSGPACK_OBJECT_ARRAY == p->val.type ) {
-                if( 0 == match(p, "static") ) {
-                    if( 0 != process_static(dhcp, &p->val.via.array) ) {
+                break;
+            case KEY_STATIC:
+                if( TOKEN_ARRAY == val.type ) {
+                    if( 0 != process_static(dhcp, c, &val, ctx) ) {
                         return -1;
                     }
                     objects_left &= ~(1 << 3);
-                } else if( 0 == match(p, "pool-range") ) {
-                    if( 0 != process_pool(dhcp, &p->val.via.array) ) {
+                }
+                break;
+            case KEY_POOL_RANGE:
+                if( TOKEN_ARRAY == val.type ) {
+                    if( 0 != process_pool(dhcp, c, &val) ) {
                         return -1;
                     }
                     objects_left &= ~(1 << 4);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     if( 1 & objects_left ) {
@@ -293,3 +486,72 @@ int process_dhcp( dhcp_t *dhcp, msgpack_object *obj )
 
     return (0 == objects_left) ? 0 : -1;
 }
+
+static size_t __hash_mac( const uint8_t mac[6], unsigned shift )
+{
+    uint64_t k = 0;
+    int i;
+
+    for( i = 0; i < 6; i++ ) {
+        k = (k << 8) | mac[i];
+    }
+
+    return (size_t) ((k * HASH_MULTIPLIER) >> shift);
+}
+
+static size_t __hash_ip( uint32_t ip, unsigned shift )
+{
+    return (size_t) (((uint64_t) ip * HASH_MULTIPLIER) >> shift);
+}
+
+/**
+ *  Finds the lease of a MAC or an IP in the index, or by scanning the
+ *  leases of a dhcp_t that has none (one that was not decoded).
+ *
+ *  @return the index of the first lease with it + 1, or 0 if there is none
+ */
+static size_t __find_mac( const dhcp_t *dhcp, const uint8_t mac[6] )
+{
+    const dhcp_index_t *idx = dhcp->index;
+    size_t h;
+
+    if( NULL == idx ) {
+        for( h = 0; h < dhcp->fixed_count; h++ ) {
+            if( 0 == memcmp(dhcp->fixed[h].mac, mac, 6) ) {
+                return h + 1;
+            }
+        }
+        return 0;
+    }
+
+    for( h = __hash_mac(mac, idx->shift); 0 != idx->by_mac[h]; h = (h + 1) & idx->mask ) {
+        if( 0 == memcmp(dhcp->fixed[idx->by_mac[h] - 1].mac, mac, 6) ) {
+            return idx->by_mac[h];
+        }
+    }
+
+    return 0;
+}
+
+static size_t __find_ip( const dhcp_t *dhcp, uint32_t ip )
+{
+    const dhcp_index_t *idx = dhcp->index;
+    size_t h;
+
+    if( NULL == idx ) {
+        for( h = 0; h < dhcp->fixed_count; h++ ) {
+            if( dhcp->fixed[h].ip == ip ) {
+                return h + 1;
+            }
+        }
+        return 0;
+    }
+
+    for( h = __hash_ip(ip, idx->shift); 0 != idx->by_ip[h]; h = (h + 1) & idx->mask ) {
+        if( dhcp->fixed[idx->by_ip[h] - 1].ip == ip ) {
+            return idx->by_ip[h];
+        }
+    }
+
+    return 0;
+}
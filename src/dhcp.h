@@ -24,6 +24,18 @@ typedef struct {
     uint32_t ip;                        /* (R) V 1.0.0 */
 } dhcp_static_t;
 
+/**
+ *  Open addressing hash tables of the static leases by MAC & by IP, built
+ *  by dhcp_index().  Each slot holds the index of a lease + 1, or 0 if
+ *  it is empty; a duplicate key keeps the first lease.
+ */
+typedef struct {
+    uint32_t *by_mac;
+    uint32_t *by_ip;
+    size_t    mask;                     /* The number of slots - 1. */
+    unsigned  shift;                    /* 64 - log2(the number of slots). */
+} dhcp_index_t;
+
 typedef struct {
     uint32_t       router_ip;           /* (R) V 1.0.0 */
     uint32_t       subnet_mask;         /* (R) V 1.0.0 */
@@ -31,6 +43,8 @@ typedef struct {
     uint32_t       lease_length;        /* (R) V 1.0.0 */
     dhcp_static_t *fixed;               /* (O) V 1.0.0 */
     size_t         fixed_count;
+    dhcp_index_t  *index;               /* NULL until dhcp_index() is called,
+                                         * or if there are no static leases. */
 } dhcp_t;
 
 /**
@@ -51,6 +65,51 @@ dhcp_t* dhcp_convert( const void *buf, size_t len );
  */
 void dhcp_destroy( dhcp_t *d );
 
+/**
+ *  This function builds the hash tables of the static leases, so they are
+ *  found in O(1) & validated in O(n).  Without them the leases are scanned,
+ *  which is cheaper for the few leases most configs have.  The tables take
+ *  8 bytes per slot, with two to four slots per lease, & are released with
+ *  the dhcp.
+ *
+ *  @note: the dhcp must be from dhcp_convert() or snapshot_all().  Calling
+ *         it again does nothing.
+ *
+ *  @param dhcp the dhcp to index
+ *
+ *  @return 0 on success, error otherwise
+ */
+int dhcp_index( dhcp_t *dhcp );
+
+/**
+ *  These functions find the static lease of a MAC or an IP, using the index
+ *  if there is one.
+ *
+ *  @param dhcp the dhcp
+ *  @param mac  the MAC
+ *  @param ip   the IP
+ *
+ *  @return the lease, or NULL if there is none
+ */
+const dhcp_static_t* dhcp_find_mac( const dhcp_t *dhcp, const uint8_t mac[6] );
+const dhcp_static_t* dhcp_find_ip( const dhcp_t *dhcp, uint32_t ip );
+
+/**
+ *  This function checks that the dhcp can be applied as it is: the pool
+ *  range is in order & in the router's subnet, and each static lease is
+ *  in the subnet, outside the pool & not the router, with a MAC & an IP no
+ *  other lease has.  This takes O(n) using the index, or O(n^2) for a dhcp
+ *  without one (see dhcp_index()).
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         dhcp_strerror().
+ *
+ *  @param dhcp the dhcp
+ *
+ *  @return 0 if valid, error otherwise
+ */
+int dhcp_validate( const dhcp_t *dhcp );
+
 /**
  *  This function returns a general reason why the conversion failed.
  *
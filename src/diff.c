@@ -0,0 +1,526 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <stdbool.h>
+#include <string.h>
+
+#include "diff.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define DHCP_FIELDS     (DIFF_DHCP_ROUTER_IP | DIFF_DHCP_SUBNET_MASK |          \
+                         DIFF_DHCP_POOL_RANGE | DIFF_DHCP_LEASE_LENGTH |        \
+                         DIFF_DHCP_FIXED)
+#define FIREWALL_FIELDS (DIFF_FIREWALL_LEVEL | DIFF_FIREWALL_FILTERS)
+#define GRE_FIELDS      (DIFF_GRE_PRIMARY | DIFF_GRE_SECONDARY)
+#define WIFI_BAND       (DIFF_WIFI_EXTENSION_CHANNEL | DIFF_WIFI_CHANNEL |      \
+                         DIFF_WIFI_BANDWITH | DIFF_WIFI_STANDARDS |             \
+                         DIFF_WIFI_APS | DIFF_WIFI_DFS_ENABLED |                \
+                         DIFF_WIFI_BASIC_RATE | DIFF_WIFI_TX_POWER)
+#define WIFI_FIELDS     (WIFI_BAND | (WIFI_BAND << DIFF_WIFI_2G))
+#define XDNS_FIELDS     (DIFF_XDNS_DEFAULT_IPV4 | DIFF_XDNS_DEFAULT_IPV6)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The key of an array entry: a number, then bytes. */
+typedef struct {
+    uint32_t n;
+    const void *p;
+    size_t len;
+    size_t i;                   /* The index of the entry in its array. */
+} item_t;
+
+/* Tells if the entries at oi & ni, with the same key, are the same. */
+typedef bool (*same_fn)( const void *old, size_t oi, const void *new, size_t ni );
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static int __diff_array( item_t *old_items, size_t old_count, const void *old,
+                         item_t *new_items, size_t new_count, const void *new,
+                         same_fn same, diff_sub_t *d );
+static int __key_cmp( const item_t *a, const item_t *b );
+static int __item_cmp( const void *a, const void *b );
+static bool __same_lease( const void *old, size_t oi, const void *new, size_t ni );
+static bool __same_mapping( const void *old, size_t oi, const void *new, size_t ni );
+static bool __same_bytes( const void *a, size_t a_len, const void *b, size_t b_len );
+static bool __same_str( const char *a, const char *b );
+static uint32_t __wifi_band( const wifi_config_t *a, const wifi_config_t *b );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See diff.h for details. */
+diff_t* diff_all( const all_t *old, const all_t *new )
+{
+    const all_t none = { .full_envelope = NULL };
+    diff_t *d;
+
+    d = (diff_t*) calloc( 1, sizeof(diff_t) );
+    if( NULL == d ) {
+        return NULL;
+    }
+
+    if( NULL == old ) old = &none;
+    if( NULL == new ) new = &none;
+
+    if( (0 != diff_dhcp(old->dhcp, new->dhcp, &d->dhcp)) ||
+        (0 != diff_firewall(old->firewall, new->firewall, &d->firewall)) ||
+        (0 != diff_gre(old->gre, new->gre, &d->gre)) ||
+        (0 != diff_portmapping(old->portmapping, new->portmapping, &d->portmapping)) ||
+        (0 != diff_wifi(old->wifi, new->wifi, &d->wifi)) ||
+        (0 != diff_xdns(old->xdns, new->xdns, &d->xdns)) )
+    {
+        diff_destroy( d );
+        return NULL;
+    }
+
+    return d;
+}
+
+/* See diff.h for details. */
+int diff_dhcp( const dhcp_t *old, const dhcp_t *new, diff_sub_t *d )
+{
+    size_t old_count = (NULL != old) ? old->fixed_count : 0;
+    size_t new_count = (NULL != new) ? new->fixed_count : 0;
+    item_t *items;
+    size_t i;
+    int rv;
+
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT | DHCP_FIELDS;
+    } else if( NULL != old ) {
+        if( old->router_ip != new->router_ip )      d->fields |= DIFF_DHCP_ROUTER_IP;
+        if( old->subnet_mask != new->subnet_mask )  d->fields |= DIFF_DHCP_SUBNET_MASK;
+        if( (old->pool_range[0] != new->pool_range[0]) ||
+            (old->pool_range[1] != new->pool_range[1]) )
+        {
+            d->fields |= DIFF_DHCP_POOL_RANGE;
+        }
+        if( old->lease_length != new->lease_length ) d->fields |= DIFF_DHCP_LEASE_LENGTH;
+    }
+
+    items = (item_t*) calloc( old_count + new_count + 1, sizeof(item_t) );
+    if( NULL == items ) {
+        return -1;
+    }
+
+    for( i = 0; i < old_count; i++ ) {
+        items[i].p = old->fixed[i].mac;
+        items[i].len = sizeof(old->fixed[i].mac);
+        items[i].i = i;
+    }
+    for( i = 0; i < new_count; i++ ) {
+        items[old_count + i].p = new->fixed[i].mac;
+        items[old_count + i].len = sizeof(new->fixed[i].mac);
+        items[old_count + i].i = i;
+    }
+
+    rv = __diff_array( items, old_count, old, &items[old_count], new_count, new,
+                       __same_lease, d );
+    if( 0 < d->entries_count ) {
+        d->fields |= DIFF_DHCP_FIXED;
+    }
+    free( items );
+
+    return rv;
+}
+
+/* See diff.h for details. */
+int diff_firewall( const firewall_t *old, const firewall_t *new, diff_sub_t *d )
+{
+    size_t old_count = (NULL != old) ? old->filters_count : 0;
+    size_t new_count = (NULL != new) ? new->filters_count : 0;
+    item_t *items;
+    size_t i;
+    int rv;
+
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT | FIREWALL_FIELDS;
+    } else if( NULL != old ) {
+        if( !__same_bytes(old->level, old->level_len, new->level, new->level_len) ) {
+            d->fields |= DIFF_FIREWALL_LEVEL;
+        }
+
+        /* The rules apply in order, so a filter that only moved counts. */
+        if( old_count != new_count ) {
+            d->fields |= DIFF_FIREWALL_FILTERS;
+        }
+        for( i = 0; (i < old_count) && (i < new_count); i++ ) {
+            if( !__same_bytes(old->filters[i], old->filter_lens[i],
+                              new->filters[i], new->filter_lens[i]) )
+            {
+                d->fields |= DIFF_FIREWALL_FILTERS;
+                break;
+            }
+        }
+    }
+
+    items = (item_t*) calloc( old_count + new_count + 1, sizeof(item_t) );
+    if( NULL == items ) {
+        return -1;
+    }
+
+    for( i = 0; i < old_count; i++ ) {
+        items[i].p = old->filters[i];
+        items[i].len = old->filter_lens[i];
+        items[i].i = i;
+    }
+    for( i = 0; i < new_count; i++ ) {
+        items[old_count + i].p = new->filters[i];
+        items[old_count + i].len = new->filter_lens[i];
+        items[old_count + i].i = i;
+    }
+
+    /* A filter is all key, so it is only ever added or removed. */
+    rv = __diff_array( items, old_count, old, &items[old_count], new_count, new,
+                       NULL, d );
+    free( items );
+
+    return rv;
+}
+
+/* See diff.h for details. */
+int diff_gre( const gre_t *old, const gre_t *new, diff_sub_t *d )
+{
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT | GRE_FIELDS;
+    } else if( NULL != old ) {
+        if( !__same_bytes(old->primary_remote_endpoint, old->primary_remote_endpoint_len,
+                          new->primary_remote_endpoint, new->primary_remote_endpoint_len) )
+        {
+            d->fields |= DIFF_GRE_PRIMARY;
+        }
+        if( !__same_bytes(old->secondary_remote_endpoint, old->secondary_remote_endpoint_len,
+                          new->secondary_remote_endpoint, new->secondary_remote_endpoint_len) )
+        {
+            d->fields |= DIFF_GRE_SECONDARY;
+        }
+    }
+
+    return 0;
+}
+
+/* See diff.h for details. */
+int diff_portmapping( const portmapping_t *old, const portmapping_t *new, diff_sub_t *d )
+{
+    size_t old_count = (NULL != old) ? old->entries_count : 0;
+    size_t new_count = (NULL != new) ? new->entries_count : 0;
+    item_t *items;
+    size_t i;
+    int rv;
+
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT;
+    }
+
+    items = (item_t*) calloc( old_count + new_count + 1, sizeof(item_t) );
+    if( NULL == items ) {
+        return -1;
+    }
+
+    for( i = 0; i < old_count; i++ ) {
+        const pm_entry_t *e = &old->entries[i];
+
+        items[i].n = ((uint32_t) e->port_range[0] << 16) | e->port_range[1];
+        items[i].p = e->protocol;
+        items[i].len = e->protocol_len;
+        items[i].i = i;
+    }
+    for( i = 0; i < new_count; i++ ) {
+        const pm_entry_t *e = &new->entries[i];
+
+        items[old_count + i].n = ((uint32_t) e->port_range[0] << 16) | e->port_range[1];
+        items[old_count + i].p = e->protocol;
+        items[old_count + i].len = e->protocol_len;
+        items[old_count + i].i = i;
+    }
+
+    rv = __diff_array( items, old_count, old, &items[old_count], new_count, new,
+                       __same_mapping, d );
+    if( (0 < d->entries_count) || (DIFF_PRESENT & d->fields) ) {
+        d->fields |= DIFF_PORTMAPPING_ENTRIES;
+    }
+    free( items );
+
+    return rv;
+}
+
+/* See diff.h for details. */
+int diff_wifi( const wifi_t *old, const wifi_t *new, diff_sub_t *d )
+{
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT | WIFI_FIELDS;
+    } else if( NULL != old ) {
+        d->fields = __wifi_band( &old->config_5g, &new->config_5g ) |
+                    (__wifi_band(&old->config_2g, &new->config_2g) << DIFF_WIFI_2G);
+    }
+
+    return 0;
+}
+
+/* See diff.h for details. */
+int diff_xdns( const xdns_t *old, const xdns_t *new, diff_sub_t *d )
+{
+    memset( d, 0, sizeof(diff_sub_t) );
+
+    if( (NULL == old) != (NULL == new) ) {
+        d->fields = DIFF_PRESENT | XDNS_FIELDS;
+    } else if( NULL != old ) {
+        if( old->default_ipv4 != new->default_ipv4 ) {
+            d->fields |= DIFF_XDNS_DEFAULT_IPV4;
+        }
+        if( 0 != memcmp(old->default_ipv6, new->default_ipv6, sizeof(old->default_ipv6)) ) {
+            d->fields |= DIFF_XDNS_DEFAULT_IPV6;
+        }
+    }
+
+    return 0;
+}
+
+/* See diff.h for details. */
+void diff_sub_destroy( diff_sub_t *d )
+{
+    if( NULL != d->entries ) {
+        free( d->entries );
+    }
+    memset( d, 0, sizeof(diff_sub_t) );
+}
+
+/* See diff.h for details. */
+void diff_destroy( diff_t *d )
+{
+    if( NULL != d ) {
+        diff_sub_destroy( &d->dhcp );
+        diff_sub_destroy( &d->firewall );
+        diff_sub_destroy( &d->gre );
+        diff_sub_destroy( &d->portmapping );
+        diff_sub_destroy( &d->wifi );
+        diff_sub_destroy( &d->xdns );
+        free( d );
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Matches the entries of two arrays by key: both are sorted, then walked
+ *  together, so the changes come out in key order.
+ *
+ *  @param old_items the keys of the old entries, sorted in place
+ *  @param old       the old subsystem, passed to same
+ *  @param new_items the keys of the new entries, sorted in place
+ *  @param new       the new subsystem, passed to same
+ *  @param same      compares entries with the same key, NULL if the key is
+ *                   the whole entry
+ *  @param d         where the changes go
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __diff_array( item_t *old_items, size_t old_count, const void *old,
+                         item_t *new_items, size_t new_count, const void *new,
+                         same_fn same, diff_sub_t *d )
+{
+    size_t o = 0, n = 0;
+
+    if( 0 == (old_count + new_count) ) {
+        return 0;
+    }
+
+    d->entries = (diff_entry_t*) malloc( (old_count + new_count) * sizeof(diff_entry_t) );
+    if( NULL == d->entries ) {
+        return -1;
+    }
+
+    qsort( old_items, old_count, sizeof(item_t), __item_cmp );
+    qsort( new_items, new_count, sizeof(item_t), __item_cmp );
+
+    while( (o < old_count) || (n < new_count) ) {
+        diff_entry_t *e = &d->entries[d->entries_count];
+        int cmp;
+
+        if( o == old_count ) {
+            cmp = 1;
+        } else if( n == new_count ) {
+            cmp = -1;
+        } else {
+            cmp = __key_cmp( &old_items[o], &new_items[n] );
+        }
+
+        if( cmp < 0 ) {
+            e->op = DIFF_REMOVED;
+            e->old_index = old_items[o++].i;
+            e->new_index = 0;
+            d->entries_count++;
+        } else if( 0 < cmp ) {
+            e->op = DIFF_ADDED;
+            e->old_index = 0;
+            e->new_index = new_items[n++].i;
+            d->entries_count++;
+        } else {
+            if( (NULL != same) && !same(old, old_items[o].i, new, new_items[n].i) ) {
+                e->op = DIFF_MODIFIED;
+                e->old_index = old_items[o].i;
+                e->new_index = new_items[n].i;
+                d->entries_count++;
+            }
+            o++;
+            n++;
+        }
+    }
+
+    if( 0 == d->entries_count ) {
+        free( d->entries );
+        d->entries = NULL;
+    }
+
+    return 0;
+}
+
+/**
+ *  Orders two keys.
+ */
+static int __key_cmp( const item_t *a, const item_t *b )
+{
+    size_t len = (a->len < b->len) ? a->len : b->len;
+    int rv;
+
+    if( a->n != b->n ) {
+        return (a->n < b->n) ? -1 : 1;
+    }
+
+    rv = (0 < len) ? memcmp( a->p, b->p, len ) : 0;
+    if( 0 != rv ) {
+        return rv;
+    }
+    if( a->len != b->len ) {
+        return (a->len < b->len) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ *  Orders two items by key, then by index so equal keys keep their order.
+ */
+static int __item_cmp( const void *a, const void *b )
+{
+    const item_t *x = (const item_t*) a;
+    const item_t *y = (const item_t*) b;
+    int rv;
+
+    rv = __key_cmp( x, y );
+    if( 0 == rv ) {
+        rv = (x->i < y->i) ? -1 : (x->i > y->i);
+    }
+
+    return rv;
+}
+
+static bool __same_lease( const void *old, size_t oi, const void *new, size_t ni )
+{
+    return ((const dhcp_t*) old)->fixed[oi].ip == ((const dhcp_t*) new)->fixed[ni].ip;
+}
+
+static bool __same_mapping( const void *old, size_t oi, const void *new, size_t ni )
+{
+    const pm_entry_t *a = &((const portmapping_t*) old)->entries[oi];
+    const pm_entry_t *b = &((const portmapping_t*) new)->entries[ni];
+
+    if( (a->target_port != b->target_port) || (a->ip_version != b->ip_version) ) {
+        return false;
+    }
+
+    if( 4 == a->ip_version ) {
+        return a->ip.v4 == b->ip.v4;
+    }
+
+    return 0 == memcmp( a->ip.v6, b->ip.v6, sizeof(a->ip.v6) );
+}
+
+static bool __same_bytes( const void *a, size_t a_len, const void *b, size_t b_len )
+{
+    return (a_len == b_len) && ((0 == a_len) || (0 == memcmp(a, b, a_len)));
+}
+
+static bool __same_str( const char *a, const char *b )
+{
+    if( (NULL == a) || (NULL == b) ) {
+        return a == b;
+    }
+
+    return 0 == strcmp( a, b );
+}
+
+/**
+ *  Finds the DIFF_WIFI_* that changed in one band.
+ */
+static uint32_t __wifi_band( const wifi_config_t *a, const wifi_config_t *b )
+{
+    uint32_t fields = 0;
+    size_t i;
+
+    if( a->extension_channel != b->extension_channel ) fields |= DIFF_WIFI_EXTENSION_CHANNEL;
+    if( a->channel != b->channel )                     fields |= DIFF_WIFI_CHANNEL;
+    if( a->bandwith != b->bandwith )                   fields |= DIFF_WIFI_BANDWITH;
+    if( a->dfs_enabled != b->dfs_enabled )             fields |= DIFF_WIFI_DFS_ENABLED;
+    if( !__same_str(a->basic_rate, b->basic_rate) )    fields |= DIFF_WIFI_BASIC_RATE;
+    if( a->tx_power != b->tx_power )                   fields |= DIFF_WIFI_TX_POWER;
+
+    if( !__same_bytes(a->standards, a->standards_count, b->standards, b->standards_count) ) {
+        fields |= DIFF_WIFI_STANDARDS;
+    }
+
+    if( a->aps_count != b->aps_count ) {
+        fields |= DIFF_WIFI_APS;
+    }
+    for( i = 0; !(DIFF_WIFI_APS & fields) && (i < a->aps_count); i++ ) {
+        const wifi_ap_t *x = &a->aps[i];
+        const wifi_ap_t *y = &b->aps[i];
+
+        if( !__same_str(x->name, y->name) ||
+            !__same_str(x->ssid, y->ssid) ||
+            !__same_str(x->password, y->password) ||
+            !__same_str(x->advertisement, y->advertisement) ||
+            !__same_str(x->security_mode, y->security_mode) ||
+            !__same_str(x->method, y->method) )
+        {
+            fields |= DIFF_WIFI_APS;
+        }
+    }
+
+    return fields;
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __DIFF_H__
+#define __DIFF_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "all.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* The subsystem is in only one of the configs. */
+#define DIFF_PRESENT                (1u << 31)
+
+/* The fields of each subsystem that changed, in diff_sub_t.fields. */
+#define DIFF_DHCP_ROUTER_IP         (1u << 0)
+#define DIFF_DHCP_SUBNET_MASK       (1u << 1)
+#define DIFF_DHCP_POOL_RANGE        (1u << 2)
+#define DIFF_DHCP_LEASE_LENGTH      (1u << 3)
+#define DIFF_DHCP_FIXED             (1u << 4)
+
+#define DIFF_FIREWALL_LEVEL         (1u << 0)
+#define DIFF_FIREWALL_FILTERS       (1u << 1)   /* Including their order. */
+
+#define DIFF_GRE_PRIMARY            (1u << 0)
+#define DIFF_GRE_SECONDARY          (1u << 1)
+
+#define DIFF_PORTMAPPING_ENTRIES    (1u << 0)
+
+/* The 5GHz fields; the same for 2.4GHz are shifted by DIFF_WIFI_2G. */
+#define DIFF_WIFI_EXTENSION_CHANNEL (1u << 0)
+#define DIFF_WIFI_CHANNEL           (1u << 1)
+#define DIFF_WIFI_BANDWITH          (1u << 2)
+#define DIFF_WIFI_STANDARDS         (1u << 3)
+#define DIFF_WIFI_APS               (1u << 4)
+#define DIFF_WIFI_DFS_ENABLED       (1u << 5)
+#define DIFF_WIFI_BASIC_RATE        (1u << 6)
+#define DIFF_WIFI_TX_POWER          (1u << 7)
+#define DIFF_WIFI_2G                16
+
+#define DIFF_XDNS_DEFAULT_IPV4      (1u << 0)
+#define DIFF_XDNS_DEFAULT_IPV6      (1u << 1)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+typedef enum {
+    DIFF_ADDED,
+    DIFF_REMOVED,
+    DIFF_MODIFIED,
+} diff_op_t;
+
+/**
+ *  A change to an entry of an array.  Entries are matched by their key: the
+ *  MAC of a dhcp fixed lease, the whole firewall filter, and the protocol &
+ *  external port range of a port mapping.  Entries with the same key are
+ *  matched in the order they appear.
+ */
+typedef struct {
+    diff_op_t op;
+    size_t old_index;           /* Into the old array, unless DIFF_ADDED. */
+    size_t new_index;           /* Into the new array, unless DIFF_REMOVED. */
+} diff_entry_t;
+
+/* The changes to a subsystem. */
+typedef struct {
+    uint32_t fields;            /* The DIFF_* of what changed, 0 if nothing. */
+    diff_entry_t *entries;      /* The changes to the array, by key. */
+    size_t entries_count;
+} diff_sub_t;
+
+/**
+ *  The changes between two configs.  The old one can be had from
+ *  webcfg_get_current() when a new one arrives.
+ */
+typedef struct {
+    diff_sub_t dhcp;
+    diff_sub_t firewall;
+    diff_sub_t gre;
+    diff_sub_t portmapping;
+    diff_sub_t wifi;
+    diff_sub_t xdns;
+} diff_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function finds what changed between two configs.  Arrays are
+ *  matched by sorting their keys, in O(n log n).
+ *
+ *  @param old the previous config, may be NULL
+ *  @param new the new config, may be NULL
+ *
+ *  @return NULL on error, success otherwise
+ */
+diff_t* diff_all( const all_t *old, const all_t *new );
+
+/**
+ *  These functions find what changed in one subsystem.  A subsystem that
+ *  is NULL on one side has every field & entry changed, with DIFF_PRESENT.
+ *
+ *  @param old the previous subsystem, may be NULL
+ *  @param new the new subsystem, may be NULL
+ *  @param d   the changes, released with diff_sub_destroy()
+ *
+ *  @return 0 on success, error otherwise
+ */
+int diff_dhcp( const dhcp_t *old, const dhcp_t *new, diff_sub_t *d );
+int diff_firewall( const firewall_t *old, const firewall_t *new, diff_sub_t *d );
+int diff_gre( const gre_t *old, const gre_t *new, diff_sub_t *d );
+int diff_portmapping( const portmapping_t *old, const portmapping_t *new, diff_sub_t *d );
+int diff_wifi( const wifi_t *old, const wifi_t *new, diff_sub_t *d );
+int diff_xdns( const xdns_t *old, const xdns_t *new, diff_sub_t *d );
+
+/**
+ *  This function releases the changes to a subsystem.
+ *
+ *  @param d the changes
+ */
+void diff_sub_destroy( diff_sub_t *d );
+
+/**
+ *  This function destroys the changes between two configs.
+ *
+ *  @param d the changes to destroy
+ */
+void diff_destroy( diff_t *d );
+
+#endif
@@ -15,15 +15,18 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "envelope.h"
 #include "helpers.h"
+#include "sha256.h"
+#include "token.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+
+/* Room reserved for the schema base when decoding incrementally. */
+#define STREAM_ARENA_SIZE 64
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -38,19 +41,94 @@ enum {
     ENV_MISSING_SCHEMA_MINOR_ELEMENT,
     ENV_MISSING_SCHEMA_PATCH_ELEMENT,
     ENV_MISSING_SHA256_ELEMENT,
-    ENV_MISSING_PAYLOAD_ELEMENT
+    ENV_MISSING_PAYLOAD_ELEMENT,
+    ENV_INCOMPLETE,
+    ENV_SHA256_MISMATCH
+};
+
+enum stream_state {
+    STREAM_ROOT,
+    STREAM_ENV_KEY,
+    STREAM_ENV_VALUE,
+    STREAM_SCHEMA_KEY,
+    STREAM_SCHEMA_VALUE,
+    STREAM_DONE,
+    STREAM_ERROR
+};
+
+enum {
+    KEY_UNKNOWN,
+    KEY_SCHEMA,
+    KEY_SHA256,
+    KEY_PAYLOAD,
+    KEY_BASE,
+    KEY_MAJOR,
+    KEY_MINOR,
+    KEY_PATCH
+};
+
+struct envelope_stream {
+    envelope_t *env;            /* The envelope being built. */
+    enum stream_state state;
+    int key;                    /* The field the last key named. */
+    uint8_t env_left;           /* Same bits as process_env(). */
+    uint8_t schema_left;        /* Same bits as process_schema(). */
+    uint32_t env_entries;       /* Entries left in the envelope map. */
+    uint32_t schema_entries;    /* Entries left in the schema map. */
+    uint64_t skip;              /* Elements left in an ignored value. */
+    int err;
+
+    /* The header being assembled. */
+    uint8_t hdr[TOKEN_MAX_HEADER];
+    size_t hdr_len;
+    size_t hdr_need;
+    token_t token;
+
+    /* Where the decoder is in the buffer. */
+    bool view;                  /* The payload is not copied. */
+    size_t offset;              /* The bytes written so far. */
+    size_t payload_at;          /* The offset of the payload, if view. */
+
+    /* The data following the header. */
+    uint8_t *dest;              /* Where to copy the data, NULL to discard. */
+    uint32_t data_left;
+    bool consumed;              /* The value is being stored. */
+    bool hashing;               /* The data is the payload. */
+    sha256_t hash;              /* The payload hashed as it arrives. */
+
+    char key_buf[8];
+    size_t key_len;
 };
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __env_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "schema",  's', 'c', 'a', KEY_SCHEMA ),
+    HELPER_KEY( "sha256",  's', 'h', '6', KEY_SHA256 ),
+    HELPER_KEY( "payload", 'p', 'a', 'd', KEY_PAYLOAD ),
+};
+
+static const helper_key_t __schema_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "base",  'b', 'a', 'e', KEY_BASE ),
+    HELPER_KEY( "major", 'm', 'a', 'r', KEY_MAJOR ),
+    HELPER_KEY( "minor", 'm', 'i', 'r', KEY_MINOR ),
+    HELPER_KEY( "patch", 'p', 'a', 'h', KEY_PATCH ),
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_schema( schema_t *s, msgpack_object_map *map );
-int process_env( envelope_t *e, msgpack_object *obj );
+int process_schema( schema_t *s, cursor_t *c, const token_t *map, helper_ctx_t *ctx );
+int process_env( envelope_t *e, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+int process_env_fields( envelope_t *e, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+static envelope_stream_t* __stream_create( bool view );
+static int __stream_header( envelope_stream_t *s );
+static void __stream_item( envelope_stream_t *s );
+static void __stream_advance( envelope_stream_t *s );
+static void __stream_error( envelope_stream_t *s, int err );
+static int __stream_key( envelope_stream_t *s );
+static int __verify( const envelope_t *e, const uint8_t digest[SHA256_SIZE] );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -60,23 +138,187 @@ int process_env( envelope_t *e, msgpack_object *obj );
 envelope_t* envelope_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(envelope_t), NULL,
-                           MSGPACK_OBJECT_MAP, false,
+                           TOKEN_MAP, false, false, NULL,
                            (process_fn_t) process_env,
                            (destroy_fn_t) envelope_destroy );
 }
 
 /* See envelope.h for details. */
-void envelope_destroy( envelope_t *env )
+envelope_t* envelope_convert_view( const void *buf, size_t len )
+{
+    return helper_convert( buf, len, sizeof(envelope_t), NULL,
+                           TOKEN_MAP, false, true, NULL,
+                           (process_fn_t) process_env,
+                           (destroy_fn_t) envelope_destroy );
+}
+
+/* See envelope.h for details. */
+int envelope_peek( const void *buf, size_t len, schema_t *schema, uint8_t sha256[32] )
 {
-    if( NULL != env ) {
-        if( NULL != env->schema.base ) {
-            free( env->schema.base );
+    envelope_t *e;
+
+    e = helper_convert( buf, len, sizeof(envelope_t), NULL,
+                        TOKEN_MAP, false, true, NULL,
+                        (process_fn_t) process_env_fields,
+                        (destroy_fn_t) envelope_destroy );
+    if( NULL == e ) {
+        return -1;
+    }
+
+    memcpy( schema, &e->schema, sizeof(schema_t) );
+    memcpy( sha256, e->sha256, member_size(envelope_t, sha256) );
+    envelope_destroy( e );
+
+    return 0;
+}
+
+/* See envelope.h for details. */
+envelope_stream_t* envelope_stream_create( void )
+{
+    return __stream_create( false );
+}
+
+/* See envelope.h for details. */
+envelope_stream_t* envelope_stream_create_view( void )
+{
+    return __stream_create( true );
+}
+
+/* See envelope.h for details. */
+int envelope_stream_write( envelope_stream_t *s, const void *buf, size_t len )
+{
+    const uint8_t *p = (const uint8_t*) buf;
+
+    while( (0 < len) && (STREAM_DONE != s->state) && (STREAM_ERROR != s->state) ) {
+        size_t n;
+
+        if( 0 < s->data_left ) {
+            n = (len < s->data_left) ? len : s->data_left;
+            s->offset += n;
+            if( NULL != s->dest ) {
+                memcpy( s->dest, p, n );
+                s->dest += n;
+            }
+            if( s->hashing ) {
+                sha256_update( &s->hash, p, n );
+            }
+            s->data_left -= (uint32_t) n;
+            if( 0 == s->data_left ) {
+                __stream_item( s );
+            }
+        } else {
+            if( 0 == s->hdr_len ) {
+                s->hdr_need = token_header_size( *p );
+                if( 0 == s->hdr_need ) {
+                    __stream_error( s, ENV_INVALID_FIRST_ELEMENT );
+                    break;
+                }
+            }
+
+            n = s->hdr_need - s->hdr_len;
+            n = (len < n) ? len : n;
+            memcpy( &s->hdr[s->hdr_len], p, n );
+            s->hdr_len += n;
+            s->offset += n;
+
+            if( s->hdr_len == s->hdr_need ) {
+                s->hdr_len = 0;
+                token_decode( s->hdr, &s->token );
+                if( 0 != __stream_header(s) ) {
+                    break;
+                }
+                s->data_left = token_data_size( &s->token );
+                if( 0 == s->data_left ) {
+                    __stream_item( s );
+                }
+            }
         }
-        if( NULL != env->payload ) {
-            free( env->payload );
+
+        p += n;
+        len -= n;
+    }
+
+    if( STREAM_ERROR == s->state ) {
+        errno = s->err;
+        return -1;
+    }
+
+    errno = ENV_OK;
+    return 0;
+}
+
+/* See envelope.h for details. */
+envelope_t* envelope_stream_finish( envelope_stream_t *s )
+{
+    envelope_t *env = NULL;
+    uint8_t digest[SHA256_SIZE];
+
+    if( NULL == s ) {
+        return NULL;
+    }
+
+    if( STREAM_ERROR == s->state ) {
+        errno = s->err;
+    } else if( STREAM_DONE != s->state ) {
+        errno = ENV_INCOMPLETE;
+    } else if( 1 & s->env_left ) {
+        errno = ENV_MISSING_SCHEMA_ELEMENT;
+    } else if( (1 << 1) & s->env_left ) {
+        errno = ENV_MISSING_SHA256_ELEMENT;
+    } else if( (1 << 2) & s->env_left ) {
+        errno = ENV_MISSING_PAYLOAD_ELEMENT;
+    } else {
+        sha256_final( &s->hash, digest );
+        if( 0 != __verify(s->env, digest) ) {
+            envelope_stream_destroy( s );
+            return NULL;
         }
-        free( env );
+        env = s->env;
+        s->env = NULL;
+        errno = ENV_OK;
+    }
+
+    envelope_stream_destroy( s );
+
+    return env;
+}
+
+/* See envelope.h for details. */
+envelope_t* envelope_stream_finish_view( envelope_stream_t *s, const void *buf, size_t len )
+{
+    envelope_t *env;
+    size_t at;
+
+    if( NULL == s ) {
+        return NULL;
     }
+
+    at = s->payload_at;
+    if( (len < s->offset) && (STREAM_ERROR != s->state) ) {
+        __stream_error( s, ENV_INCOMPLETE );
+    }
+
+    env = envelope_stream_finish( s );
+    if( (NULL != env) && (0 < env->len) ) {
+        env->payload = (uint8_t*) buf + at;
+    }
+
+    return env;
+}
+
+/* See envelope.h for details. */
+void envelope_stream_destroy( envelope_stream_t *s )
+{
+    if( NULL != s ) {
+        envelope_destroy( s->env );
+        free( s );
+    }
+}
+
+/* See envelope.h for details. */
+void envelope_destroy( envelope_t *env )
+{
+    helper_free( env );
 }
 
 /* See envelope.h for details. */
@@ -96,6 +338,8 @@ const char* envelope_strerror( int errnum )
         { .v = ENV_MISSING_SCHEMA_PATCH_ELEMENT,    .txt = "'patch' element missing." },
         { .v = ENV_MISSING_SHA256_ELEMENT,          .txt = "'sha256' element missing." },
         { .v = ENV_MISSING_PAYLOAD_ELEMENT,         .txt = "'payload' element missing." },
+        { .v = ENV_INCOMPLETE,                      .txt = "Incomplete envelope." },
+        { .v = ENV_SHA256_MISMATCH,                 .txt = "'sha256' does not match the payload." },
         { .v = 0, .txt = NULL }
     };
     int i = 0;
@@ -116,42 +360,58 @@ const char* envelope_strerror( int errnum )
  *  Convert the msgpack map into the schema_t structure.
  *
  *  @param s    schema pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param map  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_schema( schema_t *s, msgpack_object_map *map )
+int process_schema( schema_t *s, cursor_t *c, const token_t *map, helper_ctx_t *ctx )
 {
-    int size = map->size;
+    uint32_t left = map->size;
     uint8_t objects_left = 0x0f;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < size--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( (MSGPACK_OBJECT_STR == p->val.type) && (0 == match(p, "base")) ) {
-                objects_left &= ~(1 << 0);
-                s->base = strndup( p->val.via.str.ptr, p->val.via.str.size );
-                if( NULL == s->base ) {
-                    errno = ENV_OUT_OF_MEMORY;
-                    return -1;
+    token_t key, val;
+
+    cursor_enter( c );
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__schema_keys, &key) ) {
+            case KEY_BASE:
+                if( TOKEN_STR == val.type ) {
+                    objects_left &= ~(1 << 0);
+                    s->base_len = val.size;
+                    s->base = helper_str( ctx, val.ptr, s->base_len );
+                    if( NULL == s->base ) {
+                        errno = ENV_OUT_OF_MEMORY;
+                        return -1;
+                    }
                 }
-            } else if( MSGPACK_OBJECT_POSITIVE_INTEGER == p->val.type ) {
-                if( 0 == match(p, "major") ) {
-                    s->major = p->val.via.u64;
+                break;
+            case KEY_MAJOR:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    s->major = val.via.u64;
                     objects_left &= ~(1 << 1);
-                } else if( 0 == match(p, "minor") ) {
-                    s->minor = p->val.via.u64;
+                }
+                break;
+            case KEY_MINOR:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    s->minor = val.via.u64;
                     objects_left &= ~(1 << 2);
-                } else if( 0 == match(p, "patch") ) {
-                    s->patch = p->val.via.u64;
+                }
+                break;
+            case KEY_PATCH:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    s->patch = val.via.u64;
                     objects_left &= ~(1 << 3);
                 }
-            }
+                break;
+            default:
+                break;
         }
-
-        p++;
     }
+    cursor_skip( c, 2 * (uint64_t) left );
 
     if( 1 & objects_left ) {
         errno = ENV_MISSING_SCHEMA_BASE_ELEMENT;
@@ -168,47 +428,79 @@ int process_schema( schema_t *s, msgpack_object_map *map )
     return (0 == objects_left) ? 0 : -1;
 }
 
+/**
+ *  Convert the msgpack map into the envelope_t structure, verifying the
+ *  payload.
+ *
+ *  @param e    envelope pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
+ *
+ *  @return 0 on success, error otherwise
+ */
+int process_env( envelope_t *e, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
+{
+    uint8_t digest[SHA256_SIZE];
+
+    if( 0 != process_env_fields(e, c, obj, ctx) ) {
+        return -1;
+    }
+
+    sha256( e->payload, e->len, digest );
+    return __verify( e, digest );
+}
+
 /**
  *  Convert the msgpack map into the envelope_t structure.
  *
  *  @param e    envelope pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_env( envelope_t *e, msgpack_object *obj )
+int process_env_fields( envelope_t *e, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int size = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x07;
-    msgpack_object_kv *p;
+    token_t key, val;
     size_t sha256_size = member_size(envelope_t, sha256);
 
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < size--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( (MSGPACK_OBJECT_MAP == p->val.type) && (0 == match(p, "schema")) ) {
-                if( 0 != process_schema( &e->schema, &p->val.via.map) ) {
-                    return -1;
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__env_keys, &key) ) {
+            case KEY_SCHEMA:
+                if( TOKEN_MAP == val.type ) {
+                    if( 0 != process_schema( &e->schema, c, &val, ctx) ) {
+                        return -1;
+                    }
+                    objects_left &= ~(1 << 0);
                 }
-                objects_left &= ~(1 << 0);
-            } else if( MSGPACK_OBJECT_BIN == p->val.type ) {
-                if( (sha256_size == p->val.via.bin.size) && (0 == match(p, "sha256")) ) {
-                    memcpy( e->sha256, p->val.via.bin.ptr, sha256_size );
+                break;
+            case KEY_SHA256:
+                if( (TOKEN_BIN == val.type) && (sha256_size == val.size) ) {
+                    memcpy( e->sha256, val.ptr, sha256_size );
                     objects_left &= ~(1 << 1);
-                } else if( 0 == match(p, "payload") ) {
-                    e->len = p->val.via.bin.size;
-                    e->payload = malloc( e->len );
-                    if( NULL == e->payload ) {
+                }
+                break;
+            case KEY_PAYLOAD:
+                if( TOKEN_BIN == val.type ) {
+                    e->len = val.size;
+                    e->payload = helper_bin( ctx, val.ptr, e->len );
+                    if( (NULL == e->payload) && (0 < e->len) ) {
                         errno = ENV_OUT_OF_MEMORY;
                         return -1;
                     }
-                    memcpy( e->payload, p->val.via.bin.ptr, e->len );
                     objects_left &= ~(1 << 2);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     if( 1 & objects_left ) {
@@ -223,3 +515,291 @@ int process_env( envelope_t *e, msgpack_object *obj )
 
     return (0 == objects_left) ? 0 : -1;
 }
+
+/**
+ *  Creates an incremental decoder.
+ *
+ *  @param view true to leave the payload where it is & note where that is
+ *
+ *  @return NULL on error, success otherwise
+ */
+static envelope_stream_t* __stream_create( bool view )
+{
+    envelope_stream_t *s;
+
+    s = (envelope_stream_t*) malloc( sizeof(envelope_stream_t) );
+    if( NULL != s ) {
+        memset( s, 0, sizeof(envelope_stream_t) );
+        s->view = view;
+        s->env_left = 0x07;
+        s->schema_left = 0x0f;
+        sha256_init( &s->hash );
+        s->env = helper_create( sizeof(envelope_t), STREAM_ARENA_SIZE, false );
+        if( NULL == s->env ) {
+            free( s );
+            s = NULL;
+        }
+    }
+
+    if( NULL == s ) {
+        errno = ENV_OUT_OF_MEMORY;
+    }
+
+    return s;
+}
+
+/**
+ *  Handles a complete header before any data that follows it, deciding
+ *  where the data goes.
+ *
+ *  @param s the decoder
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __stream_header( envelope_stream_t *s )
+{
+    token_t *t = &s->token;
+    helper_ctx_t *ctx = helper_ctx( s->env );
+
+    s->dest = NULL;
+    s->consumed = false;
+    s->hashing = false;
+
+    if( 0 < s->skip ) {
+        return 0;
+    }
+
+    switch( s->state ) {
+        case STREAM_ENV_KEY:
+        case STREAM_SCHEMA_KEY:
+            s->key_len = t->size;
+            if( (TOKEN_STR == t->type) && (t->size <= sizeof(s->key_buf)) ) {
+                s->dest = (uint8_t*) s->key_buf;
+            }
+            break;
+
+        case STREAM_ENV_VALUE:
+            if( (KEY_SHA256 == s->key) && (TOKEN_BIN == t->type) &&
+                (member_size(envelope_t, sha256) == t->size) &&
+                ((1 << 1) & s->env_left) )
+            {
+                s->dest = s->env->sha256;
+                s->consumed = true;
+            } else if( (KEY_PAYLOAD == s->key) && (TOKEN_BIN == t->type) &&
+                       ((1 << 2) & s->env_left) )
+            {
+                s->env->len = t->size;
+                s->payload_at = s->offset;
+                if( (0 < t->size) && !s->view ) {
+                    s->env->payload = (uint8_t*) helper_alloc( ctx, t->size );
+                    if( NULL == s->env->payload ) {
+                        __stream_error( s, ENV_OUT_OF_MEMORY );
+                        return -1;
+                    }
+                }
+                s->dest = s->env->payload;
+                s->consumed = true;
+                s->hashing = true;
+            }
+            break;
+
+        case STREAM_SCHEMA_VALUE:
+            if( (KEY_BASE == s->key) && (TOKEN_STR == t->type) && (1 & s->schema_left) ) {
+                s->env->schema.base_len = t->size;
+                s->env->schema.base = (char*) helper_alloc( ctx, t->size + 1 );
+                if( NULL == s->env->schema.base ) {
+                    __stream_error( s, ENV_OUT_OF_MEMORY );
+                    return -1;
+                }
+                s->dest = (uint8_t*) s->env->schema.base;
+                s->consumed = true;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return 0;
+}
+
+/**
+ *  Handles a complete item: the header and any data that follows it.
+ *
+ *  @param s the decoder
+ */
+static void __stream_item( envelope_stream_t *s )
+{
+    token_t *t = &s->token;
+    schema_t *schema = &s->env->schema;
+
+    if( 0 < s->skip ) {
+        s->skip += token_children( t ) - 1;
+        if( 0 == s->skip ) {
+            __stream_advance( s );
+        }
+        return;
+    }
+
+    switch( s->state ) {
+        case STREAM_ROOT:
+            if( TOKEN_MAP != t->type ) {
+                __stream_error( s, ENV_INVALID_FIRST_ELEMENT );
+                return;
+            }
+            s->env_entries = t->size;
+            s->state = (0 < s->env_entries) ? STREAM_ENV_KEY : STREAM_DONE;
+            return;
+
+        case STREAM_ENV_KEY:
+        case STREAM_SCHEMA_KEY:
+            s->key = __stream_key( s );
+            break;
+
+        case STREAM_ENV_VALUE:
+            if( s->consumed ) {
+                s->env_left &= (KEY_SHA256 == s->key) ? ~(1 << 1) : ~(1 << 2);
+            } else if( (KEY_SCHEMA == s->key) && (TOKEN_MAP == t->type) && (1 & s->env_left) ) {
+                s->schema_entries = t->size;
+                if( 0 < s->schema_entries ) {
+                    s->state = STREAM_SCHEMA_KEY;
+                    return;
+                }
+                s->state = STREAM_SCHEMA_VALUE;
+            }
+            break;
+
+        case STREAM_SCHEMA_VALUE:
+            if( s->consumed ) {
+                schema->base[schema->base_len] = '\0';
+                s->schema_left &= ~(1 << 0);
+            } else if( TOKEN_POSITIVE_INTEGER == t->type ) {
+                if( (KEY_MAJOR == s->key) && ((1 << 1) & s->schema_left) ) {
+                    schema->major = t->via.u64;
+                    s->schema_left &= ~(1 << 1);
+                } else if( (KEY_MINOR == s->key) && ((1 << 2) & s->schema_left) ) {
+                    schema->minor = t->via.u64;
+                    s->schema_left &= ~(1 << 2);
+                } else if( (KEY_PATCH == s->key) && ((1 << 3) & s->schema_left) ) {
+                    schema->patch = t->via.u64;
+                    s->schema_left &= ~(1 << 3);
+                }
+            }
+            break;
+
+        default:
+            return;
+    }
+
+    /* Anything not stored is skipped, including the contents of containers. */
+    s->skip = token_children( t );
+    if( 0 == s->skip ) {
+        __stream_advance( s );
+    }
+}
+
+/**
+ *  Moves past a completed key or value.
+ *
+ *  @param s the decoder
+ */
+static void __stream_advance( envelope_stream_t *s )
+{
+    switch( s->state ) {
+        case STREAM_ENV_KEY:
+            s->state = STREAM_ENV_VALUE;
+            break;
+
+        case STREAM_SCHEMA_KEY:
+            s->state = STREAM_SCHEMA_VALUE;
+            break;
+
+        case STREAM_SCHEMA_VALUE:
+            if( 0 < s->schema_entries ) {
+                s->schema_entries--;
+            }
+            if( 0 < s->schema_entries ) {
+                s->state = STREAM_SCHEMA_KEY;
+                break;
+            }
+
+            /* The schema map is complete, so is the envelope value. */
+            if( 1 & s->schema_left ) {
+                __stream_error( s, ENV_MISSING_SCHEMA_BASE_ELEMENT );
+                break;
+            } else if( (1 << 1) & s->schema_left ) {
+                __stream_error( s, ENV_MISSING_SCHEMA_MAJOR_ELEMENT );
+                break;
+            } else if( (1 << 2) & s->schema_left ) {
+                __stream_error( s, ENV_MISSING_SCHEMA_MINOR_ELEMENT );
+                break;
+            } else if( (1 << 3) & s->schema_left ) {
+                __stream_error( s, ENV_MISSING_SCHEMA_PATCH_ELEMENT );
+                break;
+            }
+            s->env_left &= ~(1 << 0);
+            /* fall through */
+
+        case STREAM_ENV_VALUE:
+            s->env_entries--;
+            s->state = (0 < s->env_entries) ? STREAM_ENV_KEY : STREAM_DONE;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**
+ *  Stops the decoder.
+ *
+ *  @param s   the decoder
+ *  @param err the reason
+ */
+static void __stream_error( envelope_stream_t *s, int err )
+{
+    s->state = STREAM_ERROR;
+    s->err = err;
+}
+
+/**
+ *  Determines which field the key just decoded names.
+ *
+ *  @param s the decoder
+ *
+ *  @return the field
+ */
+static int __stream_key( envelope_stream_t *s )
+{
+    token_t key = s->token;
+
+    if( sizeof(s->key_buf) < s->key_len ) {
+        return KEY_UNKNOWN;
+    }
+
+    key.ptr = s->key_buf;
+    if( STREAM_ENV_KEY == s->state ) {
+        return helper_key( __env_keys, &key );
+    }
+
+    return helper_key( __schema_keys, &key );
+}
+
+/**
+ *  Checks the payload's digest against the one the envelope carries.
+ *
+ *  @param e      the envelope
+ *  @param digest the digest of the payload
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __verify( const envelope_t *e, const uint8_t digest[SHA256_SIZE] )
+{
+    if( 0 != memcmp(e->sha256, digest, SHA256_SIZE) ) {
+        errno = ENV_SHA256_MISMATCH;
+        return -1;
+    }
+
+    errno = ENV_OK;
+    return 0;
+}
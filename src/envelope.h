@@ -21,6 +21,7 @@
 
 typedef struct {
     char *base;         /* (R) V 1.0.0 */
+    size_t base_len;
     uint64_t major;     /* (R) V 1.0.0 */
     uint64_t minor;     /* (R) V 1.0.0 */
     uint64_t patch;     /* (R) V 1.0.0 */
@@ -39,7 +40,7 @@ typedef struct {
 
 /**
  *  This function converts a msgpack buffer into an envelope_t structure
- *  if possible.
+ *  if possible.  The payload must match the 'sha256' element.
  *
  *  @note: errno is set with a custom error that can be made readable by
  *         envelope_strerror().
@@ -51,6 +52,113 @@ typedef struct {
  */
 envelope_t* envelope_convert( const void *buf, size_t len );
 
+/**
+ *  This function converts a msgpack buffer into an envelope_t structure
+ *  if possible, but references the schema base and payload in buf instead
+ *  of copying them.
+ *
+ *  @note: buf must remain valid & unchanged until the envelope is destroyed.
+ *         schema.base is not '\0' terminated, use schema.base_len instead.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_t* envelope_convert_view( const void *buf, size_t len );
+
+/**
+ *  This function reads the schema & sha256 of an envelope without copying
+ *  or verifying the payload, which is enough to tell if the envelope has
+ *  been seen before.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         envelope_strerror().  schema->base references buf and is not '\0'
+ *         terminated, use schema->base_len instead.
+ *
+ *  @param buf    the buffer to read
+ *  @param len    the length of the buffer in bytes
+ *  @param schema the schema of the envelope
+ *  @param sha256 the sha256 the envelope claims for the payload
+ *
+ *  @return 0 on success, error otherwise
+ */
+int envelope_peek( const void *buf, size_t len, schema_t *schema, uint8_t sha256[32] );
+
+/**
+ *  The incremental envelope decoder.  Bytes are written to it as they arrive
+ *  and the payload is copied straight into the resulting envelope_t.
+ */
+typedef struct envelope_stream envelope_stream_t;
+
+/**
+ *  This function creates an incremental envelope decoder.
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_stream_t* envelope_stream_create( void );
+
+/**
+ *  This function creates an incremental envelope decoder that verifies the
+ *  payload as it arrives but doesn't copy it: the caller keeps the bytes
+ *  (in a file, for example) & finishes with envelope_stream_finish_view().
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_stream_t* envelope_stream_create_view( void );
+
+/**
+ *  This function decodes the next part of the msgpack buffer.  The chunks
+ *  may be split anywhere.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         envelope_strerror().
+ *
+ *  @param s   the decoder
+ *  @param buf the next part of the buffer
+ *  @param len the length of the part in bytes
+ *
+ *  @return 0 on success, error otherwise (the rest of the envelope can be
+ *          discarded)
+ */
+int envelope_stream_write( envelope_stream_t *s, const void *buf, size_t len );
+
+/**
+ *  This function completes the decode, providing the envelope_t structure if
+ *  possible.  The decoder is destroyed either way.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         envelope_strerror().
+ *
+ *  @param s the decoder
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_t* envelope_stream_finish( envelope_stream_t *s );
+
+/**
+ *  This function completes the decode of an envelope_stream_create_view()
+ *  decoder like envelope_stream_finish(), with the payload referencing buf.
+ *
+ *  @note: buf must start with the bytes written to the decoder, and
+ *         remain valid & unchanged until the envelope is destroyed.
+ *
+ *  @param s   the decoder
+ *  @param buf the bytes written
+ *  @param len the length of buf in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+envelope_t* envelope_stream_finish_view( envelope_stream_t *s, const void *buf, size_t len );
+
+/**
+ *  This function destroys an incremental decoder that is not going to be
+ *  finished.
+ *
+ *  @param s the decoder to destroy
+ */
+void envelope_stream_destroy( envelope_stream_t *s );
+
 /**
  *  This function destroys an envelope_t object.
  *
@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "firewall.h"
@@ -36,15 +35,29 @@ enum {
     FIREWALL_INVALID_FILTERS,
 };
 
+enum {
+    KEY_LEVEL = 1,
+    KEY_FILTERS
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __firewall_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "level",   'l', 'e', 'l', KEY_LEVEL ),
+    HELPER_KEY( "filters", 'f', 'i', 's', KEY_FILTERS ),
+};
+
+static const helper_array_t __firewall_filters = {
+    .key = "filters",
+    .element_size = sizeof(char*) + sizeof(size_t),
+    .index_size = 0,
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_firewall( firewall_t *firewall, msgpack_object *obj );
+int process_firewall( firewall_t *firewall, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -54,30 +67,24 @@ int process_firewall( firewall_t *firewall, msgpack_object *obj );
 firewall_t* firewall_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(firewall_t), "firewall",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, &__firewall_filters,
                            (process_fn_t) process_firewall,
                            (destroy_fn_t) firewall_destroy );
 }
 
 /* See firewall.h for details. */
-void firewall_destroy( firewall_t *firewall )
+firewall_t* firewall_convert_view( const void *buf, size_t len )
 {
-    if( NULL != firewall ) {
-        size_t i;
+    return helper_convert( buf, len, sizeof(firewall_t), "firewall",
+                           TOKEN_MAP, true, true, &__firewall_filters,
+                           (process_fn_t) process_firewall,
+                           (destroy_fn_t) firewall_destroy );
+}
 
-        if( NULL != firewall->level ) {
-            free( firewall->level );
-        }
-        for( i = 0; i < firewall->filters_count; i++ ) {
-            if( NULL != firewall->filters[i] ) {
-                free( firewall->filters[i] );
-            }
-        }
-        if( NULL != firewall->filters ) {
-            free( firewall->filters );
-        }
-        free( firewall );
-    }
+/* See firewall.h for details. */
+void firewall_destroy( firewall_t *firewall )
+{
+    helper_free( firewall );
 }
 
 /* See firewall.h for details. */
@@ -112,48 +119,58 @@ const char* firewall_strerror( int errnum )
  *  Convert the msgpack map into the firewall_t structure.
  *
  *  @param firewall firewall pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_firewall( firewall_t *firewall, msgpack_object *obj )
+int process_firewall( firewall_t *firewall, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x03;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_STR == p->val.type ) {
-                if( 0 == match(p, "level") ) {
-                    firewall->level = strndup( p->val.via.str.ptr, p->val.via.str.size );
+    token_t key, val;
+
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__firewall_keys, &key) ) {
+            case KEY_LEVEL:
+                if( TOKEN_STR == val.type ) {
+                    firewall->level_len = val.size;
+                    firewall->level = helper_str( ctx, val.ptr, firewall->level_len );
                     if( NULL == firewall->level ) {
                         errno = FIREWALL_OUT_OF_MEMORY;
                         return -1;
                     }
                     objects_left &= ~(1 << 0);
                 }
-            } else if( MSGPACK_OBJECT_ARRAY == p->val.type ) {
-                if( 0 == match(p, "filters") ) {
+                break;
+            case KEY_FILTERS:
+                if( TOKEN_ARRAY == val.type ) {
                     uint32_t i;
-                    msgpack_object_array *array = &p->val.via.array;
-                    for( i = 0; i < array->size; i++ ) {
-                        if( MSGPACK_OBJECT_STR != array->ptr[i].type ) {
-                            errno = FIREWALL_INVALID_FILTERS;
-                            return -1;
-                        }
-                    }
-                    firewall->filters = (char**) malloc( array->size * sizeof(char*) );
-                    if( NULL == firewall->filters ) {
+
+                    firewall->filters = (char**) helper_alloc( ctx, val.size * sizeof(char*) );
+                    firewall->filter_lens = (size_t*) helper_alloc( ctx, val.size * sizeof(size_t) );
+                    if( (NULL == firewall->filters) || (NULL == firewall->filter_lens) ) {
                         errno = FIREWALL_OUT_OF_MEMORY;
                         return -1;
                     }
-                    memset( firewall->filters, 0, array->size * sizeof(char*) );
-                    firewall->filters_count = array->size;
-                    for( i = 0; i < array->size; i++ ) {
-                        firewall->filters[i] = strndup( array->ptr[i].via.str.ptr, array->ptr[i].via.str.size );
+                    memset( firewall->filters, 0, val.size * sizeof(char*) );
+                    firewall->filters_count = val.size;
+
+                    cursor_enter( c );
+                    for( i = 0; i < val.size; i++ ) {
+                        token_t filter;
+
+                        cursor_next( c, &filter );
+                        if( TOKEN_STR != filter.type ) {
+                            errno = FIREWALL_INVALID_FILTERS;
+                            return -1;
+                        }
+                        firewall->filter_lens[i] = filter.size;
+                        firewall->filters[i] = helper_str( ctx, filter.ptr, filter.size );
                         if( NULL == firewall->filters[i] ) {
                             errno = FIREWALL_OUT_OF_MEMORY;
                             return -1;
@@ -161,9 +178,10 @@ int process_firewall( firewall_t *firewall, msgpack_object *obj )
                     }
                     objects_left &= ~(1 << 1);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     errno = FIREWALL_OK;
@@ -21,7 +21,9 @@
 
 typedef struct {
     char *level;            /* (O) V 1.0.0 */
+    size_t level_len;
     char **filters;         /* (O) V 1.0.0 */
+    size_t *filter_lens;
     size_t filters_count;
 } firewall_t;
 
@@ -36,6 +38,20 @@ typedef struct {
  */
 firewall_t* firewall_convert( const void *buf, size_t len );
 
+/**
+ *  This function converts a msgpack buffer into an firewall_t structure
+ *  if possible, but references the level and filters in buf instead of copying them.
+ *
+ *  @note: buf must remain valid & unchanged until the firewall is destroyed.
+ *         The strings are not '\0' terminated, use the matching lengths.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+firewall_t* firewall_convert_view( const void *buf, size_t len );
+
 /**
  *  This function destroys an firewall_t object.
  *
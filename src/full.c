@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "full.h"
@@ -34,18 +33,47 @@ enum {
     FULL_INVALID_FIRST_ELEMENT   = HELPERS_INVALID_FIRST_ELEMENT,
     FULL_MISSING_FULL_ENTRY      = HELPERS_MISSING_WRAPPER,
     FULL_INVALID_SUBSYSTEMS,
+    FULL_MISSING_SUBSYSTEM,
+};
+
+enum {
+    KEY_SUBSYSTEMS = 1,
+    KEY_URL,
+    KEY_PAYLOAD
 };
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __full_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "subsystems", 's', 'u', 's', KEY_SUBSYSTEMS ),
+};
+
+static const helper_key_t __subsystem_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "url",     'u', 'r', 'l', KEY_URL ),
+    HELPER_KEY( "payload", 'p', 'a', 'd', KEY_PAYLOAD ),
+};
+
+static const helper_array_t __full_subsystems = {
+    .key = "subsystems",
+    .element_size = sizeof(subsystem_t),
+    .index_size = 0,
+};
+
+/* The lazy decode only indexes the subsystems, see full_get(). */
+static const helper_array_t __full_index = {
+    .key = "subsystems",
+    .element_size = sizeof(full_index_t),
+    .index_size = 0,
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_full( full_t *full, msgpack_object *obj );
-int process_subsystems( full_t *full, msgpack_object_array *array );
+int process_full( full_t *full, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+int process_full_lazy( full_t *full, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+int process_subsystems( full_t *full, cursor_t *c, const token_t *array, helper_ctx_t *ctx );
+static const subsystem_t* __materialize( full_t *full, full_index_t *idx );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -55,31 +83,60 @@ int process_subsystems( full_t *full, msgpack_object_array *array );
 full_t* full_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(full_t), "full",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, &__full_subsystems,
                            (process_fn_t) process_full,
                            (destroy_fn_t) full_destroy );
 }
 
 /* See full.h for details. */
-void full_destroy( full_t *full )
+full_t* full_convert_view( const void *buf, size_t len )
 {
-    if( NULL != full ) {
-        if( NULL != full->subsystems ) {
-            size_t i;
+    return helper_convert( buf, len, sizeof(full_t), "full",
+                           TOKEN_MAP, true, true, &__full_subsystems,
+                           (process_fn_t) process_full,
+                           (destroy_fn_t) full_destroy );
+}
 
-            for( i = 0; i < full->subsystems_count; i++ ) {
-                if( NULL != full->subsystems[i].url ) {
-                    free( full->subsystems[i].url );
-                }
-                if( NULL != full->subsystems[i].payload ) {
-                    free( full->subsystems[i].payload );
-                }
-            }
+/* See full.h for details. */
+full_t* full_convert_lazy( const void *buf, size_t len )
+{
+    return helper_convert( buf, len, sizeof(full_t), "full",
+                           TOKEN_MAP, true, true, &__full_index,
+                           (process_fn_t) process_full_lazy,
+                           (destroy_fn_t) full_destroy );
+}
 
-            free( full->subsystems );
+/* See full.h for details. */
+const subsystem_t* full_get( full_t *full, const char *url )
+{
+    size_t len = strlen( url );
+    size_t i;
+
+    for( i = 0; i < full->index_count; i++ ) {
+        full_index_t *idx = &full->index[i];
+
+        if( (len == idx->url_len) && (0 == memcmp(&full->source[idx->url], url, len)) ) {
+            return __materialize( full, idx );
+        }
+    }
+
+    for( i = 0; i < full->subsystems_count; i++ ) {
+        subsystem_t *sub = &full->subsystems[i];
+
+        if( (len == sub->url_len) && (0 == memcmp(sub->url, url, len)) ) {
+            errno = FULL_OK;
+            return sub;
         }
-        free( full );
     }
+
+    errno = FULL_MISSING_SUBSYSTEM;
+    return NULL;
+}
+
+/* See full.h for details. */
+void full_destroy( full_t *full )
+{
+    helper_free( full );
 }
 
 /* See full.h for details. */
@@ -93,6 +150,8 @@ const char* full_strerror( int errnum )
         { .v = FULL_OUT_OF_MEMORY,           .txt = "Out of memory." },
         { .v = FULL_INVALID_FIRST_ELEMENT,   .txt = "Invalid first element." },
         { .v = FULL_MISSING_FULL_ENTRY,      .txt = "'full' element missing." },
+        { .v = FULL_INVALID_SUBSYSTEMS,      .txt = "'subsystems' element is invalid." },
+        { .v = FULL_MISSING_SUBSYSTEM,       .txt = "Subsystem not found." },
         { .v = 0, .txt = NULL }
     };
     int i = 0;
@@ -119,32 +178,30 @@ const char* full_get_schema_version( void ) {
  *  Convert the msgpack map into the full_t structure.
  *
  *  @param full full pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_full( full_t *full, msgpack_object *obj )
+int process_full( full_t *full, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x01;
-    msgpack_object_kv *p;
+    token_t key, val;
 
     (void) full;
 
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_ARRAY == p->val.type ) {
-                if( 0 == match(p, "subsystems") ) {
-                    if( 0 != process_subsystems(full, &p->val.via.array) ) {
-                        return -1;
-                    }
-                    objects_left &= ~(1 << 0);
-                }
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        if( (KEY_SUBSYSTEMS == helper_key(__full_keys, &key)) && (TOKEN_ARRAY == val.type) ) {
+            if( 0 != process_subsystems(full, c, &val, ctx) ) {
+                return -1;
             }
+            objects_left &= ~(1 << 0);
         }
-        p++;
     }
 
     errno = FULL_OK;
@@ -152,67 +209,172 @@ int process_full( full_t *full, msgpack_object *obj )
     return 0;
 }
 
-int process_subsystems( full_t *full, msgpack_object_array *array )
+/**
+ *  Index the msgpack map into the full_t structure.
+ *
+ *  @param full full pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
+ *
+ *  @return 0 on success, error otherwise
+ */
+int process_full_lazy( full_t *full, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
+{
+    full->source = ctx->src;
+
+    return process_full( full, c, obj, ctx );
+}
+
+int process_subsystems( full_t *full, cursor_t *c, const token_t *array, helper_ctx_t *ctx )
 {
+    bool lazy = (NULL != full->source);
+
+    cursor_enter( c );
+
     if( 0 < array->size ) {
         uint32_t i;
 
-        full->subsystems_count = array->size;
-        full->subsystems = (subsystem_t*) malloc( full->subsystems_count * sizeof(subsystem_t) );
-        if( NULL == full->subsystems ) {
-            errno = FULL_OUT_OF_MEMORY;
-            return -1;
-        }
+        if( lazy ) {
+            full->index_count = array->size;
+            full->index = (full_index_t*) helper_alloc( ctx, full->index_count * sizeof(full_index_t) );
+            if( NULL == full->index ) {
+                errno = FULL_OUT_OF_MEMORY;
+                return -1;
+            }
+        } else {
+            full->subsystems_count = array->size;
+            full->subsystems = (subsystem_t*) helper_alloc( ctx, full->subsystems_count * sizeof(subsystem_t) );
+            if( NULL == full->subsystems ) {
+                errno = FULL_OUT_OF_MEMORY;
+                return -1;
+            }
 
-        memset( full->subsystems, 0, full->subsystems_count * sizeof(subsystem_t) );
+            memset( full->subsystems, 0, full->subsystems_count * sizeof(subsystem_t) );
+        }
 
         for( i = 0; i < array->size; i++ ) {
-            if( MSGPACK_OBJECT_MAP == array->ptr[i].type ) {
+            token_t item;
+            token_t url = { .ptr = NULL }, payload = { .ptr = NULL };
+
+            cursor_next( c, &item );
+            if( TOKEN_MAP == item.type ) {
                 uint8_t objects_left = 0x03;
-                msgpack_object_kv *p;
-                int left;
-
-                left = array->ptr[i].via.map.size;
-                p = array->ptr[i].via.map.ptr;
-                while( (0 < objects_left) && (0 < left--) ) {
-                    if( MSGPACK_OBJECT_STR == p->key.type ) {
-                        if( MSGPACK_OBJECT_STR == p->val.type ) {
-                            if( 0 == match(p, "url") ) {
-                                full->subsystems[i].url = strndup( p->val.via.str.ptr, p->val.via.str.size );
-                                if( NULL == full->subsystems[i].url ) {
-                                    errno = FULL_OUT_OF_MEMORY;
-                                    return -1;
-                                }
+                uint32_t left = item.size;
+
+                cursor_enter( c );
+                while( (0 < objects_left) && (0 < left) ) {
+                    token_t key, val;
+
+                    left--;
+                    cursor_next( c, &key );
+                    cursor_next( c, &val );
+                    switch( helper_key(__subsystem_keys, &key) ) {
+                        case KEY_URL:
+                            if( TOKEN_STR == val.type ) {
+                                url = val;
                                 objects_left &= ~(1 << 0);
                             }
-                        } else if( MSGPACK_OBJECT_BIN == p->val.type ) {
-                            if( 0 == match(p, "payload") ) {
-                                full->subsystems[i].payload_len = p->val.via.bin.size;
-                                if( 0 < p->val.via.bin.size ) {
-                                    full->subsystems[i].payload = (uint8_t*) malloc( p->val.via.bin.size );
-                                    if( NULL == full->subsystems[i].payload ) {
-                                        errno = FULL_OUT_OF_MEMORY;
-                                        return -1;
-                                    }
-                                    memcpy( full->subsystems[i].payload, p->val.via.bin.ptr, p->val.via.bin.size );
-                                }
+                            break;
+                        case KEY_PAYLOAD:
+                            if( TOKEN_BIN == val.type ) {
+                                payload = val;
                                 objects_left &= ~(1 << 1);
                             }
-                        }
+                            break;
+                        default:
+                            break;
                     }
-                    p++;
                 }
 
                 if( 0 < objects_left ) {
                     errno = FULL_INVALID_SUBSYSTEMS;
                     return -1;
                 }
+                cursor_skip( c, 2 * (uint64_t) left );
             } else {
                 errno = FULL_INVALID_SUBSYSTEMS;
                 return -1;
             }
+
+            if( lazy ) {
+                full_index_t *idx = &full->index[i];
+
+                idx->url = (uint32_t) ((const uint8_t*) url.ptr - full->source);
+                idx->url_len = url.size;
+                idx->payload = (uint32_t) ((const uint8_t*) payload.ptr - full->source);
+                idx->payload_len = payload.size;
+                idx->copy = NULL;
+            } else {
+                subsystem_t *sub = &full->subsystems[i];
+
+                sub->url_len = url.size;
+                sub->url = helper_str( ctx, url.ptr, url.size );
+                if( NULL == sub->url ) {
+                    errno = FULL_OUT_OF_MEMORY;
+                    return -1;
+                }
+                sub->payload_len = payload.size;
+                if( 0 < payload.size ) {
+                    sub->payload = helper_bin( ctx, payload.ptr, payload.size );
+                    if( NULL == sub->payload ) {
+                        errno = FULL_OUT_OF_MEMORY;
+                        return -1;
+                    }
+                }
+            }
         }
     }
 
     return 0;
 }
+
+/**
+ *  Copies an indexed subsystem out of the source buffer the first time it is
+ *  requested.
+ *
+ *  @param full the full
+ *  @param idx  the subsystem
+ *
+ *  @return NULL on error, success otherwise
+ */
+static const subsystem_t* __materialize( full_t *full, full_index_t *idx )
+{
+    helper_ctx_t *ctx = helper_ctx( full );
+    subsystem_t *sub;
+
+    if( NULL != idx->copy ) {
+        errno = FULL_OK;
+        return idx->copy;
+    }
+
+    sub = (subsystem_t*) helper_alloc( ctx, sizeof(subsystem_t) );
+    if( NULL == sub ) {
+        errno = FULL_OUT_OF_MEMORY;
+        return NULL;
+    }
+    memset( sub, 0, sizeof(subsystem_t) );
+
+    sub->url_len = idx->url_len;
+    sub->url = (char*) helper_alloc( ctx, idx->url_len + 1 );
+    if( NULL == sub->url ) {
+        errno = FULL_OUT_OF_MEMORY;
+        return NULL;
+    }
+    memcpy( sub->url, &full->source[idx->url], idx->url_len );
+    sub->url[idx->url_len] = '\0';
+
+    sub->payload_len = idx->payload_len;
+    if( 0 < idx->payload_len ) {
+        sub->payload = (uint8_t*) helper_alloc( ctx, idx->payload_len );
+        if( NULL == sub->payload ) {
+            errno = FULL_OUT_OF_MEMORY;
+            return NULL;
+        }
+        memcpy( sub->payload, &full->source[idx->payload], idx->payload_len );
+    }
+
+    idx->copy = sub;
+    errno = FULL_OK;
+    return sub;
+}
@@ -21,13 +21,28 @@
 
 typedef struct {
     char *url;                      /* (R) V 1.0.0 */
+    size_t url_len;
     uint8_t *payload;               /* (R) V 1.0.0 */
     size_t payload_len;
 } subsystem_t;
 
+/* Where a subsystem is in the buffer given to full_convert_lazy(). */
+typedef struct {
+    uint32_t     url;               /* Offset of the url. */
+    uint32_t     url_len;
+    uint32_t     payload;           /* Offset of the payload. */
+    uint32_t     payload_len;
+    subsystem_t *copy;              /* Set once the subsystem is requested. */
+} full_index_t;
+
 typedef struct {
     subsystem_t *subsystems;        /* (O) V 1.0.0 */
     size_t       subsystems_count;
+
+    /* Only set by full_convert_lazy(), which leaves subsystems empty. */
+    const uint8_t *source;
+    full_index_t  *index;
+    size_t         index_count;
 } full_t;
 
 /**
@@ -41,6 +56,52 @@ typedef struct {
  */
 full_t* full_convert( const void *buf, size_t len );
 
+/**
+ *  This function converts a msgpack buffer into an full_t structure
+ *  if possible, but references the subsystem urls and payloads in buf
+ *  instead of copying them.
+ *
+ *  @note: buf must remain valid & unchanged until the full is destroyed.
+ *         The urls are not '\0' terminated, use url_len instead.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+full_t* full_convert_view( const void *buf, size_t len );
+
+/**
+ *  This function indexes a msgpack buffer into an full_t structure if
+ *  possible, recording only where each subsystem is.  Nothing is copied
+ *  until full_get() asks for a subsystem.
+ *
+ *  @note: buf must remain valid & unchanged until the full is destroyed.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+full_t* full_convert_lazy( const void *buf, size_t len );
+
+/**
+ *  This function provides a subsystem by url, copying it out of the buffer
+ *  the first time it is requested from a full_convert_lazy() result.  Other
+ *  results are searched as they are.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         full_strerror().  Not safe to call from several threads at once on
+ *         the same full.
+ *
+ *  @param full the full to search
+ *  @param url  the url of the subsystem
+ *
+ *  @return NULL on error, success otherwise (valid until the full is
+ *          destroyed)
+ */
+const subsystem_t* full_get( full_t *full, const char *url );
+
 /**
  *  This function destroys an full_t object.
  *
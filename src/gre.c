@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "gre.h"
@@ -35,15 +34,23 @@ enum {
     GRE_MISSING_GRE_ENTRY       = HELPERS_MISSING_WRAPPER,
 };
 
+enum {
+    KEY_PRIMARY = 1,
+    KEY_SECONDARY
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __gre_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "primary-remote-endpoint",   'p', 'r', 't', KEY_PRIMARY ),
+    HELPER_KEY( "secondary-remote-endpoint", 's', 'e', 't', KEY_SECONDARY ),
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_gre( gre_t *gre, msgpack_object *obj );
+int process_gre( gre_t *gre, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -53,7 +60,16 @@ int process_gre( gre_t *gre, msgpack_object *obj );
 gre_t* gre_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(gre_t), "gre",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, NULL,
+                           (process_fn_t) process_gre,
+                           (destroy_fn_t) gre_destroy );
+}
+
+/* See gre.h for details. */
+gre_t* gre_convert_view( const void *buf, size_t len )
+{
+    return helper_convert( buf, len, sizeof(gre_t), "gre",
+                           TOKEN_MAP, true, true, NULL,
                            (process_fn_t) process_gre,
                            (destroy_fn_t) gre_destroy );
 }
@@ -61,15 +77,7 @@ gre_t* gre_convert( const void *buf, size_t len )
 /* See gre.h for details. */
 void gre_destroy( gre_t *gre )
 {
-    if( NULL != gre ) {
-        if( NULL != gre->primary_remote_endpoint ) {
-            free( gre->primary_remote_endpoint );
-        }
-        if( NULL != gre->secondary_remote_endpoint ) {
-            free( gre->secondary_remote_endpoint );
-        }
-        free( gre );
-    }
+    helper_free( gre );
 }
 
 /* See gre.h for details. */
@@ -103,31 +111,48 @@ const char* gre_strerror( int errnum )
  *  Convert the msgpack map into the gre_t structure.
  *
  *  @param gre gre pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_gre( gre_t *gre, msgpack_object *obj )
+int process_gre( gre_t *gre, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x03;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_STR == p->val.type ) {
-                if( 0 == match(p, "primary-remote-endpoint") ) {
-                    gre->primary_remote_endpoint = strndup( p->val.via.str.ptr, p->val.via.str.size );
+    token_t key, val;
+
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__gre_keys, &key) ) {
+            case KEY_PRIMARY:
+                if( TOKEN_STR == val.type ) {
+                    gre->primary_remote_endpoint_len = val.size;
+                    gre->primary_remote_endpoint = helper_str( ctx, val.ptr, val.size );
+                    if( NULL == gre->primary_remote_endpoint ) {
+                        errno = GRE_OUT_OF_MEMORY;
+                        return -1;
+                    }
                     objects_left &= ~(1 << 0);
-                } else if( 0 == match(p, "secondary-remote-endpoint") ) {
-                    gre->secondary_remote_endpoint = strndup( p->val.via.str.ptr, p->val.via.str.size );
+                }
+                break;
+            case KEY_SECONDARY:
+                if( TOKEN_STR == val.type ) {
+                    gre->secondary_remote_endpoint_len = val.size;
+                    gre->secondary_remote_endpoint = helper_str( ctx, val.ptr, val.size );
+                    if( NULL == gre->secondary_remote_endpoint ) {
+                        errno = GRE_OUT_OF_MEMORY;
+                        return -1;
+                    }
                     objects_left &= ~(1 << 1);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     errno = GRE_OK;
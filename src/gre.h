@@ -21,7 +21,9 @@
 
 typedef struct {
     char *primary_remote_endpoint;      /* (O) V 1.0.0 */
+    size_t primary_remote_endpoint_len;
     char *secondary_remote_endpoint;    /* (O) V 1.0.0 */
+    size_t secondary_remote_endpoint_len;
 } gre_t;
 
 /**
@@ -35,6 +37,20 @@ typedef struct {
  */
 gre_t* gre_convert( const void *buf, size_t len );
 
+/**
+ *  This function converts a msgpack buffer into an gre_t structure
+ *  if possible, but references the endpoints in buf instead of copying them.
+ *
+ *  @note: buf must remain valid & unchanged until the gre is destroyed.
+ *         The strings are not '\0' terminated, use the matching lengths.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+gre_t* gre_convert_view( const void *buf, size_t len );
+
 /**
  *  This function destroys an gre_t object.
  *
@@ -15,19 +15,41 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+/* All arena allocations are aligned to this many bytes. */
+#define ARENA_ALIGN         8
+
+/* The smallest overflow block to allocate. */
+#define ARENA_CHUNK_SIZE    1024
+
+/* The deepest nesting accepted, the same as msgpack-c. */
+#define HELPER_MAX_DEPTH    32
+
+#define arena_round(x) (((x) + (ARENA_ALIGN - 1)) & ~((size_t) (ARENA_ALIGN - 1)))
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-/* none */
+
+/* Hidden header placed in front of every structure helper_convert() returns.
+ * The union keeps the structure that follows suitably aligned. */
+typedef union {
+    helper_ctx_t ctx;
+    long double  align_ld;
+    void        *align_p;
+    uint64_t     align_u64;
+} helper_hdr_t;
+
+/* An overflow block, used only when the arena estimate was too small. */
+struct helper_block {
+    helper_block_t *next;
+    helper_hdr_t    data[];
+};
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
@@ -37,86 +59,334 @@
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-msgpack_object* __finder( const char *name, 
-                          msgpack_object_type expect_type,
-                          msgpack_object_map *map );
+int __finder( const char *name, token_type_t expect_type,
+              cursor_t *c, token_t *obj );
+int __sizer( cursor_t *c, const token_t *obj, bool view, int depth,
+             const helper_array_t *array, size_t *size );
+size_t __array_size( const helper_array_t *array, uint32_t count );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
 void* helper_convert( const void *buf, size_t len,
                       size_t struct_size, const char *wrapper,
-                      msgpack_object_type expect_type, bool optional,
+                      token_type_t expect_type, bool optional,
+                      bool view, const helper_array_t *array,
                       process_fn_t process,
                       destroy_fn_t destroy )
 {
-    void *p = malloc( struct_size );
+    void *p = NULL;
+    cursor_t c;
+    token_t obj;
 
-    if( NULL == p ) {
-        errno = HELPERS_OUT_OF_MEMORY;
-    } else {
-        memset( p, 0, struct_size );
+    if( (NULL == buf) || (0 == len) ) {
+        p = helper_create( struct_size, 0, view );
+        if( NULL == p ) {
+            errno = HELPERS_OUT_OF_MEMORY;
+        }
+        return p;
+    }
 
-        if( NULL != buf && 0 < len ) {
-            size_t offset = 0;
-            msgpack_unpacked msg;
-            msgpack_unpack_return mp_rv;
+    cursor_init( &c, buf, len );
 
-            msgpack_unpacked_init( &msg );
+    /* The outermost wrapper MUST be a map. */
+    if( (0 == cursor_next(&c, &obj)) && (TOKEN_MAP == obj.type) ) {
+        int found = 0;
 
-            /* The outermost wrapper MUST be a map. */
-            mp_rv = msgpack_unpack_next( &msg, (const char*) buf, len, &offset );
-            if( (MSGPACK_UNPACK_SUCCESS == mp_rv) && (0 != offset) &&
-                (MSGPACK_OBJECT_MAP == msg.data.type) )
-            {
-                msgpack_object *inner;
+        if( NULL != wrapper ) {
+            found = __finder( wrapper, expect_type, &c, &obj );
+        }
 
-                inner = &msg.data;
-                if( NULL != wrapper ) {
-                    inner = __finder( wrapper, expect_type, &msg.data.via.map );
+        if( (0 == found) || ((0 < found) && (true == optional)) ) {
+            size_t arena_size = 0;
+
+            if( 0 == found ) {
+                cursor_t scan = c;
+
+                cursor_enter( &scan );
+                if( 0 != __sizer(&scan, &obj, view, 0, array, &arena_size) ) {
+                    errno = HELPERS_INVALID_FIRST_ELEMENT;
+                    return NULL;
                 }
+            }
 
-                if( ((true == optional) && (NULL == inner)) ||
-                    ((NULL != inner) && (0 == (process)(p, inner))) )
-                {
-                    msgpack_unpacked_destroy( &msg );
+            p = helper_create( struct_size, arena_size, view );
+            if( NULL == p ) {
+                errno = HELPERS_OUT_OF_MEMORY;
+            } else if( 0 != found ) {
+                errno = HELPERS_OK;
+            } else {
+                helper_ctx( p )->src = (const uint8_t*) buf;
+                cursor_enter( &c );
+                if( 0 == (process)(p, &c, &obj, helper_ctx(p)) ) {
                     errno = HELPERS_OK;
-                    return p;
+                } else {
+                    (destroy)( p );
+                    p = NULL;
                 }
-            } else {
-                errno = HELPERS_INVALID_FIRST_ELEMENT;
             }
+        }
+    } else {
+        errno = HELPERS_INVALID_FIRST_ELEMENT;
+    }
+
+    return p;
+}
+
+/* See helpers.h for details. */
+int helper_key( const helper_key_t *keys, const token_t *key )
+{
+    const uint8_t *s = (const uint8_t*) key->ptr;
+    const helper_key_t *k;
+
+    if( (TOKEN_STR != key->type) || (key->size < 2) ) {
+        return 0;
+    }
+
+    k = &keys[HELPER_KEY_HASH(key->size, s[0], s[1], s[key->size - 1])];
+    if( (k->len == key->size) && (NULL != k->name) && (0 == memcmp(k->name, s, k->len)) ) {
+        return k->id;
+    }
+
+    return 0;
+}
+
+/* See helpers.h for details. */
+void* helper_create( size_t struct_size, size_t arena_size, bool view )
+{
+    helper_hdr_t *hdr;
+
+    struct_size = arena_round( struct_size );
+
+    hdr = (helper_hdr_t*) malloc( sizeof(helper_hdr_t) + struct_size + arena_size );
+    if( NULL == hdr ) {
+        return NULL;
+    }
+
+    memset( hdr, 0, sizeof(helper_hdr_t) + struct_size );
+    hdr->ctx.view = view;
+    hdr->ctx.next = ((uint8_t*) &hdr[1]) + struct_size;
+    hdr->ctx.left = arena_size;
+
+    return &hdr[1];
+}
 
-            msgpack_unpacked_destroy( &msg );
+/* See helpers.h for details. */
+helper_ctx_t* helper_ctx( void *p )
+{
+    helper_hdr_t *hdr = (helper_hdr_t*) p;
+
+    return &hdr[-1].ctx;
+}
 
-            (destroy)( p );
-            p = NULL;
+/* See helpers.h for details. */
+void helper_free( void *p )
+{
+    if( NULL != p ) {
+        helper_hdr_t *hdr = (helper_hdr_t*) p;
+        helper_block_t *b = hdr[-1].ctx.blocks;
+
+        while( NULL != b ) {
+            helper_block_t *next = b->next;
+            free( b );
+            b = next;
         }
+
+        free( &hdr[-1] );
     }
+}
 
-    return p;
+/* See helpers.h for details. */
+void* helper_alloc( helper_ctx_t *ctx, size_t size )
+{
+    void *rv;
+
+    size = arena_round( size );
+    if( ctx->left < size ) {
+        size_t block_size = (ARENA_CHUNK_SIZE < size) ? size : ARENA_CHUNK_SIZE;
+        helper_block_t *b;
+
+        b = (helper_block_t*) malloc( sizeof(helper_block_t) + block_size );
+        if( NULL == b ) {
+            return NULL;
+        }
+
+        b->next = ctx->blocks;
+        ctx->blocks = b;
+        ctx->next = (uint8_t*) b->data;
+        ctx->left = block_size;
+    }
+
+    rv = ctx->next;
+    ctx->next += size;
+    ctx->left -= size;
+
+    return rv;
+}
+
+/* See helpers.h for details. */
+char* helper_str( helper_ctx_t *ctx, const char *ptr, size_t len )
+{
+    char *s;
+
+    if( true == ctx->view ) {
+        return (char*) ptr;
+    }
+
+    s = (char*) helper_alloc( ctx, len + 1 );
+    if( NULL != s ) {
+        memcpy( s, ptr, len );
+        s[len] = '\0';
+    }
+
+    return s;
+}
+
+/* See helpers.h for details. */
+uint8_t* helper_bin( helper_ctx_t *ctx, const char *ptr, size_t len )
+{
+    uint8_t *b;
+
+    if( true == ctx->view ) {
+        return (uint8_t*) ptr;
+    }
+
+    if( 0 == len ) {
+        return NULL;
+    }
+
+    b = (uint8_t*) helper_alloc( ctx, len );
+    if( NULL != b ) {
+        memcpy( b, ptr, len );
+    }
+
+    return b;
 }
 
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
 
-msgpack_object* __finder( const char *name, 
-                          msgpack_object_type expect_type,
-                          msgpack_object_map *map )
+/**
+ *  Finds the wrapper in the map just read, leaving the cursor at the value.
+ *
+ *  @param name        the wrapper to find
+ *  @param expect_type the type the value must have
+ *  @param c           the cursor, just past the map header
+ *  @param obj         the map header in, the wrapper value out
+ *
+ *  @return 0 if found, 1 if not found, -1 if the map is invalid
+ */
+int __finder( const char *name, token_type_t expect_type,
+              cursor_t *c, token_t *obj )
 {
-    uint32_t i;
+    uint32_t i, size = obj->size;
 
-    for( i = 0; i < map->size; i++ ) {
-        if( MSGPACK_OBJECT_STR == map->ptr[i].key.type ) {
-            if( expect_type == map->ptr[i].val.type ) {
-                if( 0 == match(&(map->ptr[i]), name) ) {
-                    return &map->ptr[i].val;
-                }
+    cursor_enter( c );
+    for( i = 0; i < size; i++ ) {
+        token_t key;
+
+        if( (0 != cursor_next(c, &key)) || (0 != cursor_next(c, obj)) ) {
+            errno = HELPERS_INVALID_FIRST_ELEMENT;
+            return -1;
+        }
+
+        if( (TOKEN_STR == key.type) && (expect_type == obj->type) ) {
+            if( (strlen(name) == key.size) && (0 == memcmp(key.ptr, name, key.size)) ) {
+                return 0;
             }
         }
     }
 
     errno = HELPERS_MISSING_WRAPPER;
-    return NULL;
+    return 1;
+}
+
+/**
+ *  Checks the elements of the object are valid & complete while sizing the
+ *  arena needed to decode it: the strings & binary blobs that are copied
+ *  plus what the decoder allocates for the array it keeps.
+ *
+ *  @param c     the cursor at the first element of the object
+ *  @param obj   the object to size
+ *  @param view  if the strings & binary blobs are referenced instead
+ *  @param depth the nesting depth of the object
+ *  @param array the array the decoder allocates for, NULL if none or if
+ *               this is not the object being decoded
+ *  @param size  the running total of bytes to reserve
+ *
+ *  @return 0 on success, error otherwise
+ */
+int __sizer( cursor_t *c, const token_t *obj, bool view, int depth,
+             const helper_array_t *array, size_t *size )
+{
+    uint64_t i, count = token_children( obj );
+    bool is_array = false;
+
+    if( HELPER_MAX_DEPTH < depth ) {
+        return -1;
+    }
+
+    if( (NULL != array) && (NULL == array->key) && (TOKEN_ARRAY == obj->type) ) {
+        *size += __array_size( array, obj->size );
+    }
+
+    for( i = 0; i < count; i++ ) {
+        /* Map keys are never copied. */
+        bool is_key = (TOKEN_MAP == obj->type) && (0 == (i & 1));
+        token_t t;
+
+        if( 0 != cursor_next(c, &t) ) {
+            return -1;
+        }
+        cursor_enter( c );
+
+        switch( t.type ) {
+            case TOKEN_STR:
+                if( true == is_key ) {
+                    is_array = (NULL != array) && (NULL != array->key) &&
+                               (strlen(array->key) == t.size) &&
+                               (0 == memcmp(array->key, t.ptr, t.size));
+                } else if( false == view ) {
+                    *size += arena_round( t.size + 1 );
+                }
+                break;
+            case TOKEN_BIN:
+                if( (false == view) && (false == is_key) ) {
+                    *size += arena_round( t.size );
+                }
+                break;
+            case TOKEN_ARRAY:
+            case TOKEN_MAP:
+                if( (true == is_array) && (false == is_key) && (TOKEN_ARRAY == t.type) ) {
+                    *size += __array_size( array, t.size );
+                }
+                if( 0 != __sizer(c, &t, view, depth + 1, NULL, size) ) {
+                    return -1;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  The arena the decoder allocates for an array with this many elements.
+ *
+ *  @param array the array the decoder allocates for
+ *  @param count the number of elements
+ *
+ *  @return the bytes to reserve
+ */
+size_t __array_size( const helper_array_t *array, uint32_t count )
+{
+    if( 0 == count ) {
+        return 0;
+    }
+
+    return (size_t) count * arena_round( array->element_size ) +
+           arena_round( array->index_size );
 }
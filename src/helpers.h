@@ -20,13 +20,32 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#include "cursor.h"
+
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
-#define match(p, s) strncmp((p)->key.via.str.ptr, s, (p)->key.via.str.size)
 #define member_size(type, member) sizeof(((type *)0)->member)
 
+/* The number of slots in each key table. */
+#define HELPER_KEY_SLOTS 32
+
+/* The key table slot for a key, from the length and the first, second & last
+ * characters.  Keys must be at least 2 characters long. */
+#define HELPER_KEY_HASH(len, c0, c1, cn) \
+    ((((len) + (c0) + (c1) + (cn)) ^ (((len) + (c0) + (c1) + (cn)) >> 4)) & (HELPER_KEY_SLOTS - 1))
+
+/* Places a key in its key table slot, for example:
+ *
+ *     static const helper_key_t keys[HELPER_KEY_SLOTS] = {
+ *         HELPER_KEY( "url", 'u', 'r', 'l', KEY_URL ),
+ *     };
+ *
+ * Two keys in the same slot are reported by -Woverride-init, which the
+ * build turns on, so the table is always a perfect hash. */
+#define HELPER_KEY(str, c0, c1, cn, value) \
+    [HELPER_KEY_HASH(sizeof(str) - 1, c0, c1, cn)] = { .name = str, .len = sizeof(str) - 1, .id = value }
+
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
@@ -37,7 +56,37 @@ enum {
     HELPERS_MISSING_WRAPPER
 };
 
-typedef int (*process_fn_t)(void *, msgpack_object *);
+typedef struct {
+    const char *name;   /* NULL for an empty slot. */
+    size_t len;
+    int id;             /* Must not be 0. */
+} helper_key_t;
+
+typedef struct helper_block helper_block_t;
+
+typedef struct {
+    bool view;          /* Strings & binary blobs reference the input buffer
+                         * instead of being copied. */
+    const uint8_t *src; /* The buffer being decoded by helper_convert(). */
+
+    /* The arena every allocation for the structure is drawn from. */
+    uint8_t *next;              /* The next free byte in the current block. */
+    size_t left;                /* The bytes left in the current block. */
+    helper_block_t *blocks;     /* Any overflow blocks. */
+} helper_ctx_t;
+
+/* What a decoder allocates for the one array of the object it keeps, so the
+ * arena can be sized for it.  Each element is rounded to the arena alignment;
+ * anything not covered ends up in an overflow block, not an error. */
+typedef struct {
+    const char *key;        /* The key of the array in the object, NULL if
+                             * the object is the array. */
+    size_t element_size;    /* The bytes allocated per element. */
+    size_t index_size;      /* The bytes allocated once if there are any
+                             * elements, such as the header of an index. */
+} helper_array_t;
+
+typedef int (*process_fn_t)(void *, cursor_t *, const token_t *, helper_ctx_t *);
 typedef void (*destroy_fn_t)(void *);
 
 /*----------------------------------------------------------------------------*/
@@ -49,12 +98,23 @@ typedef void (*destroy_fn_t)(void *);
  *  sanity items (including an optional wrapper map) before calling the process
  *  argument passed in.  This also allocates the structure for the caller.
  *
+ *  process is given the cursor positioned at the first element of the object
+ *  (the token).  The object has already been checked to be complete, valid
+ *  msgpack, so process does not need to check the cursor_next() results;
+ *  type checks on the tokens are enough.
+ *
+ *  The structure is placed at the front of an arena sized to hold everything
+ *  process is expected to allocate through helper_alloc(), so the result
+ *  is normally a single contiguous block released by helper_free().
+ *
  *  @param buf          the buffer to decode
  *  @param len          the length of the buffer in bytes
  *  @param struct_size  the size of the structure to allocate and pass to process
  *  @param wrapper      the optional wrapper to look for & enforce
  *  @param expect_type  the type of object expected
  *  @param optional     if the inner wrapper layer is optional
+ *  @param view         if the result may reference buf instead of copying
+ *  @param array        the array process allocates for, NULL if none
  *  @param process      the process function to call if successful
  *  @param destroy      the destroy function to call if there was an error
  *
@@ -63,8 +123,87 @@ typedef void (*destroy_fn_t)(void *);
  */
 void* helper_convert( const void *buf, size_t len,
                       size_t struct_size, const char *wrapper,
-                      msgpack_object_type expect_type, bool optional,
+                      token_type_t expect_type, bool optional,
+                      bool view, const helper_array_t *array,
                       process_fn_t process,
                       destroy_fn_t destroy );
 
+/**
+ *  Resolves a map key to the id of the field it names.  The key must match
+ *  exactly, including the length.
+ *
+ *  @param keys the key table (HELPER_KEY_SLOTS long)
+ *  @param key  the key to look up
+ *
+ *  @returns the id of the key or 0 if the key is unknown or not a string
+ */
+int helper_key( const helper_key_t *keys, const token_t *key );
+
+/**
+ *  Allocates a zeroed structure at the front of a new arena, for decoders
+ *  that do not use helper_convert().
+ *
+ *  @param struct_size the size of the structure
+ *  @param arena_size  the bytes to reserve after the structure
+ *  @param view        if the strings & binary blobs are referenced instead
+ *
+ *  @return the structure or NULL if out of memory
+ */
+void* helper_create( size_t struct_size, size_t arena_size, bool view );
+
+/**
+ *  Returns the decode context of a structure from helper_create() or
+ *  helper_convert().
+ *
+ *  @param p the structure
+ *
+ *  @return the decode context
+ */
+helper_ctx_t* helper_ctx( void *p );
+
+/**
+ *  Frees the structure allocated by helper_convert() along with everything
+ *  allocated from its arena.
+ *
+ *  @param p the structure returned by helper_convert()
+ */
+void helper_free( void *p );
+
+/**
+ *  Allocates memory from the arena of the structure being decoded.  The
+ *  memory is not initialized and is released by helper_free().
+ *
+ *  @param ctx  the decode context
+ *  @param size the number of bytes needed
+ *
+ *  @returns the memory or NULL if out of memory
+ */
+void* helper_alloc( helper_ctx_t *ctx, size_t size );
+
+/**
+ *  Provides the string based on the decode mode.  When viewing the input
+ *  the pointer passed in is returned, otherwise a '\0' terminated copy is
+ *  made.
+ *
+ *  @param ctx the decode context
+ *  @param ptr the string to reference or copy
+ *  @param len the length of the string in bytes
+ *
+ *  @returns the string or NULL if out of memory
+ */
+char* helper_str( helper_ctx_t *ctx, const char *ptr, size_t len );
+
+/**
+ *  Provides the binary blob based on the decode mode.  When viewing the input
+ *  the pointer passed in is returned, otherwise a copy is made.  Empty blobs
+ *  are always NULL when copied.
+ *
+ *  @param ctx the decode context
+ *  @param ptr the binary blob to reference or copy
+ *  @param len the length of the blob in bytes
+ *
+ *  @returns the blob or NULL if out of memory
+ */
+uint8_t* helper_bin( helper_ctx_t *ctx, const char *ptr, size_t len );
+
 #endif
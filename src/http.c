@@ -17,103 +17,442 @@
 #include "http.h"
 #include "http_headers.h"
 
+#include <ctype.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <strings.h>
+#include <sys/mman.h>
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+#define MIN_BODY_SIZE   4096
+
+/* The request headers, in the order they are sent. */
+enum {
+    HDR_AUTH = 0,
+    HDR_CFG_VER,
+    HDR_SCHEMA_VER,
+    HDR_FW,
+    HDR_STATUS,
+    HDR_TRANS_ID,
+    HDR_BOOT_TIME,
+    HDR_READY_TIME,
+    HDR_CURRENT_TIME,
+    HDR_IF_RANGE,
+    HDR_COUNT
+};
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-/* none */
+struct http_client {
+    pthread_mutex_t lock[CURL_LOCK_DATA_LAST];  /* One per shared kind. */
+    CURLSH *share;              /* The DNS cache, TLS sessions & connections. */
+    CURL *curl;                 /* Reused so its connections stay alive. */
+    CURLM *multi;               /* Made on the first http_fetch(). */
+
+    CURLM *async;               /* Made by http_client_watch(). */
+    struct transfer *pending;   /* The http_start() transfers in progress. */
+    http_watch_fn watch;
+    http_timer_fn timer;
+    void *user_data;
+
+    header_slot_t slots[HDR_COUNT]; /* Reused by one request at a time. */
+    bool slots_busy;
+};
+
+typedef struct transfer {
+    CURL *curl;
+    struct curl_slist *headers;
+    bool slots;                 /* The headers are the client's slots. */
+    http_response_t resp;
+
+    /* Only for http_start(). */
+    struct transfer *next;
+    http_request_t req;
+    http_done_fn done;
+    void *user_data;
+} transfer_t;
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const char *__prefixes[HDR_COUNT] = {
+    "Authorization: Bearer ",
+    "IF-NONE-MATCH: ",
+    "Schema-Version: ",
+    "X-System-Firmware-Version: ",
+    "X-System-Status: ",
+    "Transaction-Id: ",
+    "X-System-Boot-Time: ",
+    "X-System-Ready-Time: ",
+    "X-System-Current-Time: ",
+    "If-Range: ",
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
+void setup_curl( CURL *curl, http_request_t *req, http_response_t *resp,
+                 struct curl_slist *headers );
+void setup_multi( CURL *curl, http_client_t *client, transfer_t *xfer );
 int to_headers( struct curl_slist **l, http_request_t *r );
 size_t write_cb( void *buf, size_t size, size_t nmemb, http_response_t *resp );
+int grow_data( http_response_t *resp, size_t needed );
+void free_data( http_response_t *resp );
+size_t sink_cb( void *buf, size_t size, size_t nmemb, http_response_t *resp );
+size_t header_cb( char *buf, size_t size, size_t nmemb, http_response_t *resp );
+int progress_cb( void *userp, curl_off_t dltotal, curl_off_t dlnow,
+                 curl_off_t ultotal, curl_off_t ulnow );
+void finish_resp( CURL *curl, http_response_t *resp );
+void share_lock_cb( CURL *curl, curl_lock_data data, curl_lock_access access,
+                    void *userp );
+void share_unlock_cb( CURL *curl, curl_lock_data data, void *userp );
+int socket_cb( CURL *curl, curl_socket_t fd, int what, void *userp, void *socketp );
+int timer_cb( CURLM *multi, long timeout_ms, void *userp );
+int get_headers( http_client_t *client, http_request_t *r, struct curl_slist **l,
+                 bool *slots );
+void put_headers( http_client_t *client, struct curl_slist *l, bool slots );
+int patch_slots( http_client_t *client, http_request_t *r );
+transfer_t* next_done( http_client_t *client, CURLM *multi );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
 /*----------------------------------------------------------------------------*/
+http_client_t* http_client_create( void )
+{
+    http_client_t *client;
+    int i;
+
+    client = (http_client_t*) malloc( sizeof(http_client_t) );
+    if( NULL == client ) {
+        return NULL;
+    }
+    memset( client, 0, sizeof(http_client_t) );
+
+    for( i = 0; i < CURL_LOCK_DATA_LAST; i++ ) {
+        pthread_mutex_init( &client->lock[i], NULL );
+    }
+
+    client->share = curl_share_init();
+    client->curl = curl_easy_init();
+    if( (NULL == client->share) || (NULL == client->curl) ) {
+        http_client_destroy( client );
+        return NULL;
+    }
+
+    for( i = 0; i < HDR_COUNT; i++ ) {
+        if( 0 != header_slot_init(&client->slots[i], __prefixes[i]) ) {
+            http_client_destroy( client );
+            return NULL;
+        }
+    }
+
+    curl_share_setopt( client->share, CURLSHOPT_LOCKFUNC, share_lock_cb );
+    curl_share_setopt( client->share, CURLSHOPT_UNLOCKFUNC, share_unlock_cb );
+    curl_share_setopt( client->share, CURLSHOPT_USERDATA, client );
+    curl_share_setopt( client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS );
+    curl_share_setopt( client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION );
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt( client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT );
+#endif
+
+    return client;
+}
+
+void http_client_destroy( http_client_t *client )
+{
+    if( NULL != client ) {
+        int i;
+
+        /* The handle must let go of the share before it can be cleaned up. */
+        curl_easy_cleanup( client->curl );
+        if( NULL != client->multi ) {
+            curl_multi_cleanup( client->multi );
+        }
+        while( NULL != client->pending ) {
+            transfer_t *xfer = client->pending;
+
+            client->pending = xfer->next;
+            curl_multi_remove_handle( client->async, xfer->curl );
+            curl_easy_cleanup( xfer->curl );
+            put_headers( client, xfer->headers, xfer->slots );
+            free_data( &xfer->resp );
+            free( xfer );
+        }
+        if( NULL != client->async ) {
+            curl_multi_cleanup( client->async );
+        }
+        curl_share_cleanup( client->share );
+        for( i = 0; i < HDR_COUNT; i++ ) {
+            header_slot_destroy( &client->slots[i] );
+        }
+        for( i = 0; i < CURL_LOCK_DATA_LAST; i++ ) {
+            pthread_mutex_destroy( &client->lock[i] );
+        }
+        free( client );
+    }
+}
+
 int http_request( http_request_t *req, http_response_t *resp )
 {
     int rv = -1;
     CURL *curl = NULL;
     struct curl_slist *headers = NULL;
-    long ipvmode;
+    bool slots;
 
     if( NULL == req || NULL == resp ) {
         return -1;
     }
     memset( resp, 0, sizeof(http_response_t) );
 
-    if( 0 != to_headers(&headers, req) ) {
+    if( 0 != get_headers(req->client, req, &headers, &slots) ) {
         return -2;
     }
 
-    /* Build the curl object. */
-    curl = curl_easy_init();
+    /* Build the curl object, or reuse the client's so the connection, the
+     * TLS session & the DNS lookup from the last request are kept. */
+    if( NULL != req->client ) {
+        curl = req->client->curl;
+        curl_easy_reset( curl );
+        curl_easy_setopt( curl, CURLOPT_SHARE, req->client->share );
+    } else {
+        curl = curl_easy_init();
+    }
     if( NULL != curl ) {
 
-        curl_easy_setopt( curl, CURLOPT_URL, req->url );
-        curl_easy_setopt( curl, CURLOPT_HTTPHEADER, headers );
-        curl_easy_setopt( curl, CURLOPT_TIMEOUT, req->timeout_s );
-        curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1L );
-        if( req->interface ) {
-            curl_easy_setopt( curl, CURLOPT_INTERFACE, req->interface );
+        setup_curl( curl, req, resp, headers );
+
+        resp->code = curl_easy_perform( curl );
+        finish_resp( curl, resp );
+
+        resp->curl = curl;
+        resp->client = req->client;
+
+        rv = 0;
+    }
+
+    put_headers( req->client, headers, slots );
+
+    return rv;
+}
+
+int http_fetch( http_client_t *client, http_request_t *reqs, size_t count,
+                http_done_fn done, void *user_data )
+{
+    transfer_t *t;
+    int running = 0;
+    int rv = 0;
+    size_t i;
+
+    if( (NULL == client) || ((NULL == reqs) && (0 < count)) || (NULL == done) ) {
+        return -1;
+    }
+    if( 0 == count ) {
+        return 0;
+    }
+
+    if( NULL == client->multi ) {
+        client->multi = curl_multi_init();
+        if( NULL == client->multi ) {
+            return -3;
         }
+        curl_multi_setopt( client->multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+    }
 
-        /* figure out the IP version to use. */
-        ipvmode = CURL_IPRESOLVE_WHATEVER;
-        if( 4 == req->ip_version ) ipvmode = CURL_IPRESOLVE_V4;
-        if( 6 == req->ip_version ) ipvmode = CURL_IPRESOLVE_V6;
-        curl_easy_setopt( curl, CURLOPT_IPRESOLVE, ipvmode );
+    t = (transfer_t*) calloc( count, sizeof(transfer_t) );
+    if( NULL == t ) {
+        return -3;
+    }
 
-        /* Ensure TLS 1.2+, verify the hostname, cert, etc. */
-        if( req->ca_cert_path ) {
-            curl_easy_setopt( curl, CURLOPT_CAINFO, req->ca_cert_path );
+    for( i = 0; i < count; i++ ) {
+        if( 0 != to_headers(&t[i].headers, &reqs[i]) ) {
+            rv = -2;
+            break;
         }
-        curl_easy_setopt( curl, CURLOPT_SSL_VERIFYPEER, 1L );
-        curl_easy_setopt( curl, CURLOPT_SSL_VERIFYHOST, 2L );
-        curl_easy_setopt( curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 );
 
-        /* Don't perform an OCSP check as that can DDoS that endpoint. */
-        curl_easy_setopt( curl, CURLOPT_SSL_VERIFYSTATUS, 0L );
+        t[i].curl = curl_easy_init();
+        if( NULL == t[i].curl ) {
+            rv = -3;
+            break;
+        }
 
-        /* Setup response handling. */
-        curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, write_cb );
-        curl_easy_setopt( curl, CURLOPT_WRITEDATA, resp );
+        setup_curl( t[i].curl, &reqs[i], &t[i].resp, t[i].headers );
+        setup_multi( t[i].curl, client, &t[i] );
 
-        resp->code = curl_easy_perform( curl );
-        if( CURLE_OK == resp->code ) {
-            curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &resp->http_status );
+        if( CURLM_OK != curl_multi_add_handle(client->multi, t[i].curl) ) {
+            rv = -3;
+            break;
         }
+    }
 
-        resp->curl = curl;
+    if( 0 == rv ) {
+        do {
+            transfer_t *xfer;
 
-        rv = 0;
+            if( CURLM_OK != curl_multi_perform(client->multi, &running) ) {
+                rv = -3;
+                break;
+            }
+
+            while( NULL != (xfer = next_done(client, client->multi)) ) {
+                done( user_data, (size_t) (xfer - t), &xfer->resp );
+
+                free_data( &xfer->resp );
+                curl_easy_cleanup( xfer->curl );
+                xfer->curl = NULL;
+            }
+
+            if( 0 < running ) {
+                curl_multi_poll( client->multi, NULL, 0, 1000, NULL );
+            }
+        } while( 0 < running );
     }
 
-    curl_slist_free_all( headers );
+    /* Anything left did not finish. */
+    for( i = 0; i < count; i++ ) {
+        if( NULL != t[i].curl ) {
+            curl_multi_remove_handle( client->multi, t[i].curl );
+            curl_easy_cleanup( t[i].curl );
+            free_data( &t[i].resp );
+        }
+        curl_slist_free_all( t[i].headers );
+    }
+    free( t );
 
     return rv;
 }
 
+int http_client_watch( http_client_t *client, http_watch_fn watch,
+                       http_timer_fn timer, void *user_data )
+{
+    if( (NULL == client) || (NULL == watch) || (NULL == timer) ) {
+        return -1;
+    }
+    if( NULL != client->async ) {
+        return -1;
+    }
+
+    client->async = curl_multi_init();
+    if( NULL == client->async ) {
+        return -3;
+    }
+    client->watch = watch;
+    client->timer = timer;
+    client->user_data = user_data;
+
+    curl_multi_setopt( client->async, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX );
+    curl_multi_setopt( client->async, CURLMOPT_SOCKETFUNCTION, socket_cb );
+    curl_multi_setopt( client->async, CURLMOPT_SOCKETDATA, client );
+    curl_multi_setopt( client->async, CURLMOPT_TIMERFUNCTION, timer_cb );
+    curl_multi_setopt( client->async, CURLMOPT_TIMERDATA, client );
+
+    return 0;
+}
+
+int http_start( http_client_t *client, http_request_t *req, http_done_fn done,
+                void *user_data )
+{
+    transfer_t *xfer;
+
+    if( (NULL == client) || (NULL == req) || (NULL == done) ) {
+        return -1;
+    }
+    if( NULL == client->async ) {
+        return -1;
+    }
+
+    xfer = (transfer_t*) calloc( 1, sizeof(transfer_t) );
+    if( NULL == xfer ) {
+        return -3;
+    }
+
+    /* The request is kept as the body may be passed to its write_fn. */
+    memcpy( &xfer->req, req, sizeof(http_request_t) );
+    xfer->done = done;
+    xfer->user_data = user_data;
+
+    if( 0 != get_headers(client, &xfer->req, &xfer->headers, &xfer->slots) ) {
+        free( xfer );
+        return -2;
+    }
+
+    xfer->curl = curl_easy_init();
+    if( NULL == xfer->curl ) {
+        put_headers( client, xfer->headers, xfer->slots );
+        free( xfer );
+        return -3;
+    }
+
+    setup_curl( xfer->curl, &xfer->req, &xfer->resp, xfer->headers );
+    setup_multi( xfer->curl, client, xfer );
+
+    if( CURLM_OK != curl_multi_add_handle(client->async, xfer->curl) ) {
+        curl_easy_cleanup( xfer->curl );
+        put_headers( client, xfer->headers, xfer->slots );
+        free( xfer );
+        return -3;
+    }
+
+    xfer->next = client->pending;
+    client->pending = xfer;
+
+    return 0;
+}
+
+int http_process( http_client_t *client, int fd, int events )
+{
+    transfer_t *xfer;
+    int mask = 0;
+    int running;
+
+    if( (NULL == client) || (NULL == client->async) ) {
+        return -1;
+    }
+
+    if( HTTP_EVENT_IN & events )  mask |= CURL_CSELECT_IN;
+    if( HTTP_EVENT_OUT & events ) mask |= CURL_CSELECT_OUT;
+    if( HTTP_EVENT_ERR & events ) mask |= CURL_CSELECT_ERR;
+    if( HTTP_TIMEOUT == fd ) {
+        fd = CURL_SOCKET_TIMEOUT;
+        mask = 0;
+    }
+
+    if( CURLM_OK != curl_multi_socket_action(client->async, fd, mask, &running) ) {
+        return -3;
+    }
+
+    while( NULL != (xfer = next_done(client, client->async)) ) {
+        transfer_t **prev = &client->pending;
+
+        while( *prev != xfer ) {
+            prev = &(*prev)->next;
+        }
+        *prev = xfer->next;
+
+        (xfer->done)( xfer->user_data, 0, &xfer->resp );
+
+        free_data( &xfer->resp );
+        curl_easy_cleanup( xfer->curl );
+        put_headers( client, xfer->headers, xfer->slots );
+        free( xfer );
+    }
+
+    return 0;
+}
+
 void http_destroy( http_response_t *resp )
 {
-    if( resp->data ) {
-        free( resp->data );
+    free_data( resp );
+
+    /* A client's curl object lives on for the next request. */
+    if( NULL == resp->client ) {
+        curl_easy_cleanup( resp->curl );
     }
-    curl_easy_cleanup( resp->curl );
 }
 
 
@@ -121,6 +460,243 @@ void http_destroy( http_response_t *resp )
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
 
+/**
+ *  Sets the options every request is made with.
+ *
+ *  @param curl    the curl object to set up
+ *  @param req     the http request
+ *  @param resp    the response to collect the body in
+ *  @param headers the request headers from get_headers()
+ */
+void setup_curl( CURL *curl, http_request_t *req, http_response_t *resp,
+                 struct curl_slist *headers )
+{
+    long ipvmode;
+
+    curl_easy_setopt( curl, CURLOPT_URL, req->url );
+    curl_easy_setopt( curl, CURLOPT_HTTPHEADER, headers );
+    curl_easy_setopt( curl, CURLOPT_TIMEOUT, req->timeout_s );
+    curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1L );
+    curl_easy_setopt( curl, CURLOPT_TCP_KEEPALIVE, 1L );
+    if( req->interface ) {
+        curl_easy_setopt( curl, CURLOPT_INTERFACE, req->interface );
+    }
+
+    /* figure out the IP version to use. */
+    ipvmode = CURL_IPRESOLVE_WHATEVER;
+    if( 4 == req->ip_version ) ipvmode = CURL_IPRESOLVE_V4;
+    if( 6 == req->ip_version ) ipvmode = CURL_IPRESOLVE_V6;
+    curl_easy_setopt( curl, CURLOPT_IPRESOLVE, ipvmode );
+
+    /* Ensure TLS 1.2+, verify the hostname, cert, etc. */
+    if( req->ca_cert_path ) {
+        curl_easy_setopt( curl, CURLOPT_CAINFO, req->ca_cert_path );
+    }
+    curl_easy_setopt( curl, CURLOPT_SSL_VERIFYPEER, 1L );
+    curl_easy_setopt( curl, CURLOPT_SSL_VERIFYHOST, 2L );
+    curl_easy_setopt( curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 );
+
+    /* Don't perform an OCSP check as that can DDoS that endpoint. */
+    curl_easy_setopt( curl, CURLOPT_SSL_VERIFYSTATUS, 0L );
+
+    /* Ask for the body compressed with anything curl can decompress as it
+     * arrives, so the write handlers only ever see the decompressed bytes.
+     * Not when only the rest of a partial body is asked for: the range would
+     * be of the compressed bytes, which don't follow on from the decompressed
+     * part already held. */
+    if( (NULL != req->write_fn) && (0 < req->resume_from) ) {
+        curl_easy_setopt( curl, CURLOPT_ACCEPT_ENCODING, "identity" );
+    } else {
+        curl_easy_setopt( curl, CURLOPT_ACCEPT_ENCODING, "" );
+    }
+
+    /* Keep the ETag for the response cache. */
+    curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, header_cb );
+    curl_easy_setopt( curl, CURLOPT_HEADERDATA, resp );
+
+    if( NULL != req->abort_fn ) {
+        resp->abort_fn = req->abort_fn;
+        resp->abort_data = req->abort_data;
+        curl_easy_setopt( curl, CURLOPT_XFERINFOFUNCTION, progress_cb );
+        curl_easy_setopt( curl, CURLOPT_XFERINFODATA, resp );
+        curl_easy_setopt( curl, CURLOPT_NOPROGRESS, 0L );
+    }
+
+    /* Setup response handling. */
+    if( NULL != req->write_fn ) {
+        curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, sink_cb );
+        curl_easy_setopt( curl, CURLOPT_WRITEDATA, resp );
+        resp->curl = curl;
+        resp->write_fn = req->write_fn;
+        resp->write_data = req->write_data;
+
+        /* Only ask for the rest, without curl's resume checks, so a changed
+         * body arrives in full instead of failing the transfer. */
+        if( 0 < req->resume_from ) {
+            char range[32];
+
+            snprintf( range, sizeof(range), "%zu-", req->resume_from );
+            curl_easy_setopt( curl, CURLOPT_RANGE, range );
+            resp->resumed_from = req->resume_from;
+        }
+    } else {
+        curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, write_cb );
+        curl_easy_setopt( curl, CURLOPT_WRITEDATA, resp );
+
+        resp->curl = curl;
+        if( NULL != req->body_buf ) {
+            resp->data = req->body_buf;
+            resp->size = req->body_buf_size;
+            resp->body_buf = req->body_buf;
+        }
+    }
+}
+
+/**
+ *  Sets the options for a request made on one of the client's multi handles.
+ *
+ *  @param curl   the curl object to set up
+ *  @param client the client it belongs to
+ *  @param xfer   the transfer it is part of
+ */
+void setup_multi( CURL *curl, http_client_t *client, transfer_t *xfer )
+{
+    curl_easy_setopt( curl, CURLOPT_SHARE, client->share );
+    curl_easy_setopt( curl, CURLOPT_PRIVATE, xfer );
+
+    /* Wait for the first connection to learn if it can multiplex instead of
+     * opening one per request. */
+    curl_easy_setopt( curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS );
+    curl_easy_setopt( curl, CURLOPT_PIPEWAIT, 1L );
+}
+
+/**
+ *  Provides the next finished transfer of a multi handle, with its response
+ *  filled in and removed from the handle.
+ *
+ *  @param client the client the handle belongs to
+ *  @param multi  the handle
+ *
+ *  @return the transfer, or NULL if no more are finished
+ */
+transfer_t* next_done( http_client_t *client, CURLM *multi )
+{
+    CURLMsg *msg;
+    int left;
+
+    while( NULL != (msg = curl_multi_info_read(multi, &left)) ) {
+        transfer_t *xfer = NULL;
+
+        if( CURLMSG_DONE != msg->msg ) {
+            continue;
+        }
+
+        curl_easy_getinfo( msg->easy_handle, CURLINFO_PRIVATE, (char**) &xfer );
+        xfer->resp.code = msg->data.result;
+        finish_resp( xfer->curl, &xfer->resp );
+        xfer->resp.curl = xfer->curl;
+        xfer->resp.client = client;
+
+        curl_multi_remove_handle( multi, xfer->curl );
+
+        return xfer;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Provides the headers for a request: the client's slots patched with the
+ *  request's values if they are free, otherwise a new list.
+ *
+ *  @param client the client, or NULL
+ *  @param r      the http request
+ *  @param l      the headers
+ *  @param slots  set to true if the headers are the client's slots
+ *
+ *  @return 0 on success, error otherwise
+ */
+int get_headers( http_client_t *client, http_request_t *r, struct curl_slist **l,
+                 bool *slots )
+{
+    *l = NULL;
+    *slots = false;
+
+    if( (NULL != client) && !client->slots_busy ) {
+        if( 0 != patch_slots(client, r) ) {
+            return -1;
+        }
+
+        /* Only the authorization is optional. */
+        *l = &client->slots[(NULL != r->auth) ? HDR_AUTH : HDR_CFG_VER].node;
+        *slots = true;
+        client->slots_busy = true;
+
+        return 0;
+    }
+
+    return to_headers( l, r );
+}
+
+/**
+ *  Releases the headers from get_headers().
+ */
+void put_headers( http_client_t *client, struct curl_slist *l, bool slots )
+{
+    if( slots ) {
+        client->slots_busy = false;
+    } else {
+        curl_slist_free_all( l );
+    }
+}
+
+/**
+ *  Writes the request's values into the client's header slots.  Only a value
+ *  longer than any before it allocates.
+ *
+ *  @param client the client
+ *  @param r      the http request
+ *
+ *  @return 0 on success, error otherwise
+ */
+int patch_slots( http_client_t *client, http_request_t *r )
+{
+    header_slot_t *s = client->slots;
+    int rv = 0;
+    int i;
+
+    if( !(r->cfg_ver) || !(r->schema_ver) || !(r->fw) || !(r->status) || !(r->trans_id) ) {
+        return -1;
+    }
+
+    if( r->auth ) {
+        rv |= header_slot_set( &s[HDR_AUTH], r->auth );
+    }
+    rv |= header_slot_set( &s[HDR_CFG_VER], r->cfg_ver );
+    rv |= header_slot_set( &s[HDR_SCHEMA_VER], r->schema_ver );
+    rv |= header_slot_set( &s[HDR_FW], r->fw );
+    rv |= header_slot_set( &s[HDR_STATUS], r->status );
+    rv |= header_slot_set( &s[HDR_TRANS_ID], r->trans_id );
+    rv |= header_slot_set_u32( &s[HDR_BOOT_TIME], r->boot_unixtime );
+    rv |= header_slot_set_u32( &s[HDR_READY_TIME], r->ready_unixtime );
+    rv |= header_slot_set_u32( &s[HDR_CURRENT_TIME], r->current_unixtime );
+    if( r->if_range ) {
+        rv |= header_slot_set( &s[HDR_IF_RANGE], r->if_range );
+    }
+
+    for( i = 0; i < HDR_COUNT - 1; i++ ) {
+        s[i].node.next = &s[i + 1].node;
+    }
+    s[HDR_COUNT - 1].node.next = NULL;
+
+    /* The If-Range is optional too. */
+    if( !(r->if_range) ) {
+        s[HDR_IF_RANGE - 1].node.next = NULL;
+    }
+
+    return rv;
+}
+
 /**
  *  Convert the http request's headers 
  *
@@ -150,6 +726,9 @@ int to_headers( struct curl_slist **l, http_request_t *r )
     rv |= append_header( l, "X-System-Boot-Time: %d", r->boot_unixtime );
     rv |= append_header( l, "X-System-Ready-Time: %d", r->ready_unixtime );
     rv |= append_header( l, "X-System-Current-Time: %d", r->current_unixtime );
+    if( r->if_range ) {
+        rv |= append_header( l, "If-Range: %s", r->if_range );
+    }
 
     return rv;
 }
@@ -162,14 +741,239 @@ size_t write_cb( void *buf, size_t size, size_t nmemb, http_response_t *resp )
     size_t n = size * nmemb;
     uint8_t *tmp;
 
-    resp->data = realloc( resp->data, resp->len + n );
-    if( NULL == resp->data ) {
+    if( (resp->size - resp->len < n) && (0 != grow_data(resp, resp->len + n)) ) {
         return 0;
     }
 
     tmp = (uint8_t*) resp->data;
     memcpy( &tmp[resp->len], buf, n );
     resp->len += n;
+    resp->body_len += n;
 
     return n;
 }
+
+/**
+ *  Makes room for at least the needed bytes in the response data.  The
+ *  whole body is reserved at once when the server gave its Content-Length,
+ *  otherwise the buffer doubles so the body is copied O(log n) times.
+ *
+ *  @param resp   the response
+ *  @param needed the minimum size of the data buffer
+ *
+ *  @return 0 on success, error otherwise
+ */
+int grow_data( http_response_t *resp, size_t needed )
+{
+    curl_off_t length = -1;
+    size_t size = 2 * resp->size;
+    void *tmp;
+
+    if( (CURLE_OK == curl_easy_getinfo(resp->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length)) &&
+        (0 < length) && (size < (size_t) length) )
+    {
+        size = (size_t) length;
+    }
+    if( size < needed ) {
+        size = needed;
+    }
+    if( size < MIN_BODY_SIZE ) {
+        size = MIN_BODY_SIZE;
+    }
+
+    if( (NULL != resp->data) && (resp->data == resp->body_buf) ) {
+        /* Outgrew the caller's buffer. */
+        tmp = malloc( size );
+        if( NULL != tmp ) {
+            memcpy( tmp, resp->data, resp->len );
+        }
+    } else {
+        tmp = realloc( resp->data, size );
+    }
+    if( NULL == tmp ) {
+        return -1;
+    }
+
+    resp->data = tmp;
+    resp->size = size;
+
+    return 0;
+}
+
+/**
+ *  Frees what the response holds: the data unless it is the caller's buffer
+ *  or a mapped cache file, the mapping & the ETag.
+ */
+void free_data( http_response_t *resp )
+{
+    if( NULL != resp->map ) {
+        munmap( resp->map, resp->map_len );
+        resp->map = NULL;
+    } else if( (NULL != resp->data) && (resp->data != resp->body_buf) ) {
+        free( resp->data );
+    }
+    resp->data = NULL;
+
+    if( NULL != resp->etag ) {
+        free( resp->etag );
+        resp->etag = NULL;
+    }
+}
+
+/**
+ *  The write callback handler for passing the response to the caller as it
+ *  arrives.
+ */
+size_t sink_cb( void *buf, size_t size, size_t nmemb, http_response_t *resp )
+{
+    size_t n = size * nmemb;
+
+    /* Anything but a 206 is the whole body. */
+    if( (0 == resp->body_len) && (0 < resp->resumed_from) ) {
+        long status = 0;
+
+        curl_easy_getinfo( resp->curl, CURLINFO_RESPONSE_CODE, &status );
+        if( 206 != status ) {
+            resp->resumed_from = 0;
+            if( 0 != (resp->write_fn)(resp->write_data, NULL, 0) ) {
+                return 0;
+            }
+        }
+    }
+
+    if( 0 != (resp->write_fn)(resp->write_data, buf, n) ) {
+        return 0;
+    }
+    resp->body_len += n;
+
+    return n;
+}
+
+/**
+ *  The header callback handler, which keeps the ETag of the final response.
+ *  Each response along a redirect starts with its status line, which drops
+ *  the ETag of the one before.
+ */
+size_t header_cb( char *buf, size_t size, size_t nmemb, http_response_t *resp )
+{
+    size_t n = size * nmemb;
+    size_t len = n;
+
+    bool status = (5 <= n) && (0 == strncmp(buf, "HTTP/", 5));
+    bool etag = (5 < n) && (0 == strncasecmp(buf, "ETag:", 5));
+
+    if( (status || etag) && (NULL != resp->etag) ) {
+        free( resp->etag );
+        resp->etag = NULL;
+    }
+
+    if( etag ) {
+        buf += 5;
+        len -= 5;
+        while( (0 < len) && isspace((unsigned char) *buf) ) {
+            buf++;
+            len--;
+        }
+        while( (0 < len) && isspace((unsigned char) buf[len - 1]) ) {
+            len--;
+        }
+        if( 0 < len ) {
+            resp->etag = strndup( buf, len );
+        }
+    }
+
+    return n;
+}
+
+/**
+ *  The progress callback handler, which lets the caller abandon the request.
+ */
+int progress_cb( void *userp, curl_off_t dltotal, curl_off_t dlnow,
+                 curl_off_t ultotal, curl_off_t ulnow )
+{
+    http_response_t *resp = (http_response_t*) userp;
+
+    (void) dltotal;
+    (void) dlnow;
+    (void) ultotal;
+    (void) ulnow;
+
+    return (resp->abort_fn)( resp->abort_data );
+}
+
+/**
+ *  Fills in what is known about the response once the transfer is done.
+ */
+void finish_resp( CURL *curl, http_response_t *resp )
+{
+    curl_off_t wire = 0;
+
+    curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &resp->http_status );
+    if( 206 != resp->http_status ) {
+        resp->resumed_from = 0;
+    }
+    if( CURLE_OK == curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire) ) {
+        resp->wire_len = (size_t) wire;
+    }
+}
+
+/**
+ *  The share lock handlers libcurl calls around each use of the shared DNS
+ *  cache, TLS sessions & connections.
+ */
+void share_lock_cb( CURL *curl, curl_lock_data data, curl_lock_access access,
+                    void *userp )
+{
+    http_client_t *client = (http_client_t*) userp;
+
+    (void) curl;
+    (void) access;
+
+    pthread_mutex_lock( &client->lock[data] );
+}
+
+void share_unlock_cb( CURL *curl, curl_lock_data data, void *userp )
+{
+    http_client_t *client = (http_client_t*) userp;
+
+    (void) curl;
+
+    pthread_mutex_unlock( &client->lock[data] );
+}
+
+/**
+ *  Passes the sockets curl wants watched on to the client's owner.
+ */
+int socket_cb( CURL *curl, curl_socket_t fd, int what, void *userp, void *socketp )
+{
+    http_client_t *client = (http_client_t*) userp;
+    int events = 0;
+
+    (void) curl;
+    (void) socketp;
+
+    if( (CURL_POLL_IN == what) || (CURL_POLL_INOUT == what) ) {
+        events |= HTTP_EVENT_IN;
+    }
+    if( (CURL_POLL_OUT == what) || (CURL_POLL_INOUT == what) ) {
+        events |= HTTP_EVENT_OUT;
+    }
+
+    (client->watch)( client->user_data, (int) fd, events );
+
+    return 0;
+}
+
+/**
+ *  Passes the timeout curl wants on to the client's owner.
+ */
+int timer_cb( CURLM *multi, long timeout_ms, void *userp )
+{
+    http_client_t *client = (http_client_t*) userp;
+
+    (void) multi;
+
+    (client->timer)( client->user_data, timeout_ms );
+
+    return 0;
+}
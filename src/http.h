@@ -16,9 +16,53 @@
 #ifndef REQUEST_H
 #define REQUEST_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <curl/curl.h>
 
+/* The socket events for http_watch_fn & http_process(). */
+#define HTTP_EVENT_IN   0x01
+#define HTTP_EVENT_OUT  0x02
+#define HTTP_EVENT_ERR  0x04
+
+/* The fd to pass to http_process() when the timeout expires. */
+#define HTTP_TIMEOUT    -1
+
+/**
+ *  Receives the response body as it arrives, for example by feeding an
+ *  envelope_stream_t.
+ *
+ *  When a request resumes a partial body but the server sends all of it
+ *  instead (because it changed), this is first called with a NULL buf to
+ *  drop the partial body.
+ *
+ *  @param user_data the write_data from the request
+ *  @param buf       the next part of the body, or NULL to start over
+ *  @param len       the length of the part in bytes
+ *
+ *  @return 0 to continue, anything else aborts the transfer
+ */
+typedef int (*http_write_fn)( void *user_data, const void *buf, size_t len );
+
+/**
+ *  Polled while a request runs, at least once a second.
+ *
+ *  @param user_data the abort_data from the request
+ *
+ *  @return 0 to continue, anything else abandons the request
+ */
+typedef int (*http_abort_fn)( void *user_data );
+
+/**
+ *  A long lived HTTP client.  The client keeps its connections alive between
+ *  requests and shares the DNS cache, the TLS sessions and the connections
+ *  across them, so a poll to the same server normally skips both the TCP
+ *  and the TLS handshakes.
+ *
+ *  A client makes one request at a time.
+ */
+typedef struct http_client http_client_t;
+
 typedef struct {
     /* Headers */
     const char *auth;           /* (optional) Authorization: Bearer %s */
@@ -27,6 +71,7 @@ typedef struct {
     const char *fw;             /* X-System-Firmware-Version: %s */
     const char *status;         /* X-System-Status: %s */
     const char *trans_id;       /* Transaction-Id: %s */
+    const char *if_range;       /* (optional) If-Range: %s */
     uint32_t boot_unixtime;     /* X-System-Boot-Time: %d */
     uint32_t ready_unixtime;    /* X-System-Ready-Time: %d */
     uint32_t current_unixtime;  /* X-System-Current-Time: %d */
@@ -44,18 +89,95 @@ typedef struct {
                                  * If NULL is specified the system chooses for you. */
     const char *ca_cert_path;   /* (optional) The CA certificate path.
                                  * If NULL is specified the system chooses for you. */
+
+    http_write_fn write_fn;     /* (optional) Receives the body instead of the
+                                 * response data/len.  If NULL is specified the
+                                 * body is collected in the response. */
+    void *write_data;           /* (optional) Passed to write_fn. */
+
+    http_abort_fn abort_fn;     /* (optional) Lets the request be abandoned
+                                 * before it completes or times out. */
+    void *abort_data;           /* (optional) Passed to abort_fn. */
+
+    size_t resume_from;         /* (optional) With a write_fn, the length of
+                                 * a partial body already held, so only the
+                                 * rest is asked for.  Pass the validator it
+                                 * came with in if_range, so the server sends
+                                 * all of it if it has changed.  The body is
+                                 * asked for uncompressed (identity), as a
+                                 * range of a compressed body can't be
+                                 * appended to the part held. */
+
+    void *body_buf;             /* (optional) The buffer to collect the body
+                                 * in, so polls allocate nothing once it is
+                                 * big enough.  A body that does not fit is
+                                 * moved to an allocated buffer. */
+    size_t body_buf_size;       /* The size of body_buf in bytes. */
+
+    http_client_t *client;      /* (optional) The client to make the request
+                                 * with.  If NULL is specified a connection is
+                                 * made just for this request. */
 } http_request_t;
 
 typedef struct {
     CURLcode code;              /* The response code from the perform(). */
-    long http_status;           /* The curl http status. */
-    CURL *curl;                 /* The curl object for getting more information. */
+    long http_status;           /* The curl http status, 0 if no response
+                                 * arrived.  Check the code as well, as the
+                                 * body may have been cut short. */
+    CURL *curl;                 /* The curl object for getting more information.
+                                 * If the request used a client this is only
+                                 * valid until its next request. */
+    http_client_t *client;      /* The client the curl object belongs to. */
 
     /* The response */
     size_t len;                 /* The response length. */
     void *data;                 /* The response data. */
+    size_t size;                /* The size of the data buffer. */
+    void *body_buf;             /* The request's body_buf, which is not freed
+                                 * if data still points to it. */
+
+    /* The body sizes.  The server may compress the body with any encoding
+     * curl supports, which is decompressed as it arrives. */
+    size_t wire_len;            /* The body bytes received, as sent. */
+    size_t body_len;            /* The body bytes after decompression. */
+    size_t resumed_from;        /* The length of the partial body the body
+                                 * continues (206), 0 if it is all of it. */
+
+    /* The request's write_fn & write_data, while the body arrives. */
+    http_write_fn write_fn;
+    void *write_data;
+
+    /* The request's abort_fn & abort_data, while it runs. */
+    http_abort_fn abort_fn;
+    void *abort_data;
+
+    char *etag;                 /* The ETag the server sent, or NULL. */
+
+    /* Set by an http_cache_t when the server answered 304 & the stored body
+     * is provided instead.  The data then points into the mapping of the
+     * cache file, which is unmapped with the response.  To keep the body
+     * take map & map_len, set them to NULL and munmap() them when done. */
+    bool cached;
+    void *map;
+    size_t map_len;
 } http_response_t;
 
+/**
+ *  Creates a client that reuses its connections & TLS sessions across
+ *  requests.
+ *
+ *  @return NULL on error, success otherwise
+ */
+http_client_t* http_client_create( void );
+
+/**
+ *  Destroys the client and closes its connections.  The responses made with
+ *  it must be destroyed first.
+ *
+ *  @param client the client to destroy
+ */
+void http_client_destroy( http_client_t *client );
+
 /**
  *  Makes the HTTP request and provides the response.
  *
@@ -73,4 +195,100 @@ int http_request( http_request_t *req, http_response_t *resp );
  */
 void http_destroy( http_response_t *resp );
 
+/**
+ *  Receives each response of http_fetch() & http_start() as soon as its transfer is done.
+ *
+ *  The response is destroyed when this returns.  To keep the body take
+ *  resp->data and set it to NULL.
+ *
+ *  @param user_data the user_data passed to http_fetch() or http_start()
+ *  @param index     the index of the request the response is for (always 0
+ *                   for http_start())
+ *  @param resp      the response
+ */
+typedef void (*http_done_fn)( void *user_data, size_t index, http_response_t *resp );
+
+/**
+ *  Makes all the requests at once over the client's connections and calls
+ *  done() for each as it finishes, in the order they finish.  Where the
+ *  server supports HTTP/2 the requests share a single connection, otherwise
+ *  they are made in parallel over several.
+ *
+ *  The client field of the requests is ignored.
+ *
+ *  @param client    the client to make the requests with
+ *  @param reqs      the requests
+ *  @param count     the number of requests
+ *  @param done      the completion handler
+ *  @param user_data passed to done()
+ *
+ *  @return 0 if all the requests were made (each response has its own
+ *          code & status), error otherwise
+ */
+int http_fetch( http_client_t *client, http_request_t *reqs, size_t count,
+                http_done_fn done, void *user_data );
+
+/**
+ *  Called when the sockets to watch for a client change.
+ *
+ *  @param user_data the user_data passed to http_client_watch()
+ *  @param fd        the socket
+ *  @param events    the HTTP_EVENT_* to watch for, 0 to stop watching it
+ */
+typedef void (*http_watch_fn)( void *user_data, int fd, int events );
+
+/**
+ *  Called when the time until http_process() must be called with
+ *  HTTP_TIMEOUT changes.
+ *
+ *  @param user_data  the user_data passed to http_client_watch()
+ *  @param timeout_ms the time left in ms, -1 to cancel the timeout
+ */
+typedef void (*http_timer_fn)( void *user_data, long timeout_ms );
+
+/**
+ *  Lets the client make requests without blocking, driven by an event loop.
+ *  The client asks for its sockets to be watched & for a timeout via the
+ *  callbacks, and the loop calls http_process() when either fires.
+ *
+ *  @note: http_process() must not be called from the callbacks.
+ *
+ *  @param client    the client
+ *  @param watch     called to change the sockets to watch
+ *  @param timer     called to change the timeout
+ *  @param user_data passed to the callbacks
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_client_watch( http_client_t *client, http_watch_fn watch,
+                       http_timer_fn timer, void *user_data );
+
+/**
+ *  Starts a request on a client set up with http_client_watch() without
+ *  waiting for it.  done() is called from http_process() once it finishes.
+ *
+ *  The client field of the request is ignored.
+ *
+ *  @param client    the client to make the request with
+ *  @param req       the request, which is copied
+ *  @param done      the completion handler
+ *  @param user_data passed to done()
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_start( http_client_t *client, http_request_t *req, http_done_fn done,
+                void *user_data );
+
+/**
+ *  Makes progress on the started requests after a socket event or the
+ *  timeout.
+ *
+ *  @param client the client
+ *  @param fd     the socket with events, or HTTP_TIMEOUT
+ *  @param events the HTTP_EVENT_* that happened on the socket
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_process( http_client_t *client, int fd, int events );
+
 #endif
@@ -0,0 +1,647 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "http_cache.h"
+#include "sha256.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+
+/* The http_cache_file_t after the body starts on this boundary. */
+#define HTTP_CACHE_ALIGN    8
+
+/* The longest ETag worth keeping. */
+#define MAX_ETAG_LEN        256
+
+/* The file name is the hex sha256 of the URL. */
+#define NAME_LEN            (2 * SHA256_SIZE)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The cached copy of a URL, while a request for it is made. */
+typedef struct {
+    char *path;
+    void *map;                  /* NULL if the URL is not cached. */
+    size_t map_len;
+    const char *etag;           /* In the mapping. */
+    const uint8_t *body;        /* In the mapping. */
+    size_t body_len;
+} entry_t;
+
+/* An http_cache_start() request in progress. */
+typedef struct pending {
+    struct pending *next;
+    http_cache_t *cache;
+    entry_t entry;
+    http_done_fn done;
+    void *user_data;
+} pending_t;
+
+/* The http_cache_fetch() requests. */
+typedef struct {
+    entry_t *entries;
+    http_done_fn done;
+    void *user_data;
+} fetch_t;
+
+struct http_cache {
+    char *dir;
+    size_t dir_len;
+    pending_t *pending;
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static char* __name( http_cache_t *cache, const char *url );
+static int __open( http_cache_t *cache, const char *url, entry_t *e );
+static void __close( entry_t *e );
+static void __finish( entry_t *e, http_response_t *resp );
+static int __store( const char *path, const char *etag, const void *body, size_t len );
+static int __copy( const char *from, const char *to );
+static size_t __tail( const char *etag, size_t body_len, uint8_t *tail );
+static int __write_all( int fd, const void *buf, size_t len );
+static size_t __trailer_offset( size_t body_len, size_t etag_len );
+static void __fetch_done( void *user_data, size_t index, http_response_t *resp );
+static void __start_done( void *user_data, size_t index, http_response_t *resp );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See http_cache.h for details. */
+http_cache_t* http_cache_create( const char *dir )
+{
+    http_cache_t *cache;
+
+    if( NULL == dir ) {
+        return NULL;
+    }
+
+    cache = (http_cache_t*) calloc( 1, sizeof(http_cache_t) );
+    if( NULL == cache ) {
+        return NULL;
+    }
+
+    cache->dir = strdup( dir );
+    if( NULL == cache->dir ) {
+        free( cache );
+        return NULL;
+    }
+    cache->dir_len = strlen( dir );
+
+    return cache;
+}
+
+/* See http_cache.h for details. */
+void http_cache_destroy( http_cache_t *cache )
+{
+    if( NULL != cache ) {
+        while( NULL != cache->pending ) {
+            pending_t *p = cache->pending;
+
+            cache->pending = p->next;
+            __close( &p->entry );
+            free( p );
+        }
+        free( cache->dir );
+        free( cache );
+    }
+}
+
+/* See http_cache.h for details. */
+int http_cache_request( http_cache_t *cache, http_request_t *req,
+                        http_response_t *resp )
+{
+    http_request_t r;
+    entry_t e;
+    int rv;
+
+    if( (NULL == cache) || (NULL == req) || (NULL == resp) || (NULL == req->url) ) {
+        return -1;
+    }
+
+    if( 0 != __open(cache, req->url, &e) ) {
+        return -3;
+    }
+
+    memcpy( &r, req, sizeof(http_request_t) );
+    if( NULL != e.map ) {
+        r.cfg_ver = e.etag;
+    }
+
+    rv = http_request( &r, resp );
+    if( 0 == rv ) {
+        __finish( &e, resp );
+    }
+    __close( &e );
+
+    return rv;
+}
+
+/* See http_cache.h for details. */
+int http_cache_fetch( http_cache_t *cache, http_client_t *client,
+                      http_request_t *reqs, size_t count,
+                      http_done_fn done, void *user_data )
+{
+    http_request_t *r;
+    fetch_t f;
+    size_t i;
+    int rv = 0;
+
+    if( (NULL == cache) || ((NULL == reqs) && (0 < count)) || (NULL == done) ) {
+        return -1;
+    }
+    if( 0 == count ) {
+        return http_fetch( client, reqs, count, done, user_data );
+    }
+
+    r = (http_request_t*) malloc( count * sizeof(http_request_t) );
+    f.entries = (entry_t*) calloc( count, sizeof(entry_t) );
+    if( (NULL == r) || (NULL == f.entries) ) {
+        free( r );
+        free( f.entries );
+        return -3;
+    }
+    f.done = done;
+    f.user_data = user_data;
+
+    memcpy( r, reqs, count * sizeof(http_request_t) );
+    for( i = 0; (0 == rv) && (i < count); i++ ) {
+        if( NULL == reqs[i].url ) {
+            rv = -1;
+        } else if( 0 != __open(cache, reqs[i].url, &f.entries[i]) ) {
+            rv = -3;
+        } else if( NULL != f.entries[i].map ) {
+            r[i].cfg_ver = f.entries[i].etag;
+        }
+    }
+
+    if( 0 == rv ) {
+        rv = http_fetch( client, r, count, __fetch_done, &f );
+    }
+
+    for( i = 0; i < count; i++ ) {
+        __close( &f.entries[i] );
+    }
+    free( f.entries );
+    free( r );
+
+    return rv;
+}
+
+/* See http_cache.h for details. */
+int http_cache_start( http_cache_t *cache, http_client_t *client,
+                      http_request_t *req, http_done_fn done, void *user_data )
+{
+    http_request_t r;
+    pending_t *p;
+    int rv;
+
+    if( (NULL == cache) || (NULL == req) || (NULL == req->url) || (NULL == done) ) {
+        return -1;
+    }
+
+    p = (pending_t*) calloc( 1, sizeof(pending_t) );
+    if( NULL == p ) {
+        return -3;
+    }
+    if( 0 != __open(cache, req->url, &p->entry) ) {
+        free( p );
+        return -3;
+    }
+    p->cache = cache;
+    p->done = done;
+    p->user_data = user_data;
+
+    memcpy( &r, req, sizeof(http_request_t) );
+    if( NULL != p->entry.map ) {
+        r.cfg_ver = p->entry.etag;
+    }
+
+    rv = http_start( client, &r, __start_done, p );
+    if( 0 != rv ) {
+        __close( &p->entry );
+        free( p );
+        return rv;
+    }
+
+    p->next = cache->pending;
+    cache->pending = p;
+
+    return 0;
+}
+
+/* See http_cache.h for details. */
+int http_cache_store_file( http_cache_t *cache, const char *url,
+                           const char *etag, const char *path )
+{
+    uint8_t tail[MAX_ETAG_LEN + HTTP_CACHE_ALIGN + sizeof(http_cache_file_t)];
+    struct stat st;
+    size_t len;
+    char *name;
+    int fd, rv = -1;
+
+    if( (NULL == cache) || (NULL == url) || (NULL == etag) || (NULL == path) ) {
+        return -1;
+    }
+
+    name = __name( cache, url );
+    if( NULL == name ) {
+        return -3;
+    }
+
+    /* Only the rest of the file is written; the body stays where it is. */
+    fd = open( path, O_WRONLY | O_APPEND | O_CLOEXEC );
+    if( 0 <= fd ) {
+        if( 0 == fstat(fd, &st) ) {
+            len = __tail( etag, (size_t) st.st_size, tail );
+            if( (0 < len) && (0 == __write_all(fd, tail, len)) && (0 == fsync(fd)) ) {
+                rv = 0;
+            }
+        }
+        if( 0 != close(fd) ) {
+            rv = -1;
+        }
+    }
+
+    if( (0 == rv) && (0 != rename(path, name)) ) {
+        rv = ((EXDEV == errno) && (0 == __copy(path, name))) ? 0 : -1;
+        unlink( path );
+    }
+
+    if( 0 != rv ) {
+        /* Don't ask for a body that is no longer the one stored. */
+        unlink( name );
+    }
+    free( name );
+
+    return rv;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Provides the path of the cache file for a URL.
+ *
+ *  @return the path (to be freed), or NULL on error
+ */
+static char* __name( http_cache_t *cache, const char *url )
+{
+    uint8_t digest[SHA256_SIZE];
+    char *path;
+    int i;
+
+    path = (char*) malloc( cache->dir_len + 1 + NAME_LEN + 1 );
+    if( NULL == path ) {
+        return NULL;
+    }
+
+    sha256( url, strlen(url), digest );
+    memcpy( path, cache->dir, cache->dir_len );
+    path[cache->dir_len] = '/';
+    for( i = 0; i < SHA256_SIZE; i++ ) {
+        sprintf( &path[cache->dir_len + 1 + 2 * i], "%02x", digest[i] );
+    }
+
+    return path;
+}
+
+/**
+ *  Finds the cached copy of a URL & maps it.  A missing or damaged file
+ *  just means the URL is not cached.
+ *
+ *  @param cache the cache
+ *  @param url   the URL
+ *  @param e     the entry to fill in
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __open( http_cache_t *cache, const char *url, entry_t *e )
+{
+    const http_cache_file_t *f;
+    struct stat st;
+    size_t size;
+    void *p;
+    int fd;
+
+    memset( e, 0, sizeof(entry_t) );
+
+    e->path = __name( cache, url );
+    if( NULL == e->path ) {
+        return -1;
+    }
+
+    fd = open( e->path, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 ) {
+        return 0;
+    }
+    if( (0 != fstat(fd, &st)) || (st.st_size < (off_t) sizeof(http_cache_file_t)) ) {
+        close( fd );
+        return 0;
+    }
+
+    p = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == p ) {
+        return 0;
+    }
+
+    /* Only trust a file that is exactly what its trailer says. */
+    size = (size_t) st.st_size;
+    f = (const http_cache_file_t*) &((const uint8_t*) p)[size - sizeof(http_cache_file_t)];
+    if( (0 != (size % HTTP_CACHE_ALIGN)) ||
+        (0 != memcmp(f->magic, HTTP_CACHE_MAGIC, sizeof(f->magic))) ||
+        (HTTP_CACHE_VERSION != f->version) ||
+        (0 == f->etag_len) || (MAX_ETAG_LEN < f->etag_len) ||
+        ((uint64_t) size < f->body_len) ||
+        (size != __trailer_offset((size_t) f->body_len, f->etag_len) + sizeof(http_cache_file_t)) ||
+        ('\0' != ((const char*) p)[f->body_len + f->etag_len]) )
+    {
+        munmap( p, size );
+        return 0;
+    }
+
+    e->map = p;
+    e->map_len = size;
+    e->etag = &((const char*) p)[f->body_len];
+    e->body = (const uint8_t*) p;
+    e->body_len = (size_t) f->body_len;
+
+    return 0;
+}
+
+/**
+ *  Releases an entry.
+ */
+static void __close( entry_t *e )
+{
+    if( NULL != e->map ) {
+        munmap( e->map, e->map_len );
+        e->map = NULL;
+    }
+    free( e->path );
+    e->path = NULL;
+}
+
+/**
+ *  Applies a response to the cache: a 304 for a cached URL hands the
+ *  mapping of the cached body to the response, a 200 stores the new body.
+ *  A body passed to a write_fn is left for http_cache_store_file().
+ *
+ *  @param e    the entry for the URL
+ *  @param resp the response
+ */
+static void __finish( entry_t *e, http_response_t *resp )
+{
+    if( CURLE_OK != resp->code ) {
+        return;
+    }
+
+    if( (304 == resp->http_status) && (NULL != e->map) ) {
+        if( (NULL != resp->data) && (resp->data != resp->body_buf) ) {
+            free( resp->data );
+        }
+        resp->data = (void*) e->body;
+        resp->len = e->body_len;
+        resp->size = e->body_len;
+        resp->cached = true;
+        resp->map = e->map;
+        resp->map_len = e->map_len;
+        e->map = NULL;
+    } else if( 200 == resp->http_status ) {
+        if( (NULL != resp->write_fn) || (NULL == resp->etag) ||
+            (0 != __store(e->path, resp->etag, resp->data, resp->len)) )
+        {
+            /* Don't ask for a body that is no longer the one stored. */
+            unlink( e->path );
+        }
+    }
+}
+
+/**
+ *  Writes a cache file so it either fully replaces the old one or not at
+ *  all.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __store( const char *path, const char *etag, const void *body, size_t len )
+{
+    uint8_t tail[MAX_ETAG_LEN + HTTP_CACHE_ALIGN + sizeof(http_cache_file_t)];
+    size_t tail_len = __tail( etag, len, tail );
+    char *tmp;
+    int fd, rv = -1;
+
+    if( 0 == tail_len ) {
+        return -1;
+    }
+
+    tmp = (char*) malloc( strlen(path) + 5 );
+    if( NULL == tmp ) {
+        return -1;
+    }
+    sprintf( tmp, "%s.tmp", path );
+
+    fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+    if( 0 <= fd ) {
+        if( (0 == __write_all(fd, body, len)) &&
+            (0 == __write_all(fd, tail, tail_len)) &&
+            (0 == fsync(fd)) )
+        {
+            rv = 0;
+        }
+        if( 0 != close(fd) ) {
+            rv = -1;
+        }
+        if( (0 == rv) && (0 != rename(tmp, path)) ) {
+            rv = -1;
+        }
+        if( 0 != rv ) {
+            unlink( tmp );
+        }
+    }
+    free( tmp );
+
+    return rv;
+}
+
+/**
+ *  Copies a file so the copy either fully replaces the old one or not at
+ *  all.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __copy( const char *from, const char *to )
+{
+    uint8_t buf[4096];
+    ssize_t n = -1;
+    char *tmp;
+    int in, out, rv = -1;
+
+    in = open( from, O_RDONLY | O_CLOEXEC );
+    if( in < 0 ) {
+        return -1;
+    }
+
+    tmp = (char*) malloc( strlen(to) + 5 );
+    if( NULL == tmp ) {
+        close( in );
+        return -1;
+    }
+    sprintf( tmp, "%s.tmp", to );
+
+    out = open( tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+    if( 0 <= out ) {
+        while( (0 < (n = read(in, buf, sizeof(buf)))) &&
+               (0 == __write_all(out, buf, (size_t) n)) )
+        {
+        }
+        if( (0 == n) && (0 == fsync(out)) ) {
+            rv = 0;
+        }
+        if( 0 != close(out) ) {
+            rv = -1;
+        }
+        if( (0 == rv) && (0 != rename(tmp, to)) ) {
+            rv = -1;
+        }
+        if( 0 != rv ) {
+            unlink( tmp );
+        }
+    }
+    free( tmp );
+    close( in );
+
+    return rv;
+}
+
+/**
+ *  Provides what follows a body in a cache file: the ETag, the padding &
+ *  the http_cache_file_t.
+ *
+ *  @param etag     the ETag
+ *  @param body_len the length of the body
+ *  @param tail     where to put it, MAX_ETAG_LEN + HTTP_CACHE_ALIGN +
+ *                  sizeof(http_cache_file_t) bytes
+ *
+ *  @return the length of the tail, 0 if the ETag is not worth keeping
+ */
+static size_t __tail( const char *etag, size_t body_len, uint8_t *tail )
+{
+    http_cache_file_t f;
+    size_t etag_len = strlen( etag );
+    size_t offset;
+
+    if( (0 == etag_len) || (MAX_ETAG_LEN < etag_len) ) {
+        return 0;
+    }
+
+    /* The trailer is aligned within the file, not the tail. */
+    offset = __trailer_offset( body_len, etag_len ) - body_len;
+
+    memset( tail, 0, offset );
+    memcpy( tail, etag, etag_len );
+
+    memcpy( f.magic, HTTP_CACHE_MAGIC, sizeof(f.magic) );
+    f.version = HTTP_CACHE_VERSION;
+    f.etag_len = (uint32_t) etag_len;
+    f.body_len = (uint64_t) body_len;
+    memcpy( &tail[offset], &f, sizeof(http_cache_file_t) );
+
+    return offset + sizeof(http_cache_file_t);
+}
+
+/**
+ *  Writes all of a buffer.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __write_all( int fd, const void *buf, size_t len )
+{
+    const uint8_t *p = (const uint8_t*) buf;
+
+    while( 0 < len ) {
+        ssize_t n = write( fd, p, len );
+
+        if( n <= 0 ) {
+            if( (n < 0) && (EINTR == errno) ) {
+                continue;
+            }
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+/**
+ *  Provides where the http_cache_file_t starts in a cache file.
+ */
+static size_t __trailer_offset( size_t body_len, size_t etag_len )
+{
+    size_t offset = body_len + etag_len + 1;
+
+    return (offset + HTTP_CACHE_ALIGN - 1) & ~((size_t) HTTP_CACHE_ALIGN - 1);
+}
+
+/**
+ *  Applies each http_cache_fetch() response to the cache before passing it
+ *  on.
+ */
+static void __fetch_done( void *user_data, size_t index, http_response_t *resp )
+{
+    fetch_t *f = (fetch_t*) user_data;
+
+    __finish( &f->entries[index], resp );
+    (f->done)( f->user_data, index, resp );
+}
+
+/**
+ *  Applies the http_cache_start() response to the cache before passing it
+ *  on.
+ */
+static void __start_done( void *user_data, size_t index, http_response_t *resp )
+{
+    pending_t *p = (pending_t*) user_data;
+    pending_t **prev = &p->cache->pending;
+
+    while( *prev != p ) {
+        prev = &(*prev)->next;
+    }
+    *prev = p->next;
+
+    __finish( &p->entry, resp );
+    (p->done)( p->user_data, index, resp );
+
+    __close( &p->entry );
+    free( p );
+}
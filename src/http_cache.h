@@ -0,0 +1,131 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <stdint.h>
+
+#include "http.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define HTTP_CACHE_MAGIC    "WEBCFGHC"
+#define HTTP_CACHE_VERSION  1
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  A cache of response bodies on disk, keyed by URL.  Each URL has one file,
+ *  named by the sha256 of the URL, with the body & the ETag the server sent:
+ *
+ *      body | ETag '\0' | padding to 8 | http_cache_file_t
+ *
+ *  The body comes first so a download of it becomes the cache file by
+ *  appending the rest & renaming it into place.
+ *
+ *  A request for a cached URL is sent with the stored ETag in IF-NONE-MATCH
+ *  in place of the request's cfg_ver.  When the server answers 304 the body
+ *  is provided from a mapping of the file, so an unchanged document only
+ *  costs the headers on the wire & nothing is copied.
+ *
+ *  Bodies collected in the response are stored by the request.  Those passed
+ *  to a write_fn are stored by http_cache_store_file() once complete.
+ */
+typedef struct http_cache http_cache_t;
+
+typedef struct {
+    uint8_t magic[8];           /* HTTP_CACHE_MAGIC */
+    uint32_t version;           /* HTTP_CACHE_VERSION */
+    uint32_t etag_len;          /* Not counting the '\0'. */
+    uint64_t body_len;          /* The ETag follows the body. */
+} http_cache_file_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Creates a cache kept in a directory.
+ *
+ *  @param dir the directory, which must exist (normally the durable_path)
+ *
+ *  @return NULL on error, success otherwise
+ */
+http_cache_t* http_cache_create( const char *dir );
+
+/**
+ *  Destroys the cache.  The files are kept for the next one.  A client with
+ *  requests started by http_cache_start() must be destroyed first.
+ *
+ *  @param cache the cache to destroy
+ */
+void http_cache_destroy( http_cache_t *cache );
+
+/**
+ *  Makes the request like http_request(), but conditional on the cached
+ *  copy of the URL.  A 304 for a cached URL provides the cached body with
+ *  resp->cached set, a 200 with an ETag replaces the cached copy & a 200
+ *  without one removes it.
+ *
+ *  @param cache the cache
+ *  @param req   the request object
+ *  @param resp  the response object, destroyed with http_destroy()
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_cache_request( http_cache_t *cache, http_request_t *req,
+                        http_response_t *resp );
+
+/**
+ *  Makes the requests like http_fetch(), each conditional on the cached copy
+ *  of its URL as for http_cache_request().
+ *
+ *  @return 0 if all the requests were made, error otherwise
+ */
+int http_cache_fetch( http_cache_t *cache, http_client_t *client,
+                      http_request_t *reqs, size_t count,
+                      http_done_fn done, void *user_data );
+
+/**
+ *  Starts the request like http_start(), conditional on the cached copy of
+ *  the URL as for http_cache_request().  The cache must outlive the
+ *  request.
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_cache_start( http_cache_t *cache, http_client_t *client,
+                      http_request_t *req, http_done_fn done, void *user_data );
+
+/**
+ *  Stores a body a write_fn wrote to a file as the cached copy of the URL,
+ *  once the response is complete.  The file is moved into the cache, not
+ *  copied, unless it is on another filesystem.  A mapping of the file stays
+ *  valid.
+ *
+ *  @param cache the cache
+ *  @param url   the URL the body is for
+ *  @param etag  the ETag the body came with
+ *  @param path  the file holding only the body, which is gone on success
+ *
+ *  @return 0 on success, error otherwise
+ */
+int http_cache_store_file( http_cache_t *cache, const char *url,
+                           const char *etag, const char *path );
+
+#endif
@@ -17,6 +17,7 @@
 #include "http_headers.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
@@ -32,6 +33,9 @@
  */
 #define sizeof_array(x) (sizeof(x) / sizeof((x)[0]))
 
+/* The smallest buffer a header slot is given, enough for most values. */
+#define MIN_SLOT_SIZE   128
+
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
@@ -93,6 +97,71 @@ int vappend_header( struct curl_slist **l, const char *format, va_list args )
     return 0;
 }
 
+int header_slot_init( header_slot_t *s, const char *prefix )
+{
+    size_t len = strlen( prefix );
+
+    memset( s, 0, sizeof(header_slot_t) );
+
+    s->size = (MIN_SLOT_SIZE < len + 1) ? len + 1 : MIN_SLOT_SIZE;
+    s->buf = (char*) malloc( s->size );
+    if( NULL == s->buf ) {
+        return -1;
+    }
+    memcpy( s->buf, prefix, len + 1 );
+    s->prefix_len = len;
+    s->node.data = s->buf;
+
+    return 0;
+}
+
+int header_slot_set( header_slot_t *s, const char *value )
+{
+    size_t len = strlen( value );
+
+    if( s->size < s->prefix_len + len + 1 ) {
+        size_t size = 2 * s->size;
+        char *tmp;
+
+        if( size < s->prefix_len + len + 1 ) {
+            size = s->prefix_len + len + 1;
+        }
+        tmp = (char*) realloc( s->buf, size );
+        if( NULL == tmp ) {
+            return -1;
+        }
+        s->buf = tmp;
+        s->size = size;
+        s->node.data = s->buf;
+    }
+
+    memcpy( &s->buf[s->prefix_len], value, len + 1 );
+
+    return 0;
+}
+
+int header_slot_set_u32( header_slot_t *s, uint32_t value )
+{
+    char digits[11];
+    size_t i = sizeof_array(digits) - 1;
+
+    digits[i] = '\0';
+    do {
+        digits[--i] = (char) ('0' + (value % 10));
+        value /= 10;
+    } while( 0 < value );
+
+    return header_slot_set( s, &digits[i] );
+}
+
+void header_slot_destroy( header_slot_t *s )
+{
+    if( NULL != s->buf ) {
+        free( s->buf );
+    }
+    memset( s, 0, sizeof(header_slot_t) );
+}
+
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
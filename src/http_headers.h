@@ -18,6 +18,19 @@
 
 #include <curl/curl.h>
 #include <stdarg.h>
+#include <stdint.h>
+
+/**
+ *  A header line that is built once and then changed in place.  The node is
+ *  linked into a curl_slist by the owner, and only ever points at the
+ *  slot's own buffer, so it must not be freed with curl_slist_free_all().
+ */
+typedef struct {
+    struct curl_slist node;
+    char *buf;
+    size_t size;                /* The size of buf. */
+    size_t prefix_len;          /* The length of the fixed start of the line. */
+} header_slot_t;
 
 /**
  *  Convert a printf() formatted argument list into a curl header.
@@ -33,4 +46,32 @@ int append_header( struct curl_slist **l, const char *format, ... );
  */
 int vappend_header( struct curl_slist **l, const char *format, va_list ap );
 
+/**
+ *  Sets up a header slot with the fixed start of the line, for example
+ *  "Transaction-Id: ".
+ *
+ *  @return 0 on success or error otherwise
+ */
+int header_slot_init( header_slot_t *s, const char *prefix );
+
+/**
+ *  Replaces the rest of the line after the prefix.  Nothing is allocated or
+ *  formatted unless the value outgrows every value before it.
+ *
+ *  @return 0 on success or error otherwise
+ */
+int header_slot_set( header_slot_t *s, const char *value );
+
+/**
+ *  Replaces the rest of the line after the prefix with a decimal number.
+ *
+ *  @return 0 on success or error otherwise
+ */
+int header_slot_set_u32( header_slot_t *s, uint32_t value );
+
+/**
+ *  Frees the slot's buffer.
+ */
+void header_slot_destroy( header_slot_t *s );
+
 #endif
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __INDEX_H__
+#define __INDEX_H__
+
+#include "helpers.h"
+#include "portmapping.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Builds the index of the entries: the port ranges of each protocol, sorted,
+ *  with the furthest port reached so far, & a bitmap of the covered ports
+ *  for the protocols with many entries.  Used by the decoder & when a
+ *  portmapping is rebuilt from a snapshot.
+ *
+ *  @param pm  the portmapping with its entries
+ *  @param ctx the decode context the index is allocated from
+ *
+ *  @return 0 on success, error otherwise
+ */
+int portmapping_index_build( portmapping_t *pm, helper_ctx_t *ctx );
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pool.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct pool {
+    pthread_mutex_t run;        /* Held for the whole of a batch. */
+
+    pthread_mutex_t lock;       /* Protects the rest. */
+    pthread_cond_t work;        /* A batch started or the pool is stopping. */
+    pthread_cond_t done;        /* The last job of a batch finished. */
+
+    pool_fn_t fn;
+    void *arg;
+    size_t count;               /* The jobs in the batch. */
+    size_t next;                /* The next job to hand out. */
+    size_t finished;
+    bool stop;
+
+    size_t threads_count;
+    pthread_t threads[];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void* __worker( void *arg );
+static void __work( pool_t *p );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See pool.h for details. */
+pool_t* pool_create( size_t threads )
+{
+    pool_t *p;
+    size_t i;
+
+    p = (pool_t*) malloc( sizeof(pool_t) + threads * sizeof(pthread_t) );
+    if( NULL == p ) {
+        return NULL;
+    }
+
+    memset( p, 0, sizeof(pool_t) );
+    pthread_mutex_init( &p->run, NULL );
+    pthread_mutex_init( &p->lock, NULL );
+    pthread_cond_init( &p->work, NULL );
+    pthread_cond_init( &p->done, NULL );
+
+    for( i = 0; i < threads; i++ ) {
+        if( 0 != pthread_create(&p->threads[i], NULL, __worker, p) ) {
+            pool_destroy( p );
+            return NULL;
+        }
+        p->threads_count++;
+    }
+
+    return p;
+}
+
+/* See pool.h for details. */
+void pool_run( pool_t *p, size_t count, pool_fn_t fn, void *arg )
+{
+    size_t i;
+
+    if( (NULL == p) || (0 == p->threads_count) || (count < 2) ) {
+        for( i = 0; i < count; i++ ) {
+            fn( arg, i );
+        }
+        return;
+    }
+
+    pthread_mutex_lock( &p->run );
+    pthread_mutex_lock( &p->lock );
+    p->fn = fn;
+    p->arg = arg;
+    p->count = count;
+    p->next = 0;
+    p->finished = 0;
+    pthread_cond_broadcast( &p->work );
+
+    /* Help out rather than wait. */
+    __work( p );
+    while( p->finished < p->count ) {
+        pthread_cond_wait( &p->done, &p->lock );
+    }
+    p->count = 0;
+    p->next = 0;
+    pthread_mutex_unlock( &p->lock );
+    pthread_mutex_unlock( &p->run );
+}
+
+/* See pool.h for details. */
+void pool_destroy( pool_t *p )
+{
+    size_t i;
+
+    if( NULL == p ) {
+        return;
+    }
+
+    pthread_mutex_lock( &p->lock );
+    p->stop = true;
+    pthread_cond_broadcast( &p->work );
+    pthread_mutex_unlock( &p->lock );
+
+    for( i = 0; i < p->threads_count; i++ ) {
+        pthread_join( p->threads[i], NULL );
+    }
+
+    pthread_cond_destroy( &p->done );
+    pthread_cond_destroy( &p->work );
+    pthread_mutex_destroy( &p->lock );
+    pthread_mutex_destroy( &p->run );
+    free( p );
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  The worker thread.
+ */
+static void* __worker( void *arg )
+{
+    pool_t *p = (pool_t*) arg;
+
+    pthread_mutex_lock( &p->lock );
+    while( !p->stop ) {
+        if( p->next < p->count ) {
+            __work( p );
+        } else {
+            pthread_cond_wait( &p->work, &p->lock );
+        }
+    }
+    pthread_mutex_unlock( &p->lock );
+
+    return NULL;
+}
+
+/**
+ *  Runs jobs of the current batch until there are none left to hand out.
+ *
+ *  @note the lock must be held.
+ */
+static void __work( pool_t *p )
+{
+    while( p->next < p->count ) {
+        size_t i = p->next++;
+        pool_fn_t fn = p->fn;
+        void *arg = p->arg;
+
+        pthread_mutex_unlock( &p->lock );
+        fn( arg, i );
+        pthread_mutex_lock( &p->lock );
+
+        p->finished++;
+        if( p->finished == p->count ) {
+            pthread_cond_signal( &p->done );
+        }
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  A small pool of worker threads that runs batches of independent jobs.
+ */
+typedef struct pool pool_t;
+
+/**
+ *  A job of a batch.
+ *
+ *  @param arg the argument given to pool_run()
+ *  @param i   the index of the job in the batch
+ */
+typedef void (*pool_fn_t)( void *arg, size_t i );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function creates a pool.
+ *
+ *  @param threads the number of worker threads; the thread calling
+ *                 pool_run() works too, so 0 runs everything in the caller
+ *
+ *  @return NULL on error, success otherwise
+ */
+pool_t* pool_create( size_t threads );
+
+/**
+ *  This function runs a batch of jobs, returning once all of them are done.
+ *  Batches from different threads take turns.
+ *
+ *  @param p     the pool, NULL runs the jobs in the calling thread
+ *  @param count the number of jobs
+ *  @param fn    the function to call for each job
+ *  @param arg   the argument to pass to fn
+ */
+void pool_run( pool_t *p, size_t count, pool_fn_t fn, void *arg );
+
+/**
+ *  This function stops the worker threads & destroys the pool.
+ *
+ *  @param p the pool to destroy
+ */
+void pool_destroy( pool_t *p );
+
+#endif
@@ -15,15 +15,18 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
+#include "index.h"
 #include "portmapping.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+/* A protocol with this many entries also gets a bitmap of the ports they
+ * cover, so most misses cost a single bit test. */
+#define PORT_BITMAP_ENTRIES 64
+#define PORT_BITMAP_SIZE    ((UINT16_MAX + 1) / 8)
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -43,19 +46,49 @@ enum {
     PM_MISSING_PORT_RANGE,
     PM_MISSING_PROTOCOL,
     PM_INVALID_PM_OBJECT,
+    PM_OVERLAPPING_PORT_RANGES,
+};
+
+enum {
+    KEY_TARGET_PORT = 1,
+    KEY_TARGET_IPV4,
+    KEY_TARGET_IPV6,
+    KEY_PORT_RANGE,
+    KEY_PROTOCOL
 };
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __entry_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "target-port",         't', 'a', 't', KEY_TARGET_PORT ),
+    HELPER_KEY( "target-ipv4",         't', 'a', '4', KEY_TARGET_IPV4 ),
+    HELPER_KEY( "target-ipv6",         't', 'a', '6', KEY_TARGET_IPV6 ),
+    HELPER_KEY( "external-port-range", 'e', 'x', 'e', KEY_PORT_RANGE ),
+    HELPER_KEY( "protocol",            'p', 'r', 'l', KEY_PROTOCOL ),
+};
+
+/* Each entry with its range in the index, at most its own protocol & the
+ * protocol it is sorted into while the index is built.  The arrays of
+ * ranges & protocols sorted into are each rounded up to the arena alignment
+ * once, which the extra bytes of the index cover.  The port bitmaps are only
+ * built for busy protocols & are not reserved. */
+static const helper_array_t __pm_entries = {
+    .key = NULL,
+    .element_size = sizeof(pm_entry_t) + sizeof(pm_range_t) + sizeof(pm_protocol_t) +
+                    sizeof(uint32_t),
+    .index_size = sizeof(pm_index_t) + sizeof(uint32_t),
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_portrange( pm_entry_t *e, msgpack_object_array *array );
-int process_entry( pm_entry_t *e, msgpack_object_map *map );
-int process_portmapping( portmapping_t *pm, msgpack_object *obj );
+int process_portrange( pm_entry_t *e, cursor_t *c, const token_t *array );
+int process_entry( pm_entry_t *e, cursor_t *c, const token_t *map, helper_ctx_t *ctx );
+int process_portmapping( portmapping_t *pm, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
+static const pm_protocol_t* __find_protocol( const pm_index_t *idx, const char *protocol,
+                                             size_t len );
+static int __range_cmp( const void *a, const void *b );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -65,7 +98,16 @@ int process_portmapping( portmapping_t *pm, msgpack_object *obj );
 portmapping_t* portmapping_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(portmapping_t), "port-mapping",
-                           MSGPACK_OBJECT_ARRAY, true,
+                           TOKEN_ARRAY, true, false, &__pm_entries,
+                           (process_fn_t) process_portmapping,
+                           (destroy_fn_t) portmapping_destroy );
+}
+
+/* See portmapping.h for details. */
+portmapping_t* portmapping_convert_view( const void *buf, size_t len )
+{
+    return helper_convert( buf, len, sizeof(portmapping_t), "port-mapping",
+                           TOKEN_ARRAY, true, true, &__pm_entries,
                            (process_fn_t) process_portmapping,
                            (destroy_fn_t) portmapping_destroy );
 }
@@ -73,18 +115,225 @@ portmapping_t* portmapping_convert( const void *buf, size_t len )
 /* See portmapping.h for details. */
 void portmapping_destroy( portmapping_t *pm )
 {
-    if( NULL != pm ) {
-        size_t i;
-        for( i = 0; i < pm->entries_count; i++ ) {
-            if( NULL != pm->entries[i].protocol ) {
-                free( pm->entries[i].protocol );
+    helper_free( pm );
+}
+
+/* See portmapping.h for details. */
+const pm_entry_t* portmapping_lookup( const portmapping_t *pm,
+                                      const char *protocol, size_t protocol_len,
+                                      uint16_t port )
+{
+    const pm_protocol_t *p;
+    size_t lo = 0, hi;
+
+    if( (NULL == pm) || (NULL == pm->index) ) {
+        return NULL;
+    }
+
+    p = __find_protocol( pm->index, protocol, protocol_len );
+    if( NULL == p ) {
+        return NULL;
+    }
+    if( (NULL != p->ports) && !(p->ports[port >> 3] & (1 << (port & 7))) ) {
+        return NULL;
+    }
+
+    /* Find the ranges starting at or before the port ... */
+    hi = p->ranges_count;
+    while( lo < hi ) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if( p->ranges[mid].first <= port ) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    /* ... & walk back through those that may still reach it, which is only
+     * the last one unless ranges overlap. */
+    while( (0 < lo) && (port <= p->ranges[lo - 1].max_last) ) {
+        const pm_range_t *r = &p->ranges[--lo];
+
+        if( (r->first <= port) && (port <= r->last) ) {
+            return &pm->entries[r->entry];
+        }
+    }
+
+    return NULL;
+}
+
+/* See portmapping.h for details. */
+bool portmapping_overlaps( const portmapping_t *pm, size_t *a, size_t *b )
+{
+    size_t i, j;
+
+    if( (NULL == pm) || (NULL == pm->index) ) {
+        return false;
+    }
+
+    /* In order of their first port, a range overlaps an earlier one if it
+     * starts before the furthest reaching earlier one ends. */
+    for( i = 0; i < pm->index->protocols_count; i++ ) {
+        const pm_protocol_t *p = &pm->index->protocols[i];
+        const pm_range_t *reach = NULL;
+
+        for( j = 0; j < p->ranges_count; j++ ) {
+            const pm_range_t *r = &p->ranges[j];
+
+            if( r->last < r->first ) {
+                continue;
+            }
+            if( (NULL != reach) && (r->first <= reach->last) ) {
+                if( NULL != a ) *a = reach->entry;
+                if( NULL != b ) *b = r->entry;
+                return true;
+            }
+            if( (NULL == reach) || (reach->last < r->last) ) {
+                reach = r;
             }
         }
-        if( NULL != pm->entries ) {
-            free( pm->entries );
+    }
+
+    return false;
+}
+
+/* See portmapping.h for details. */
+int portmapping_validate( const portmapping_t *pm )
+{
+    size_t i;
+
+    for( i = 0; i < pm->entries_count; i++ ) {
+        if( pm->entries[i].port_range[1] < pm->entries[i].port_range[0] ) {
+            errno = PM_INVALID_PORT_RANGE;
+            return -1;
         }
-        free( pm );
     }
+
+    if( portmapping_overlaps(pm, NULL, NULL) ) {
+        errno = PM_OVERLAPPING_PORT_RANGES;
+        return -1;
+    }
+
+    errno = PM_OK;
+    return 0;
+}
+
+/* See index.h for details. */
+int portmapping_index_build( portmapping_t *pm, helper_ctx_t *ctx )
+{
+    pm_index_t *idx;
+    pm_range_t *ranges;
+    uint32_t *protocol_of;
+    size_t i, p;
+
+    idx = (pm_index_t*) helper_alloc( ctx, sizeof(pm_index_t) );
+    ranges = (pm_range_t*) helper_alloc( ctx, sizeof(pm_range_t) * pm->entries_count );
+    /* Only needed while building, but taken from the arena like the rest so
+     * a decode makes no allocations of its own. */
+    protocol_of = (uint32_t*) helper_alloc( ctx, sizeof(uint32_t) * pm->entries_count );
+    if( (NULL == idx) || (NULL == ranges) || (NULL == protocol_of) ) {
+        errno = PM_OUT_OF_MEMORY;
+        return -1;
+    }
+
+    /* There are only a few protocols, so they are found by a search.  Until
+     * the entries are counted they are kept in the ranges. */
+    memset( idx, 0, sizeof(pm_index_t) );
+    for( i = 0; i < pm->entries_count; i++ ) {
+        const pm_entry_t *e = &pm->entries[i];
+
+        for( p = 0; p < idx->protocols_count; p++ ) {
+            const pm_entry_t *first = &pm->entries[ranges[p].entry];
+
+            if( (first->protocol_len == e->protocol_len) &&
+                (0 == memcmp(first->protocol, e->protocol, e->protocol_len)) )
+            {
+                break;
+            }
+        }
+        if( p == idx->protocols_count ) {
+            ranges[p].entry = (uint32_t) i;
+            idx->protocols_count++;
+        }
+        protocol_of[i] = (uint32_t) p;
+    }
+
+    idx->protocols = (pm_protocol_t*) helper_alloc( ctx, sizeof(pm_protocol_t) * idx->protocols_count );
+    if( NULL == idx->protocols ) {
+        errno = PM_OUT_OF_MEMORY;
+        return -1;
+    }
+    memset( idx->protocols, 0, sizeof(pm_protocol_t) * idx->protocols_count );
+
+    for( p = 0; p < idx->protocols_count; p++ ) {
+        const pm_entry_t *first = &pm->entries[ranges[p].entry];
+
+        idx->protocols[p].protocol = first->protocol;
+        idx->protocols[p].protocol_len = first->protocol_len;
+    }
+    for( i = 0; i < pm->entries_count; i++ ) {
+        idx->protocols[protocol_of[i]].ranges_count++;
+    }
+
+    /* Each protocol gets its slice of the ranges. */
+    for( p = 0, i = 0; p < idx->protocols_count; p++ ) {
+        idx->protocols[p].ranges = &ranges[i];
+        i += idx->protocols[p].ranges_count;
+        idx->protocols[p].ranges_count = 0;
+    }
+    for( i = 0; i < pm->entries_count; i++ ) {
+        pm_protocol_t *proto = &idx->protocols[protocol_of[i]];
+        pm_range_t *r = &proto->ranges[proto->ranges_count++];
+
+        r->first = pm->entries[i].port_range[0];
+        r->last = pm->entries[i].port_range[1];
+        r->entry = (uint32_t) i;
+    }
+
+    for( p = 0; p < idx->protocols_count; p++ ) {
+        pm_protocol_t *proto = &idx->protocols[p];
+        uint32_t covered = 0;   /* The ports below are in the bitmap. */
+
+        qsort( proto->ranges, proto->ranges_count, sizeof(pm_range_t), __range_cmp );
+
+        for( i = 0; i < proto->ranges_count; i++ ) {
+            pm_range_t *r = &proto->ranges[i];
+
+            r->max_last = r->last;
+            if( (0 < i) && (r->last < r[-1].max_last) ) {
+                r->max_last = r[-1].max_last;
+            }
+        }
+
+        if( proto->ranges_count < PORT_BITMAP_ENTRIES ) {
+            continue;
+        }
+
+        proto->ports = (uint8_t*) helper_alloc( ctx, PORT_BITMAP_SIZE );
+        if( NULL == proto->ports ) {
+            errno = PM_OUT_OF_MEMORY;
+            return -1;
+        }
+        memset( proto->ports, 0, PORT_BITMAP_SIZE );
+
+        /* Each port is set once, however much the ranges overlap. */
+        for( i = 0; i < proto->ranges_count; i++ ) {
+            const pm_range_t *r = &proto->ranges[i];
+            uint32_t port = (covered < r->first) ? r->first : covered;
+
+            for( ; port <= r->last; port++ ) {
+                proto->ports[port >> 3] |= (uint8_t) (1 << (port & 7));
+            }
+            if( covered < port ) {
+                covered = port;
+            }
+        }
+    }
+
+    pm->index = idx;
+
+    return 0;
 }
 
 /* See portmapping.h for details. */
@@ -108,6 +357,7 @@ const char* portmapping_strerror( int errnum )
         { .v = PM_MISSING_PORT_RANGE,               .txt = "'external-port-range' element missing." },
         { .v = PM_MISSING_PROTOCOL,                 .txt = "'protocol' element missing." },
         { .v = PM_INVALID_PM_OBJECT,                .txt = "Invalid 'port-mapping' array." },
+        { .v = PM_OVERLAPPING_PORT_RANGES,          .txt = "Overlapping 'external-port-range' values." },
         { .v = 0, .txt = NULL }
     };
     int i = 0;
@@ -128,21 +378,29 @@ const char* portmapping_strerror( int errnum )
  *  Converts the msgpack array into the pool_range values.
  *
  *  @param e     the entry pointer
- *  @param array the msgpack array pointer
+ *  @param c     the cursor at the array elements
+ *  @param array the array
  *
  *  @return 0 on success, error otherwise
  */
-int process_portrange( pm_entry_t *e, msgpack_object_array *array )
+int process_portrange( pm_entry_t *e, cursor_t *c, const token_t *array )
 {
-    if( (2 == array->size) &&
-        (MSGPACK_OBJECT_POSITIVE_INTEGER == array->ptr[0].type) &&
-        (MSGPACK_OBJECT_POSITIVE_INTEGER == array->ptr[1].type) &&
-        (array->ptr[0].via.u64 <= UINT16_MAX) &&
-        (array->ptr[1].via.u64 <= UINT16_MAX) )
-    {
-        e->port_range[0] = (uint16_t) array->ptr[0].via.u64;
-        e->port_range[1] = (uint16_t) array->ptr[1].via.u64;
-        return 0;
+    token_t start, end;
+
+    if( 2 == array->size ) {
+        cursor_enter( c );
+        cursor_next( c, &start );
+        cursor_next( c, &end );
+
+        if( (TOKEN_POSITIVE_INTEGER == start.type) &&
+            (TOKEN_POSITIVE_INTEGER == end.type) &&
+            (start.via.u64 <= UINT16_MAX) &&
+            (end.via.u64 <= UINT16_MAX) )
+        {
+            e->port_range[0] = (uint16_t) start.via.u64;
+            e->port_range[1] = (uint16_t) end.via.u64;
+            return 0;
+        }
     }
 
     errno = PM_INVALID_PORT_RANGE;
@@ -154,62 +412,78 @@ int process_portrange( pm_entry_t *e, msgpack_object_array *array )
  *  Convert the msgpack map into the pm_entry_t structure.
  *
  *  @param e    the entry pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param map  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_entry( pm_entry_t *e, msgpack_object_map *map )
+int process_entry( pm_entry_t *e, cursor_t *c, const token_t *map, helper_ctx_t *ctx )
 {
-    int left = map->size;
+    uint32_t left = map->size;
     uint8_t objects_left = 0x07;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_POSITIVE_INTEGER == p->val.type ) {
-                if( 0 == match(p, "target-port") ) {
-                    if( UINT16_MAX < p->val.via.u64 ) {
+    token_t key, val;
+
+    cursor_enter( c );
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__entry_keys, &key) ) {
+            case KEY_TARGET_PORT:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    if( UINT16_MAX < val.via.u64 ) {
                         errno = PM_INVALID_PORT_NUMBER;
                         return -1;
                     } else {
-                        e->target_port = (uint16_t) p->val.via.u64;
+                        e->target_port = (uint16_t) val.via.u64;
                     }
                     objects_left &= ~(1 << 0);
-                } else if( 0 == match(p, "target-ipv4") ) {
+                }
+                break;
+            case KEY_TARGET_IPV4:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
                     if( 0 != e->ip_version ) {
                         errno = PM_BOTH_IPV4_AND_IPV6_TARGETS_EXIST;
                         return -1;
                     }
-                    if( UINT32_MAX < p->val.via.u64 ) {
+                    if( UINT32_MAX < val.via.u64 ) {
                         errno = PM_INVALID_INTERNAL_IPV4;
                         return -1;
                     } else {
-                        e->ip.v4 = (uint32_t) p->val.via.u64;
+                        e->ip.v4 = (uint32_t) val.via.u64;
                         e->ip_version = 4;
                     }
                     objects_left &= ~(1 << 1);
                 }
-            } else if( MSGPACK_OBJECT_ARRAY == p->val.type ) {
-                if( 0 == match(p, "external-port-range") ) {
-                    if( 0 != process_portrange(e, &p->val.via.array) ) {
+                break;
+            case KEY_PORT_RANGE:
+                if( TOKEN_ARRAY == val.type ) {
+                    if( 0 != process_portrange(e, c, &val) ) {
                         return -1;
                     }
                     objects_left &= ~(1 << 2);
                 }
-            } else if( MSGPACK_OBJECT_STR == p->val.type ) {
-                if( 0 == match(p, "protocol") ) {
-                    e->protocol = strndup( p->val.via.str.ptr, p->val.via.str.size );
+                break;
+            case KEY_PROTOCOL:
+                if( TOKEN_STR == val.type ) {
+                    e->protocol_len = val.size;
+                    e->protocol = helper_str( ctx, val.ptr, val.size );
+                    if( NULL == e->protocol ) {
+                        errno = PM_OUT_OF_MEMORY;
+                        return -1;
+                    }
                     objects_left &= ~(1 << 3);
                 }
-            } else if( MSGPACK_OBJECT_BIN == p->val.type ) {
-                if( 0 == match(p, "target-ipv6") ) {
+                break;
+            case KEY_TARGET_IPV6:
+                if( TOKEN_BIN == val.type ) {
                     if( 0 != e->ip_version ) {
                         errno = PM_BOTH_IPV4_AND_IPV6_TARGETS_EXIST;
                         return -1;
                     }
-                    if( 16 == p->val.via.bin.size ) {
-                        memcpy( &e->ip.v6, p->val.via.bin.ptr, 16 );
+                    if( 16 == val.size ) {
+                        memcpy( &e->ip.v6, val.ptr, 16 );
                         e->ip_version = 6;
                         objects_left &= ~(1 << 1);
                     } else {
@@ -217,10 +491,12 @@ int process_entry( pm_entry_t *e, msgpack_object_map *map )
                         return -1;
                     }
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
+    cursor_skip( c, 2 * (uint64_t) left );
 
     if( 1 & objects_left ) {
         errno = PM_MISSING_INTERNAL_PORT;
@@ -237,31 +513,73 @@ int process_entry( pm_entry_t *e, msgpack_object_map *map )
     return (0 == objects_left) ? 0 : -1;
 }
 
-int process_portmapping( portmapping_t *pm, msgpack_object *obj )
+int process_portmapping( portmapping_t *pm, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_array *array = &obj->via.array;
-    if( 0 < array->size ) {
+    if( 0 < obj->size ) {
         size_t i;
 
-        pm->entries_count = array->size;
-        pm->entries = (pm_entry_t *) malloc( sizeof(pm_entry_t) * pm->entries_count );
+        pm->entries_count = obj->size;
+        pm->entries = (pm_entry_t *) helper_alloc( ctx, sizeof(pm_entry_t) * pm->entries_count );
         if( NULL == pm->entries ) {
             pm->entries_count = 0;
+            errno = PM_OUT_OF_MEMORY;
             return -1;
         }
 
         memset( pm->entries, 0, sizeof(pm_entry_t) * pm->entries_count );
 
         for( i = 0; i < pm->entries_count; i++ ) {
-            if( MSGPACK_OBJECT_MAP != array->ptr[i].type ) {
+            token_t item;
+
+            cursor_next( c, &item );
+            if( TOKEN_MAP != item.type ) {
                 errno = PM_INVALID_PM_OBJECT;
                 return -1;
             }
-            if( 0 != process_entry(&pm->entries[i], &array->ptr[i].via.map) ) {
+            if( 0 != process_entry(&pm->entries[i], c, &item, ctx) ) {
                 return -1;
             }
         }
+
+        return portmapping_index_build( pm, ctx );
     }
 
     return 0;
 }
+
+/**
+ *  Finds the index of a protocol.
+ */
+static const pm_protocol_t* __find_protocol( const pm_index_t *idx, const char *protocol,
+                                             size_t len )
+{
+    size_t i;
+
+    for( i = 0; i < idx->protocols_count; i++ ) {
+        const pm_protocol_t *p = &idx->protocols[i];
+
+        if( (p->protocol_len == len) && (0 == memcmp(p->protocol, protocol, len)) ) {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Orders port ranges by their first port, then their last.
+ */
+static int __range_cmp( const void *a, const void *b )
+{
+    const pm_range_t *x = (const pm_range_t*) a;
+    const pm_range_t *y = (const pm_range_t*) b;
+
+    if( x->first != y->first ) {
+        return (x->first < y->first) ? -1 : 1;
+    }
+    if( x->last != y->last ) {
+        return (x->last < y->last) ? -1 : 1;
+    }
+
+    return (x->entry < y->entry) ? -1 : (x->entry > y->entry);
+}
@@ -16,11 +16,13 @@
 #ifndef __PORTMAPPING_H__
 #define __PORTMAPPING_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 typedef struct {
     char      *protocol;        /* (R) V 1.0.0 */
+    size_t    protocol_len;
     uint16_t  port_range[2];    /* (R) V 1.0.0 */
     uint16_t  target_port;      /* (R) V 1.0.0 */
 
@@ -31,9 +33,37 @@ typedef struct {
     } ip;                       /* (R) V 1.0.0 */
 } pm_entry_t;
 
+/* An entry's external port range, in the index. */
+typedef struct {
+    uint16_t first;
+    uint16_t last;
+    uint16_t max_last;          /* The highest `last` up to this one. */
+    uint32_t entry;             /* The index of the entry. */
+} pm_range_t;
+
+/* The entries of one protocol, by port range. */
+typedef struct {
+    const char *protocol;
+    size_t      protocol_len;
+    pm_range_t *ranges;         /* Sorted by first, then last. */
+    size_t      ranges_count;
+    uint8_t    *ports;          /* (optional) A bit for each port covered,
+                                 * with many entries. */
+} pm_protocol_t;
+
+/**
+ *  An index of the entries, built as they are decoded, so a port is looked
+ *  up in O(log n) & overlaps are found in O(n).
+ */
+typedef struct {
+    pm_protocol_t *protocols;
+    size_t         protocols_count;
+} pm_index_t;
+
 typedef struct {
     pm_entry_t *entries;        /* (O) V 1.0.0 */
     size_t      entries_count;
+    pm_index_t *index;          /* NULL if there are no entries. */
 } portmapping_t;
 
 /**
@@ -47,6 +77,20 @@ typedef struct {
  */
 portmapping_t* portmapping_convert( const void *buf, size_t len );
 
+/**
+ *  This function converts a msgpack buffer into an portmapping_t structure
+ *  if possible, but references the protocols in buf instead of copying them.
+ *
+ *  @note: buf must remain valid & unchanged until the portmapping is destroyed.
+ *         The strings are not '\0' terminated, use the matching lengths.
+ *
+ *  @param buf the buffer to convert
+ *  @param len the length of the buffer in bytes
+ *
+ *  @return NULL on error, success otherwise
+ */
+portmapping_t* portmapping_convert_view( const void *buf, size_t len );
+
 /**
  *  This function destroys an portmapping_t object.
  *
@@ -54,6 +98,45 @@ portmapping_t* portmapping_convert( const void *buf, size_t len );
  */
 void portmapping_destroy( portmapping_t *d );
 
+/**
+ *  This function finds the entry that maps an external port.
+ *
+ *  @param pm           the portmapping
+ *  @param protocol     the protocol
+ *  @param protocol_len the length of the protocol
+ *  @param port         the external port
+ *
+ *  @return the entry, or NULL if none maps the port
+ */
+const pm_entry_t* portmapping_lookup( const portmapping_t *pm,
+                                      const char *protocol, size_t protocol_len,
+                                      uint16_t port );
+
+/**
+ *  This function finds two entries of the same protocol whose port ranges
+ *  overlap.
+ *
+ *  @param pm the portmapping
+ *  @param a  (optional) the index of the first entry of an overlap
+ *  @param b  (optional) the index of the entry it overlaps
+ *
+ *  @return true if there is an overlap, false otherwise
+ */
+bool portmapping_overlaps( const portmapping_t *pm, size_t *a, size_t *b );
+
+/**
+ *  This function checks that the entries can all be applied together: each
+ *  port range is in order & no two of the same protocol overlap.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         portmapping_strerror().
+ *
+ *  @param pm the portmapping
+ *
+ *  @return 0 if valid, error otherwise
+ */
+int portmapping_validate( const portmapping_t *pm );
+
 /**
  *  This function returns a general reason why the conversion failed.
  *
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "queue.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+struct queue {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;       /* An item was added or the queue closed. */
+    size_t head;                /* The oldest item. */
+    size_t count;
+    size_t capacity;
+    bool closed;
+    void *items[];
+};
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See queue.h for details. */
+queue_t* queue_create( size_t capacity )
+{
+    queue_t *q;
+
+    if( 0 == capacity ) {
+        return NULL;
+    }
+
+    q = (queue_t*) malloc( sizeof(queue_t) + capacity * sizeof(void*) );
+    if( NULL == q ) {
+        return NULL;
+    }
+
+    memset( q, 0, sizeof(queue_t) );
+    q->capacity = capacity;
+    pthread_mutex_init( &q->lock, NULL );
+    pthread_cond_init( &q->ready, NULL );
+
+    return q;
+}
+
+/* See queue.h for details. */
+void* queue_push( queue_t *q, void *item )
+{
+    void *out = NULL;
+
+    pthread_mutex_lock( &q->lock );
+    if( q->closed ) {
+        out = item;
+    } else {
+        if( q->count == q->capacity ) {
+            out = q->items[q->head];
+            q->head = (q->head + 1) % q->capacity;
+            q->count--;
+        }
+        q->items[(q->head + q->count) % q->capacity] = item;
+        q->count++;
+        pthread_cond_signal( &q->ready );
+    }
+    pthread_mutex_unlock( &q->lock );
+
+    return out;
+}
+
+/* See queue.h for details. */
+void* queue_pop( queue_t *q )
+{
+    void *item = NULL;
+
+    pthread_mutex_lock( &q->lock );
+    while( !q->closed && (0 == q->count) ) {
+        pthread_cond_wait( &q->ready, &q->lock );
+    }
+    if( !q->closed ) {
+        item = q->items[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+    }
+    pthread_mutex_unlock( &q->lock );
+
+    return item;
+}
+
+/* See queue.h for details. */
+void queue_close( queue_t *q )
+{
+    pthread_mutex_lock( &q->lock );
+    q->closed = true;
+    pthread_cond_broadcast( &q->ready );
+    pthread_mutex_unlock( &q->lock );
+}
+
+/* See queue.h for details. */
+void queue_destroy( queue_t *q, void (*release)(void*) )
+{
+    if( NULL == q ) {
+        return;
+    }
+
+    while( 0 < q->count ) {
+        if( NULL != release ) {
+            release( q->items[q->head] );
+        }
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+    }
+
+    pthread_cond_destroy( &q->ready );
+    pthread_mutex_destroy( &q->lock );
+    free( q );
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __QUEUE_H__
+#define __QUEUE_H__
+
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  A bounded queue that hands items from one thread to another.  Adding to
+ *  a full queue never waits: the oldest item is pushed out instead, so a
+ *  slow consumer only ever sees the newest items & never holds back the
+ *  producer.
+ */
+typedef struct queue queue_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function creates a queue.
+ *
+ *  @param capacity the most items the queue holds, at least 1
+ *
+ *  @return NULL on error, success otherwise
+ */
+queue_t* queue_create( size_t capacity );
+
+/**
+ *  This function adds an item to the end of the queue.
+ *
+ *  @param q    the queue
+ *  @param item the item, which must not be NULL
+ *
+ *  @return the item that did not fit for the caller to release: the oldest
+ *          one if the queue was full, the item itself if the queue is
+ *          closed, NULL otherwise
+ */
+void* queue_push( queue_t *q, void *item );
+
+/**
+ *  This function takes the item at the front of the queue, waiting for one
+ *  if it is empty.
+ *
+ *  @param q the queue
+ *
+ *  @return the item, or NULL once the queue is closed
+ */
+void* queue_pop( queue_t *q );
+
+/**
+ *  This function closes the queue, waking every queue_pop() with NULL.  The
+ *  items still in it are left for queue_destroy().
+ *
+ *  @param q the queue
+ */
+void queue_close( queue_t *q );
+
+/**
+ *  This function destroys the queue & any items left in it.
+ *
+ *  @param q       the queue to destroy
+ *  @param release called for each item left, may be NULL
+ */
+void queue_destroy( queue_t *q, void (*release)(void*) );
+
+#endif
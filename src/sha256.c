@@ -0,0 +1,336 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "sha256.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA256_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_SHA2)
+#define SHA256_ARMV8 1
+#include <arm_neon.h>
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define ror(x, n)   (((x) >> (n)) | ((x) << (32 - (n))))
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+static const uint32_t __k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t __h0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __blocks( sha256_t *s, const uint8_t *data, size_t blocks );
+static void __blocks_portable( uint32_t h[8], const uint8_t *data, size_t blocks );
+#if defined(SHA256_X86)
+static void __blocks_shani( uint32_t h[8], const uint8_t *data, size_t blocks );
+#elif defined(SHA256_ARMV8)
+static void __blocks_armv8( uint32_t h[8], const uint8_t *data, size_t blocks );
+#endif
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See sha256.h for details. */
+void sha256_init( sha256_t *s )
+{
+    sha256_init_portable( s );
+    s->accel = sha256_accelerated();
+}
+
+/* See sha256.h for details. */
+void sha256_init_portable( sha256_t *s )
+{
+    memset( s, 0, sizeof(sha256_t) );
+    memcpy( s->h, __h0, sizeof(__h0) );
+}
+
+/* See sha256.h for details. */
+void sha256_update( sha256_t *s, const void *buf, size_t len )
+{
+    const uint8_t *p = (const uint8_t*) buf;
+
+    s->len += len;
+
+    if( 0 < s->buf_len ) {
+        size_t n = sizeof(s->buf) - s->buf_len;
+
+        n = (len < n) ? len : n;
+        memcpy( &s->buf[s->buf_len], p, n );
+        s->buf_len += n;
+        p += n;
+        len -= n;
+
+        if( sizeof(s->buf) == s->buf_len ) {
+            __blocks( s, s->buf, 1 );
+            s->buf_len = 0;
+        }
+    }
+
+    /* Whole blocks are hashed straight from the caller's buffer. */
+    if( sizeof(s->buf) <= len ) {
+        size_t blocks = len / sizeof(s->buf);
+
+        __blocks( s, p, blocks );
+        p += blocks * sizeof(s->buf);
+        len -= blocks * sizeof(s->buf);
+    }
+
+    if( 0 < len ) {
+        memcpy( s->buf, p, len );
+        s->buf_len = len;
+    }
+}
+
+/* See sha256.h for details. */
+void sha256_final( sha256_t *s, uint8_t digest[SHA256_SIZE] )
+{
+    uint64_t bits = s->len * 8;
+    int i;
+
+    s->buf[s->buf_len++] = 0x80;
+    if( sizeof(s->buf) - 8 < s->buf_len ) {
+        memset( &s->buf[s->buf_len], 0, sizeof(s->buf) - s->buf_len );
+        __blocks( s, s->buf, 1 );
+        s->buf_len = 0;
+    }
+    memset( &s->buf[s->buf_len], 0, sizeof(s->buf) - 8 - s->buf_len );
+    for( i = 0; i < 8; i++ ) {
+        s->buf[63 - i] = (uint8_t) (bits >> (8 * i));
+    }
+    __blocks( s, s->buf, 1 );
+
+    for( i = 0; i < 8; i++ ) {
+        digest[4 * i + 0] = (uint8_t) (s->h[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (s->h[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (s->h[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) (s->h[i]);
+    }
+}
+
+/* See sha256.h for details. */
+void sha256( const void *buf, size_t len, uint8_t digest[SHA256_SIZE] )
+{
+    sha256_t s;
+
+    sha256_init( &s );
+    sha256_update( &s, buf, len );
+    sha256_final( &s, digest );
+}
+
+/* See sha256.h for details. */
+bool sha256_accelerated( void )
+{
+#if defined(SHA256_X86)
+    unsigned int a, b, c, d;
+
+    /* SHA-NI plus the SSSE3 & SSE4.1 instructions used alongside it. */
+    if( (0 == __get_cpuid(1, &a, &b, &c, &d)) ||
+        (0 == (c & bit_SSSE3)) || (0 == (c & bit_SSE4_1)) )
+    {
+        return false;
+    }
+    if( (0 == __get_cpuid_count(7, 0, &a, &b, &c, &d)) || (0 == (b & (1 << 29))) ) {
+        return false;
+    }
+    return true;
+#elif defined(SHA256_ARMV8)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Hashes whole blocks with the implementation the state calls for.
+ */
+static void __blocks( sha256_t *s, const uint8_t *data, size_t blocks )
+{
+#if defined(SHA256_X86)
+    if( true == s->accel ) {
+        __blocks_shani( s->h, data, blocks );
+        return;
+    }
+#elif defined(SHA256_ARMV8)
+    if( true == s->accel ) {
+        __blocks_armv8( s->h, data, blocks );
+        return;
+    }
+#endif
+    __blocks_portable( s->h, data, blocks );
+}
+
+/**
+ *  The portable implementation, straight from FIPS 180-4.
+ */
+static void __blocks_portable( uint32_t h[8], const uint8_t *data, size_t blocks )
+{
+    while( 0 < blocks-- ) {
+        uint32_t w[64];
+        uint32_t a, b, c, d, e, f, g, hh;
+        int i;
+
+        for( i = 0; i < 16; i++ ) {
+            w[i] = ((uint32_t) data[4 * i] << 24) | ((uint32_t) data[4 * i + 1] << 16) |
+                   ((uint32_t) data[4 * i + 2] << 8) | ((uint32_t) data[4 * i + 3]);
+        }
+        for( i = 16; i < 64; i++ ) {
+            uint32_t s0 = ror(w[i - 15], 7) ^ ror(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = ror(w[i - 2], 17) ^ ror(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        a = h[0]; b = h[1]; c = h[2]; d = h[3];
+        e = h[4]; f = h[5]; g = h[6]; hh = h[7];
+
+        for( i = 0; i < 64; i++ ) {
+            uint32_t s1 = ror(e, 6) ^ ror(e, 11) ^ ror(e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = hh + s1 + ch + __k[i] + w[i];
+            uint32_t s0 = ror(a, 2) ^ ror(a, 13) ^ ror(a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+
+            hh = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d;
+        h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+
+        data += 64;
+    }
+}
+
+#if defined(SHA256_X86)
+/**
+ *  The x86 SHA-NI implementation.
+ */
+__attribute__((target("sha,sse4.1")))
+static void __blocks_shani( uint32_t h[8], const uint8_t *data, size_t blocks )
+{
+    const __m128i mask = _mm_set_epi64x( 0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL );
+    __m128i state0, state1, tmp;
+
+    /* The instructions want the state as ABEF & CDGH. */
+    tmp    = _mm_shuffle_epi32( _mm_loadu_si128((const __m128i*) &h[0]), 0xb1 );
+    state1 = _mm_shuffle_epi32( _mm_loadu_si128((const __m128i*) &h[4]), 0x1b );
+    state0 = _mm_alignr_epi8( tmp, state1, 8 );
+    state1 = _mm_blend_epi16( state1, tmp, 0xf0 );
+
+    while( 0 < blocks-- ) {
+        __m128i abef = state0;
+        __m128i cdgh = state1;
+        __m128i m[4];
+        int i;
+
+        for( i = 0; i < 16; i++ ) {
+            __m128i msg;
+
+            if( i < 4 ) {
+                m[i] = _mm_shuffle_epi8( _mm_loadu_si128((const __m128i*) &data[16 * i]), mask );
+            } else {
+                msg = _mm_sha256msg1_epu32( m[i & 3], m[(i + 1) & 3] );
+                msg = _mm_add_epi32( msg, _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4) );
+                m[i & 3] = _mm_sha256msg2_epu32( msg, m[(i + 3) & 3] );
+            }
+
+            msg = _mm_add_epi32( m[i & 3], _mm_loadu_si128((const __m128i*) &__k[4 * i]) );
+            state1 = _mm_sha256rnds2_epu32( state1, state0, msg );
+            state0 = _mm_sha256rnds2_epu32( state0, state1, _mm_shuffle_epi32(msg, 0x0e) );
+        }
+
+        state0 = _mm_add_epi32( state0, abef );
+        state1 = _mm_add_epi32( state1, cdgh );
+        data += 64;
+    }
+
+    tmp    = _mm_shuffle_epi32( state0, 0x1b );
+    state1 = _mm_shuffle_epi32( state1, 0xb1 );
+    state0 = _mm_blend_epi16( tmp, state1, 0xf0 );
+    state1 = _mm_alignr_epi8( state1, tmp, 8 );
+    _mm_storeu_si128( (__m128i*) &h[0], state0 );
+    _mm_storeu_si128( (__m128i*) &h[4], state1 );
+}
+#elif defined(SHA256_ARMV8)
+/**
+ *  The ARMv8 crypto extension implementation.
+ */
+static void __blocks_armv8( uint32_t h[8], const uint8_t *data, size_t blocks )
+{
+    uint32x4_t state0 = vld1q_u32( &h[0] );
+    uint32x4_t state1 = vld1q_u32( &h[4] );
+
+    while( 0 < blocks-- ) {
+        uint32x4_t abcd = state0;
+        uint32x4_t efgh = state1;
+        uint32x4_t m[4];
+        int i;
+
+        for( i = 0; i < 16; i++ ) {
+            uint32x4_t msg, prev;
+
+            if( i < 4 ) {
+                m[i] = vreinterpretq_u32_u8( vrev32q_u8(vld1q_u8(&data[16 * i])) );
+            } else {
+                msg = vsha256su0q_u32( m[i & 3], m[(i + 1) & 3] );
+                m[i & 3] = vsha256su1q_u32( msg, m[(i + 2) & 3], m[(i + 3) & 3] );
+            }
+
+            msg = vaddq_u32( m[i & 3], vld1q_u32(&__k[4 * i]) );
+            prev = state0;
+            state0 = vsha256hq_u32( state0, state1, msg );
+            state1 = vsha256h2q_u32( state1, prev, msg );
+        }
+
+        state0 = vaddq_u32( state0, abcd );
+        state1 = vaddq_u32( state1, efgh );
+        data += 64;
+    }
+
+    vst1q_u32( &h[0], state0 );
+    vst1q_u32( &h[4], state1 );
+}
+#endif
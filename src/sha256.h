@@ -0,0 +1,95 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SHA256_H__
+#define __SHA256_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SHA256_SIZE 32
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The state of a hash in progress.  It holds no pointers, so it may be
+ * copied or saved & restored to continue the hash later. */
+typedef struct {
+    uint32_t h[8];
+    uint64_t len;               /* The number of bytes hashed so far. */
+    uint8_t  buf[64];           /* The partial block. */
+    uint32_t buf_len;
+    bool     accel;             /* Use the CPU's SHA instructions. */
+} sha256_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Starts a hash, using the CPU's SHA instructions (x86 SHA-NI or the ARMv8
+ *  crypto extensions) when they are available.
+ *
+ *  @param s the hash state
+ */
+void sha256_init( sha256_t *s );
+
+/**
+ *  Starts a hash that always uses the portable implementation.  This is
+ *  only useful for testing & benchmarking.
+ *
+ *  @param s the hash state
+ */
+void sha256_init_portable( sha256_t *s );
+
+/**
+ *  Adds the next part of the data to the hash.
+ *
+ *  @param s   the hash state
+ *  @param buf the data
+ *  @param len the length of the data in bytes
+ */
+void sha256_update( sha256_t *s, const void *buf, size_t len );
+
+/**
+ *  Completes the hash.  The state must be initialized again to be reused.
+ *
+ *  @param s      the hash state
+ *  @param digest the resulting digest
+ */
+void sha256_final( sha256_t *s, uint8_t digest[SHA256_SIZE] );
+
+/**
+ *  Hashes a complete buffer.
+ *
+ *  @param buf    the data
+ *  @param len    the length of the data in bytes
+ *  @param digest the resulting digest
+ */
+void sha256( const void *buf, size_t len, uint8_t digest[SHA256_SIZE] );
+
+/**
+ *  Reports if the CPU's SHA instructions are used.
+ *
+ *  @return true if they are, false if the portable implementation is used
+ */
+bool sha256_accelerated( void );
+
+#endif
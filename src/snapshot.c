@@ -0,0 +1,1041 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "helpers.h"
+#include "index.h"
+#include "sha256.h"
+#include "snapshot.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+
+/* Every structure in the image starts on this boundary. */
+#define SNAPSHOT_ALIGN 8
+
+/* The part of the image covered by the checksum. */
+#define SNAPSHOT_SUMMED offsetof(snapshot_t, strings)
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+enum {
+    SNAPSHOT_OK = 0,
+    SNAPSHOT_OUT_OF_MEMORY,
+    SNAPSHOT_TOO_LARGE,
+    SNAPSHOT_IO_ERROR,
+    SNAPSHOT_INVALID_HEADER,
+    SNAPSHOT_WRONG_SIZE,
+    SNAPSHOT_CHECKSUM_MISMATCH,
+    SNAPSHOT_INVALID_OFFSET
+};
+
+/* The image being built.  It is built twice: once with no buffer to size it,
+ * then again into the buffer. */
+typedef struct {
+    uint8_t *buf;
+    uint64_t data;          /* The next free structure offset. */
+    uint64_t strings;       /* The next free string offset. */
+} image_t;
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __build( image_t *img, const all_t *cfg, snapshot_t *root );
+static uint32_t __alloc( image_t *img, size_t size );
+static void __put( image_t *img, uint32_t off, const void *p, size_t size );
+static snapshot_str_t __str( image_t *img, const char *p, size_t len );
+static snapshot_str_t __cstr( image_t *img, const char *p );
+static uint32_t __envelope( image_t *img, const envelope_t *e );
+static uint32_t __dhcp( image_t *img, const dhcp_t *d );
+static uint32_t __firewall( image_t *img, const firewall_t *f );
+static uint32_t __gre( image_t *img, const gre_t *g );
+static uint32_t __portmapping( image_t *img, const portmapping_t *pm );
+static uint32_t __wifi( image_t *img, const wifi_t *w );
+static void __wifi_config( image_t *img, const wifi_config_t *cfg, snapshot_wifi_config_t *out );
+static uint32_t __xdns( image_t *img, const xdns_t *x );
+static int __write_file( const char *path, const uint8_t *buf, size_t len );
+static void __sum( const uint8_t *image, size_t size, uint8_t digest[32] );
+static int __load_str( const snapshot_t *s, snapshot_str_t str, char **p, size_t *len );
+static int __load_envelope( const snapshot_t *s, uint32_t off, envelope_t **out );
+static int __load_dhcp( const snapshot_t *s, uint32_t off, dhcp_t **out );
+static int __load_firewall( const snapshot_t *s, uint32_t off, firewall_t **out );
+static int __load_gre( const snapshot_t *s, uint32_t off, gre_t **out );
+static int __load_portmapping( const snapshot_t *s, uint32_t off, portmapping_t **out );
+static int __load_wifi( const snapshot_t *s, uint32_t off, wifi_t **out );
+static int __load_wifi_config( const snapshot_t *s, const snapshot_wifi_config_t *in,
+                               wifi_config_t *out, helper_ctx_t *ctx );
+static int __load_xdns( const snapshot_t *s, uint32_t off, xdns_t **out );
+static void __unmap( void *view, size_t len );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See snapshot.h for details. */
+int snapshot_write( const char *path, const all_t *cfg )
+{
+    image_t img;
+    snapshot_t root;
+    uint64_t data_size;
+    int rv;
+
+    /* Size the image. */
+    memset( &img, 0, sizeof(image_t) );
+    img.data = sizeof(snapshot_t);
+    __build( &img, cfg, &root );
+    data_size = img.data;
+
+    if( UINT32_MAX < data_size + img.strings ) {
+        errno = SNAPSHOT_TOO_LARGE;
+        return -1;
+    }
+
+    /* Build it. */
+    img.buf = (uint8_t*) calloc( 1, data_size + img.strings );
+    if( NULL == img.buf ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    img.strings = data_size;
+    img.data = sizeof(snapshot_t);
+
+    memset( &root, 0, sizeof(snapshot_t) );
+    __build( &img, cfg, &root );
+
+    memcpy( root.magic, SNAPSHOT_MAGIC, sizeof(root.magic) );
+    root.version = SNAPSHOT_VERSION;
+    root.byte_order = SNAPSHOT_BYTE_ORDER;
+    root.size = img.strings;
+    root.strings = (uint32_t) data_size;
+    root.strings_size = (uint32_t) (img.strings - data_size);
+    memcpy( img.buf, &root, sizeof(snapshot_t) );
+    __sum( img.buf, root.size, ((snapshot_t*) img.buf)->sha256 );
+
+    rv = __write_file( path, img.buf, root.size );
+    free( img.buf );
+
+    return rv;
+}
+
+/* See snapshot.h for details. */
+const snapshot_t* snapshot_map( const char *path )
+{
+    const snapshot_t *s;
+    uint8_t digest[32];
+    struct stat st;
+    void *p;
+    int fd;
+
+    fd = open( path, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 ) {
+        errno = SNAPSHOT_IO_ERROR;
+        return NULL;
+    }
+
+    if( (0 != fstat(fd, &st)) || (st.st_size < (off_t) sizeof(snapshot_t)) ) {
+        close( fd );
+        errno = SNAPSHOT_WRONG_SIZE;
+        return NULL;
+    }
+
+    p = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    close( fd );
+    if( MAP_FAILED == p ) {
+        errno = SNAPSHOT_IO_ERROR;
+        return NULL;
+    }
+    s = (const snapshot_t*) p;
+
+    if( (0 != memcmp(s->magic, SNAPSHOT_MAGIC, sizeof(s->magic))) ||
+        (SNAPSHOT_VERSION != s->version) ||
+        (SNAPSHOT_BYTE_ORDER != s->byte_order) )
+    {
+        munmap( p, (size_t) st.st_size );
+        errno = SNAPSHOT_INVALID_HEADER;
+        return NULL;
+    }
+
+    if( (uint64_t) st.st_size != s->size ) {
+        munmap( p, (size_t) st.st_size );
+        errno = SNAPSHOT_WRONG_SIZE;
+        return NULL;
+    }
+
+    __sum( (const uint8_t*) p, s->size, digest );
+    if( 0 != memcmp(digest, s->sha256, sizeof(digest)) ) {
+        munmap( p, (size_t) st.st_size );
+        errno = SNAPSHOT_CHECKSUM_MISMATCH;
+        return NULL;
+    }
+
+    errno = SNAPSHOT_OK;
+    return s;
+}
+
+/* See snapshot.h for details. */
+void snapshot_unmap( const snapshot_t *s )
+{
+    if( NULL != s ) {
+        munmap( (void*) s, s->size );
+    }
+}
+
+/* See snapshot.h for details. */
+all_t* snapshot_all( const snapshot_t *s )
+{
+    all_t *all;
+
+    all = (all_t*) calloc( 1, sizeof(all_t) );
+    if( NULL == all ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return NULL;
+    }
+
+    if( (0 != __load_envelope(s, s->full_envelope, &all->full_envelope)) ||
+        (0 != __load_envelope(s, s->dhcp.envelope, &all->dhcp_envelope)) ||
+        (0 != __load_dhcp(s, s->dhcp.data, &all->dhcp)) ||
+        (0 != __load_envelope(s, s->firewall.envelope, &all->firewall_envelope)) ||
+        (0 != __load_firewall(s, s->firewall.data, &all->firewall)) ||
+        (0 != __load_envelope(s, s->gre.envelope, &all->gre_envelope)) ||
+        (0 != __load_gre(s, s->gre.data, &all->gre)) ||
+        (0 != __load_envelope(s, s->portmapping.envelope, &all->portmapping_envelope)) ||
+        (0 != __load_portmapping(s, s->portmapping.data, &all->portmapping)) ||
+        (0 != __load_envelope(s, s->wifi.envelope, &all->wifi_envelope)) ||
+        (0 != __load_wifi(s, s->wifi.data, &all->wifi)) ||
+        (0 != __load_envelope(s, s->xdns.envelope, &all->xdns_envelope)) ||
+        (0 != __load_xdns(s, s->xdns.data, &all->xdns)) )
+    {
+        /* The image is still the caller's. */
+        int e = errno;
+
+        all_destroy( all );
+        errno = e;
+        return NULL;
+    }
+
+    all->view = (void*) s;
+    all->view_len = (size_t) s->size;
+    all->view_release = __unmap;
+
+    errno = SNAPSHOT_OK;
+    return all;
+}
+
+/* See snapshot.h for details. */
+const void* snapshot_at( const snapshot_t *s, uint32_t off, size_t size )
+{
+    if( (0 == off) || (s->size < size) || (s->size - size < off) ) {
+        return NULL;
+    }
+
+    return &((const uint8_t*) s)[off];
+}
+
+/* See snapshot.h for details. */
+const void* snapshot_array( const snapshot_t *s, snapshot_array_t a, size_t size )
+{
+    if( (0 == a.count) || (s->size / a.count < size) ) {
+        return NULL;
+    }
+
+    return snapshot_at( s, a.off, size * a.count );
+}
+
+/* See snapshot.h for details. */
+const char* snapshot_str( const snapshot_t *s, snapshot_str_t str )
+{
+    const char *p;
+
+    p = (const char*) snapshot_at( s, str.off, (size_t) str.len + 1 );
+    if( (NULL == p) || ('\0' != p[str.len]) ) {
+        return NULL;
+    }
+
+    return p;
+}
+
+/* See snapshot.h for details. */
+const char* snapshot_strerror( int errnum )
+{
+    struct error_map {
+        int v;
+        const char *txt;
+    } map[] = {
+        { .v = SNAPSHOT_OK,                 .txt = "No errors." },
+        { .v = SNAPSHOT_OUT_OF_MEMORY,      .txt = "Out of memory." },
+        { .v = SNAPSHOT_TOO_LARGE,          .txt = "The configuration is too large." },
+        { .v = SNAPSHOT_IO_ERROR,           .txt = "Unable to access the file." },
+        { .v = SNAPSHOT_INVALID_HEADER,     .txt = "Invalid header." },
+        { .v = SNAPSHOT_WRONG_SIZE,         .txt = "The file is the wrong size." },
+        { .v = SNAPSHOT_CHECKSUM_MISMATCH,  .txt = "The checksum does not match." },
+        { .v = SNAPSHOT_INVALID_OFFSET,     .txt = "A reference is outside the image." },
+        { .v = 0, .txt = NULL }
+    };
+    int i = 0;
+
+    while( (map[i].v != errnum) && (NULL != map[i].txt) ) { i++; }
+
+    if( NULL == map[i].txt ) {
+        return "Unknown error.";
+    }
+
+    return map[i].txt;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Lays out the whole configuration.
+ *
+ *  @param img  the image
+ *  @param cfg  the configuration
+ *  @param root the root of the image to fill in
+ */
+static void __build( image_t *img, const all_t *cfg, snapshot_t *root )
+{
+    root->full_envelope        = __envelope( img, cfg->full_envelope );
+    root->dhcp.envelope        = __envelope( img, cfg->dhcp_envelope );
+    root->dhcp.data            = __dhcp( img, cfg->dhcp );
+    root->firewall.envelope    = __envelope( img, cfg->firewall_envelope );
+    root->firewall.data        = __firewall( img, cfg->firewall );
+    root->gre.envelope         = __envelope( img, cfg->gre_envelope );
+    root->gre.data             = __gre( img, cfg->gre );
+    root->portmapping.envelope = __envelope( img, cfg->portmapping_envelope );
+    root->portmapping.data     = __portmapping( img, cfg->portmapping );
+    root->wifi.envelope        = __envelope( img, cfg->wifi_envelope );
+    root->wifi.data            = __wifi( img, cfg->wifi );
+    root->xdns.envelope        = __envelope( img, cfg->xdns_envelope );
+    root->xdns.data            = __xdns( img, cfg->xdns );
+}
+
+/**
+ *  Reserves room for a structure.  Offsets are only meaningful once the
+ *  image is being built into the buffer.
+ */
+static uint32_t __alloc( image_t *img, size_t size )
+{
+    uint64_t off;
+
+    off = (img->data + SNAPSHOT_ALIGN - 1) & ~((uint64_t) SNAPSHOT_ALIGN - 1);
+    img->data = off + size;
+
+    return (uint32_t) off;
+}
+
+/**
+ *  Copies a structure into the image, if it is being built.
+ */
+static void __put( image_t *img, uint32_t off, const void *p, size_t size )
+{
+    if( NULL != img->buf ) {
+        memcpy( &img->buf[off], p, size );
+    }
+}
+
+/**
+ *  Adds a string to the string table.
+ */
+static snapshot_str_t __str( image_t *img, const char *p, size_t len )
+{
+    snapshot_str_t str = { .off = 0, .len = 0 };
+
+    if( NULL != p ) {
+        str.off = (uint32_t) img->strings;
+        str.len = (uint32_t) len;
+        __put( img, str.off, p, len );
+        img->strings += len + 1;
+    }
+
+    return str;
+}
+
+/**
+ *  Adds a '\0' terminated string to the string table.
+ */
+static snapshot_str_t __cstr( image_t *img, const char *p )
+{
+    return __str( img, p, (NULL != p) ? strlen(p) : 0 );
+}
+
+static uint32_t __envelope( image_t *img, const envelope_t *e )
+{
+    snapshot_envelope_t out;
+    uint32_t off;
+
+    if( NULL == e ) {
+        return 0;
+    }
+
+    memset( &out, 0, sizeof(out) );
+    off = __alloc( img, sizeof(out) );
+    out.base = __str( img, e->schema.base, e->schema.base_len );
+    out.major = e->schema.major;
+    out.minor = e->schema.minor;
+    out.patch = e->schema.patch;
+    memcpy( out.sha256, e->sha256, sizeof(out.sha256) );
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static uint32_t __dhcp( image_t *img, const dhcp_t *d )
+{
+    snapshot_dhcp_t out;
+    uint32_t off;
+    size_t i;
+
+    if( NULL == d ) {
+        return 0;
+    }
+
+    memset( &out, 0, sizeof(out) );
+    off = __alloc( img, sizeof(out) );
+    out.router_ip = d->router_ip;
+    out.subnet_mask = d->subnet_mask;
+    out.pool_range[0] = d->pool_range[0];
+    out.pool_range[1] = d->pool_range[1];
+    out.lease_length = d->lease_length;
+    if( 0 < d->fixed_count ) {
+        out.fixed.count = (uint32_t) d->fixed_count;
+        out.fixed.off = __alloc( img, d->fixed_count * sizeof(dhcp_static_t) );
+        for( i = 0; i < d->fixed_count; i++ ) {
+            dhcp_static_t fixed;
+
+            /* Copied field by field so the padding is always zero. */
+            memset( &fixed, 0, sizeof(fixed) );
+            memcpy( fixed.mac, d->fixed[i].mac, sizeof(fixed.mac) );
+            fixed.ip = d->fixed[i].ip;
+            __put( img, out.fixed.off + i * sizeof(fixed), &fixed, sizeof(fixed) );
+        }
+    }
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static uint32_t __firewall( image_t *img, const firewall_t *f )
+{
+    snapshot_firewall_t out;
+    uint32_t off;
+    size_t i;
+
+    if( NULL == f ) {
+        return 0;
+    }
+
+    memset( &out, 0, sizeof(out) );
+    off = __alloc( img, sizeof(out) );
+    out.level = __str( img, f->level, f->level_len );
+    if( 0 < f->filters_count ) {
+        out.filters.count = (uint32_t) f->filters_count;
+        out.filters.off = __alloc( img, f->filters_count * sizeof(snapshot_str_t) );
+        for( i = 0; i < f->filters_count; i++ ) {
+            snapshot_str_t str = __str( img, f->filters[i], f->filter_lens[i] );
+
+            __put( img, out.filters.off + i * sizeof(str), &str, sizeof(str) );
+        }
+    }
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static uint32_t __gre( image_t *img, const gre_t *g )
+{
+    snapshot_gre_t out;
+    uint32_t off;
+
+    if( NULL == g ) {
+        return 0;
+    }
+
+    off = __alloc( img, sizeof(out) );
+    out.primary_remote_endpoint = __str( img, g->primary_remote_endpoint,
+                                         g->primary_remote_endpoint_len );
+    out.secondary_remote_endpoint = __str( img, g->secondary_remote_endpoint,
+                                           g->secondary_remote_endpoint_len );
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static uint32_t __portmapping( image_t *img, const portmapping_t *pm )
+{
+    snapshot_portmapping_t out;
+    uint32_t off;
+    size_t i;
+
+    if( NULL == pm ) {
+        return 0;
+    }
+
+    memset( &out, 0, sizeof(out) );
+    off = __alloc( img, sizeof(out) );
+    if( 0 < pm->entries_count ) {
+        out.entries.count = (uint32_t) pm->entries_count;
+        out.entries.off = __alloc( img, pm->entries_count * sizeof(snapshot_pm_entry_t) );
+        for( i = 0; i < pm->entries_count; i++ ) {
+            const pm_entry_t *in = &pm->entries[i];
+            snapshot_pm_entry_t e;
+
+            memset( &e, 0, sizeof(e) );
+            e.protocol = __str( img, in->protocol, in->protocol_len );
+            e.port_range[0] = in->port_range[0];
+            e.port_range[1] = in->port_range[1];
+            e.target_port = in->target_port;
+            e.ip_version = in->ip_version;
+            memcpy( e.ip.v6, in->ip.v6, sizeof(e.ip.v6) );
+            __put( img, out.entries.off + i * sizeof(e), &e, sizeof(e) );
+        }
+    }
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static uint32_t __wifi( image_t *img, const wifi_t *w )
+{
+    snapshot_wifi_t out;
+    uint32_t off;
+
+    if( NULL == w ) {
+        return 0;
+    }
+
+    off = __alloc( img, sizeof(out) );
+    __wifi_config( img, &w->config_5g, &out.config_5g );
+    __wifi_config( img, &w->config_2g, &out.config_2g );
+    __put( img, off, &out, sizeof(out) );
+
+    return off;
+}
+
+static void __wifi_config( image_t *img, const wifi_config_t *cfg, snapshot_wifi_config_t *out )
+{
+    size_t i;
+
+    memset( out, 0, sizeof(snapshot_wifi_config_t) );
+    out->extension_channel = cfg->extension_channel;
+    out->dfs_enabled = cfg->dfs_enabled ? 1 : 0;
+    out->channel = cfg->channel;
+    out->bandwith = cfg->bandwith;
+    out->standards = __str( img, cfg->standards, cfg->standards_count );
+    out->basic_rate = __cstr( img, cfg->basic_rate );
+    out->tx_power = cfg->tx_power;
+    if( 0 < cfg->aps_count ) {
+        out->aps.count = (uint32_t) cfg->aps_count;
+        out->aps.off = __alloc( img, cfg->aps_count * sizeof(snapshot_wifi_ap_t) );
+        for( i = 0; i < cfg->aps_count; i++ ) {
+            const wifi_ap_t *in = &cfg->aps[i];
+            snapshot_wifi_ap_t ap;
+
+            ap.name = __cstr( img, in->name );
+            ap.ssid = __cstr( img, in->ssid );
+            ap.password = __cstr( img, in->password );
+            ap.advertisement = __cstr( img, in->advertisement );
+            ap.security_mode = __cstr( img, in->security_mode );
+            ap.method = __cstr( img, in->method );
+            __put( img, out->aps.off + i * sizeof(ap), &ap, sizeof(ap) );
+        }
+    }
+}
+
+static uint32_t __xdns( image_t *img, const xdns_t *x )
+{
+    uint32_t off;
+
+    if( NULL == x ) {
+        return 0;
+    }
+
+    off = __alloc( img, sizeof(xdns_t) );
+    __put( img, off, x, sizeof(xdns_t) );
+
+    return off;
+}
+
+/**
+ *  Writes the file atomically: to a temporary file in the same directory
+ *  that is synced & then renamed over the file.
+ *
+ *  @param path the file to write
+ *  @param buf  the contents
+ *  @param len  the length of the contents in bytes
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __write_file( const char *path, const uint8_t *buf, size_t len )
+{
+    size_t path_len = strlen( path );
+    char *tmp, *dir;
+    int fd, rv = -1;
+
+    tmp = (char*) malloc( 2 * (path_len + 5) );
+    if( NULL == tmp ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    sprintf( tmp, "%s.tmp", path );
+    dir = &tmp[path_len + 5];
+    memcpy( dir, path, path_len + 1 );
+    dir = dirname( dir );
+
+    errno = SNAPSHOT_IO_ERROR;
+    fd = open( tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+    if( 0 <= fd ) {
+        while( 0 < len ) {
+            ssize_t n = write( fd, buf, len );
+
+            if( n <= 0 ) {
+                if( (n < 0) && (EINTR == errno) ) {
+                    continue;
+                }
+                break;
+            }
+            buf += n;
+            len -= (size_t) n;
+        }
+
+        if( (0 == len) && (0 == fsync(fd)) ) {
+            rv = 0;
+        }
+        if( 0 != close(fd) ) {
+            rv = -1;
+        }
+
+        if( (0 == rv) && (0 != rename(tmp, path)) ) {
+            rv = -1;
+        }
+        if( 0 != rv ) {
+            unlink( tmp );
+        }
+    }
+
+    /* Make the rename durable too. */
+    if( 0 == rv ) {
+        fd = open( dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC );
+        if( 0 <= fd ) {
+            fsync( fd );
+            close( fd );
+        }
+    }
+    free( tmp );
+
+    errno = (0 == rv) ? SNAPSHOT_OK : SNAPSHOT_IO_ERROR;
+    return rv;
+}
+
+/**
+ *  Computes the checksum of an image.
+ */
+static void __sum( const uint8_t *image, size_t size, uint8_t digest[32] )
+{
+    sha256( &image[SNAPSHOT_SUMMED], size - SNAPSHOT_SUMMED, digest );
+}
+
+/**
+ *  Resolves a string in the image, which is referenced, not copied.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __load_str( const snapshot_t *s, snapshot_str_t str, char **p, size_t *len )
+{
+    *p = NULL;
+    *len = 0;
+
+    if( 0 == str.off ) {
+        return 0;
+    }
+
+    *p = (char*) snapshot_str( s, str );
+    if( NULL == *p ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+    *len = str.len;
+
+    return 0;
+}
+
+/**
+ *  These functions rebuild a structure from the image.  Only the structure
+ *  & its arrays of pointers are allocated; the strings & plain arrays are
+ *  referenced in the image.
+ *
+ *  @param s   the image
+ *  @param off the offset of the structure, 0 for none
+ *  @param out the structure, NULL for none
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __load_envelope( const snapshot_t *s, uint32_t off, envelope_t **out )
+{
+    const snapshot_envelope_t *in;
+    envelope_t *e;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_envelope_t*) snapshot_at( s, off, sizeof(snapshot_envelope_t) );
+    if( NULL == in ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    e = (envelope_t*) helper_create( sizeof(envelope_t), 0, true );
+    if( NULL == e ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = e;
+
+    e->schema.major = in->major;
+    e->schema.minor = in->minor;
+    e->schema.patch = in->patch;
+    memcpy( e->sha256, in->sha256, sizeof(e->sha256) );
+
+    return __load_str( s, in->base, &e->schema.base, &e->schema.base_len );
+}
+
+static int __load_dhcp( const snapshot_t *s, uint32_t off, dhcp_t **out )
+{
+    const snapshot_dhcp_t *in;
+    dhcp_t *d;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_dhcp_t*) snapshot_at( s, off, sizeof(snapshot_dhcp_t) );
+    if( NULL == in ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    d = (dhcp_t*) helper_create( sizeof(dhcp_t), 0, true );
+    if( NULL == d ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = d;
+
+    d->router_ip = in->router_ip;
+    d->subnet_mask = in->subnet_mask;
+    d->pool_range[0] = in->pool_range[0];
+    d->pool_range[1] = in->pool_range[1];
+    d->lease_length = in->lease_length;
+    if( 0 < in->fixed.count ) {
+        d->fixed = (dhcp_static_t*) snapshot_array( s, in->fixed, sizeof(dhcp_static_t) );
+        if( NULL == d->fixed ) {
+            errno = SNAPSHOT_INVALID_OFFSET;
+            return -1;
+        }
+        d->fixed_count = in->fixed.count;
+    }
+
+    return 0;
+}
+
+static int __load_firewall( const snapshot_t *s, uint32_t off, firewall_t **out )
+{
+    const snapshot_firewall_t *in;
+    const snapshot_str_t *filters = NULL;
+    helper_ctx_t *ctx;
+    firewall_t *f;
+    size_t i;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_firewall_t*) snapshot_at( s, off, sizeof(snapshot_firewall_t) );
+    if( (NULL != in) && (0 < in->filters.count) ) {
+        filters = (const snapshot_str_t*) snapshot_array( s, in->filters, sizeof(snapshot_str_t) );
+    }
+    if( (NULL == in) || ((0 < in->filters.count) && (NULL == filters)) ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    f = (firewall_t*) helper_create( sizeof(firewall_t),
+                                     in->filters.count * (sizeof(char*) + sizeof(size_t)),
+                                     true );
+    if( NULL == f ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = f;
+    ctx = helper_ctx( f );
+
+    if( 0 != __load_str(s, in->level, &f->level, &f->level_len) ) {
+        return -1;
+    }
+    if( 0 < in->filters.count ) {
+        f->filters = (char**) helper_alloc( ctx, in->filters.count * sizeof(char*) );
+        f->filter_lens = (size_t*) helper_alloc( ctx, in->filters.count * sizeof(size_t) );
+        if( (NULL == f->filters) || (NULL == f->filter_lens) ) {
+            errno = SNAPSHOT_OUT_OF_MEMORY;
+            return -1;
+        }
+        for( i = 0; i < in->filters.count; i++ ) {
+            if( 0 != __load_str(s, filters[i], &f->filters[i], &f->filter_lens[i]) ) {
+                return -1;
+            }
+        }
+        f->filters_count = in->filters.count;
+    }
+
+    return 0;
+}
+
+static int __load_gre( const snapshot_t *s, uint32_t off, gre_t **out )
+{
+    const snapshot_gre_t *in;
+    gre_t *g;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_gre_t*) snapshot_at( s, off, sizeof(snapshot_gre_t) );
+    if( NULL == in ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    g = (gre_t*) helper_create( sizeof(gre_t), 0, true );
+    if( NULL == g ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = g;
+
+    if( (0 != __load_str(s, in->primary_remote_endpoint,
+                         &g->primary_remote_endpoint,
+                         &g->primary_remote_endpoint_len)) ||
+        (0 != __load_str(s, in->secondary_remote_endpoint,
+                         &g->secondary_remote_endpoint,
+                         &g->secondary_remote_endpoint_len)) )
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int __load_portmapping( const snapshot_t *s, uint32_t off, portmapping_t **out )
+{
+    const snapshot_portmapping_t *in;
+    const snapshot_pm_entry_t *entries = NULL;
+    portmapping_t *pm;
+    size_t i;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_portmapping_t*) snapshot_at( s, off, sizeof(snapshot_portmapping_t) );
+    if( (NULL != in) && (0 < in->entries.count) ) {
+        entries = (const snapshot_pm_entry_t*) snapshot_array( s, in->entries,
+                                                               sizeof(snapshot_pm_entry_t) );
+    }
+    if( (NULL == in) || ((0 < in->entries.count) && (NULL == entries)) ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    pm = (portmapping_t*) helper_create( sizeof(portmapping_t),
+                                         in->entries.count * sizeof(pm_entry_t), true );
+    if( NULL == pm ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = pm;
+
+    if( 0 < in->entries.count ) {
+        pm->entries = (pm_entry_t*) helper_alloc( helper_ctx(pm),
+                                                  in->entries.count * sizeof(pm_entry_t) );
+        if( NULL == pm->entries ) {
+            errno = SNAPSHOT_OUT_OF_MEMORY;
+            return -1;
+        }
+        memset( pm->entries, 0, in->entries.count * sizeof(pm_entry_t) );
+        pm->entries_count = in->entries.count;
+
+        for( i = 0; i < in->entries.count; i++ ) {
+            pm_entry_t *e = &pm->entries[i];
+
+            if( 0 != __load_str(s, entries[i].protocol, &e->protocol, &e->protocol_len) ) {
+                return -1;
+            }
+            e->port_range[0] = entries[i].port_range[0];
+            e->port_range[1] = entries[i].port_range[1];
+            e->target_port = entries[i].target_port;
+            e->ip_version = entries[i].ip_version;
+            memcpy( e->ip.v6, entries[i].ip.v6, sizeof(e->ip.v6) );
+        }
+    }
+
+    if( 0 != portmapping_index_build(pm, helper_ctx(pm)) ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int __load_wifi( const snapshot_t *s, uint32_t off, wifi_t **out )
+{
+    const snapshot_wifi_t *in;
+    wifi_t *w;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const snapshot_wifi_t*) snapshot_at( s, off, sizeof(snapshot_wifi_t) );
+    if( NULL == in ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    w = (wifi_t*) helper_create( sizeof(wifi_t),
+                                 (in->config_5g.aps.count + in->config_2g.aps.count) *
+                                 sizeof(wifi_ap_t), true );
+    if( NULL == w ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    *out = w;
+
+    if( (0 != __load_wifi_config(s, &in->config_5g, &w->config_5g, helper_ctx(w))) ||
+        (0 != __load_wifi_config(s, &in->config_2g, &w->config_2g, helper_ctx(w))) )
+    {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int __load_wifi_config( const snapshot_t *s, const snapshot_wifi_config_t *in,
+                               wifi_config_t *out, helper_ctx_t *ctx )
+{
+    const snapshot_wifi_ap_t *aps = NULL;
+    size_t len, i;
+
+    out->extension_channel = in->extension_channel;
+    out->dfs_enabled = (0 != in->dfs_enabled);
+    out->channel = in->channel;
+    out->bandwith = in->bandwith;
+    out->tx_power = in->tx_power;
+
+    if( (0 != __load_str(s, in->standards, &out->standards, &out->standards_count)) ||
+        (0 != __load_str(s, in->basic_rate, &out->basic_rate, &len)) )
+    {
+        return -1;
+    }
+
+    if( 0 == in->aps.count ) {
+        return 0;
+    }
+
+    aps = (const snapshot_wifi_ap_t*) snapshot_array( s, in->aps, sizeof(snapshot_wifi_ap_t) );
+    if( NULL == aps ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    out->aps = (wifi_ap_t*) helper_alloc( ctx, in->aps.count * sizeof(wifi_ap_t) );
+    if( NULL == out->aps ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    memset( out->aps, 0, in->aps.count * sizeof(wifi_ap_t) );
+    out->aps_count = in->aps.count;
+
+    for( i = 0; i < in->aps.count; i++ ) {
+        if( (0 != __load_str(s, aps[i].name, &out->aps[i].name, &len)) ||
+            (0 != __load_str(s, aps[i].ssid, &out->aps[i].ssid, &len)) ||
+            (0 != __load_str(s, aps[i].password, &out->aps[i].password, &len)) ||
+            (0 != __load_str(s, aps[i].advertisement, &out->aps[i].advertisement, &len)) ||
+            (0 != __load_str(s, aps[i].security_mode, &out->aps[i].security_mode, &len)) ||
+            (0 != __load_str(s, aps[i].method, &out->aps[i].method, &len)) )
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int __load_xdns( const snapshot_t *s, uint32_t off, xdns_t **out )
+{
+    const xdns_t *in;
+
+    *out = NULL;
+    if( 0 == off ) {
+        return 0;
+    }
+
+    in = (const xdns_t*) snapshot_at( s, off, sizeof(xdns_t) );
+    if( NULL == in ) {
+        errno = SNAPSHOT_INVALID_OFFSET;
+        return -1;
+    }
+
+    *out = (xdns_t*) helper_create( sizeof(xdns_t), 0, true );
+    if( NULL == *out ) {
+        errno = SNAPSHOT_OUT_OF_MEMORY;
+        return -1;
+    }
+    memcpy( *out, in, sizeof(xdns_t) );
+
+    return 0;
+}
+
+/**
+ *  Unmaps the image once the configuration rebuilt from it is destroyed.
+ */
+static void __unmap( void *view, size_t len )
+{
+    (void) len;
+
+    snapshot_unmap( (const snapshot_t*) view );
+}
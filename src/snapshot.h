@@ -0,0 +1,258 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "all.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+#define SNAPSHOT_MAGIC      "WEBCFGSS"
+#define SNAPSHOT_VERSION    1
+
+/* Written as is, so an image from a host of the other byte order is refused. */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* The snapshot is a flat image of an all_t.  Every reference in it is an
+ * offset from the start of the image, with 0 meaning "none", so the image
+ * can be mapped anywhere & used as is.  Structures come first, followed by
+ * the '\0' terminated strings in a string table.  Any change to the layout
+ * must change SNAPSHOT_VERSION.
+ *
+ * The structures mirror the decoded ones, for example:
+ *
+ *     const snapshot_dhcp_t *dhcp;
+ *     const dhcp_static_t *fixed;
+ *
+ *     dhcp = snapshot_at( s, s->dhcp.data, sizeof(snapshot_dhcp_t) );
+ *     fixed = snapshot_array( s, dhcp->fixed, sizeof(dhcp_static_t) );
+ */
+
+typedef struct {
+    uint32_t off;
+    uint32_t len;           /* Not counting the '\0'. */
+} snapshot_str_t;
+
+typedef struct {
+    uint32_t off;
+    uint32_t count;
+} snapshot_array_t;
+
+typedef struct {
+    uint32_t envelope;      /* snapshot_envelope_t */
+    uint32_t data;          /* snapshot_dhcp_t, snapshot_firewall_t, ... */
+} snapshot_subsystem_t;
+
+typedef struct {
+    snapshot_str_t base;
+    uint64_t major;
+    uint64_t minor;
+    uint64_t patch;
+    uint8_t sha256[32];     /* The payload is not kept. */
+} snapshot_envelope_t;
+
+typedef struct {
+    uint32_t router_ip;
+    uint32_t subnet_mask;
+    uint32_t pool_range[2];
+    uint32_t lease_length;
+    snapshot_array_t fixed;         /* dhcp_static_t */
+} snapshot_dhcp_t;
+
+typedef struct {
+    snapshot_str_t level;
+    snapshot_array_t filters;       /* snapshot_str_t */
+} snapshot_firewall_t;
+
+typedef struct {
+    snapshot_str_t primary_remote_endpoint;
+    snapshot_str_t secondary_remote_endpoint;
+} snapshot_gre_t;
+
+typedef struct {
+    snapshot_str_t protocol;
+    uint16_t port_range[2];
+    uint16_t target_port;
+    uint8_t ip_version;
+    uint8_t reserved;
+    union {
+        uint32_t v4;
+        uint8_t v6[16];
+    } ip;
+} snapshot_pm_entry_t;
+
+typedef struct {
+    snapshot_array_t entries;       /* snapshot_pm_entry_t */
+} snapshot_portmapping_t;
+
+typedef struct {
+    snapshot_str_t name;
+    snapshot_str_t ssid;
+    snapshot_str_t password;
+    snapshot_str_t advertisement;
+    snapshot_str_t security_mode;
+    snapshot_str_t method;
+} snapshot_wifi_ap_t;
+
+typedef struct {
+    char extension_channel;
+    uint8_t dfs_enabled;
+    int16_t channel;
+    uint32_t reserved;
+    uint64_t bandwith;
+    snapshot_str_t standards;       /* standards_count long */
+    snapshot_array_t aps;           /* snapshot_wifi_ap_t */
+    snapshot_str_t basic_rate;
+    uint64_t tx_power;
+} snapshot_wifi_config_t;
+
+typedef struct {
+    snapshot_wifi_config_t config_5g;
+    snapshot_wifi_config_t config_2g;
+} snapshot_wifi_t;
+
+typedef struct {
+    uint8_t magic[8];               /* SNAPSHOT_MAGIC */
+    uint32_t version;               /* SNAPSHOT_VERSION */
+    uint32_t byte_order;            /* SNAPSHOT_BYTE_ORDER */
+    uint64_t size;                  /* The whole image in bytes. */
+    uint8_t sha256[32];             /* Of the image after this field. */
+
+    uint32_t strings;               /* The string table. */
+    uint32_t strings_size;
+
+    uint32_t full_envelope;         /* snapshot_envelope_t */
+    uint32_t reserved;
+    snapshot_subsystem_t dhcp;
+    snapshot_subsystem_t firewall;
+    snapshot_subsystem_t gre;
+    snapshot_subsystem_t portmapping;
+    snapshot_subsystem_t wifi;
+    snapshot_subsystem_t xdns;      /* xdns_t */
+} snapshot_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function writes a flat image of the configuration to a file.  The
+ *  image is written next to the file first & renamed over it once it is on
+ *  disk, so the file is always either the old or the new image.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         snapshot_strerror().
+ *
+ *  @param path the file to write (normally in the durable_path)
+ *  @param cfg  the configuration to write
+ *
+ *  @return 0 on success, error otherwise
+ */
+int snapshot_write( const char *path, const all_t *cfg );
+
+/**
+ *  This function maps an image read only after checking the header &
+ *  checksum.  Nothing is parsed or allocated.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         snapshot_strerror().
+ *
+ *  @param path the file to map
+ *
+ *  @return NULL on error, success otherwise
+ */
+const snapshot_t* snapshot_map( const char *path );
+
+/**
+ *  This function unmaps an image.
+ *
+ *  @param s the image to unmap
+ */
+void snapshot_unmap( const snapshot_t *s );
+
+/**
+ *  This function rebuilds the configuration an image holds, so it can be
+ *  used before the next one is downloaded.  Only the structures are
+ *  allocated; the strings & plain arrays are referenced in the image, and
+ *  the payloads of the envelopes are not there.
+ *
+ *  @note: unlike snapshot_map() this allocates: each structure, its
+ *         arrays of pointers, the port mappings & their lookup index are
+ *         built again at boot.  What it saves is decoding the msgpack, not
+ *         allocating or indexing.  Like a decoded dhcp, the dhcp is only
+ *         indexed if dhcp_index() is called.
+ *
+ *  @note: errno is set with a custom error that can be made readable by
+ *         snapshot_strerror().  On success the image is released by
+ *         all_destroy() with the configuration & must not be unmapped.
+ *
+ *  @param s the image from snapshot_map()
+ *
+ *  @return NULL on error, success otherwise
+ */
+all_t* snapshot_all( const snapshot_t *s );
+
+/**
+ *  This function resolves the offset of a structure in the image.
+ *
+ *  @param s    the image
+ *  @param off  the offset of the structure
+ *  @param size the size of the structure in bytes
+ *
+ *  @return the structure, or NULL for none or if it is not in the image
+ */
+const void* snapshot_at( const snapshot_t *s, uint32_t off, size_t size );
+
+/**
+ *  This function resolves an array in the image.
+ *
+ *  @param s    the image
+ *  @param a    the array
+ *  @param size the size of each element in bytes
+ *
+ *  @return the first element, or NULL for none or if it is not in the image
+ */
+const void* snapshot_array( const snapshot_t *s, snapshot_array_t a, size_t size );
+
+/**
+ *  This function resolves a string in the image.
+ *
+ *  @param s   the image
+ *  @param str the string
+ *
+ *  @return the '\0' terminated string, or NULL for none or if it is not in
+ *          the image
+ */
+const char* snapshot_str( const snapshot_t *s, snapshot_str_t str );
+
+/**
+ *  This function returns a general reason why the operation failed.
+ *
+ *  @param errnum the errno value to inspect
+ *
+ *  @return the constant string (do not alter or free) describing the error
+ */
+const char* snapshot_strerror( int errnum );
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <string.h>
+
+#include "token.h"
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+/* none */
+
+/*----------------------------------------------------------------------------*/
+/*                            File Scoped Variables                           */
+/*----------------------------------------------------------------------------*/
+
+/* Header sizes for the 0xc0 - 0xdf types; 0 marks 0xc1 (never used). */
+static const uint8_t __header_sizes[32] = {
+    1, 0, 1, 1,             /* nil, (never used), false, true */
+    2, 3, 5,                /* bin 8, 16, 32 */
+    3, 4, 6,                /* ext 8, 16, 32 */
+    5, 9,                   /* float 32, 64 */
+    2, 3, 5, 9,             /* uint 8, 16, 32, 64 */
+    2, 3, 5, 9,             /* int 8, 16, 32, 64 */
+    2, 2, 2, 2, 2,          /* fixext 1, 2, 4, 8, 16 */
+    2, 3, 5,                /* str 8, 16, 32 */
+    3, 5,                   /* array 16, 32 */
+    3, 5                    /* map 16, 32 */
+};
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static uint64_t __be( const uint8_t *p, size_t len );
+static void __sint( token_t *t, const uint8_t *p, size_t len );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See token.h for details. */
+size_t token_header_size( uint8_t first )
+{
+    if( (first < 0xc0) || (0xe0 <= first) ) {
+        return 1;
+    }
+
+    return __header_sizes[first - 0xc0];
+}
+
+/* See token.h for details. */
+void token_decode( const uint8_t *hdr, token_t *t )
+{
+    uint8_t b = hdr[0];
+
+    memset( t, 0, sizeof(token_t) );
+
+    if( b <= 0x7f ) {
+        t->type = TOKEN_POSITIVE_INTEGER;
+        t->via.u64 = b;
+    } else if( b <= 0x8f ) {
+        t->type = TOKEN_MAP;
+        t->size = b & 0x0f;
+    } else if( b <= 0x9f ) {
+        t->type = TOKEN_ARRAY;
+        t->size = b & 0x0f;
+    } else if( b <= 0xbf ) {
+        t->type = TOKEN_STR;
+        t->size = b & 0x1f;
+    } else if( 0xe0 <= b ) {
+        t->type = TOKEN_NEGATIVE_INTEGER;
+        t->via.i64 = (int8_t) b;
+    } else {
+        switch( b ) {
+            case 0xc0:
+                t->type = TOKEN_NIL;
+                break;
+            case 0xc2:
+            case 0xc3:
+                t->type = TOKEN_BOOLEAN;
+                t->via.boolean = (0xc3 == b);
+                break;
+            case 0xc4:
+            case 0xc5:
+            case 0xc6:
+                t->type = TOKEN_BIN;
+                t->size = (uint32_t) __be( &hdr[1], 1 << (b - 0xc4) );
+                break;
+            case 0xc7:
+            case 0xc8:
+            case 0xc9:
+                t->type = TOKEN_EXT;
+                t->size = (uint32_t) __be( &hdr[1], 1 << (b - 0xc7) );
+                t->ext_type = (int8_t) hdr[1 + (1 << (b - 0xc7))];
+                break;
+            case 0xca:
+            {
+                uint32_t u = (uint32_t) __be( &hdr[1], 4 );
+                float f;
+
+                memcpy( &f, &u, sizeof(f) );
+                t->type = TOKEN_FLOAT;
+                t->via.f64 = f;
+                break;
+            }
+            case 0xcb:
+            {
+                uint64_t u = __be( &hdr[1], 8 );
+
+                memcpy( &t->via.f64, &u, sizeof(double) );
+                t->type = TOKEN_FLOAT;
+                break;
+            }
+            case 0xcc:
+            case 0xcd:
+            case 0xce:
+            case 0xcf:
+                t->type = TOKEN_POSITIVE_INTEGER;
+                t->via.u64 = __be( &hdr[1], 1 << (b - 0xcc) );
+                break;
+            case 0xd0:
+            case 0xd1:
+            case 0xd2:
+            case 0xd3:
+                __sint( t, &hdr[1], 1 << (b - 0xd0) );
+                break;
+            case 0xd4:
+            case 0xd5:
+            case 0xd6:
+            case 0xd7:
+            case 0xd8:
+                t->type = TOKEN_EXT;
+                t->size = 1 << (b - 0xd4);
+                t->ext_type = (int8_t) hdr[1];
+                break;
+            case 0xd9:
+            case 0xda:
+            case 0xdb:
+                t->type = TOKEN_STR;
+                t->size = (uint32_t) __be( &hdr[1], 1 << (b - 0xd9) );
+                break;
+            case 0xdc:
+            case 0xdd:
+                t->type = TOKEN_ARRAY;
+                t->size = (uint32_t) __be( &hdr[1], 2 << (b - 0xdc) );
+                break;
+            default: /* 0xde, 0xdf */
+                t->type = TOKEN_MAP;
+                t->size = (uint32_t) __be( &hdr[1], 2 << (b - 0xde) );
+                break;
+        }
+    }
+}
+
+/* See token.h for details. */
+uint64_t token_children( const token_t *t )
+{
+    if( TOKEN_ARRAY == t->type ) {
+        return t->size;
+    }
+    if( TOKEN_MAP == t->type ) {
+        return 2 * (uint64_t) t->size;
+    }
+
+    return 0;
+}
+
+/* See token.h for details. */
+uint32_t token_data_size( const token_t *t )
+{
+    if( (TOKEN_STR == t->type) || (TOKEN_BIN == t->type) || (TOKEN_EXT == t->type) ) {
+        return t->size;
+    }
+
+    return 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Reads a big endian unsigned value.
+ */
+static uint64_t __be( const uint8_t *p, size_t len )
+{
+    uint64_t v = 0;
+    size_t i;
+
+    for( i = 0; i < len; i++ ) {
+        v = (v << 8) | p[i];
+    }
+
+    return v;
+}
+
+/**
+ *  Reads a big endian signed value, classifying it the way msgpack-c does.
+ */
+static void __sint( token_t *t, const uint8_t *p, size_t len )
+{
+    uint64_t u = __be( p, len );
+    int64_t v;
+
+    /* Sign extend from the encoded width. */
+    if( len < 8 ) {
+        uint64_t sign = ((uint64_t) 1) << (len * 8 - 1);
+        u = (u ^ sign) - sign;
+    }
+    v = (int64_t) u;
+
+    if( 0 <= v ) {
+        t->type = TOKEN_POSITIVE_INTEGER;
+        t->via.u64 = (uint64_t) v;
+    } else {
+        t->type = TOKEN_NEGATIVE_INTEGER;
+        t->via.i64 = v;
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright 2020 Comcast Cable Communications Management, LLC
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef __TOKEN_H__
+#define __TOKEN_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------------------*/
+/*                                   Macros                                   */
+/*----------------------------------------------------------------------------*/
+
+/* The longest msgpack header (type byte plus fixed size fields). */
+#define TOKEN_MAX_HEADER 9
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef enum {
+    TOKEN_NIL,
+    TOKEN_BOOLEAN,
+    TOKEN_POSITIVE_INTEGER,     /* Any integer >= 0, like msgpack-c. */
+    TOKEN_NEGATIVE_INTEGER,
+    TOKEN_FLOAT,
+    TOKEN_STR,
+    TOKEN_BIN,
+    TOKEN_EXT,
+    TOKEN_ARRAY,
+    TOKEN_MAP
+} token_type_t;
+
+/* A single msgpack header.  Strings, binary blobs and extensions are followed
+ * by size bytes of data; arrays and maps by size elements (pairs for maps). */
+typedef struct {
+    token_type_t type;
+    uint32_t size;
+    int8_t ext_type;
+    const char *ptr;            /* The data when the whole buffer is available
+                                 * (see cursor.h), NULL otherwise. */
+    union {
+        bool boolean;
+        uint64_t u64;
+        int64_t i64;
+        double f64;
+    } via;
+} token_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  Determines the size of the header from its first byte.
+ *
+ *  @param first the first byte of the header
+ *
+ *  @return the number of header bytes (1 to TOKEN_MAX_HEADER), or 0 if the
+ *          byte is not a valid msgpack type
+ */
+size_t token_header_size( uint8_t first );
+
+/**
+ *  Decodes a complete header.
+ *
+ *  @param hdr the header bytes, token_header_size(hdr[0]) bytes long
+ *  @param t   the token to fill in
+ */
+void token_decode( const uint8_t *hdr, token_t *t );
+
+/**
+ *  Returns the number of elements that follow the token: the array size,
+ *  twice the map size, or zero for everything else.
+ *
+ *  @param t the token to inspect
+ *
+ *  @return the number of elements to follow
+ */
+uint64_t token_children( const token_t *t );
+
+/**
+ *  Returns the number of data bytes that follow the token: the size of a
+ *  string, binary blob or extension, or zero for everything else.
+ *
+ *  @param t the token to inspect
+ *
+ *  @return the number of data bytes to follow
+ */
+uint32_t token_data_size( const token_t *t );
+
+#endif
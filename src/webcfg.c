@@ -14,27 +14,198 @@
  * limitations under the License.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "webcfg.h"
+#include "cache.h"
+#include "envelope.h"
+#include "http.h"
+#include "http_cache.h"
+#include "pool.h"
+#include "queue.h"
+#include "snapshot.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+#define SCHEMA_VERSION      "v1.0"
+#define SYSTEM_STATUS       "online"
+#define HTTP_TIMEOUT_S      30
+#define NO_VERSION          "NONE"
+#define DOWNLOAD_FILE       "webcfg.download"
+#define RESUME_FILE         "webcfg.resume"
+#define RESUME_MAGIC        "WEBCFGRS"
+#define RESUME_VERSION      1
+#define SNAPSHOT_FILE       "webcfg.snapshot"
+
+/* The decoded envelope & payload of each subsystem, for the config applied
+ * & a newer one. */
+#define DECODED_ENTRIES     (2 * 2 * WEBCFG_SUBSYSTEMS)
+
+/* How many items wait between the stages of the background engine.  A
+ * newer item pushes out the oldest, as only the newest config matters. */
+#define QUEUE_DEPTH         1
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
 /*----------------------------------------------------------------------------*/
-/* none */
+
+/* A body to decode. */
+typedef struct {
+    void *data;
+    size_t len;
+    bool owned;                 /* The data is freed once it is decoded. */
+    void *view;                 /* (optional) The mapping the data is in, */
+    size_t view_len;            /* which the config keeps. */
+    envelope_t *env;            /* (optional) The full envelope of the data,
+                                 * decoded as it was downloaded. */
+} body_t;
+
+/* The subsystems of a config being applied on the pool. */
+typedef struct {
+    const all_t *cfg;
+    pthread_mutex_t lock;
+    pthread_cond_t done;        /* A subsystem finished. */
+    uint32_t finished;          /* The WEBCFG_BIT()s of those finished. */
+    int results[WEBCFG_SUBSYSTEMS];
+} apply_t;
+
+/* One of the two places the current config is published in. */
+typedef struct {
+    all_t *cfg;
+    uint32_t pins;              /* Readers between finding the slot current &
+                                 * taking a reference to its config. */
+} slot_t;
+
+/* A config webcfg shares.  The config is the first member, so the one handed
+ * out leads back to its count, & all_destroy() frees the rest with it. */
+typedef struct shared {
+    all_t cfg;
+    uint32_t refs;              /* The references webcfg holds & hands out. */
+    struct shared *prev;        /* The configs still shared, so the ones that */
+    struct shared *next;        /* are webcfg's can be told from others. */
+} shared_t;
+
+/* A decoded config to apply. */
+typedef struct {
+    all_t *cfg;
+    char ver[2 * 32 + 1];
+} update_t;
+
+typedef struct {
+    bool ready;
+    struct webcfg_opts opts;
+    http_client_t *client;
+    bool nonblocking;
+    bool syncing;               /* A non-blocking check is in progress. */
+    uint32_t trans;             /* Counts the checks for the Transaction-Id. */
+    void *body;                 /* Reused for the response body. */
+    size_t body_size;
+    char *download;             /* Where the body goes if tmp_path is set. */
+    char *resume;               /* Describes a partial download to resume. */
+    int fd;                     /* The download while a check is running. */
+    envelope_stream_t *stream;  /* Decodes the download as it arrives. */
+    http_cache_t *cache;        /* The last body, if durable_path is set. */
+    char *snapshot;             /* The image of the config applied, if
+                                 * durable_path is set. */
+    pool_t *pool;               /* Decodes & applies the subsystems. */
+    bool each;                  /* Some subsystem has its own apply. */
+    uint8_t order[WEBCFG_SUBSYSTEMS]; /* The subsystems, each after its `after`s. */
+    cache_t *decoded;           /* The subsystems decoded, by content. */
+    const void *applied_data[WEBCFG_SUBSYSTEMS]; /* What each apply last
+                                 * applied, held in the decoded cache. */
+
+    pthread_mutex_t publishing; /* Held while the current config changes. */
+
+    pthread_mutex_t lock;       /* Protects the rest against the engine. */
+    char cfg_ver[2 * 32 + 1];   /* The sha256 of the newest config decoded. */
+    char applied_ver[2 * 32 + 1]; /* The sha256 of the config last applied. */
+    bool applied;               /* The cached body is the config applied. */
+    bool actual_changed;        /* webcfg_update_actual() was called, so what
+                                 * each apply last applied is unknown. */
+
+    /* The config applied, in current[current_idx].  The other slot is empty
+     * except while a newer config is being published. */
+    slot_t current[2];
+    uint32_t current_idx;
+
+    /* The background engine: a thread for each stage. */
+    bool background;
+    pthread_cond_t wake;        /* A check is wanted or the engine is stopping. */
+    bool check_now;
+    bool stop;
+    queue_t *bodies;            /* Fetched & waiting to be decoded. */
+    queue_t *updates;           /* Decoded & waiting to be applied. */
+    pthread_t threads[3];
+    size_t threads_count;
+} webcfg_t;
+
+/* The start of the resume file, followed by the validator & the URL the
+ * partial download came with. */
+typedef struct {
+    uint8_t magic[8];           /* RESUME_MAGIC */
+    uint32_t version;           /* RESUME_VERSION */
+    uint32_t etag_len;
+    uint32_t url_len;
+    uint64_t received;          /* The length of the partial download. */
+} resume_t;
 
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static webcfg_t __webcfg;
+
+/* Configs can be released after webcfg_shutdown(), so these outlive it. */
+static pthread_mutex_t __shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static shared_t *__shared = NULL;
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-/* none */
+static void __cleanup( void );
+static int __check( void );
+static void __done( void *user_data, size_t index, http_response_t *resp );
+static bool __take( http_response_t *resp, body_t *b );
+static bool __decode( body_t *b, update_t *u );
+static void __apply( update_t *u );
+static void __version( const all_t *cfg, char ver[2 * 32 + 1] );
+static bool __apply_each( const all_t *cfg );
+static void __apply_one( void *arg, size_t i );
+static void* __data( const all_t *cfg, int s );
+static void __applied( int s, void *data );
+static int __order( const struct webcfg_opts *o, uint8_t order[WEBCFG_SUBSYSTEMS] );
+static all_t* __share( all_t *cfg, uint32_t refs );
+static void __publish( all_t *cfg );
+static void __make_current( all_t *cfg );
+static void __restore( void );
+static void __drop_body( body_t *b );
+static void __release_body( void *p );
+static void __release_update( void *p );
+static int __engine_start( void );
+static void __engine_stop( void );
+static void* __fetcher( void *arg );
+static void* __decoder( void *arg );
+static void* __applier( void *arg );
+static int __stopping( void *user_data );
+static int __to_file( void *user_data, const void *buf, size_t len );
+static void __stream_start( size_t resumed );
+static bool __from_file( bool ok, const char *etag, body_t *b );
+static void __keep_partial( const char *etag );
+static size_t __resume_load( char **etag );
+static char* __path( const char *dir, const char *file );
+static void __unmap( void *view, size_t len );
+static void __watch( void *user_data, int fd, int events );
+static void __timer( void *user_data, long timeout_ms );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -43,20 +214,237 @@
 /* See webcfg.h for details. */
 int webcfg_init( struct webcfg_opts *opts )
 {
-    (void) opts;
+    uint8_t order[WEBCFG_SUBSYSTEMS];
+    pthread_condattr_t attr;
+    bool each = false;
+    int i;
+
+    if( (NULL == opts) || (NULL == opts->url) ) {
+        return -1;
+    }
+
+    /* Something must apply the config, and the subsystems must have an
+     * order to be applied in. */
+    for( i = 0; i < WEBCFG_SUBSYSTEMS; i++ ) {
+        each = each || (NULL != opts->apply[i].apply);
+    }
+    if( ((NULL == opts->update_config) && !each) || (0 != __order(opts, order)) ) {
+        return -1;
+    }
+
+    /* The event loop callbacks go together, and leave no room for the
+     * engine. */
+    if( (NULL == opts->watch_fd) != (NULL == opts->watch_timeout) ) {
+        return -1;
+    }
+    if( (NULL != opts->watch_fd) && (0 < opts->poll_interval_s) ) {
+        return -1;
+    }
+
+    if( __webcfg.ready ) {
+        return -2;
+    }
+
+    memset( &__webcfg, 0, sizeof(webcfg_t) );
+    memcpy( &__webcfg.opts, opts, sizeof(struct webcfg_opts) );
+    strcpy( __webcfg.cfg_ver, NO_VERSION );
+    strcpy( __webcfg.applied_ver, NO_VERSION );
+    memcpy( __webcfg.order, order, sizeof(order) );
+    __webcfg.fd = -1;
+
+    pthread_mutex_init( &__webcfg.lock, NULL );
+    pthread_mutex_init( &__webcfg.publishing, NULL );
+    pthread_condattr_init( &attr );
+    pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+    pthread_cond_init( &__webcfg.wake, &attr );
+    pthread_condattr_destroy( &attr );
+
+    if( NULL != opts->tmp_path ) {
+        __webcfg.download = __path( opts->tmp_path, DOWNLOAD_FILE );
+        __webcfg.resume = __path( opts->tmp_path, RESUME_FILE );
+    }
+
+    __webcfg.client = http_client_create();
+    __webcfg.decoded = cache_create( DECODED_ENTRIES );
+    if( (NULL == __webcfg.client) || (NULL == __webcfg.decoded) ||
+        ((NULL != opts->tmp_path) && ((NULL == __webcfg.download) || (NULL == __webcfg.resume))) )
+    {
+        __cleanup();
+        return -3;
+    }
+
+    /* Keep the last body so an unchanged config is never sent again, even
+     * across restarts, and an image of the config applied so there is a
+     * current one before the first check. */
+    if( NULL != opts->durable_path ) {
+        __webcfg.cache = http_cache_create( opts->durable_path );
+        __webcfg.snapshot = __path( opts->durable_path, SNAPSHOT_FILE );
+        if( (NULL == __webcfg.cache) || (NULL == __webcfg.snapshot) ) {
+            __cleanup();
+            return -3;
+        }
+        __restore();
+    }
+
+    /* The caller applies a subsystem too, so the slowest chain of them is
+     * never short of a thread.  The subsystems are decoded on it as well. */
+    __webcfg.each = each;
+    __webcfg.pool = pool_create( WEBCFG_SUBSYSTEMS - 1 );
+    if( NULL == __webcfg.pool ) {
+        __cleanup();
+        return -3;
+    }
+
+    if( NULL != opts->watch_fd ) {
+        if( 0 != http_client_watch(__webcfg.client, __watch, __timer, NULL) ) {
+            __cleanup();
+            return -3;
+        }
+        __webcfg.nonblocking = true;
+    }
+
+    if( 0 < opts->poll_interval_s ) {
+        __webcfg.background = true;
+        if( 0 != __engine_start() ) {
+            __cleanup();
+            return -3;
+        }
+    }
+
+    __webcfg.ready = true;
 
     return 0;
 }
 
+/* See webcfg.h for details. */
+int webcfg_sync( void )
+{
+    if( !__webcfg.ready ) {
+        return -1;
+    }
+
+    if( __webcfg.background ) {
+        pthread_mutex_lock( &__webcfg.lock );
+        __webcfg.check_now = true;
+        pthread_cond_signal( &__webcfg.wake );
+        pthread_mutex_unlock( &__webcfg.lock );
+        return 0;
+    }
+
+    if( __webcfg.syncing ) {
+        return -2;
+    }
+
+    return __check();
+}
+
+/* See webcfg.h for details. */
+int webcfg_process( int fd, int events )
+{
+    int e = 0;
+
+    if( !__webcfg.ready || !__webcfg.nonblocking ) {
+        return -1;
+    }
+
+    if( WEBCFG_EVENT_IN & events )  e |= HTTP_EVENT_IN;
+    if( WEBCFG_EVENT_OUT & events ) e |= HTTP_EVENT_OUT;
+    if( WEBCFG_EVENT_ERR & events ) e |= HTTP_EVENT_ERR;
+
+    return http_process( __webcfg.client, (WEBCFG_TIMEOUT == fd) ? HTTP_TIMEOUT : fd, e );
+}
+
 /* See webcfg.h for details. */
 void webcfg_shutdown( void )
 {
+    if( __webcfg.ready ) {
+        __cleanup();
+    }
+}
+
+/* See webcfg.h for details. */
+const all_t* webcfg_get_current( void )
+{
+    slot_t *slot;
+    all_t *cfg;
+    uint32_t i;
+
+    /* Pin the current slot, so the config in it can't be released before
+     * there is a reference to it.  If a newer config was published in the
+     * meantime the pin may be too late, so try again. */
+    while( true ) {
+        i = __atomic_load_n( &__webcfg.current_idx, __ATOMIC_SEQ_CST );
+        slot = &__webcfg.current[i];
+        __atomic_add_fetch( &slot->pins, 1, __ATOMIC_SEQ_CST );
+        if( i == __atomic_load_n(&__webcfg.current_idx, __ATOMIC_SEQ_CST) ) {
+            break;
+        }
+        __atomic_sub_fetch( &slot->pins, 1, __ATOMIC_SEQ_CST );
+    }
+
+    cfg = __atomic_load_n( &slot->cfg, __ATOMIC_ACQUIRE );
+    if( NULL != cfg ) {
+        __atomic_add_fetch( &((shared_t*) cfg)->refs, 1, __ATOMIC_RELAXED );
+    }
+    __atomic_sub_fetch( &slot->pins, 1, __ATOMIC_SEQ_CST );
+
+    return cfg;
+}
+
+/* See webcfg.h for details. */
+void webcfg_release( const all_t *cfg )
+{
+    shared_t *p = (shared_t*) cfg;
+
+    if( (NULL != p) && (0 == __atomic_sub_fetch(&p->refs, 1, __ATOMIC_ACQ_REL)) ) {
+        pthread_mutex_lock( &__shared_lock );
+        if( NULL != p->prev ) {
+            p->prev->next = p->next;
+        } else {
+            __shared = p->next;
+        }
+        if( NULL != p->next ) {
+            p->next->prev = p->prev;
+        }
+        pthread_mutex_unlock( &__shared_lock );
+
+        all_destroy( &p->cfg );
+    }
 }
 
 /* See webcfg.h for details. */
 int webcfg_update_actual( const all_t *cfg )
 {
-    (void) cfg;
+    char ver[sizeof(__webcfg.cfg_ver)];
+    shared_t *p;
+
+    if( !__webcfg.ready || (NULL == cfg) || (NULL == cfg->full_envelope) ) {
+        return -1;
+    }
+
+    /* A config webcfg shares can be handed out as the current one too.  The
+     * caller holds a reference to it, so it can't go away meanwhile. */
+    pthread_mutex_lock( &__shared_lock );
+    for( p = __shared; (NULL != p) && (&p->cfg != cfg); p = p->next ) {
+        ;
+    }
+    if( NULL != p ) {
+        __atomic_add_fetch( &p->refs, 1, __ATOMIC_ACQ_REL );
+    }
+    pthread_mutex_unlock( &__shared_lock );
+
+    if( NULL != p ) {
+        __make_current( &p->cfg );
+    }
+
+    __version( cfg, ver );
+
+    pthread_mutex_lock( &__webcfg.lock );
+    strcpy( __webcfg.cfg_ver, ver );
+    strcpy( __webcfg.applied_ver, ver );
+    __webcfg.applied = true;
+    __webcfg.actual_changed = true;
+    pthread_mutex_unlock( &__webcfg.lock );
 
     return 0;
 }
@@ -64,10 +452,1095 @@ int webcfg_update_actual( const all_t *cfg )
 /* See webcfg.h for details. */
 void webcfg_free( all_t *cfg )
 {
-    (void) cfg;
+    webcfg_release( cfg );
 }
 
 /*----------------------------------------------------------------------------*/
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
-/* none */
+
+/**
+ *  Stops the engine & releases everything, however far webcfg_init() got.
+ */
+static void __cleanup( void )
+{
+    int i;
+
+    __engine_stop();
+    __publish( NULL );
+    pool_destroy( __webcfg.pool );
+    for( i = 0; i < WEBCFG_SUBSYSTEMS; i++ ) {
+        __applied( i, NULL );
+    }
+    cache_destroy( __webcfg.decoded );
+
+    http_client_destroy( __webcfg.client );
+    http_cache_destroy( __webcfg.cache );
+    if( 0 <= __webcfg.fd ) {
+        __from_file( false, NULL, NULL );
+    }
+    if( NULL != __webcfg.body ) {
+        free( __webcfg.body );
+    }
+    if( NULL != __webcfg.download ) {
+        free( __webcfg.download );
+    }
+    if( NULL != __webcfg.resume ) {
+        free( __webcfg.resume );
+    }
+    if( NULL != __webcfg.snapshot ) {
+        free( __webcfg.snapshot );
+    }
+
+    pthread_cond_destroy( &__webcfg.wake );
+    pthread_mutex_destroy( &__webcfg.publishing );
+    pthread_mutex_destroy( &__webcfg.lock );
+    memset( &__webcfg, 0, sizeof(webcfg_t) );
+}
+
+/**
+ *  Makes a check: blocking until it is done, or just starting it in the
+ *  non-blocking mode.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __check( void )
+{
+    struct webcfg_opts *o = &__webcfg.opts;
+    http_request_t req;
+    char trans_id[16];
+    char ver[sizeof(__webcfg.cfg_ver)];
+    char *auth = NULL;
+    char *etag = NULL;
+    int rv;
+
+    if( NULL != o->get_auth ) {
+        auth = (o->get_auth)( o->user_data );
+    }
+
+    snprintf( trans_id, sizeof(trans_id), "%08x", ++__webcfg.trans );
+
+    pthread_mutex_lock( &__webcfg.lock );
+    strcpy( ver, __webcfg.cfg_ver );
+    pthread_mutex_unlock( &__webcfg.lock );
+
+    memset( &req, 0, sizeof(http_request_t) );
+    req.auth             = auth;
+    req.cfg_ver          = ver;
+    req.schema_ver       = SCHEMA_VERSION;
+    req.fw               = (NULL != o->firmware) ? o->firmware : "";
+    req.status           = SYSTEM_STATUS;
+    req.trans_id         = trans_id;
+    req.boot_unixtime    = o->boot_unixtime;
+    req.ready_unixtime   = o->ready_unixtime;
+    req.current_unixtime = (uint32_t) time( NULL );
+    req.url              = o->url;
+    req.timeout_s        = HTTP_TIMEOUT_S;
+    req.interface        = o->interface;
+    req.ca_cert_path     = o->ca_cert_path;
+    req.client           = __webcfg.client;
+
+    if( __webcfg.background ) {
+        /* The body is handed on to the decoder, so it can't be reused. */
+        req.abort_fn = __stopping;
+    } else {
+        req.body_buf = __webcfg.body;
+        req.body_buf_size = __webcfg.body_size;
+    }
+
+    /* Stream the body to the file instead of holding it in memory, after
+     * what an interrupted check left if it can be resumed. */
+    if( NULL != __webcfg.download ) {
+        req.resume_from = __resume_load( &etag );
+        req.if_range = etag;
+
+        __webcfg.fd = open( __webcfg.download,
+                            O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC |
+                            ((0 < req.resume_from) ? 0 : O_TRUNC), 0600 );
+        if( __webcfg.fd < 0 ) {
+            if( NULL != auth ) {
+                free( auth );
+            }
+            if( NULL != etag ) {
+                free( etag );
+            }
+            return -4;
+        }
+        req.write_fn = __to_file;
+        __stream_start( req.resume_from );
+    }
+
+    if( __webcfg.nonblocking ) {
+        if( NULL != __webcfg.cache ) {
+            rv = http_cache_start( __webcfg.cache, __webcfg.client, &req, __done, NULL );
+        } else {
+            rv = http_start( __webcfg.client, &req, __done, NULL );
+        }
+        if( 0 == rv ) {
+            __webcfg.syncing = true;
+        } else if( 0 <= __webcfg.fd ) {
+            __from_file( false, NULL, NULL );
+        }
+    } else {
+        http_response_t resp;
+
+        if( NULL != __webcfg.cache ) {
+            rv = http_cache_request( __webcfg.cache, &req, &resp );
+        } else {
+            rv = http_request( &req, &resp );
+        }
+        if( 0 == rv ) {
+            __done( NULL, 0, &resp );
+            http_destroy( &resp );
+        } else if( 0 <= __webcfg.fd ) {
+            __from_file( false, NULL, NULL );
+        }
+    }
+
+    if( NULL != auth ) {
+        free( auth );
+    }
+    if( NULL != etag ) {
+        free( etag );
+    }
+
+    return rv;
+}
+
+/**
+ *  Passes the body of a check on to be decoded & applied: right away, or
+ *  through the engine's queues.
+ */
+static void __done( void *user_data, size_t index, http_response_t *resp )
+{
+    body_t b;
+    update_t u;
+
+    (void) user_data;
+    (void) index;
+
+    __webcfg.syncing = false;
+
+    if( !__take(resp, &b) ) {
+        return;
+    }
+
+    if( __webcfg.background ) {
+        body_t *p = (body_t*) malloc( sizeof(body_t) );
+
+        if( NULL == p ) {
+            __drop_body( &b );
+            return;
+        }
+        memcpy( p, &b, sizeof(body_t) );
+
+        p = (body_t*) queue_push( __webcfg.bodies, p );
+        if( NULL != p ) {
+            __release_body( p );
+        }
+        return;
+    }
+
+    if( __decode(&b, &u) ) {
+        __apply( &u );
+    }
+}
+
+/**
+ *  Provides the body of a check if it holds a config to apply.  A 304
+ *  means the config has not changed, so the cached body is only used if it
+ *  has not been applied yet (after a restart or when update_config()
+ *  refused it).
+ *
+ *  @param resp the response
+ *  @param b    the body, taken from the response if owned
+ *
+ *  @return true if there is a body to decode
+ */
+static bool __take( http_response_t *resp, body_t *b )
+{
+    bool ok;
+
+    memset( b, 0, sizeof(body_t) );
+    ok = (CURLE_OK == resp->code) &&
+         ((200 == resp->http_status) || (0 < resp->resumed_from));
+
+    if( resp->cached ) {
+        bool applied;
+
+        if( 0 <= __webcfg.fd ) {
+            __from_file( false, NULL, NULL );
+        }
+
+        pthread_mutex_lock( &__webcfg.lock );
+        applied = __webcfg.applied;
+        pthread_mutex_unlock( &__webcfg.lock );
+        if( applied ) {
+            return false;
+        }
+
+        /* Decode in place from the cache file & keep its mapping. */
+        b->data = resp->data;
+        b->len = resp->len;
+        b->view = resp->map;
+        b->view_len = resp->map_len;
+        resp->map = NULL;
+        resp->data = NULL;
+        return true;
+    }
+
+    if( 0 <= __webcfg.fd ) {
+        /* A body cut short is kept to resume, if it can be validated & is
+         * an envelope so far. */
+        if( (CURLE_OK != resp->code) && (NULL != __webcfg.stream) &&
+            ((200 == resp->http_status) || (206 == resp->http_status)) &&
+            (NULL != resp->etag) && (0 != strncmp(resp->etag, "W/", 2)) )
+        {
+            __keep_partial( resp->etag );
+            return false;
+        }
+        return __from_file( ok, resp->etag, b );
+    }
+
+    if( __webcfg.background ) {
+        if( ok ) {
+            b->data = resp->data;
+            b->len = resp->len;
+            b->owned = true;
+            resp->data = NULL;
+        }
+        return ok;
+    }
+
+    /* Keep a buffer the body outgrew for the next check, so once it is big
+     * enough checks allocate nothing for the body. */
+    if( (NULL != resp->data) && (resp->data != resp->body_buf) ) {
+        if( NULL != __webcfg.body ) {
+            free( __webcfg.body );
+        }
+        __webcfg.body = resp->data;
+        __webcfg.body_size = resp->size;
+        resp->body_buf = resp->data;
+    }
+
+    b->data = resp->data;
+    b->len = resp->len;
+    return ok;
+}
+
+/**
+ *  Verifies & decodes a body, with its subsystems in parallel on the pool.
+ *  Its version becomes the one checks ask with.
+ *
+ *  @param b the body, which is released either way
+ *  @param u the config & its version
+ *
+ *  @return true on success, false otherwise
+ */
+static bool __decode( body_t *b, update_t *u )
+{
+    if( NULL != b->view ) {
+        /* A download was verified as it arrived, which leaves the
+         * subsystems. */
+        if( NULL != b->env ) {
+            u->cfg = all_convert_envelope( b->env, __webcfg.pool, __webcfg.decoded );
+            b->env = NULL;
+        } else {
+            u->cfg = all_convert_view( b->data, b->len, __webcfg.pool, __webcfg.decoded );
+        }
+        if( NULL != u->cfg ) {
+            u->cfg->view = b->view;
+            u->cfg->view_len = b->view_len;
+            u->cfg->view_release = __unmap;
+        } else {
+            munmap( b->view, b->view_len );
+        }
+    } else {
+        u->cfg = all_convert( b->data, b->len, __webcfg.pool, __webcfg.decoded );
+        if( b->owned ) {
+            free( b->data );
+        }
+    }
+
+    if( NULL == u->cfg ) {
+        return false;
+    }
+
+    __version( u->cfg, u->ver );
+
+    pthread_mutex_lock( &__webcfg.lock );
+    strcpy( __webcfg.cfg_ver, u->ver );
+    pthread_mutex_unlock( &__webcfg.lock );
+
+    return true;
+}
+
+/**
+ *  Applies a config's subsystems, then passes it to update_config(), & makes
+ *  it the current one if it is applied, keeping its image in the
+ *  durable_path.  If it is refused, checks go back to asking with the
+ *  version applied.
+ */
+static void __apply( update_t *u )
+{
+    struct webcfg_opts *o = &__webcfg.opts;
+    bool applied = false;
+    all_t *cfg;
+
+    /* The references to publish it with & to write its image once it is
+     * published. */
+    cfg = __share( u->cfg, 2 );
+    if( NULL != cfg ) {
+        applied = true;
+        if( __webcfg.each ) {
+            applied = __apply_each( cfg );
+        }
+
+        if( applied && (NULL != o->update_config) ) {
+            ((shared_t*) cfg)->refs++;
+            applied = (0 == (o->update_config)(cfg, o->user_data));
+        }
+
+        if( applied ) {
+            __make_current( cfg );
+
+            /* Written outside the publishing lock, so webcfg_update_actual()
+             * never waits on the file. */
+            if( NULL != __webcfg.snapshot ) {
+                snapshot_write( __webcfg.snapshot, cfg );
+            }
+        } else {
+            webcfg_release( cfg );
+        }
+        webcfg_release( cfg );
+    }
+
+    pthread_mutex_lock( &__webcfg.lock );
+    __webcfg.applied = applied;
+    if( applied ) {
+        strcpy( __webcfg.applied_ver, u->ver );
+    } else if( 0 == strcmp(__webcfg.cfg_ver, u->ver) ) {
+        strcpy( __webcfg.cfg_ver, __webcfg.applied_ver );
+    }
+    pthread_mutex_unlock( &__webcfg.lock );
+}
+
+/**
+ *  Provides the version of a config: the sha256 of its full envelope, in
+ *  hex.
+ */
+static void __version( const all_t *cfg, char ver[2 * 32 + 1] )
+{
+    int i;
+
+    for( i = 0; i < 32; i++ ) {
+        sprintf( &ver[2 * i], "%02x", cfg->full_envelope->sha256[i] );
+    }
+}
+
+/**
+ *  Applies each subsystem of a config on the pool & reports the results.
+ *
+ *  @return true if every subsystem was applied, false otherwise
+ */
+static bool __apply_each( const all_t *cfg )
+{
+    struct webcfg_opts *o = &__webcfg.opts;
+    apply_t a;
+    bool forget;
+    int i;
+
+    /* Whatever is in effect now, it is not what was last applied. */
+    pthread_mutex_lock( &__webcfg.lock );
+    forget = __webcfg.actual_changed;
+    __webcfg.actual_changed = false;
+    pthread_mutex_unlock( &__webcfg.lock );
+    for( i = 0; forget && (i < WEBCFG_SUBSYSTEMS); i++ ) {
+        __applied( i, NULL );
+    }
+
+    memset( &a, 0, sizeof(apply_t) );
+    a.cfg = cfg;
+    pthread_mutex_init( &a.lock, NULL );
+    pthread_cond_init( &a.done, NULL );
+
+    pool_run( __webcfg.pool, WEBCFG_SUBSYSTEMS, __apply_one, &a );
+
+    pthread_cond_destroy( &a.done );
+    pthread_mutex_destroy( &a.lock );
+
+    if( NULL != o->report ) {
+        (o->report)( a.results, o->user_data );
+    }
+
+    for( i = 0; i < WEBCFG_SUBSYSTEMS; i++ ) {
+        if( 0 != a.results[i] ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ *  Applies the i-th subsystem in order once those it is applied after are
+ *  done, or skips it if one of them failed.  The pool hands the jobs out in
+ *  order, so those are already running & this never waits for a job that
+ *  has no thread.  A subsystem the decoded cache returned unchanged since
+ *  it was last applied is not applied again.
+ */
+static void __apply_one( void *arg, size_t i )
+{
+    apply_t *a = (apply_t*) arg;
+    int s = __webcfg.order[i];
+    const struct webcfg_apply *w = &__webcfg.opts.apply[s];
+    void *data = __data( a->cfg, s );
+    bool skip = false;
+    int rv = 0;
+    int k;
+
+    pthread_mutex_lock( &a->lock );
+    while( w->after != (a->finished & w->after) ) {
+        pthread_cond_wait( &a->done, &a->lock );
+    }
+    for( k = 0; k < WEBCFG_SUBSYSTEMS; k++ ) {
+        if( (WEBCFG_BIT(k) & w->after) && (0 != a->results[k]) ) {
+            skip = true;
+        }
+    }
+    pthread_mutex_unlock( &a->lock );
+
+    if( skip ) {
+        rv = WEBCFG_SKIPPED;
+    } else if( (NULL != w->apply) && (NULL != data) && (data != __webcfg.applied_data[s]) ) {
+        rv = (w->apply)( a->cfg, __webcfg.opts.user_data );
+
+        /* After a failure it is unknown what is in effect. */
+        __applied( s, (0 == rv) ? data : NULL );
+    }
+
+    pthread_mutex_lock( &a->lock );
+    a->results[s] = rv;
+    a->finished |= WEBCFG_BIT( s );
+    pthread_cond_broadcast( &a->done );
+    pthread_mutex_unlock( &a->lock );
+}
+
+/**
+ *  Provides a subsystem of a config.
+ *
+ *  @return the subsystem, or NULL if the config does not have it
+ */
+static void* __data( const all_t *cfg, int s )
+{
+    switch( s ) {
+        case WEBCFG_DHCP:           return cfg->dhcp;
+        case WEBCFG_FIREWALL:       return cfg->firewall;
+        case WEBCFG_GRE:            return cfg->gre;
+        case WEBCFG_PORTMAPPING:    return cfg->portmapping;
+        case WEBCFG_WIFI:           return cfg->wifi;
+        case WEBCFG_XDNS:           return cfg->xdns;
+        default:                    break;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Records what a subsystem's apply last applied.  It is held in the
+ *  decoded cache, so the same pointer can't come back as anything else.
+ *
+ *  @param s    the subsystem
+ *  @param data the subsystem applied, NULL if unknown
+ */
+static void __applied( int s, void *data )
+{
+    if( NULL != __webcfg.applied_data[s] ) {
+        cache_release( __webcfg.decoded, (void*) __webcfg.applied_data[s] );
+    }
+    __webcfg.applied_data[s] = data;
+    if( NULL != data ) {
+        cache_retain( __webcfg.decoded, data );
+    }
+}
+
+/**
+ *  Orders the subsystems so each comes after those in its `after`.
+ *
+ *  @param o     the options with the `after`s
+ *  @param order the subsystems in order
+ *
+ *  @return 0 on success, -1 if the `after`s form a cycle or name unknown
+ *          subsystems
+ */
+static int __order( const struct webcfg_opts *o, uint8_t order[WEBCFG_SUBSYSTEMS] )
+{
+    uint32_t placed = 0;
+    size_t n = 0;
+    int s;
+
+    while( n < WEBCFG_SUBSYSTEMS ) {
+        size_t before = n;
+
+        for( s = 0; s < WEBCFG_SUBSYSTEMS; s++ ) {
+            uint32_t after = o->apply[s].after;
+
+            if( !(WEBCFG_BIT(s) & placed) && (after == (placed & after)) ) {
+                order[n++] = (uint8_t) s;
+                placed |= WEBCFG_BIT( s );
+            }
+        }
+
+        if( before == n ) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Moves a config webcfg is about to share into a shared_t with its count.
+ *
+ *  @param cfg  the config, which is released on failure
+ *  @param refs the references webcfg starts with
+ *
+ *  @return the shared config, or NULL if out of memory
+ */
+static all_t* __share( all_t *cfg, uint32_t refs )
+{
+    shared_t *p = (shared_t*) malloc( sizeof(shared_t) );
+
+    if( NULL == p ) {
+        all_destroy( cfg );
+        return NULL;
+    }
+
+    /* The members are the config's, only the structure itself moves. */
+    memcpy( &p->cfg, cfg, sizeof(all_t) );
+    free( cfg );
+    p->refs = refs;
+    p->prev = NULL;
+
+    pthread_mutex_lock( &__shared_lock );
+    p->next = __shared;
+    if( NULL != __shared ) {
+        __shared->prev = p;
+    }
+    __shared = p;
+    pthread_mutex_unlock( &__shared_lock );
+
+    return &p->cfg;
+}
+
+/**
+ *  Makes a config the current one, with the reference it is published with,
+ *  and releases the reference to the one it replaces.  Only one thread
+ *  publishes at a time: see __make_current().
+ *
+ *  @param cfg the config, or NULL to clear the current one
+ */
+static void __publish( all_t *cfg )
+{
+    uint32_t i = __webcfg.current_idx;
+    slot_t *old = &__webcfg.current[i];
+    all_t *prev;
+
+    __atomic_store_n( &__webcfg.current[1 - i].cfg, cfg, __ATOMIC_RELEASE );
+    __atomic_store_n( &__webcfg.current_idx, 1 - i, __ATOMIC_SEQ_CST );
+
+    /* Readers still pinning the old slot are about to take their reference,
+     * so wait for them before dropping the slot's. */
+    while( 0 < __atomic_load_n(&old->pins, __ATOMIC_SEQ_CST) ) {
+        sched_yield();
+    }
+
+    prev = old->cfg;
+    __atomic_store_n( &old->cfg, NULL, __ATOMIC_RELAXED );
+    webcfg_release( prev );
+}
+
+/**
+ *  Publishes a config that is in effect.  A config is made current by the
+ *  engine & by webcfg_update_actual(), one at a time.
+ *
+ *  @param cfg the config, with the reference it is published with
+ */
+static void __make_current( all_t *cfg )
+{
+    pthread_mutex_lock( &__webcfg.publishing );
+    __publish( cfg );
+    pthread_mutex_unlock( &__webcfg.publishing );
+}
+
+/**
+ *  Makes the image of the config last applied the current config, until a
+ *  check provides one.  It is not applied again: the first check still
+ *  passes the config to update_config().
+ */
+static void __restore( void )
+{
+    const snapshot_t *s;
+    all_t *cfg;
+
+    s = snapshot_map( __webcfg.snapshot );
+    if( NULL == s ) {
+        return;
+    }
+
+    cfg = snapshot_all( s );
+    if( NULL == cfg ) {
+        snapshot_unmap( s );
+        return;
+    }
+
+    cfg = __share( cfg, 1 );
+    if( NULL != cfg ) {
+        __publish( cfg );
+    }
+}
+
+/**
+ *  Releases a body that is not going to be decoded.
+ */
+static void __drop_body( body_t *b )
+{
+    envelope_destroy( b->env );
+    if( NULL != b->view ) {
+        munmap( b->view, b->view_len );
+    } else if( b->owned ) {
+        free( b->data );
+    }
+}
+
+/**
+ *  Releases a queued body_t or update_t that is not going to be used.
+ */
+static void __release_body( void *p )
+{
+    __drop_body( (body_t*) p );
+    free( p );
+}
+
+static void __release_update( void *p )
+{
+    all_destroy( ((update_t*) p)->cfg );
+    free( p );
+}
+
+/**
+ *  Starts the background engine: a fetcher that checks every
+ *  poll_interval_s, a decoder & an applier, each in its own thread.  The
+ *  stages hand over through queues that never block, so a slow
+ *  update_config() never holds back the next check.
+ *
+ *  @return 0 on success, error otherwise
+ */
+static int __engine_start( void )
+{
+    void* (*stages[3])( void* ) = { __fetcher, __decoder, __applier };
+    size_t i;
+
+    __webcfg.bodies = queue_create( QUEUE_DEPTH );
+    __webcfg.updates = queue_create( QUEUE_DEPTH );
+    if( (NULL == __webcfg.bodies) || (NULL == __webcfg.updates) ) {
+        return -1;
+    }
+
+    for( i = 0; i < 3; i++ ) {
+        if( 0 != pthread_create(&__webcfg.threads[i], NULL, stages[i], NULL) ) {
+            return -1;
+        }
+        __webcfg.threads_count++;
+    }
+
+    return 0;
+}
+
+/**
+ *  Stops the background engine, if it runs.  A check in progress is
+ *  abandoned within about a second, and whatever is queued is dropped.
+ */
+static void __engine_stop( void )
+{
+    size_t i;
+
+    if( !__webcfg.background ) {
+        return;
+    }
+
+    pthread_mutex_lock( &__webcfg.lock );
+    __webcfg.stop = true;
+    pthread_cond_broadcast( &__webcfg.wake );
+    pthread_mutex_unlock( &__webcfg.lock );
+
+    if( NULL != __webcfg.bodies ) {
+        queue_close( __webcfg.bodies );
+    }
+    if( NULL != __webcfg.updates ) {
+        queue_close( __webcfg.updates );
+    }
+
+    for( i = 0; i < __webcfg.threads_count; i++ ) {
+        pthread_join( __webcfg.threads[i], NULL );
+    }
+
+    queue_destroy( __webcfg.bodies, __release_body );
+    queue_destroy( __webcfg.updates, __release_update );
+}
+
+/**
+ *  The fetcher thread: checks at once, then every poll_interval_s or when
+ *  webcfg_sync() asks.
+ */
+static void* __fetcher( void *arg )
+{
+    struct timespec next;
+
+    (void) arg;
+
+    clock_gettime( CLOCK_MONOTONIC, &next );
+
+    pthread_mutex_lock( &__webcfg.lock );
+    while( true ) {
+        int rv = 0;
+
+        while( !__webcfg.stop && !__webcfg.check_now && (ETIMEDOUT != rv) ) {
+            rv = pthread_cond_timedwait( &__webcfg.wake, &__webcfg.lock, &next );
+        }
+        if( __webcfg.stop ) {
+            break;
+        }
+        __webcfg.check_now = false;
+        pthread_mutex_unlock( &__webcfg.lock );
+
+        __check();
+
+        clock_gettime( CLOCK_MONOTONIC, &next );
+        next.tv_sec += __webcfg.opts.poll_interval_s;
+        pthread_mutex_lock( &__webcfg.lock );
+    }
+    pthread_mutex_unlock( &__webcfg.lock );
+
+    return NULL;
+}
+
+/**
+ *  The decoder thread.
+ */
+static void* __decoder( void *arg )
+{
+    body_t *b;
+
+    (void) arg;
+
+    while( NULL != (b = (body_t*) queue_pop(__webcfg.bodies)) ) {
+        update_t *u = (update_t*) malloc( sizeof(update_t) );
+
+        if( NULL == u ) {
+            __drop_body( b );
+        } else if( __decode(b, u) ) {
+            u = (update_t*) queue_push( __webcfg.updates, u );
+            if( NULL != u ) {
+                __release_update( u );
+            }
+        } else {
+            free( u );
+        }
+        free( b );
+    }
+
+    return NULL;
+}
+
+/**
+ *  The applier thread.
+ */
+static void* __applier( void *arg )
+{
+    update_t *u;
+
+    (void) arg;
+
+    while( NULL != (u = (update_t*) queue_pop(__webcfg.updates)) ) {
+        __apply( u );
+        free( u );
+    }
+
+    return NULL;
+}
+
+/**
+ *  Abandons the engine's check once it is stopping.
+ */
+static int __stopping( void *user_data )
+{
+    bool stop;
+
+    (void) user_data;
+
+    pthread_mutex_lock( &__webcfg.lock );
+    stop = __webcfg.stop;
+    pthread_mutex_unlock( &__webcfg.lock );
+
+    return stop ? 1 : 0;
+}
+
+/**
+ *  Writes the next part of the body to the download & decodes it, or
+ *  empties it if the server sent the whole body instead of the rest.  A
+ *  body that is not an envelope is abandoned as soon as that is clear.
+ */
+static int __to_file( void *user_data, const void *buf, size_t len )
+{
+    const uint8_t *p = (const uint8_t*) buf;
+
+    (void) user_data;
+
+    if( NULL == buf ) {
+        __stream_start( 0 );
+        return ftruncate( __webcfg.fd, 0 );
+    }
+
+    if( (NULL != __webcfg.stream) && (0 != envelope_stream_write(__webcfg.stream, buf, len)) ) {
+        return -1;
+    }
+
+    while( 0 < len ) {
+        ssize_t n = write( __webcfg.fd, p, len );
+
+        if( n < 0 ) {
+            return -1;
+        }
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+/**
+ *  Starts decoding the download, from the part of it an earlier check left.
+ *  Without a decoder the download is decoded once it is complete instead.
+ *
+ *  The part already there is read back & hashed again rather than saving
+ *  the decoder with it: the cost is a read of the partial file per resume,
+ *  which is small next to downloading it again.
+ *
+ *  @param resumed the length of the download already there
+ */
+static void __stream_start( size_t resumed )
+{
+    uint8_t buf[4096];
+    size_t at = 0;
+
+    envelope_stream_destroy( __webcfg.stream );
+    __webcfg.stream = envelope_stream_create_view();
+
+    while( (NULL != __webcfg.stream) && (at < resumed) ) {
+        size_t want = (sizeof(buf) < resumed - at) ? sizeof(buf) : resumed - at;
+        ssize_t n = pread( __webcfg.fd, buf, want, (off_t) at );
+
+        if( (n <= 0) || (0 != envelope_stream_write(__webcfg.stream, buf, (size_t) n)) ) {
+            envelope_stream_destroy( __webcfg.stream );
+            __webcfg.stream = NULL;
+            break;
+        }
+        at += (size_t) n;
+    }
+}
+
+/**
+ *  Closes & removes the download, and maps it to be decoded in place if
+ *  the check succeeded.  With a durable_path the download is moved into
+ *  the cache instead of being removed.  The envelope decoded as it arrived
+ *  is verified first, so a body that is not valid is neither cached nor
+ *  decoded.
+ *
+ *  @param ok   true if the body is a new configuration
+ *  @param etag (optional) the ETag the body came with, if ok
+ *  @param b    the body, in the mapping, if ok
+ *
+ *  @return true if there is a body to decode
+ */
+static bool __from_file( bool ok, const char *etag, body_t *b )
+{
+    void *map = MAP_FAILED;
+    struct stat st;
+
+    if( ok && (0 == fstat(__webcfg.fd, &st)) && (0 < st.st_size) ) {
+        map = mmap( NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, __webcfg.fd, 0 );
+    }
+
+    if( (MAP_FAILED != map) && (NULL != __webcfg.stream) ) {
+        b->env = envelope_stream_finish_view( __webcfg.stream, map, (size_t) st.st_size );
+        if( NULL == b->env ) {
+            munmap( map, (size_t) st.st_size );
+            map = MAP_FAILED;
+        }
+    } else {
+        envelope_stream_destroy( __webcfg.stream );
+    }
+    __webcfg.stream = NULL;
+
+    /* The mapping keeps the data around without the file. */
+    close( __webcfg.fd );
+    __webcfg.fd = -1;
+    if( (MAP_FAILED != map) && (NULL != etag) && (NULL != __webcfg.cache) ) {
+        http_cache_store_file( __webcfg.cache, __webcfg.opts.url, etag, __webcfg.download );
+    }
+    unlink( __webcfg.download );
+    unlink( __webcfg.resume );
+
+    if( MAP_FAILED == map ) {
+        return false;
+    }
+
+    b->data = map;
+    b->len = (size_t) st.st_size;
+    b->view = map;
+    b->view_len = (size_t) st.st_size;
+
+    return true;
+}
+
+/**
+ *  Closes a download that was cut short & records what it needs to resume:
+ *  its length, the validator & the URL.  The download is dropped if that
+ *  can't be recorded.
+ *
+ *  @param etag the strong ETag the body came with
+ */
+static void __keep_partial( const char *etag )
+{
+    const char *url = __webcfg.opts.url;
+    resume_t r;
+    struct stat st;
+    bool kept = false;
+    int fd;
+
+    if( (0 == fstat(__webcfg.fd, &st)) && (0 < st.st_size) ) {
+        memset( &r, 0, sizeof(resume_t) );
+        memcpy( r.magic, RESUME_MAGIC, sizeof(r.magic) );
+        r.version = RESUME_VERSION;
+        r.etag_len = (uint32_t) strlen( etag );
+        r.url_len = (uint32_t) strlen( url );
+        r.received = (uint64_t) st.st_size;
+
+        fd = open( __webcfg.resume, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600 );
+        if( 0 <= fd ) {
+            kept = (sizeof(resume_t) == write(fd, &r, sizeof(resume_t))) &&
+                   ((ssize_t) r.etag_len == write(fd, etag, r.etag_len)) &&
+                   ((ssize_t) r.url_len == write(fd, url, r.url_len));
+            kept = (0 == close(fd)) && kept;
+        }
+    }
+
+    if( kept ) {
+        envelope_stream_destroy( __webcfg.stream );
+        __webcfg.stream = NULL;
+        close( __webcfg.fd );
+        __webcfg.fd = -1;
+    } else {
+        __from_file( false, NULL, NULL );
+    }
+}
+
+/**
+ *  Finds the partial download an earlier check left, if it is for the same
+ *  URL & still whole.  Anything else is removed.
+ *
+ *  @param etag set to the validator to resume with (to be freed), or NULL
+ *
+ *  @return the length of the partial download, 0 if there is none
+ */
+static size_t __resume_load( char **etag )
+{
+    const char *url = __webcfg.opts.url;
+    char buf[sizeof(resume_t) + 512];
+    resume_t r;
+    struct stat st;
+    ssize_t n;
+    int fd;
+
+    *etag = NULL;
+
+    fd = open( __webcfg.resume, O_RDONLY | O_CLOEXEC );
+    if( fd < 0 ) {
+        return 0;
+    }
+    n = read( fd, buf, sizeof(buf) );
+    close( fd );
+
+    if( (0 < n) && (sizeof(resume_t) <= (size_t) n) ) {
+        memcpy( &r, buf, sizeof(resume_t) );
+        if( (0 == memcmp(r.magic, RESUME_MAGIC, sizeof(r.magic))) &&
+            (RESUME_VERSION == r.version) &&
+            (0 < r.etag_len) &&
+            ((size_t) n == sizeof(resume_t) + r.etag_len + r.url_len) &&
+            (strlen(url) == r.url_len) &&
+            (0 == memcmp(url, &buf[sizeof(resume_t) + r.etag_len], r.url_len)) &&
+            (0 == stat(__webcfg.download, &st)) &&
+            (r.received == (uint64_t) st.st_size) )
+        {
+            *etag = strndup( &buf[sizeof(resume_t)], r.etag_len );
+            if( NULL != *etag ) {
+                return (size_t) r.received;
+            }
+        }
+    }
+
+    unlink( __webcfg.resume );
+    return 0;
+}
+
+/**
+ *  Provides dir/file.
+ *
+ *  @return the path (to be freed), or NULL on error
+ */
+static char* __path( const char *dir, const char *file )
+{
+    size_t len = strlen( dir ) + strlen( file ) + 2;
+    char *p;
+
+    p = (char*) malloc( len );
+    if( NULL != p ) {
+        snprintf( p, len, "%s/%s", dir, file );
+    }
+
+    return p;
+}
+
+/**
+ *  Releases the mapping of a download once its configuration is freed.
+ */
+static void __unmap( void *view, size_t len )
+{
+    munmap( view, len );
+}
+
+/**
+ *  Passes a socket to watch on to the caller's event loop.
+ */
+static void __watch( void *user_data, int fd, int events )
+{
+    int e = 0;
+
+    (void) user_data;
+
+    if( HTTP_EVENT_IN & events )  e |= WEBCFG_EVENT_IN;
+    if( HTTP_EVENT_OUT & events ) e |= WEBCFG_EVENT_OUT;
+
+    (__webcfg.opts.watch_fd)( fd, e, __webcfg.opts.user_data );
+}
+
+/**
+ *  Passes the timeout on to the caller's event loop.
+ */
+static void __timer( void *user_data, long timeout_ms )
+{
+    (void) user_data;
+
+    (__webcfg.opts.watch_timeout)( timeout_ms, __webcfg.opts.user_data );
+}
@@ -16,6 +16,7 @@
 #ifndef __WEBCFG_H__
 #define __WEBCFG_H__
 
+#include <limits.h>
 #include <stdint.h>
 
 #include "all.h"
@@ -23,7 +24,20 @@
 /*----------------------------------------------------------------------------*/
 /*                                   Macros                                   */
 /*----------------------------------------------------------------------------*/
-/* none */
+/* The socket events for watch_fd_fn & webcfg_process(). */
+#define WEBCFG_EVENT_IN     0x01
+#define WEBCFG_EVENT_OUT    0x02
+#define WEBCFG_EVENT_ERR    0x04
+
+/* The fd to pass to webcfg_process() when the timeout expires. */
+#define WEBCFG_TIMEOUT      -1
+
+/* The result reported for a subsystem that was not applied because one it
+ * is applied after failed. */
+#define WEBCFG_SKIPPED      INT_MIN
+
+/* The bit of a subsystem in webcfg_apply.after. */
+#define WEBCFG_BIT(s)       (1u << (s))
 
 /*----------------------------------------------------------------------------*/
 /*                               Data Structures                              */
@@ -33,7 +47,9 @@
  *  configuration to apply.
  *
  *  @note The memory given to the callback should be cleaned up via a call to
- *        webcfg_free().  Otherwise memory leaks will happen.
+ *        webcfg_free().  Otherwise memory leaks will happen.  The config is
+ *        shared: once the callback succeeds it is also the one returned by
+ *        webcfg_get_current(), so it must not be modified.
  *
  *  @param  new_cfg is the new configuration to apply
  *
@@ -41,6 +57,49 @@
  */
 typedef int (*update_config_fn)( const all_t *new_cfg, void *user_data );
 
+/* The subsystems that can be applied separately. */
+typedef enum {
+    WEBCFG_DHCP = 0,
+    WEBCFG_FIREWALL,
+    WEBCFG_GRE,
+    WEBCFG_PORTMAPPING,
+    WEBCFG_WIFI,
+    WEBCFG_XDNS,
+    WEBCFG_SUBSYSTEMS           /* The number of subsystems. */
+} webcfg_subsystem_t;
+
+/**
+ *  apply_fn is a pointer to the function to call to apply one subsystem of
+ *  a new configuration.  Subsystems that don't depend on each other are
+ *  applied at the same time, from different threads.
+ *
+ *  @note The config is shared & must not be modified or freed.
+ *
+ *  @param  cfg the new configuration, of which only the subsystem matters
+ *
+ *  @return 0 if the operation was a success, error otherwise
+ */
+typedef int (*apply_fn)( const all_t *cfg, void *user_data );
+
+/* How to apply a subsystem. */
+struct webcfg_apply {
+    apply_fn apply;             /* (optional) Called if the subsystem is in
+                                 * the config & changed since it was last
+                                 * applied. */
+    uint32_t after;             /* The WEBCFG_BIT()s of the subsystems that
+                                 * must be applied successfully first. */
+};
+
+/**
+ *  report_fn is a pointer to the function to call once every subsystem of a
+ *  config has been applied.
+ *
+ *  @param results the value each apply_fn returned by webcfg_subsystem_t:
+ *                 0 if it was not called (or the subsystem is unchanged),
+ *                 WEBCFG_SKIPPED if a subsystem it is applied after failed
+ */
+typedef void (*report_fn)( const int results[WEBCFG_SUBSYSTEMS], void *user_data );
+
 /**
  *  Called to get the authorization blob needed to connect.
  *
@@ -51,6 +110,25 @@ typedef int (*update_config_fn)( const all_t *new_cfg, void *user_data );
  */
 typedef char* (*get_auth_fn)( void *user_data );
 
+/**
+ *  Called in the non-blocking mode when a socket needs to be watched by the
+ *  caller's event loop (epoll, poll, etc).
+ *
+ *  @param fd     the socket
+ *  @param events the WEBCFG_EVENT_* to watch for, 0 to stop watching it
+ */
+typedef void (*watch_fd_fn)( int fd, int events, void *user_data );
+
+/**
+ *  Called in the non-blocking mode when webcfg_process() must be called
+ *  with WEBCFG_TIMEOUT after some time, even if no socket is ready.  The
+ *  timeout fires once and replaces any earlier one.
+ *
+ *  @param timeout_ms the time left in ms, 0 to call it right away, -1 to
+ *                    cancel the timeout
+ */
+typedef void (*watch_timeout_fn)( long timeout_ms, void *user_data );
+
 
 struct webcfg_opts {
     const char *url;
@@ -58,16 +136,46 @@ struct webcfg_opts {
     const char *ca_cert_path;
     const char *firmware;
 
-    const char *tmp_path;
-    const char *durable_path;
+    const char *tmp_path;       /* (optional) The directory to download into.
+                                 * The config is then decoded in place from a
+                                 * mapping of the file instead of the heap,
+                                 * and a download cut short is resumed by the
+                                 * next check instead of starting over. */
+    const char *durable_path;   /* (optional) The directory to keep the last
+                                 * config in.  Checks then ask the server
+                                 * for it by the ETag it was sent with, and
+                                 * after a restart the kept copy is applied
+                                 * as soon as the server confirms it is
+                                 * current, without downloading it again.
+                                 * Until then webcfg_get_current() provides
+                                 * the config last applied. */
 
     uint32_t boot_unixtime;
     uint32_t ready_unixtime;
 
+    uint32_t poll_interval_s;   /* (optional) Checks in the background every
+                                 * this many seconds.  Threads fetch, decode
+                                 * & call update_config() in turn, so a slow
+                                 * update_config() never delays a check.
+                                 * Can't be used with watch_fd. */
+
     void *user_data;
 
-    update_config_fn update_config;
+    update_config_fn update_config; /* (optional) If there is an apply. */
     get_auth_fn      get_auth;
+
+    /* (optional) Applies each subsystem with its own callback, on a pool of
+     * threads in the order the `after`s require, so a config takes as long
+     * as the slowest chain of subsystems to apply.  If they all succeed,
+     * update_config() is then called if it is set. */
+    struct webcfg_apply apply[WEBCFG_SUBSYSTEMS];
+    report_fn           report;
+
+    /* (optional) When both are set webcfg never blocks the caller.  The
+     * sockets & timeout are handed to the caller's event loop, which calls
+     * webcfg_process() when they fire. */
+    watch_fd_fn      watch_fd;
+    watch_timeout_fn watch_timeout;
 };
 
 /*----------------------------------------------------------------------------*/
@@ -85,7 +193,41 @@ int webcfg_init( struct webcfg_opts *opts );
 
 
 /**
- *  Shuts down and cleans up after the library.
+ *  Checks for a new configuration now, calling update_config() with it if
+ *  there is one.
+ *
+ *  In the non-blocking mode this only starts the check; the fetch, verify,
+ *  decode & update_config() all happen in webcfg_process() calls.
+ *  Otherwise this returns once the check is complete.
+ *
+ *  With a poll_interval_s this only asks the background engine to check
+ *  now, instead of waiting for the interval.
+ *
+ *  @return 0 if the operation was a success, error otherwise
+ */
+int webcfg_sync( void );
+
+
+/**
+ *  Makes progress on a check in the non-blocking mode.  Call this from the
+ *  event loop when a socket given to watch_fd() is ready or the timeout
+ *  given to watch_timeout() expires.
+ *
+ *  @note This must not be called from the watch_fd() or watch_timeout()
+ *        callbacks.
+ *
+ *  @param fd     the socket that is ready, or WEBCFG_TIMEOUT
+ *  @param events the WEBCFG_EVENT_* that happened on the socket
+ *
+ *  @return 0 if the operation was a success, error otherwise
+ */
+int webcfg_process( int fd, int events );
+
+
+/**
+ *  Shuts down and cleans up after the library.  A background check in
+ *  progress is abandoned, so this returns within about a second unless an
+ *  update_config() call is running.
  *
  *  @note the `user_data` is not freed.
  */
@@ -93,7 +235,36 @@ void webcfg_shutdown( void );
 
 
 /**
- *  Called with an update for the actual configuration present.
+ *  Provides a reference to the config last applied, without taking a lock
+ *  or copying it.  The config stays valid & unchanged until the reference is
+ *  released, even if a newer one is applied in the meantime; each version
+ *  is freed once its last reference is released.
+ *
+ *  @note This can be called from any thread between webcfg_init() and
+ *        webcfg_shutdown().
+ *
+ *  @return the config (to be released with webcfg_release()), or NULL if
+ *          none has been applied yet (or kept in the durable_path)
+ */
+const all_t* webcfg_get_current( void );
+
+
+/**
+ *  Releases a reference from webcfg_get_current() or update_config().
+ *
+ *  @param cfg the config to release
+ */
+void webcfg_release( const all_t *cfg );
+
+
+/**
+ *  Called with an update for the actual configuration present, when it is
+ *  not the one webcfg last applied (for example after it was changed
+ *  locally).  Checks then ask with its version, so the server sends the
+ *  config again if it differs, and every subsystem of the next config is
+ *  applied.  A config webcfg handed out (by update_config() or
+ *  webcfg_get_current()) also becomes the current config; webcfg takes its
+ *  own reference to it.
  *
  *  @param cfg the configuration applied
  *
@@ -103,8 +274,9 @@ int webcfg_update_actual( const all_t *cfg );
 
 
 /**
- *  webcfg_free frees and releases all the resources associated with the
- *  all_t structure.
+ *  webcfg_free releases a config webcfg handed out to update_config(); it
+ *  is the same as webcfg_release().  The config is freed with its last
+ *  reference.
  *
  *  @param cfg the config structure to free
  */
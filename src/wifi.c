@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "wifi.h"
@@ -37,16 +36,24 @@ enum {
     WIFI_MISSING_2G_CFG,
 };
 
+enum {
+    KEY_5G = 1,
+    KEY_2G
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __wifi_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "5GHz",   '5', 'G', 'z', KEY_5G ),
+    HELPER_KEY( "2.4GHz", '2', '.', 'z', KEY_2G ),
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_wifi_config( wifi_config_t *cfg, msgpack_object_map *map );
-int process_wifi( wifi_t *wifi, msgpack_object *obj );
+int process_wifi_config( wifi_config_t *cfg, cursor_t *c, const token_t *map );
+int process_wifi( wifi_t *wifi, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -56,7 +63,7 @@ int process_wifi( wifi_t *wifi, msgpack_object *obj );
 wifi_t* wifi_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(wifi_t), "wifi",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, NULL,
                            (process_fn_t) process_wifi,
                            (destroy_fn_t) wifi_destroy );
 }
@@ -64,9 +71,7 @@ wifi_t* wifi_convert( const void *buf, size_t len )
 /* See wifi.h for details. */
 void wifi_destroy( wifi_t *wifi )
 {
-    if( NULL != wifi ) {
-        free( wifi );
-    }
+    helper_free( wifi );
 }
 
 /* See wifi.h for details. */
@@ -98,9 +103,10 @@ const char* wifi_strerror( int errnum )
 /*                             Internal functions                             */
 /*----------------------------------------------------------------------------*/
 
-int process_wifi_config( wifi_config_t *cfg, msgpack_object_map *map )
+int process_wifi_config( wifi_config_t *cfg, cursor_t *c, const token_t *map )
 {
     (void) cfg;
+    (void) c;
     (void) map;
 
     return 0;
@@ -110,35 +116,44 @@ int process_wifi_config( wifi_config_t *cfg, msgpack_object_map *map )
  *  Convert the msgpack map into the wifi_t structure.
  *
  *  @param wifi wifi pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_wifi( wifi_t *wifi, msgpack_object *obj )
+int process_wifi( wifi_t *wifi, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x03;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_MAP == p->val.type ) {
-                if( 0 == match(p, "5GHz") ) {
-                    if( 0 != process_wifi_config(&wifi->config_5g, &p->val.via.map) ) {
+    token_t key, val;
+
+    (void) ctx;
+
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__wifi_keys, &key) ) {
+            case KEY_5G:
+                if( TOKEN_MAP == val.type ) {
+                    if( 0 != process_wifi_config(&wifi->config_5g, c, &val) ) {
                         return -1;
                     }
                     objects_left &= ~(1 << 0);
-                } else if( 0 == match(p, "2.4GHz") ) {
-                    if( 0 != process_wifi_config(&wifi->config_2g, &p->val.via.map) ) {
+                }
+                break;
+            case KEY_2G:
+                if( TOKEN_MAP == val.type ) {
+                    if( 0 != process_wifi_config(&wifi->config_2g, c, &val) ) {
                         return -1;
                     }
                     objects_left &= ~(1 << 1);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     if( 1 & objects_left ) {
@@ -15,7 +15,6 @@
  */
 #include <errno.h>
 #include <string.h>
-#include <msgpack.h>
 
 #include "helpers.h"
 #include "xdns.h"
@@ -39,15 +38,23 @@ enum {
     XDNS_MISSING_DEFAULT_IPV4,
 };
 
+enum {
+    KEY_DEFAULT_IPV6 = 1,
+    KEY_DEFAULT_IPV4
+};
+
 /*----------------------------------------------------------------------------*/
 /*                            File Scoped Variables                           */
 /*----------------------------------------------------------------------------*/
-/* none */
+static const helper_key_t __xdns_keys[HELPER_KEY_SLOTS] = {
+    HELPER_KEY( "default-ipv6", 'd', 'e', '6', KEY_DEFAULT_IPV6 ),
+    HELPER_KEY( "default-ipv4", 'd', 'e', '4', KEY_DEFAULT_IPV4 ),
+};
 
 /*----------------------------------------------------------------------------*/
 /*                             Function Prototypes                            */
 /*----------------------------------------------------------------------------*/
-int process_xdns( xdns_t *xdns, msgpack_object *obj );
+int process_xdns( xdns_t *xdns, cursor_t *c, const token_t *obj, helper_ctx_t *ctx );
 
 /*----------------------------------------------------------------------------*/
 /*                             External Functions                             */
@@ -57,7 +64,7 @@ int process_xdns( xdns_t *xdns, msgpack_object *obj );
 xdns_t* xdns_convert( const void *buf, size_t len )
 {
     return helper_convert( buf, len, sizeof(xdns_t), "xdns",
-                           MSGPACK_OBJECT_MAP, true,
+                           TOKEN_MAP, true, false, NULL,
                            (process_fn_t) process_xdns,
                            (destroy_fn_t) xdns_destroy );
 }
@@ -65,9 +72,7 @@ xdns_t* xdns_convert( const void *buf, size_t len )
 /* See xdns.h for details. */
 void xdns_destroy( xdns_t *xdns )
 {
-    if( NULL != xdns ) {
-        free( xdns );
-    }
+    helper_free( xdns );
 }
 
 /* See xdns.h for details. */
@@ -105,42 +110,49 @@ const char* xdns_strerror( int errnum )
  *  Convert the msgpack map into the xdns_t structure.
  *
  *  @param xdns xdns pointer
- *  @param map  the msgpack map pointer
+ *  @param c    the cursor at the map entries
+ *  @param obj  the map
+ *  @param ctx  the decode context
  *
  *  @return 0 on success, error otherwise
  */
-int process_xdns( xdns_t *xdns, msgpack_object *obj )
+int process_xdns( xdns_t *xdns, cursor_t *c, const token_t *obj, helper_ctx_t *ctx )
 {
-    msgpack_object_map *map = &obj->via.map;
-    int left = map->size;
+    uint32_t left = obj->size;
     uint8_t objects_left = 0x03;
-    msgpack_object_kv *p;
-
-    p = map->ptr;
-    while( (0 < objects_left) && (0 < left--) ) {
-        if( MSGPACK_OBJECT_STR == p->key.type ) {
-            if( MSGPACK_OBJECT_BIN == p->val.type ) {
-                if( 0 == match(p, "default-ipv6") ) {
-                    if( 16 == p->val.via.bin.size ) {
-                        memcpy( &xdns->default_ipv6, p->val.via.bin.ptr, 16 );
+    token_t key, val;
+
+    (void) ctx;
+
+    while( (0 < objects_left) && (0 < left) ) {
+        left--;
+        cursor_next( c, &key );
+        cursor_next( c, &val );
+        switch( helper_key(__xdns_keys, &key) ) {
+            case KEY_DEFAULT_IPV6:
+                if( TOKEN_BIN == val.type ) {
+                    if( 16 == val.size ) {
+                        memcpy( &xdns->default_ipv6, val.ptr, 16 );
                         objects_left &= ~(1 << 0);
                     } else {
                         errno = XDNS_INVALID_DEFAULT_IPV6;
                         return -1;
                     }
                 }
-            } else if( MSGPACK_OBJECT_POSITIVE_INTEGER == p->val.type ) {
-                if( 0 == match(p, "default-ipv4") ) {
-                    if( UINT32_MAX < p->val.via.u64 ) {
+                break;
+            case KEY_DEFAULT_IPV4:
+                if( TOKEN_POSITIVE_INTEGER == val.type ) {
+                    if( UINT32_MAX < val.via.u64 ) {
                         errno = XDNS_INVALID_DEFAULT_IPV4;
                         return -1;
                     }
-                    xdns->default_ipv4 = (uint32_t) p->val.via.u64;
+                    xdns->default_ipv4 = (uint32_t) val.via.u64;
                     objects_left &= ~(1 << 1);
                 }
-            }
+                break;
+            default:
+                break;
         }
-        p++;
     }
 
     if( 1 & objects_left ) {
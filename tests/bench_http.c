@@ -0,0 +1,203 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+/* Measures collecting response bodies of 1KB to 16MB from a loopback server:
+ * with & without a Content-Length, into a reused caller buffer, and with a
+ * realloc() per chunk as http_request() used to do.
+ *
+ * Usage: bench_http [iterations]
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "../src/http.h"
+#include "loopback.h"
+
+typedef struct {
+    loopback_t l;
+    char *body;
+} server_t;
+
+typedef struct {
+    size_t len;
+    void *data;
+} chunks_t;
+
+static double now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+/* Answers /size/N with N bytes & /close/N with N bytes without a
+ * Content-Length, one connection at a time. */
+static void serve( void *user_data, int c )
+{
+    server_t *s = (server_t*) user_data;
+    loopback_request_t r;
+
+    r.got = 0;
+    r.len = 0;
+    while( 0 < loopback_recv(c, &r) ) {
+        char head[128], path[256];
+        size_t size;
+        bool no_length;
+        int len;
+
+        if( 1 != sscanf(r.buf, "GET %255s ", path) ) {
+            break;
+        }
+        no_length = ('c' == path[1]);
+        size = strtoul( strchr(&path[1], '/') + 1, NULL, 10 );
+
+        if( no_length ) {
+            len = snprintf( head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" );
+        } else {
+            len = snprintf( head, sizeof(head),
+                            "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", size );
+        }
+        send( c, head, len, MSG_NOSIGNAL );
+        send( c, s->body, size, MSG_NOSIGNAL );
+        if( no_length ) {
+            break;
+        }
+    }
+}
+
+static int server_start( server_t *s, size_t max )
+{
+    s->body = (char*) malloc( max );
+    if( NULL == s->body ) {
+        return -1;
+    }
+    memset( s->body, 'x', max );
+
+    return loopback_start( &s->l, false, serve, s );
+}
+
+static void server_stop( server_t *s )
+{
+    loopback_stop( &s->l );
+    free( s->body );
+}
+
+/* The old way: grow the body by exactly each chunk. */
+static int per_chunk( void *user_data, const void *buf, size_t len )
+{
+    chunks_t *c = (chunks_t*) user_data;
+    void *tmp;
+
+    tmp = realloc( c->data, c->len + len );
+    if( NULL == tmp ) {
+        return -1;
+    }
+    c->data = tmp;
+    memcpy( &((uint8_t*) c->data)[c->len], buf, len );
+    c->len += len;
+
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    const size_t sizes[] = { 1 << 10, 16 << 10, 256 << 10, 1 << 20, 4 << 20, 16 << 20 };
+    int iterations = (1 < argc) ? atoi( argv[1] ) : 20;
+    http_request_t req = {
+        .cfg_ver    = "v1",
+        .schema_ver = "v1",
+        .fw         = "fw",
+        .status     = "bench",
+        .trans_id   = "1",
+        .timeout_s  = 30,
+    };
+    http_client_t *client;
+    server_t server;
+    void *reused = NULL;
+    size_t reused_size = 0;
+    size_t i;
+
+    if( 0 != server_start(&server, sizes[sizeof(sizes) / sizeof(sizes[0]) - 1]) ) {
+        return 1;
+    }
+    client = http_client_create();
+    if( NULL == client ) {
+        return 1;
+    }
+    req.client = client;
+
+    printf( "%10s %14s %14s %14s %14s\n", "size", "per chunk", "no length",
+            "content-len", "reused buf" );
+
+    for( i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++ ) {
+        char url[2][96];
+        double t[4];
+        int mode, n;
+
+        snprintf( url[0], sizeof(url[0]), "http://127.0.0.1:%d/size/%zu", server.l.port, sizes[i] );
+        snprintf( url[1], sizeof(url[1]), "http://127.0.0.1:%d/close/%zu", server.l.port, sizes[i] );
+
+        for( mode = 0; mode < 4; mode++ ) {
+            double start = now();
+
+            for( n = 0; n < iterations; n++ ) {
+                http_response_t resp;
+                chunks_t chunks = { .len = 0, .data = NULL };
+
+                req.url = (1 == mode) ? url[1] : url[0];
+                req.write_fn = (0 == mode) ? per_chunk : NULL;
+                req.write_data = &chunks;
+                req.body_buf = (3 == mode) ? reused : NULL;
+                req.body_buf_size = (3 == mode) ? reused_size : 0;
+
+                if( 0 != http_request(&req, &resp) ) {
+                    return 1;
+                }
+
+                /* Keep the buffer the body outgrew, as webcfg does. */
+                if( (3 == mode) && (NULL != resp.data) && (resp.data != resp.body_buf) ) {
+                    free( reused );
+                    reused = resp.data;
+                    reused_size = resp.size;
+                    resp.data = NULL;
+                }
+                http_destroy( &resp );
+                free( chunks.data );
+            }
+
+            t[mode] = (now() - start) / iterations;
+        }
+
+        printf( "%10zu", sizes[i] );
+        for( mode = 0; mode < 4; mode++ ) {
+            printf( " %9.1f MB/s", (double) sizes[i] / (1 << 20) / t[mode] );
+        }
+        printf( "\n" );
+    }
+
+    free( reused );
+    http_client_destroy( client );
+    server_stop( &server );
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+/* Compares the accelerated SHA-256 against the portable implementation.
+ *
+ * Usage: bench_sha256 [megabytes]
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/sha256.h"
+
+static double now( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static double run( bool accel, const uint8_t *buf, size_t len, uint8_t *digest )
+{
+    double start = now();
+    sha256_t s;
+
+    if( accel ) {
+        sha256_init( &s );
+    } else {
+        sha256_init_portable( &s );
+    }
+    sha256_update( &s, buf, len );
+    sha256_final( &s, digest );
+
+    return now() - start;
+}
+
+int main( int argc, char *argv[] )
+{
+    size_t mb = (1 < argc) ? (size_t) atoi( argv[1] ) : 64;
+    size_t len = mb << 20;
+    uint8_t a[SHA256_SIZE], p[SHA256_SIZE];
+    double ta, tp;
+    uint8_t *buf;
+    size_t i;
+
+    buf = (uint8_t*) malloc( len );
+    if( NULL == buf ) {
+        return 1;
+    }
+    for( i = 0; i < len; i++ ) {
+        buf[i] = (uint8_t) (i * 131);
+    }
+
+    tp = run( false, buf, len, p );
+    ta = run( true, buf, len, a );
+
+    printf( "%zu MB\n", mb );
+    printf( "portable:    %8.1f MB/s\n", (double) mb / tp );
+    printf( "accelerated: %8.1f MB/s (%s)\n", (double) mb / ta,
+            sha256_accelerated() ? "SHA instructions" : "not available" );
+    printf( "speedup:     %8.2fx\n", tp / ta );
+
+    free( buf );
+
+    return (0 == memcmp(a, p, SHA256_SIZE)) ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+/**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "loopback.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    loopback_t *l;
+    int fd;
+} conn_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void* __conn_run( void *arg );
+static void* __server_run( void *arg );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See loopback.h for details. */
+int loopback_start( loopback_t *l, bool threaded,
+                    loopback_serve_fn_t serve, void *user_data )
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    memset( l, 0, sizeof(loopback_t) );
+    l->threaded = threaded;
+    l->serve = serve;
+    l->user_data = user_data;
+    pthread_mutex_init( &l->lock, NULL );
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+    l->fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if( (l->fd < 0) ||
+        (0 != bind(l->fd, (struct sockaddr*) &addr, sizeof(addr))) ||
+        (0 != listen(l->fd, 64)) ||
+        (0 != getsockname(l->fd, (struct sockaddr*) &addr, &len)) )
+    {
+        return -1;
+    }
+    l->port = ntohs( addr.sin_port );
+
+    return pthread_create( &l->thread, NULL, __server_run, l );
+}
+
+/* See loopback.h for details. */
+void loopback_stop( loopback_t *l )
+{
+    int active;
+
+    shutdown( l->fd, SHUT_RDWR );
+    pthread_join( l->thread, NULL );
+    close( l->fd );
+
+    do {
+        pthread_mutex_lock( &l->lock );
+        active = l->active;
+        pthread_mutex_unlock( &l->lock );
+        if( 0 < active ) {
+            usleep( 1000 );
+        }
+    } while( 0 < active );
+    pthread_mutex_destroy( &l->lock );
+}
+
+/* See loopback.h for details. */
+size_t loopback_recv( int fd, loopback_request_t *r )
+{
+    char *end;
+    ssize_t n;
+
+    /* Keep anything after the last request for this one. */
+    if( 0 < r->len ) {
+        r->got -= r->len;
+        memmove( r->buf, &r->buf[r->len], r->got );
+        r->len = 0;
+    }
+
+    r->buf[r->got] = '\0';
+    while( NULL == (end = strstr(r->buf, "\r\n\r\n")) ) {
+        if( r->got == sizeof(r->buf) - 1 ) {
+            return 0;
+        }
+        n = recv( fd, &r->buf[r->got], sizeof(r->buf) - 1 - r->got, 0 );
+        if( n <= 0 ) {
+            return 0;
+        }
+        r->got += n;
+        r->buf[r->got] = '\0';
+    }
+
+    end[2] = '\0';
+    r->len = (end + 4) - r->buf;
+
+    return r->len;
+}
+
+/* See loopback.h for details. */
+bool loopback_header( const char *head, const char *name, char *value, size_t size )
+{
+    const char *p = strstr( head, name );
+    const char *end;
+
+    if( NULL == p ) {
+        return false;
+    }
+    p += strlen( name );
+    end = strstr( p, "\r\n" );
+    snprintf( value, size, "%.*s", (int) ((NULL != end) ? (size_t) (end - p) : strlen(p)), p );
+
+    return true;
+}
+
+/* See loopback.h for details. */
+int remove_dir( const char *dir )
+{
+    struct dirent *d;
+    char path[512];
+    int count = 0;
+    DIR *p;
+
+    p = opendir( dir );
+    if( NULL == p ) {
+        return -1;
+    }
+    while( NULL != (d = readdir(p)) ) {
+        if( '.' != d->d_name[0] ) {
+            snprintf( path, sizeof(path), "%s/%s", dir, d->d_name );
+            if( 0 != unlink(path) ) {
+                count = -1;
+            } else if( 0 <= count ) {
+                count++;
+            }
+        }
+    }
+    closedir( p );
+
+    if( 0 != rmdir(dir) ) {
+        return -1;
+    }
+
+    return count;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+static void* __conn_run( void *arg )
+{
+    conn_t *conn = (conn_t*) arg;
+    loopback_t *l = conn->l;
+    int one = 1;
+
+    /* The head & body are often sent separately, don't hold the body back. */
+    setsockopt( conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one) );
+
+    (l->serve)( l->user_data, conn->fd );
+
+    close( conn->fd );
+    pthread_mutex_lock( &l->lock );
+    l->active--;
+    pthread_mutex_unlock( &l->lock );
+    free( conn );
+
+    return NULL;
+}
+
+static void* __server_run( void *arg )
+{
+    loopback_t *l = (loopback_t*) arg;
+    int fd;
+
+    while( 0 <= (fd = accept(l->fd, NULL, NULL)) ) {
+        conn_t *conn = (conn_t*) malloc( sizeof(conn_t) );
+
+        conn->l = l;
+        conn->fd = fd;
+
+        pthread_mutex_lock( &l->lock );
+        l->connections++;
+        l->active++;
+        pthread_mutex_unlock( &l->lock );
+
+        if( l->threaded ) {
+            pthread_t t;
+
+            pthread_create( &t, NULL, __conn_run, conn );
+            pthread_detach( t );
+        } else {
+            __conn_run( conn );
+        }
+    }
+
+    return NULL;
+}
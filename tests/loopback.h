@@ -0,0 +1,97 @@
+/**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#ifndef __TEST_LOOPBACK_H__
+#define __TEST_LOOPBACK_H__
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* Serves the requests of one connection; the connection is closed after. */
+typedef void (*loopback_serve_fn_t)( void *user_data, int fd );
+
+/* An HTTP server on the loopback the tests point their urls at. */
+typedef struct {
+    int fd;
+    int port;
+    bool threaded;              /* Each connection is served by its own
+                                 * thread, otherwise one at a time. */
+    loopback_serve_fn_t serve;
+    void *user_data;
+    pthread_mutex_t lock;
+    int connections;            /* Accepted so far. */
+    int active;                 /* Still open. */
+    pthread_t thread;
+} loopback_t;
+
+/* The requests read from a connection. */
+typedef struct {
+    char buf[4096];
+    size_t got;                 /* The bytes in buf. */
+    size_t len;                 /* The length of the current request head. */
+} loopback_request_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  This function starts the server on an unused loopback port.
+ *
+ *  @return 0 on success, error otherwise
+ */
+int loopback_start( loopback_t *l, bool threaded,
+                    loopback_serve_fn_t serve, void *user_data );
+
+/**
+ *  This function stops the server, waiting for the connections still open
+ *  to close.  The clients must have closed theirs first.
+ */
+void loopback_stop( loopback_t *l );
+
+/**
+ *  This function reads the head of the next request into r->buf, keeping
+ *  anything after the previous one.  The head is '\0' terminated after its
+ *  last header line.
+ *
+ *  @return the length of the head, or 0 if the connection was closed or the
+ *          head doesn't fit
+ */
+size_t loopback_recv( int fd, loopback_request_t *r );
+
+/**
+ *  This function copies the value of a request header, if it has one.
+ *
+ *  @param head the request head from loopback_recv()
+ *  @param name the header name, with the "\r\n" before it & the ": " after
+ *
+ *  @return true if found, false otherwise
+ */
+bool loopback_header( const char *head, const char *name, char *value, size_t size );
+
+/**
+ *  This function removes a directory & the files in it.
+ *
+ *  @return the number of files removed, or -1 if any could not be
+ */
+int remove_dir( const char *dir );
+
+#endif
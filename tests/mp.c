@@ -0,0 +1,169 @@
+/**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "mp.h"
+
+/*----------------------------------------------------------------------------*/
+/*                             Function Prototypes                            */
+/*----------------------------------------------------------------------------*/
+static void __byte( mp_t *mp, uint8_t b );
+static void __be( mp_t *mp, uint8_t type, uint64_t v, size_t bytes );
+static void __header( mp_t *mp, uint8_t fix, uint8_t fix_max, uint8_t type16, size_t count );
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/* See mp.h for details. */
+void mp_put( mp_t *mp, const void *p, size_t len )
+{
+    if( mp->size < mp->len + len ) {
+        size_t size = (0 < mp->size) ? mp->size : 256;
+
+        while( size < mp->len + len ) {
+            size *= 2;
+        }
+        mp->buf = (uint8_t*) realloc( mp->buf, size );
+        CU_ASSERT_FATAL( NULL != mp->buf );
+        mp->size = size;
+    }
+
+    memcpy( &mp->buf[mp->len], p, len );
+    mp->len += len;
+}
+
+/* See mp.h for details. */
+void mp_map( mp_t *mp, size_t count )
+{
+    __header( mp, 0x80, 15, 0xde, count );
+}
+
+/* See mp.h for details. */
+void mp_array( mp_t *mp, size_t count )
+{
+    __header( mp, 0x90, 15, 0xdc, count );
+}
+
+/* See mp.h for details. */
+void mp_str( mp_t *mp, const char *s )
+{
+    size_t len = strlen( s );
+
+    if( len < 32 ) {
+        __byte( mp, (uint8_t) (0xa0 | len) );
+    } else {
+        __be( mp, 0xd9, len, 1 );
+    }
+    mp_put( mp, s, len );
+}
+
+/* See mp.h for details. */
+void mp_uint( mp_t *mp, uint64_t v )
+{
+    if( v < 0x80 ) {
+        __byte( mp, (uint8_t) v );
+    } else if( v <= UINT8_MAX ) {
+        __be( mp, 0xcc, v, 1 );
+    } else if( v <= UINT16_MAX ) {
+        __be( mp, 0xcd, v, 2 );
+    } else if( v <= UINT32_MAX ) {
+        __be( mp, 0xce, v, 4 );
+    } else {
+        __be( mp, 0xcf, v, 8 );
+    }
+}
+
+/* See mp.h for details. */
+void mp_bin( mp_t *mp, const void *p, size_t len )
+{
+    if( len <= UINT8_MAX ) {
+        __be( mp, 0xc4, len, 1 );
+    } else if( len <= UINT16_MAX ) {
+        __be( mp, 0xc5, len, 2 );
+    } else {
+        __be( mp, 0xc6, len, 4 );
+    }
+    mp_put( mp, p, len );
+}
+
+/* See mp.h for details. */
+void mp_envelope( mp_t *mp, const char *base, const void *payload, size_t len,
+                  const uint8_t digest[SHA256_SIZE] )
+{
+    mp_map( mp, 3 );
+    mp_str( mp, "schema" );
+    mp_map( mp, 4 );
+    mp_str( mp, "base" );
+    mp_str( mp, base );
+    mp_str( mp, "major" );
+    mp_uint( mp, 1 );
+    mp_str( mp, "minor" );
+    mp_uint( mp, 0 );
+    mp_str( mp, "patch" );
+    mp_uint( mp, 0 );
+    mp_str( mp, "sha256" );
+    mp_bin( mp, digest, SHA256_SIZE );
+    mp_str( mp, "payload" );
+    mp_bin( mp, payload, len );
+}
+
+/* See mp.h for details. */
+void mp_free( mp_t *mp )
+{
+    free( mp->buf );
+    mp->buf = NULL;
+    mp->len = 0;
+    mp->size = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             Internal functions                             */
+/*----------------------------------------------------------------------------*/
+
+static void __byte( mp_t *mp, uint8_t b )
+{
+    mp_put( mp, &b, 1 );
+}
+
+/**
+ *  Appends a type byte followed by a big endian value.
+ */
+static void __be( mp_t *mp, uint8_t type, uint64_t v, size_t bytes )
+{
+    __byte( mp, type );
+    while( 0 < bytes-- ) {
+        __byte( mp, (uint8_t) (v >> (8 * bytes)) );
+    }
+}
+
+/**
+ *  Appends the header of a map or an array: the fix form if the count is
+ *  small enough, otherwise the 16 or 32 bit form.
+ */
+static void __header( mp_t *mp, uint8_t fix, uint8_t fix_max, uint8_t type16, size_t count )
+{
+    if( count <= fix_max ) {
+        __byte( mp, (uint8_t) (fix | count) );
+    } else if( count <= UINT16_MAX ) {
+        __be( mp, type16, count, 2 );
+    } else {
+        __be( mp, type16 + 1, count, 4 );
+    }
+}
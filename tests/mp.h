@@ -0,0 +1,64 @@
+/**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#ifndef __TEST_MP_H__
+#define __TEST_MP_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../src/sha256.h"
+
+/*----------------------------------------------------------------------------*/
+/*                               Data Structures                              */
+/*----------------------------------------------------------------------------*/
+
+/* A msgpack buffer the tests build their input in; it grows as needed. */
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+    size_t size;
+} mp_t;
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+
+/**
+ *  These functions append a msgpack element to the buffer, each in the
+ *  smallest encoding that holds it.  Maps & arrays are followed by their
+ *  count (or twice that) elements.
+ */
+void mp_put( mp_t *mp, const void *p, size_t len );
+void mp_map( mp_t *mp, size_t count );
+void mp_array( mp_t *mp, size_t count );
+void mp_str( mp_t *mp, const char *s );
+void mp_uint( mp_t *mp, uint64_t v );
+void mp_bin( mp_t *mp, const void *p, size_t len );
+
+/**
+ *  This function appends an envelope holding the payload with the given
+ *  sha256, version 1.0.0 of the base schema.
+ */
+void mp_envelope( mp_t *mp, const char *base, const void *payload, size_t len,
+                  const uint8_t digest[SHA256_SIZE] );
+
+/**
+ *  This function releases the buffer, leaving it empty.
+ */
+void mp_free( mp_t *mp );
+
+#endif
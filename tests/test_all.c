@@ -0,0 +1,385 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/all.h"
+#include "../src/sha256.h"
+#include "mp.h"
+
+static const uint8_t dhcp[] = {
+    0x81,
+        0xa4, 'd', 'h', 'c', 'p',
+            0x85,
+                0xa9, 'r', 'o', 'u', 't', 'e', 'r', '-', 'i', 'p',
+                    0xce, 0xc0, 0xa8, 0x00, 0x01,
+                0xab, 's', 'u', 'b', 'n', 'e', 't', '-', 'm', 'a', 's', 'k',
+                    0xce, 0xff, 0xff, 0xff, 0x00,
+                0xac, 'l', 'e', 'a', 's', 'e', '-', 'l', 'e', 'n', 'g', 't', 'h',
+                    0xcd, 0x0c, 0x80,
+                0xaa, 'p', 'o', 'o', 'l', '-', 'r', 'a', 'n', 'g', 'e',
+                    0x92,
+                        0xce, 0xc0, 0xa8, 0x00, 0x02,
+                        0xce, 0xc0, 0xa8, 0x00, 0x64,
+                0xa6, 's', 't', 'a', 't', 'i', 'c',
+                    0x90,
+};
+
+static const uint8_t xdns[] = {
+    0x81,
+        0xa4, 'x', 'd', 'n', 's',
+            0x82,
+                0xac, 'd', 'e', 'f', 'a', 'u', 'l', 't', '-', 'i', 'p', 'v', '4',
+                    0xce, 0x4c, 0x4c, 0x4c, 0x4c,
+                0xac, 'd', 'e', 'f', 'a', 'u', 'l', 't', '-', 'i', 'p', 'v', '6',
+                    0xc4, 0x10, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+};
+
+static const uint8_t not_dhcp[] = { 0x81, 0xa4, 'd', 'h', 'c', 'p', 0x80 };
+
+/* Appends an envelope of the payload, with the wrong sha256 if bad. */
+static void put_envelope( mp_t *mp, const char *base, const void *payload, size_t len, bool bad )
+{
+    uint8_t digest[SHA256_SIZE];
+
+    sha256( payload, len, digest );
+    if( bad ) {
+        digest[0] ^= 1;
+    }
+    mp_envelope( mp, base, payload, len, digest );
+}
+
+/* Builds a full envelope with dhcp, xdns & others subsystems of another
+ * kind.  The subsystem at bad (if any) has the wrong sha256. */
+static void build( mp_t *out, size_t others, int bad, bool twice )
+{
+    mp_t full = { NULL, 0, 0 }, sub = { NULL, 0, 0 };
+    size_t count = 2 + others + (twice ? 1 : 0);
+    size_t i;
+
+    mp_map( &full, 1 );
+    mp_str( &full, "full" );
+    mp_map( &full, 1 );
+    mp_str( &full, "subsystems" );
+    mp_array( &full, count );
+    for( i = 0; i < count; i++ ) {
+        sub.len = 0;
+        if( (0 == i) || (twice && (count - 1 == i)) ) {
+            put_envelope( &sub, "dhcp", dhcp, sizeof(dhcp), (int) i == bad );
+        } else if( 1 == i ) {
+            put_envelope( &sub, "xdns", xdns, sizeof(xdns), (int) i == bad );
+        } else {
+            put_envelope( &sub, "other", &i, sizeof(i), (int) i == bad );
+        }
+
+        mp_map( &full, 2 );
+        mp_str( &full, "url" );
+        mp_str( &full, "http://example.com/sub" );
+        mp_str( &full, "payload" );
+        mp_bin( &full, sub.buf, sub.len );
+    }
+
+    out->len = 0;
+    put_envelope( out, "full", full.buf, full.len, false );
+    mp_free( &full );
+    mp_free( &sub );
+}
+
+static void check( const mp_t *mp, pool_t *pool )
+{
+    all_t *all;
+
+    all = all_convert( mp->buf, mp->len, pool, NULL );
+    CU_ASSERT_FATAL( NULL != all );
+    CU_ASSERT_FATAL( NULL != all->full_envelope );
+    CU_ASSERT_STRING_EQUAL( "full", all->full_envelope->schema.base );
+
+    CU_ASSERT_FATAL( NULL != all->dhcp_envelope );
+    CU_ASSERT_STRING_EQUAL( "dhcp", all->dhcp_envelope->schema.base );
+    CU_ASSERT_FATAL( NULL != all->dhcp );
+    CU_ASSERT( 0xc0a80001 == all->dhcp->router_ip );
+    CU_ASSERT( 0xc0a80064 == all->dhcp->pool_range[1] );
+
+    CU_ASSERT_FATAL( NULL != all->xdns );
+    CU_ASSERT( 0x4c4c4c4c == all->xdns->default_ipv4 );
+
+    CU_ASSERT( NULL == all->firewall_envelope );
+    CU_ASSERT( NULL == all->firewall );
+    CU_ASSERT( NULL == all->wifi );
+
+    all_destroy( all );
+}
+
+void test_convert()
+{
+    mp_t mp = { NULL, 0, 0 };
+    pool_t *pool;
+    int i;
+
+    build( &mp, 0, -1, false );
+    check( &mp, NULL );
+
+    pool = pool_create( 3 );
+    CU_ASSERT_FATAL( NULL != pool );
+    check( &mp, pool );
+
+    build( &mp, 60, -1, false );
+    for( i = 0; i < 20; i++ ) {
+        check( &mp, pool );
+    }
+    check( &mp, NULL );
+    pool_destroy( pool );
+    mp_free( &mp );
+
+    all_destroy( NULL );
+}
+
+void test_errors()
+{
+    mp_t mp = { NULL, 0, 0 }, sub = { NULL, 0, 0 }, full = { NULL, 0, 0 };
+    pool_t *pool;
+    int err;
+
+    pool = pool_create( 2 );
+    CU_ASSERT_FATAL( NULL != pool );
+
+    /* Any failed subsystem fails the whole, even those that are ignored. */
+    build( &mp, 10, 0, false );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid subsystem.", all_strerror(err) );
+
+    build( &mp, 10, 7, false );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid subsystem.", all_strerror(err) );
+
+    build( &mp, 10, -1, true );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Duplicate subsystem.", all_strerror(err) );
+
+    /* A payload that is not what the schema says. */
+    sub.len = 0;
+    put_envelope( &sub, "dhcp", not_dhcp, sizeof(not_dhcp), false );
+    full.len = 0;
+    mp_map( &full, 1 );
+    mp_str( &full, "full" );
+    mp_map( &full, 1 );
+    mp_str( &full, "subsystems" );
+    mp_array( &full, 1 );
+    mp_map( &full, 2 );
+    mp_str( &full, "url" );
+    mp_str( &full, "u" );
+    mp_str( &full, "payload" );
+    mp_bin( &full, sub.buf, sub.len );
+    mp.len = 0;
+    put_envelope( &mp, "full", full.buf, full.len, false );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid subsystem.", all_strerror(err) );
+
+    mp.len = 0;
+    put_envelope( &mp, "full", "\xc0", 1, false );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid 'full' payload.", all_strerror(err) );
+
+    mp.len = 0;
+    put_envelope( &mp, "full", "\x80", 1, true );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, NULL) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid envelope.", all_strerror(err) );
+
+    pool_destroy( pool );
+    mp_free( &mp );
+    mp_free( &sub );
+    mp_free( &full );
+
+    CU_ASSERT_STRING_EQUAL( "Unknown error.", all_strerror(-1) );
+}
+
+static int released;
+
+static void release( void *view, size_t len )
+{
+    CU_ASSERT( 0 < len );
+    released++;
+    free( view );
+}
+
+void test_view()
+{
+    mp_t mp = { NULL, 0, 0 };
+    uint8_t *buf;
+    all_t *all;
+
+    build( &mp, 3, -1, false );
+    buf = (uint8_t*) malloc( mp.len );
+    CU_ASSERT_FATAL( NULL != buf );
+    memcpy( buf, mp.buf, mp.len );
+
+    all = all_convert_view( buf, mp.len, NULL, NULL );
+    CU_ASSERT_FATAL( NULL != all );
+
+    /* The envelope payloads are in the buffer. */
+    CU_ASSERT( buf < all->full_envelope->payload );
+    CU_ASSERT( all->full_envelope->payload < &buf[mp.len] );
+    CU_ASSERT_FATAL( NULL != all->dhcp_envelope );
+    CU_ASSERT( buf < all->dhcp_envelope->payload );
+    CU_ASSERT( all->dhcp_envelope->payload < &buf[mp.len] );
+
+    /* The decoded subsystems are not. */
+    CU_ASSERT_FATAL( NULL != all->dhcp );
+    CU_ASSERT( 0xc0a80001 == all->dhcp->router_ip );
+    CU_ASSERT( 0x4c4c4c4c == all->xdns->default_ipv4 );
+
+    /* The buffer goes with the all_t. */
+    all->view = buf;
+    all->view_len = mp.len;
+    all->view_release = release;
+    all_destroy( all );
+    CU_ASSERT( 1 == released );
+
+    /* It is verified just the same. */
+    build( &mp, 3, 1, false );
+    CU_ASSERT( NULL == all_convert_view(mp.buf, mp.len, NULL, NULL) );
+    mp_free( &mp );
+}
+
+void test_envelope()
+{
+    mp_t mp = { NULL, 0, 0 };
+    envelope_stream_t *s;
+    all_t *all;
+
+    /* A full envelope decoded as it arrived. */
+    build( &mp, 3, -1, false );
+    s = envelope_stream_create_view();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, mp.buf, mp.len) );
+    all = all_convert_envelope( envelope_stream_finish_view(s, mp.buf, mp.len), NULL, NULL );
+    CU_ASSERT_FATAL( NULL != all );
+    CU_ASSERT( mp.buf < all->dhcp_envelope->payload );
+    CU_ASSERT( all->dhcp_envelope->payload < &mp.buf[mp.len] );
+    CU_ASSERT( 0xc0a80001 == all->dhcp->router_ip );
+    CU_ASSERT( 0x4c4c4c4c == all->xdns->default_ipv4 );
+    all_destroy( all );
+
+    /* The subsystems are verified as usual. */
+    build( &mp, 3, 2, false );
+    s = envelope_stream_create_view();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, mp.buf, mp.len) );
+    CU_ASSERT( NULL == all_convert_envelope(envelope_stream_finish_view(s, mp.buf, mp.len), NULL, NULL) );
+    CU_ASSERT_STRING_EQUAL( "Invalid subsystem.", all_strerror(errno) );
+
+    CU_ASSERT( NULL == all_convert_envelope(NULL, NULL, NULL) );
+    mp_free( &mp );
+}
+
+void test_cache()
+{
+    mp_t mp = { NULL, 0, 0 };
+    all_t *a, *b, *c;
+    cache_t *cache;
+    pool_t *pool;
+
+    cache = cache_create( 16 );
+    pool = pool_create( 2 );
+    CU_ASSERT_FATAL( NULL != cache );
+    CU_ASSERT_FATAL( NULL != pool );
+
+    build( &mp, 0, -1, false );
+    a = all_convert( mp.buf, mp.len, pool, cache );
+    CU_ASSERT_FATAL( NULL != a );
+
+    /* The same subsystems in another config are the same pointers. */
+    build( &mp, 2, -1, false );
+    b = all_convert_view( mp.buf, mp.len, NULL, cache );
+    CU_ASSERT_FATAL( NULL != b );
+    CU_ASSERT( a->full_envelope != b->full_envelope );
+    CU_ASSERT( a->dhcp_envelope == b->dhcp_envelope );
+    CU_ASSERT( a->dhcp == b->dhcp );
+    CU_ASSERT( a->xdns == b->xdns );
+    CU_ASSERT( 0x4c4c4c4c == b->xdns->default_ipv4 );
+
+    /* A subsystem that fails releases what the others took. */
+    build( &mp, 2, 3, false );
+    CU_ASSERT( NULL == all_convert(mp.buf, mp.len, pool, cache) );
+
+    /* The results outlive the cache. */
+    cache_destroy( cache );
+    all_destroy( a );
+    CU_ASSERT( 0xc0a80001 == b->dhcp->router_ip );
+    all_destroy( b );
+
+    /* Without a cache they are decoded each time. */
+    build( &mp, 0, -1, false );
+    a = all_convert( mp.buf, mp.len, NULL, NULL );
+    c = all_convert( mp.buf, mp.len, NULL, NULL );
+    CU_ASSERT_FATAL( (NULL != a) && (NULL != c) );
+    CU_ASSERT( a->dhcp != c->dhcp );
+    all_destroy( a );
+    all_destroy( c );
+
+    pool_destroy( pool );
+    mp_free( &mp );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Convert", test_convert);
+    CU_add_test( *suite, "Errors", test_errors);
+    CU_add_test( *suite, "View", test_view);
+    CU_add_test( *suite, "Envelope", test_envelope);
+    CU_add_test( *suite, "Cache", test_cache);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
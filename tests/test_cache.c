@@ -0,0 +1,282 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/cache.h"
+
+/* An envelope with the schema thing-1.2.0 and the payload 0 .. 9. */
+static const uint8_t input[] = {
+    0x83, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x84, 0xA4, 0x62, 0x61,
+    0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+    0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+    0x61, 0x74, 0x63, 0x68, 0x00,
+    0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+    0xC4, 0x20,
+    0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+    0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
+    0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
+    0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+/* The offset of the minor version & the last payload byte in input. */
+#define MINOR_OFFSET 33
+#define PAYLOAD_END  (sizeof(input) - 1)
+
+static int converts;
+static int destroys;
+
+static void* count_convert( const void *buf, size_t len )
+{
+    uint8_t *p;
+
+    converts++;
+    p = (uint8_t*) malloc( len );
+    if( NULL != p ) {
+        memcpy( p, buf, len );
+    }
+    return p;
+}
+
+static void* other_convert( const void *buf, size_t len )
+{
+    return count_convert( buf, len );
+}
+
+static void* fail_convert( const void *buf, size_t len )
+{
+    (void) buf;
+    (void) len;
+
+    errno = 42;
+    return NULL;
+}
+
+static void count_destroy( void *p )
+{
+    destroys++;
+    free( p );
+}
+
+void test_envelope()
+{
+    uint8_t copy[sizeof(input)];
+    envelope_t *a, *b, *c;
+    cache_t *cache;
+
+    cache = cache_create( 8 );
+    CU_ASSERT_FATAL( NULL != cache );
+
+    a = cache_envelope( cache, input, sizeof(input) );
+    CU_ASSERT_FATAL( NULL != a );
+    CU_ASSERT_STRING_EQUAL( "thing", a->schema.base );
+    CU_ASSERT( 10 == a->len );
+
+    /* The same content in a different buffer is the same envelope. */
+    memcpy( copy, input, sizeof(input) );
+    b = cache_envelope( cache, copy, sizeof(copy) );
+    CU_ASSERT( a == b );
+
+    /* Another version of the schema is not. */
+    copy[MINOR_OFFSET] = 0x03;
+    c = cache_envelope( cache, copy, sizeof(copy) );
+    CU_ASSERT_FATAL( NULL != c );
+    CU_ASSERT( a != c );
+    CU_ASSERT( 3 == c->schema.minor );
+
+    cache_release( cache, a );
+    cache_release( cache, b );
+    cache_release( cache, c );
+
+    /* A new envelope is still verified. */
+    memcpy( copy, input, sizeof(input) );
+    copy[MINOR_OFFSET] = 0x04;
+    copy[PAYLOAD_END] = 0x00;
+    CU_ASSERT( NULL == cache_envelope(cache, copy, sizeof(copy)) );
+    CU_ASSERT_STRING_EQUAL( "'sha256' does not match the payload.", envelope_strerror(errno) );
+
+    CU_ASSERT( NULL == cache_envelope(cache, input, 10) );
+
+    cache_destroy( cache );
+    cache_destroy( NULL );
+}
+
+void test_payload()
+{
+    envelope_t *env;
+    cache_t *cache;
+    void *a, *b, *c;
+
+    converts = 0;
+    destroys = 0;
+
+    cache = cache_create( 8 );
+    CU_ASSERT_FATAL( NULL != cache );
+    env = cache_envelope( cache, input, sizeof(input) );
+    CU_ASSERT_FATAL( NULL != env );
+
+    a = cache_payload( cache, env, count_convert, count_destroy );
+    CU_ASSERT_FATAL( NULL != a );
+    CU_ASSERT( 0 == memcmp(a, env->payload, 10) );
+    b = cache_payload( cache, env, count_convert, count_destroy );
+    CU_ASSERT( a == b );
+    CU_ASSERT( 1 == converts );
+
+    /* Each convert function has its own entry. */
+    c = cache_payload( cache, env, other_convert, count_destroy );
+    CU_ASSERT( NULL != c );
+    CU_ASSERT( a != c );
+    CU_ASSERT( 2 == converts );
+
+    /* Failures are not cached. */
+    CU_ASSERT( NULL == cache_payload(cache, env, fail_convert, count_destroy) );
+    CU_ASSERT( 42 == errno );
+
+    CU_ASSERT( b == cache_retain(cache, b) );
+    cache_release( cache, a );
+    cache_release( cache, b );
+    cache_release( cache, b );
+    cache_release( cache, c );
+    cache_release( cache, NULL );
+    CU_ASSERT( 0 == destroys );
+
+    /* Still cached after everyone released it. */
+    a = cache_payload( cache, env, count_convert, count_destroy );
+    CU_ASSERT( 2 == converts );
+    cache_release( cache, a );
+
+    /* What is still held outlives the cache. */
+    a = cache_payload( cache, env, count_convert, count_destroy );
+    cache_destroy( cache );
+    CU_ASSERT( 1 == destroys );
+    CU_ASSERT( 0 == memcmp(a, env->payload, 10) );
+    cache_release( cache, a );
+    CU_ASSERT( 2 == destroys );
+    cache_release( cache, env );
+}
+
+void test_eviction()
+{
+    envelope_t *env;
+    cache_t *cache;
+    uint8_t *a, *b;
+
+    converts = 0;
+    destroys = 0;
+
+    cache = cache_create( 2 );
+    CU_ASSERT_FATAL( NULL != cache );
+    env = cache_envelope( cache, input, sizeof(input) );
+    CU_ASSERT_FATAL( NULL != env );
+
+    a = cache_payload( cache, env, count_convert, count_destroy );
+    CU_ASSERT_FATAL( NULL != a );
+
+    /* The envelope is older, so it goes first, but it is still held. */
+    b = cache_payload( cache, env, other_convert, count_destroy );
+    CU_ASSERT_FATAL( NULL != b );
+    CU_ASSERT( 9 == env->payload[9] );
+
+    /* Now a is evicted, but stays valid until released. */
+    cache_release( cache, b );
+    cache_release( cache, cache_envelope(cache, input, sizeof(input)) );
+    CU_ASSERT( 0 == destroys );
+    CU_ASSERT( 9 == a[9] );
+    cache_release( cache, a );
+    CU_ASSERT( 1 == destroys );
+
+    cache_release( cache, env );
+    cache_destroy( cache );
+    CU_ASSERT( 2 == destroys );
+}
+
+static void* worker( void *arg )
+{
+    cache_t *cache = (cache_t*) arg;
+    int i;
+
+    for( i = 0; i < 1000; i++ ) {
+        envelope_t *env = cache_envelope( cache, input, sizeof(input) );
+
+        if( NULL != env ) {
+            cache_release( cache, cache_payload(cache, env, count_convert, free) );
+            cache_release( cache, env );
+        }
+    }
+
+    return NULL;
+}
+
+void test_threads()
+{
+    pthread_t threads[4];
+    cache_t *cache;
+    int i;
+
+    cache = cache_create( 1 );
+    CU_ASSERT_FATAL( NULL != cache );
+
+    for( i = 0; i < 4; i++ ) {
+        CU_ASSERT_FATAL( 0 == pthread_create(&threads[i], NULL, worker, cache) );
+    }
+    for( i = 0; i < 4; i++ ) {
+        pthread_join( threads[i], NULL );
+    }
+
+    cache_destroy( cache );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Envelope", test_envelope);
+    CU_add_test( *suite, "Payload", test_payload);
+    CU_add_test( *suite, "Eviction", test_eviction);
+    CU_add_test( *suite, "Threads", test_threads);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
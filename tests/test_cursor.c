@@ -0,0 +1,243 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/cursor.h"
+
+void test_types()
+{
+    const uint8_t buf[] = {
+        0x9e,
+            0xc0,                                   /* nil */
+            0xc3,                                   /* true */
+            0x7f,                                   /* 127 */
+            0xcd, 0x12, 0x34,                       /* 0x1234 */
+            0xcf, 0x80, 0, 0, 0, 0, 0, 0, 0,        /* 1 << 63 */
+            0xd0, 0x10,                             /* 16 as int 8 */
+            0xff,                                   /* -1 */
+            0xd2, 0xff, 0xff, 0xfe, 0x00,           /* -512 */
+            0xcb, 0x3f, 0xf8, 0, 0, 0, 0, 0, 0,     /* 1.5 */
+            0xa3, 'c', 'a', 't',                    /* "cat" */
+            0xd9, 0x00,                             /* "" */
+            0xc4, 0x02, 0x01, 0x02,                 /* bin */
+            0xd5, 0x07, 0xaa, 0xbb,                 /* fixext 2 */
+            0xdc, 0x00, 0x00,                       /* [] */
+            0xde, 0x00, 0x01,                       /* { 1: nil } */
+                0x01, 0xc0,
+    };
+    cursor_t c;
+    token_t t;
+
+    cursor_init( &c, buf, sizeof(buf) );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_ARRAY == t.type );
+    CU_ASSERT( 14 == t.size );
+    cursor_enter( &c );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_NIL == t.type );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_BOOLEAN == t.type );
+    CU_ASSERT( true == t.via.boolean );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_POSITIVE_INTEGER == t.type );
+    CU_ASSERT( 127 == t.via.u64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_POSITIVE_INTEGER == t.type );
+    CU_ASSERT( 0x1234 == t.via.u64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_POSITIVE_INTEGER == t.type );
+    CU_ASSERT( (((uint64_t) 1) << 63) == t.via.u64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_POSITIVE_INTEGER == t.type );
+    CU_ASSERT( 16 == t.via.u64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_NEGATIVE_INTEGER == t.type );
+    CU_ASSERT( -1 == t.via.i64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_NEGATIVE_INTEGER == t.type );
+    CU_ASSERT( -512 == t.via.i64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_FLOAT == t.type );
+    CU_ASSERT( 1.5 == t.via.f64 );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_STR == t.type );
+    CU_ASSERT( 3 == t.size );
+    CU_ASSERT( 0 == memcmp("cat", t.ptr, 3) );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_STR == t.type );
+    CU_ASSERT( 0 == t.size );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_BIN == t.type );
+    CU_ASSERT( 2 == t.size );
+    CU_ASSERT( (const uint8_t*) t.ptr == &buf[41] );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_EXT == t.type );
+    CU_ASSERT( 2 == t.size );
+    CU_ASSERT( 7 == t.ext_type );
+    CU_ASSERT( 0 == memcmp("\xaa\xbb", t.ptr, 2) );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_ARRAY == t.type );
+    CU_ASSERT( 0 == t.size );
+
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_MAP == t.type );
+    CU_ASSERT( 1 == t.size );
+
+    /* The map contents are skipped, leaving nothing. */
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_NIL == t.type );
+}
+
+void test_skip()
+{
+    const uint8_t buf[] = {
+        0x83,
+            0xa1, 'a',
+                0x92,
+                    0x81, 0xa1, 'x', 0x91, 0xa2, 'h', 'i',
+                    0xc4, 0x03, 1, 2, 3,
+            0xa1, 'b',
+                0x81, 0xa1, 'y', 0x05,
+            0xa1, 'c',
+                0x2a,
+    };
+    cursor_t c;
+    token_t t;
+
+    /* Not entering a container skips it. */
+    cursor_init( &c, buf, sizeof(buf) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    cursor_enter( &c );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_ARRAY == t.type );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_STR == t.type );
+    CU_ASSERT( 0 == memcmp("b", t.ptr, 1) );
+
+    /* Entering reads the contents. */
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_MAP == t.type );
+    cursor_enter( &c );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 0 == memcmp("y", t.ptr, 1) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 5 == t.via.u64 );
+
+    /* Explicitly skipping. */
+    cursor_init( &c, buf, sizeof(buf) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    cursor_enter( &c );
+    CU_ASSERT( 0 == cursor_skip(&c, 5) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 42 == t.via.u64 );
+    CU_ASSERT( c.next == c.end );
+
+    /* Skipping everything. */
+    cursor_init( &c, buf, sizeof(buf) );
+    CU_ASSERT( 0 == cursor_skip(&c, 1) );
+    CU_ASSERT( c.next == c.end );
+    CU_ASSERT( 0 != cursor_skip(&c, 1) );
+}
+
+void test_errors()
+{
+    const uint8_t truncated_hdr[] = { 0xcd, 0x01 };
+    const uint8_t truncated_data[] = { 0xa4, 'a', 'b', 'c' };
+    const uint8_t truncated_array[] = { 0x93, 0x01, 0x02 };
+    const uint8_t invalid[] = { 0x92, 0x01, 0xc1, 0x02 };
+    cursor_t c;
+    token_t t;
+
+    cursor_init( &c, truncated_hdr, sizeof(truncated_hdr) );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+    CU_ASSERT( TOKEN_NIL == t.type );
+
+    cursor_init( &c, truncated_data, sizeof(truncated_data) );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+    CU_ASSERT( NULL == t.ptr );
+
+    cursor_init( &c, truncated_array, sizeof(truncated_array) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+
+    cursor_init( &c, invalid, sizeof(invalid) );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    cursor_enter( &c );
+    CU_ASSERT( 0 == cursor_next(&c, &t) );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+
+    cursor_init( &c, NULL, 0 );
+    CU_ASSERT( 0 != cursor_next(&c, &t) );
+    CU_ASSERT( 0 == cursor_skip(&c, 0) );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Types", test_types);
+    CU_add_test( *suite, "Skip", test_skip);
+    CU_add_test( *suite, "Errors", test_errors);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
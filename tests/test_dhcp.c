@@ -16,9 +16,12 @@
  */
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
 #include "../src/dhcp.h"
+#include "../src/helpers.h"
+#include "mp.h"
 
 void test_basic()
 {
@@ -78,6 +81,20 @@ void test_basic()
     CU_ASSERT( 0xc0a80020 == dhcp->fixed[2].ip );
     CU_ASSERT( 0 == memcmp(mac2, dhcp->fixed[2].mac, 6) );
 
+    /* The leases are scanned until they are indexed. */
+    CU_ASSERT( NULL == dhcp->index );
+    CU_ASSERT( &dhcp->fixed[1] == dhcp_find_mac(dhcp, mac1) );
+    CU_ASSERT( &dhcp->fixed[2] == dhcp_find_ip(dhcp, 0xc0a80020) );
+    CU_ASSERT( 0 == dhcp_index(dhcp) );
+    CU_ASSERT_FATAL( NULL != dhcp->index );
+    CU_ASSERT( &dhcp->fixed[1] == dhcp_find_mac(dhcp, mac1) );
+    CU_ASSERT( &dhcp->fixed[2] == dhcp_find_ip(dhcp, 0xc0a80020) );
+
+    /* The static leases are in the pool. */
+    CU_ASSERT( 0 != dhcp_validate(dhcp) );
+    CU_ASSERT_STRING_EQUAL( "Conflict: a 'static.ip' is in the 'pool-range'.",
+                            dhcp_strerror(errno) );
+
     dhcp_destroy( dhcp );
 }
 
@@ -110,6 +127,8 @@ void test_no_optional()
     CU_ASSERT( 0xc0a80064 == dhcp->pool_range[1] );
     CU_ASSERT( 0 == dhcp->fixed_count );
     CU_ASSERT( NULL == dhcp->fixed );
+    CU_ASSERT( 0 == dhcp_index(dhcp) );
+    CU_ASSERT( NULL == dhcp->index );
 
     dhcp_destroy( dhcp );
 }
@@ -150,7 +169,165 @@ void test_extras()
 }
 
 
+void test_exact_keys()
+{
+    const uint8_t basic[] = {
+        0x81,
+            0xa4, 'd', 'h', 'c', 'p',
+                0x86,
+                    0xa0,
+                        0x01,
+                    0xa6, 'r', 'o', 'u', 't', 'e', 'r',
+                        0x02,
+                    0xaa, 'r', 'o', 'u', 't', 'e', 'r', '-', 'i', 'p', 's',
+                        0x03,
+                    0xab, 's', 'u', 'b', 'n', 'e', 't', '-', 'm', 'a', 's', 'k',
+                        0xce, 0xff, 0xff, 0xff, 0x00,   // 255.255.255.0
+                    0xac, 'l', 'e', 'a', 's', 'e', '-', 'l', 'e', 'n', 'g', 't', 'h',
+                        0xcd, 0x0c, 0x80,               // 3200
+                    0xaa, 'p', 'o', 'o', 'l', '-', 'r', 'a', 'n', 'g', 'e',
+                        0x92,
+                            0xce, 0xc0, 0xa8, 0x00, 0x02,   // 192.168.0.2
+                            0xce, 0xc0, 0xa8, 0x00, 0x64,   // 192.168.0.100
+    };
+    dhcp_t *dhcp;
+    int err;
+
+    /* Only "router-ip" itself names the router address. */
+    dhcp = dhcp_convert( basic, sizeof(basic) );
+    err = errno;
+    CU_ASSERT( NULL == dhcp );
+    CU_ASSERT_STRING_EQUAL( "'router-ip' element missing.", dhcp_strerror(err) );
+}
+
+/* Builds a dhcp for 10.0.0.0/16 with the pool 10.0.1.0 - 10.0.1.255. */
+static void build( mp_t *mp, const dhcp_static_t *fixed, size_t count )
+{
+    size_t i;
 
+    mp->len = 0;
+    mp_map( mp, 1 );
+    mp_str( mp, "dhcp" );
+    mp_map( mp, 5 );
+    mp_str( mp, "router-ip" );
+    mp_uint( mp, 0x0a000001 );
+    mp_str( mp, "subnet-mask" );
+    mp_uint( mp, 0xffff0000 );
+    mp_str( mp, "lease-length" );
+    mp_uint( mp, 3200 );
+    mp_str( mp, "pool-range" );
+    mp_array( mp, 2 );
+    mp_uint( mp, 0x0a000100 );
+    mp_uint( mp, 0x0a0001ff );
+    mp_str( mp, "static" );
+    mp_array( mp, count );
+    for( i = 0; i < count; i++ ) {
+        mp_map( mp, 2 );
+        mp_str( mp, "mac" );
+        mp_bin( mp, fixed[i].mac, 6 );
+        mp_str( mp, "ip" );
+        mp_uint( mp, fixed[i].ip );
+    }
+}
+
+/* Decodes the leases & validates them, providing the error. */
+static int check( const dhcp_static_t *fixed, size_t count )
+{
+    mp_t mp = { NULL, 0, 0 };
+    dhcp_t *dhcp;
+    int err = -1;
+
+    build( &mp, fixed, count );
+    dhcp = dhcp_convert( mp.buf, mp.len );
+    CU_ASSERT( NULL != dhcp );
+    if( NULL != dhcp ) {
+        err = (0 == dhcp_validate(dhcp)) ? 0 : errno;
+        CU_ASSERT( (0 == err) || (NULL != dhcp_strerror(err)) );
+        /* The index finds the same conflicts as the scan. */
+        CU_ASSERT( 0 == dhcp_index(dhcp) );
+        CU_ASSERT( err == ((0 == dhcp_validate(dhcp)) ? 0 : errno) );
+        dhcp_destroy( dhcp );
+    }
+    mp_free( &mp );
+
+    return err;
+}
+
+void test_index()
+{
+    static dhcp_static_t fixed[1000];
+    uint8_t unknown[6] = { 0x02, 0, 0, 0, 0xff, 0xff };
+    mp_t mp = { NULL, 0, 0 };
+    dhcp_t *dhcp, plain;
+    size_t i;
+    int err;
+
+    for( i = 0; i < 1000; i++ ) {
+        memset( fixed[i].mac, 0, 6 );
+        fixed[i].mac[0] = 0x02;
+        fixed[i].mac[4] = (uint8_t) (i >> 8);
+        fixed[i].mac[5] = (uint8_t) i;
+        fixed[i].ip = 0x0a000200 + (uint32_t) i;
+    }
+
+    build( &mp, fixed, 1000 );
+    dhcp = dhcp_convert( mp.buf, mp.len );
+    CU_ASSERT_FATAL( NULL != dhcp );
+    /* The arena was sized for the leases alone. */
+    CU_ASSERT( NULL == helper_ctx(dhcp)->blocks );
+    CU_ASSERT( 0 == dhcp_index(dhcp) );
+    CU_ASSERT_FATAL( NULL != dhcp->index );
+    CU_ASSERT( 0 == dhcp_validate(dhcp) );
+    for( i = 0; i < 1000; i++ ) {
+        CU_ASSERT( &dhcp->fixed[i] == dhcp_find_mac(dhcp, fixed[i].mac) );
+        CU_ASSERT( &dhcp->fixed[i] == dhcp_find_ip(dhcp, fixed[i].ip) );
+    }
+    CU_ASSERT( NULL == dhcp_find_mac(dhcp, unknown) );
+    CU_ASSERT( NULL == dhcp_find_ip(dhcp, 0x0a000100) );
+    dhcp_destroy( dhcp );
+    mp_free( &mp );
+
+    /* A dhcp_t that was not decoded has no index, & is scanned instead. */
+    memset( &plain, 0, sizeof(plain) );
+    plain.router_ip = 0x0a000001;
+    plain.subnet_mask = 0xffff0000;
+    plain.pool_range[0] = 0x0a000100;
+    plain.pool_range[1] = 0x0a0001ff;
+    plain.fixed = fixed;
+    plain.fixed_count = 1000;
+    CU_ASSERT( 0 == dhcp_validate(&plain) );
+    CU_ASSERT( &fixed[20] == dhcp_find_ip(&plain, fixed[20].ip) );
+    fixed[999].ip = fixed[20].ip;
+    CU_ASSERT( 0 != dhcp_validate(&plain) );
+    CU_ASSERT_STRING_EQUAL( "Conflict: two 'static' entries have the same 'ip'.", dhcp_strerror(errno) );
+    fixed[999].ip = 0x0a000200 + 999;
+
+    fixed[999].mac[5] = 0x00;
+    fixed[999].mac[4] = 0x00;
+    err = check( fixed, 1000 );
+    CU_ASSERT_STRING_EQUAL( "Conflict: two 'static' entries have the same 'mac'.", dhcp_strerror(err) );
+    fixed[999].mac[4] = 0x03;
+    fixed[999].mac[5] = 0xe7;
+
+    fixed[500].ip = fixed[20].ip;
+    err = check( fixed, 1000 );
+    CU_ASSERT_STRING_EQUAL( "Conflict: two 'static' entries have the same 'ip'.", dhcp_strerror(err) );
+
+    fixed[500].ip = 0x0b000001;
+    err = check( fixed, 1000 );
+    CU_ASSERT_STRING_EQUAL( "Conflict: a 'static.ip' is outside the subnet.", dhcp_strerror(err) );
+
+    fixed[500].ip = 0x0a000001;
+    err = check( fixed, 1000 );
+    CU_ASSERT_STRING_EQUAL( "Conflict: a 'static.ip' is the 'router-ip'.", dhcp_strerror(err) );
+
+    fixed[500].ip = 0x0a000180;
+    err = check( fixed, 1000 );
+    CU_ASSERT_STRING_EQUAL( "Conflict: a 'static.ip' is in the 'pool-range'.", dhcp_strerror(err) );
+
+    fixed[500].ip = 0x0a000200 + 500;
+    CU_ASSERT( 0 == check(fixed, 1000) );
+}
 
 void add_suites( CU_pSuite *suite )
 {
@@ -158,6 +335,8 @@ void add_suites( CU_pSuite *suite )
     CU_add_test( *suite, "Full", test_basic);
     CU_add_test( *suite, "No Optionals", test_no_optional);
     CU_add_test( *suite, "Extra Elements", test_extras);
+    CU_add_test( *suite, "Exact Keys", test_exact_keys);
+    CU_add_test( *suite, "Index", test_index);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,268 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/diff.h"
+
+static size_t count_op( const diff_sub_t *d, diff_op_t op )
+{
+    size_t i, n = 0;
+
+    for( i = 0; i < d->entries_count; i++ ) {
+        if( op == d->entries[i].op ) {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+void test_dhcp()
+{
+    dhcp_static_t a_fixed[] = {
+        { .mac = { 1, 1, 1, 1, 1, 1 }, .ip = 0x0a000001 },
+        { .mac = { 2, 2, 2, 2, 2, 2 }, .ip = 0x0a000002 },
+        { .mac = { 3, 3, 3, 3, 3, 3 }, .ip = 0x0a000003 },
+    };
+    dhcp_static_t b_fixed[] = {
+        { .mac = { 4, 4, 4, 4, 4, 4 }, .ip = 0x0a000004 },
+        { .mac = { 3, 3, 3, 3, 3, 3 }, .ip = 0x0a000003 },
+        { .mac = { 1, 1, 1, 1, 1, 1 }, .ip = 0x0a000009 },
+    };
+    dhcp_t a = { .router_ip = 1, .subnet_mask = 2, .pool_range = { 3, 4 },
+                 .lease_length = 5, .fixed = a_fixed, .fixed_count = 3 };
+    dhcp_t b = a;
+    diff_sub_t d;
+
+    /* Nothing changed, even if the leases are in another order. */
+    CU_ASSERT_FATAL( 0 == diff_dhcp(&a, &b, &d) );
+    CU_ASSERT( 0 == d.fields );
+    CU_ASSERT( 0 == d.entries_count );
+    CU_ASSERT( NULL == d.entries );
+
+    b.lease_length = 6;
+    b.fixed = b_fixed;
+    CU_ASSERT_FATAL( 0 == diff_dhcp(&a, &b, &d) );
+    CU_ASSERT( (DIFF_DHCP_LEASE_LENGTH | DIFF_DHCP_FIXED) == d.fields );
+    CU_ASSERT_FATAL( 3 == d.entries_count );
+
+    /* In MAC order. */
+    CU_ASSERT( DIFF_MODIFIED == d.entries[0].op );
+    CU_ASSERT( 0 == d.entries[0].old_index );
+    CU_ASSERT( 2 == d.entries[0].new_index );
+    CU_ASSERT( DIFF_REMOVED == d.entries[1].op );
+    CU_ASSERT( 1 == d.entries[1].old_index );
+    CU_ASSERT( DIFF_ADDED == d.entries[2].op );
+    CU_ASSERT( 0 == d.entries[2].new_index );
+    diff_sub_destroy( &d );
+
+    /* A new subsystem has changed entirely. */
+    CU_ASSERT_FATAL( 0 == diff_dhcp(NULL, &b, &d) );
+    CU_ASSERT( DIFF_PRESENT & d.fields );
+    CU_ASSERT( DIFF_DHCP_ROUTER_IP & d.fields );
+    CU_ASSERT( 3 == count_op(&d, DIFF_ADDED) );
+    CU_ASSERT( 3 == d.entries_count );
+    diff_sub_destroy( &d );
+
+    CU_ASSERT_FATAL( 0 == diff_dhcp(NULL, NULL, &d) );
+    CU_ASSERT( 0 == d.fields );
+}
+
+void test_firewall()
+{
+    char *a_filters[] = { "drop 22", "drop 23", "accept 80" };
+    size_t a_lens[] = { 7, 7, 9 };
+    char *b_filters[] = { "drop 23", "drop 22", "accept 443" };
+    size_t b_lens[] = { 7, 7, 10 };
+    firewall_t a = { .level = "high", .level_len = 4, .filters = a_filters,
+                     .filter_lens = a_lens, .filters_count = 3 };
+    firewall_t b = a;
+    diff_sub_t d;
+
+    CU_ASSERT_FATAL( 0 == diff_firewall(&a, &b, &d) );
+    CU_ASSERT( 0 == d.fields );
+
+    /* Only the order changed. */
+    b.filters = b_filters;
+    b.filter_lens = b_lens;
+    b.filters_count = 2;
+    a.filters_count = 2;
+    CU_ASSERT_FATAL( 0 == diff_firewall(&a, &b, &d) );
+    CU_ASSERT( DIFF_FIREWALL_FILTERS == d.fields );
+    CU_ASSERT( 0 == d.entries_count );
+
+    a.filters_count = 3;
+    b.filters_count = 3;
+    b.level = "low";
+    b.level_len = 3;
+    CU_ASSERT_FATAL( 0 == diff_firewall(&a, &b, &d) );
+    CU_ASSERT( (DIFF_FIREWALL_LEVEL | DIFF_FIREWALL_FILTERS) == d.fields );
+    CU_ASSERT_FATAL( 2 == d.entries_count );
+    CU_ASSERT( 1 == count_op(&d, DIFF_ADDED) );
+    CU_ASSERT( 1 == count_op(&d, DIFF_REMOVED) );
+    CU_ASSERT( 0 == count_op(&d, DIFF_MODIFIED) );
+    diff_sub_destroy( &d );
+}
+
+void test_portmapping()
+{
+    pm_entry_t a_entries[] = {
+        { .protocol = "tcp", .protocol_len = 3, .port_range = { 80, 80 },
+          .target_port = 8080, .ip_version = 4, .ip.v4 = 0x0a000001 },
+        { .protocol = "udp", .protocol_len = 3, .port_range = { 80, 80 },
+          .target_port = 8080, .ip_version = 4, .ip.v4 = 0x0a000001 },
+        { .protocol = "tcp", .protocol_len = 3, .port_range = { 1000, 2000 },
+          .target_port = 1000, .ip_version = 4, .ip.v4 = 0x0a000002 },
+    };
+    pm_entry_t b_entries[3];
+    portmapping_t a = { .entries = a_entries, .entries_count = 3 };
+    portmapping_t b = { .entries = b_entries, .entries_count = 3 };
+    diff_sub_t d;
+
+    memcpy( b_entries, a_entries, sizeof(a_entries) );
+    CU_ASSERT_FATAL( 0 == diff_portmapping(&a, &b, &d) );
+    CU_ASSERT( 0 == d.fields );
+
+    /* One mapping moved to another host. */
+    b_entries[1].ip.v4 = 0x0a000005;
+    CU_ASSERT_FATAL( 0 == diff_portmapping(&a, &b, &d) );
+    CU_ASSERT( DIFF_PORTMAPPING_ENTRIES == d.fields );
+    CU_ASSERT_FATAL( 1 == d.entries_count );
+    CU_ASSERT( DIFF_MODIFIED == d.entries[0].op );
+    CU_ASSERT( 1 == d.entries[0].old_index );
+    CU_ASSERT( 1 == d.entries[0].new_index );
+    diff_sub_destroy( &d );
+
+    /* Another range is another mapping. */
+    b_entries[1].ip.v4 = 0x0a000001;
+    b_entries[2].port_range[1] = 2001;
+    CU_ASSERT_FATAL( 0 == diff_portmapping(&a, &b, &d) );
+    CU_ASSERT( 2 == d.entries_count );
+    CU_ASSERT( 1 == count_op(&d, DIFF_ADDED) );
+    CU_ASSERT( 1 == count_op(&d, DIFF_REMOVED) );
+    diff_sub_destroy( &d );
+
+    CU_ASSERT_FATAL( 0 == diff_portmapping(&a, NULL, &d) );
+    CU_ASSERT( (DIFF_PRESENT | DIFF_PORTMAPPING_ENTRIES) == d.fields );
+    CU_ASSERT( 3 == count_op(&d, DIFF_REMOVED) );
+    diff_sub_destroy( &d );
+}
+
+void test_scalars()
+{
+    wifi_ap_t aps[] = { { .name = "ap", .ssid = "home" } };
+    wifi_ap_t aps2[] = { { .name = "ap", .ssid = "work" } };
+    wifi_t wa, wb;
+    gre_t ga = { .primary_remote_endpoint = "url1", .primary_remote_endpoint_len = 4 };
+    gre_t gb = ga;
+    xdns_t xa = { .default_ipv4 = 1 };
+    xdns_t xb = xa;
+    diff_sub_t d;
+
+    memset( &wa, 0, sizeof(wa) );
+    wa.config_5g.channel = 36;
+    wa.config_5g.aps = aps;
+    wa.config_5g.aps_count = 1;
+    wb = wa;
+    CU_ASSERT_FATAL( 0 == diff_wifi(&wa, &wb, &d) );
+    CU_ASSERT( 0 == d.fields );
+
+    wb.config_5g.aps = aps2;
+    wb.config_2g.channel = 6;
+    CU_ASSERT_FATAL( 0 == diff_wifi(&wa, &wb, &d) );
+    CU_ASSERT( (DIFF_WIFI_APS | (DIFF_WIFI_CHANNEL << DIFF_WIFI_2G)) == d.fields );
+
+    gb.secondary_remote_endpoint = "url2";
+    gb.secondary_remote_endpoint_len = 4;
+    CU_ASSERT_FATAL( 0 == diff_gre(&ga, &gb, &d) );
+    CU_ASSERT( DIFF_GRE_SECONDARY == d.fields );
+
+    xb.default_ipv6[15] = 1;
+    CU_ASSERT_FATAL( 0 == diff_xdns(&xa, &xb, &d) );
+    CU_ASSERT( DIFF_XDNS_DEFAULT_IPV6 == d.fields );
+}
+
+void test_all()
+{
+    xdns_t xa = { .default_ipv4 = 1 };
+    xdns_t xb = { .default_ipv4 = 2 };
+    gre_t g = { .primary_remote_endpoint = NULL };
+    all_t a, b;
+    diff_t *d;
+
+    memset( &a, 0, sizeof(a) );
+    memset( &b, 0, sizeof(b) );
+    a.xdns = &xa;
+    b.xdns = &xb;
+    b.gre = &g;
+
+    d = diff_all( &a, &b );
+    CU_ASSERT_FATAL( NULL != d );
+    CU_ASSERT( DIFF_XDNS_DEFAULT_IPV4 == d->xdns.fields );
+    CU_ASSERT( DIFF_PRESENT & d->gre.fields );
+    CU_ASSERT( 0 == d->dhcp.fields );
+    CU_ASSERT( 0 == d->wifi.fields );
+    diff_destroy( d );
+
+    d = diff_all( NULL, &a );
+    CU_ASSERT_FATAL( NULL != d );
+    CU_ASSERT( DIFF_PRESENT & d->xdns.fields );
+    diff_destroy( d );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "DHCP", test_dhcp);
+    CU_add_test( *suite, "Firewall", test_firewall);
+    CU_add_test( *suite, "Port Mapping", test_portmapping);
+    CU_add_test( *suite, "Scalars", test_scalars);
+    CU_add_test( *suite, "All", test_all);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -16,6 +16,7 @@
  */
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
 #include "../src/envelope.h"
@@ -28,11 +29,15 @@ void test_simple()
         0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
         0x61, 0x74, 0x63, 0x68, 0x00,
         0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
-        0xC4, 0x20, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
         0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
         0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
     envelope_t *env;
-    const uint8_t sha[32] = {4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4,4};
+    const uint8_t sha[32] = {
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3 };
     const uint8_t payload[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
 
 
@@ -49,6 +54,32 @@ void test_simple()
     envelope_destroy( env );
 }
 
+void test_view()
+{
+    const uint8_t input[] = {
+        0x83, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x84, 0xA4, 0x62, 0x61,
+        0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00,
+        0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
+        0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
+        0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    envelope_t *env;
+
+    env = envelope_convert_view( input, sizeof(input) );
+    CU_ASSERT_FATAL( NULL != env );
+    CU_ASSERT( 5 == env->schema.base_len );
+    CU_ASSERT( 0 == strncmp("thing", env->schema.base, env->schema.base_len) );
+    CU_ASSERT( (const uint8_t*) env->schema.base == &input[15] );
+    CU_ASSERT( 10 == env->len );
+    CU_ASSERT( env->payload == &input[sizeof(input) - 10] );
+
+    envelope_destroy( env );
+}
+
 void test_errors()
 {
     const uint8_t missing_payload[] = {
@@ -64,7 +95,9 @@ void test_errors()
         0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
         0x61, 0x74, 0x63, 0x68, 0x00,
         0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
-        0xC4, 0x20, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
         0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
         0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
     envelope_t *e;
@@ -83,13 +116,209 @@ void test_errors()
     envelope_destroy( NULL );
 }
 
+void test_mismatch()
+{
+    const uint8_t input[] = {
+        0x83, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x84, 0xA4, 0x62, 0x61,
+        0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00,
+        0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
+        0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
+        0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8 };
+    envelope_stream_t *s;
+    int err;
+
+    CU_ASSERT( NULL == envelope_convert(input, sizeof(input)) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "'sha256' does not match the payload.", envelope_strerror(err) );
+
+    CU_ASSERT( NULL == envelope_convert_view(input, sizeof(input)) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "'sha256' does not match the payload.", envelope_strerror(err) );
+
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, input, sizeof(input)) );
+    CU_ASSERT( NULL == envelope_stream_finish(s) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "'sha256' does not match the payload.", envelope_strerror(err) );
+}
+
+void test_stream()
+{
+    const uint8_t input[] = {
+        0x84, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x85, 0xA4, 0x62, 0x61,
+        0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00,
+        0xA5, 0x65, 0x78, 0x74, 0x72, 0x61, 0x92, 0x81, 0xA1, 0x61, 0x91, 0x01, 0xC0,
+        0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
+        0xA9, 0x74, 0x6F, 0x6F, 0x2D, 0x6C, 0x6F, 0x6E, 0x67, 0x21,
+        0xCD, 0x01, 0x00,
+        0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
+        0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    const uint8_t sha[32] = {
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3 };
+    const uint8_t payload[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    size_t chunk;
+
+    /* Every chunk size from a byte at a time to all at once. */
+    for( chunk = 1; chunk <= sizeof(input); chunk++ ) {
+        envelope_stream_t *s;
+        envelope_t *env;
+        size_t i;
+
+        s = envelope_stream_create();
+        CU_ASSERT_FATAL( NULL != s );
+
+        for( i = 0; i < sizeof(input); i += chunk ) {
+            size_t n = sizeof(input) - i;
+            n = (n < chunk) ? n : chunk;
+            CU_ASSERT_FATAL( 0 == envelope_stream_write(s, &input[i], n) );
+        }
+
+        env = envelope_stream_finish( s );
+        CU_ASSERT_FATAL( NULL != env );
+        CU_ASSERT_STRING_EQUAL( "thing", env->schema.base );
+        CU_ASSERT( 5 == env->schema.base_len );
+        CU_ASSERT( 1 == env->schema.major );
+        CU_ASSERT( 2 == env->schema.minor );
+        CU_ASSERT( 0 == env->schema.patch );
+        CU_ASSERT( 0 == memcmp(sha, env->sha256, 32) );
+        CU_ASSERT( 10 == env->len );
+        CU_ASSERT( 0 == memcmp(payload, env->payload, 10) );
+
+        envelope_destroy( env );
+    }
+}
+
+void test_stream_view()
+{
+    const uint8_t input[] = {
+        0x83, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x84, 0xA4, 0x62, 0x61,
+        0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00,
+        0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+        0xC4, 0x20,
+        0x1F, 0x82, 0x5A, 0xA2, 0xF0, 0x02, 0x0E, 0xF7, 0xCF, 0x91, 0xDF, 0xA3, 0x0D, 0xA4, 0x66, 0x8D,
+        0x79, 0x1C, 0x5D, 0x48, 0x24, 0xFC, 0x8E, 0x41, 0x35, 0x4B, 0x89, 0xEC, 0x05, 0x79, 0x5A, 0xB3,
+        0xA7, 0x70, 0x61, 0x79, 0x6C, 0x6F, 0x61, 0x64,
+        0xC4, 0x0A, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    uint8_t copy[sizeof(input)];
+    envelope_stream_t *s;
+    envelope_t *env;
+    size_t i;
+
+    /* The payload is verified as it arrives but left where it is. */
+    s = envelope_stream_create_view();
+    CU_ASSERT_FATAL( NULL != s );
+    for( i = 0; i < sizeof(input); i += 7 ) {
+        size_t n = sizeof(input) - i;
+        n = (n < 7) ? n : 7;
+        CU_ASSERT_FATAL( 0 == envelope_stream_write(s, &input[i], n) );
+    }
+    env = envelope_stream_finish_view( s, input, sizeof(input) );
+    CU_ASSERT_FATAL( NULL != env );
+    CU_ASSERT_STRING_EQUAL( "thing", env->schema.base );
+    CU_ASSERT( 10 == env->len );
+    CU_ASSERT( &input[sizeof(input) - 10] == env->payload );
+    envelope_destroy( env );
+
+    /* A buffer shorter than what was written. */
+    s = envelope_stream_create_view();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, input, sizeof(input)) );
+    CU_ASSERT( NULL == envelope_stream_finish_view(s, input, sizeof(input) - 1) );
+    CU_ASSERT_STRING_EQUAL( "Incomplete envelope.", envelope_strerror(errno) );
+
+    /* A payload that doesn't match its sha256. */
+    memcpy( copy, input, sizeof(input) );
+    copy[sizeof(copy) - 1] ^= 1;
+    s = envelope_stream_create_view();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, copy, sizeof(copy)) );
+    CU_ASSERT( NULL == envelope_stream_finish_view(s, copy, sizeof(copy)) );
+
+    CU_ASSERT( NULL == envelope_stream_finish_view(NULL, input, sizeof(input)) );
+}
+
+void test_stream_errors()
+{
+    const uint8_t missing_payload[] = {
+        0x82, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x84, 0xA4, 0x62, 0x61,
+        0x73, 0x65, 0xA5, 0x74, 0x68, 0x69, 0x6E, 0x67, 0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00,
+        0xA6, 0x73, 0x68, 0x61, 0x32, 0x35, 0x36,
+        0xC4, 0x20, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4 };
+    const uint8_t missing_base[] = {
+        0x83, 0xA6, 0x73, 0x63, 0x68, 0x65, 0x6D, 0x61, 0x83,
+        0xA5, 0x6D, 0x61, 0x6A,
+        0x6F, 0x72, 0x01, 0xA5, 0x6D, 0x69, 0x6E, 0x6F, 0x72, 0x02, 0xA5, 0x70,
+        0x61, 0x74, 0x63, 0x68, 0x00 };
+    const uint8_t not_a_map[] = { 0x91, 0x01 };
+    const uint8_t invalid[] = { 0x81, 0xC1 };
+    envelope_stream_t *s;
+    int err;
+
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, missing_payload, sizeof(missing_payload)) );
+    CU_ASSERT( NULL == envelope_stream_finish(s) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "'payload' element missing.", envelope_strerror(err) );
+
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 != envelope_stream_write(s, missing_base, sizeof(missing_base)) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "'base' element missing.", envelope_strerror(err) );
+    CU_ASSERT( NULL == envelope_stream_finish(s) );
+
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 != envelope_stream_write(s, not_a_map, sizeof(not_a_map)) );
+    CU_ASSERT( NULL == envelope_stream_finish(s) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid first element.", envelope_strerror(err) );
+
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 != envelope_stream_write(s, invalid, sizeof(invalid)) );
+    envelope_stream_destroy( s );
+
+    /* Truncated anywhere. */
+    s = envelope_stream_create();
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == envelope_stream_write(s, missing_payload, sizeof(missing_payload) - 1) );
+    CU_ASSERT( NULL == envelope_stream_finish(s) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Incomplete envelope.", envelope_strerror(err) );
+
+    CU_ASSERT( NULL == envelope_stream_finish(NULL) );
+    envelope_stream_destroy( NULL );
+}
 
 
 void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Normal", test_simple);
+    CU_add_test( *suite, "View", test_view);
     CU_add_test( *suite, "Errors", test_errors);
+    CU_add_test( *suite, "Mismatch", test_mismatch);
+    CU_add_test( *suite, "Stream", test_stream);
+    CU_add_test( *suite, "Stream View", test_stream_view);
+    CU_add_test( *suite, "Stream Errors", test_stream_errors);
 }
 
 /*----------------------------------------------------------------------------*/
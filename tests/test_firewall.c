@@ -41,6 +41,42 @@ void test_basic()
     printf( "errno: %s\n", firewall_strerror(err) );
 
     CU_ASSERT_FATAL( NULL != firewall );
+    CU_ASSERT_STRING_EQUAL( "amazing", firewall->level );
+    CU_ASSERT( 7 == firewall->level_len );
+    CU_ASSERT_FATAL( 2 == firewall->filters_count );
+    CU_ASSERT_STRING_EQUAL( "http", firewall->filters[0] );
+    CU_ASSERT( 4 == firewall->filter_lens[0] );
+    CU_ASSERT_STRING_EQUAL( "ident", firewall->filters[1] );
+    CU_ASSERT( 5 == firewall->filter_lens[1] );
+
+    firewall_destroy( firewall );
+}
+
+void test_view()
+{
+    const uint8_t basic[] = {
+        0x81,
+            0xa8, 'f', 'i', 'r', 'e', 'w', 'a', 'l', 'l',
+                0x82,
+                    0xa5, 'l', 'e', 'v', 'e', 'l',
+                        0xa7, 'a', 'm', 'a', 'z', 'i', 'n', 'g',
+                    0xa7, 'f', 'i', 'l', 't', 'e', 'r', 's',
+                        0x92,
+                            0xa4, 'h', 't', 't', 'p',
+                            0xa5, 'i', 'd', 'e', 'n', 't',
+    };
+    firewall_t *firewall;
+
+    firewall = firewall_convert_view( basic, sizeof(basic) );
+
+    CU_ASSERT_FATAL( NULL != firewall );
+    CU_ASSERT( (const uint8_t*) firewall->level == &basic[18] );
+    CU_ASSERT( 7 == firewall->level_len );
+    CU_ASSERT_FATAL( 2 == firewall->filters_count );
+    CU_ASSERT( (const uint8_t*) firewall->filters[0] == &basic[35] );
+    CU_ASSERT( 4 == firewall->filter_lens[0] );
+    CU_ASSERT( (const uint8_t*) firewall->filters[1] == &basic[40] );
+    CU_ASSERT( 5 == firewall->filter_lens[1] );
 
     firewall_destroy( firewall );
 }
@@ -50,6 +86,7 @@ void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Full", test_basic);
+    CU_add_test( *suite, "View", test_view);
 }
 
 /*----------------------------------------------------------------------------*/
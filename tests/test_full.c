@@ -56,6 +56,34 @@ void test_basic()
     full_destroy( full );
 }
 
+void test_view()
+{
+    const uint8_t basic[] = {
+        0x81,
+            0xa4, 'f', 'u', 'l', 'l',
+                0x81,
+                    0xaa, 's', 'u', 'b', 's', 'y', 's', 't', 'e', 'm', 's',
+                        0x91,
+                            0x82,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '3',
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x01, 0xff,
+    };
+    full_t *full;
+
+    full = full_convert_view( basic, sizeof(basic) );
+
+    CU_ASSERT_FATAL( NULL != full );
+    CU_ASSERT_FATAL( 1 == full->subsystems_count );
+    CU_ASSERT( 4 == full->subsystems[0].url_len );
+    CU_ASSERT( (const uint8_t*) full->subsystems[0].url == &basic[25] );
+    CU_ASSERT( 1 == full->subsystems[0].payload_len );
+    CU_ASSERT( full->subsystems[0].payload == &basic[sizeof(basic) - 1] );
+
+    full_destroy( full );
+}
+
 void test_no_optional()
 {
     const uint8_t basic1[] = {
@@ -79,11 +107,134 @@ void test_no_optional()
 
 
 
+void test_skipped()
+{
+    const uint8_t basic[] = {
+        0x82,
+            0xa5, 'e', 'x', 't', 'r', 'a',
+                0x91, 0x91, 0x81, 0xa1, 'x', 0x92, 0xc0, 0xa1, 'y',
+            0xa4, 'f', 'u', 'l', 'l',
+                0x81,
+                    0xaa, 's', 'u', 'b', 's', 'y', 's', 't', 'e', 'm', 's',
+                        0x92,
+                            0x83,
+                                0xa5, 'e', 'x', 't', 'r', 'a',
+                                    0x82, 0xa1, 'a', 0x91, 0x01, 0xa1, 'b', 0xc4, 0x01, 0x00,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '1',
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x00,
+                            0x83,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '3',
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x01, 0xff,
+                                0xa5, 'e', 'x', 't', 'r', 'a',
+                                    0x91, 0x90,
+    };
+    full_t *full;
+    int err;
+
+    full = full_convert( basic, sizeof(basic) );
+
+    CU_ASSERT_FATAL( NULL != full );
+    CU_ASSERT( 2 == full->subsystems_count );
+    CU_ASSERT_STRING_EQUAL( full->subsystems[0].url, "url1" );
+    CU_ASSERT( 0 == full->subsystems[0].payload_len );
+    CU_ASSERT_STRING_EQUAL( full->subsystems[1].url, "url3" );
+    CU_ASSERT( 1 == full->subsystems[1].payload_len );
+    CU_ASSERT_FATAL( NULL != full->subsystems[1].payload );
+    CU_ASSERT( 0xff == full->subsystems[1].payload[0] );
+
+    full_destroy( full );
+
+    /* Any truncation is caught before decoding. */
+    full = full_convert( basic, sizeof(basic) - 1 );
+    err = errno;
+    CU_ASSERT( NULL == full );
+    CU_ASSERT_STRING_EQUAL( "Invalid first element.", full_strerror(err) );
+}
+
+void test_lazy()
+{
+    const uint8_t basic[] = {
+        0x81,
+            0xa4, 'f', 'u', 'l', 'l',
+                0x81,
+                    0xaa, 's', 'u', 'b', 's', 'y', 's', 't', 'e', 'm', 's',
+                        0x93,
+                            0x82,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '1',
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x00,
+                            0x83,
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x02, 0xfe, 0xff,
+                                0xa5, 'e', 'x', 't', 'r', 'a',
+                                    0x91, 0x90,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '2',
+                            0x82,
+                                0xa3, 'u', 'r', 'l',
+                                    0xa4, 'u', 'r', 'l', '3',
+                                0xa7, 'p', 'a', 'y', 'l', 'o', 'a', 'd',
+                                    0xc4, 0x01, 0xff,
+    };
+    const subsystem_t *sub;
+    full_t *full;
+    int err;
+
+    full = full_convert_lazy( basic, sizeof(basic) );
+    CU_ASSERT_FATAL( NULL != full );
+    CU_ASSERT( 0 == full->subsystems_count );
+    CU_ASSERT_FATAL( 3 == full->index_count );
+    CU_ASSERT( NULL == full->index[0].copy );
+    CU_ASSERT_NSTRING_EQUAL( "url2", &basic[full->index[1].url], 4 );
+    CU_ASSERT( 2 == full->index[1].payload_len );
+
+    sub = full_get( full, "url2" );
+    CU_ASSERT_FATAL( NULL != sub );
+    CU_ASSERT_STRING_EQUAL( "url2", sub->url );
+    CU_ASSERT( 4 == sub->url_len );
+    CU_ASSERT_FATAL( 2 == sub->payload_len );
+    CU_ASSERT( 0xfe == sub->payload[0] );
+    CU_ASSERT( (const uint8_t*) sub->payload != &basic[full->index[1].payload] );
+
+    /* Only what was requested is copied, once. */
+    CU_ASSERT( sub == full->index[1].copy );
+    CU_ASSERT( NULL == full->index[0].copy );
+    CU_ASSERT( NULL == full->index[2].copy );
+    CU_ASSERT( sub == full_get(full, "url2") );
+
+    sub = full_get( full, "url1" );
+    CU_ASSERT_FATAL( NULL != sub );
+    CU_ASSERT( 0 == sub->payload_len );
+    CU_ASSERT( NULL == sub->payload );
+
+    CU_ASSERT( NULL == full_get(full, "url") );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Subsystem not found.", full_strerror(err) );
+
+    full_destroy( full );
+
+    /* The eager results can be searched too. */
+    full = full_convert( basic, sizeof(basic) );
+    CU_ASSERT_FATAL( NULL != full );
+    sub = full_get( full, "url3" );
+    CU_ASSERT( sub == &full->subsystems[2] );
+    CU_ASSERT( NULL == full_get(full, "url4") );
+    full_destroy( full );
+}
+
 void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Full", test_basic);
+    CU_add_test( *suite, "View", test_view);
     CU_add_test( *suite, "No Optionals", test_no_optional);
+    CU_add_test( *suite, "Skipped Elements", test_skipped);
+    CU_add_test( *suite, "Lazy", test_lazy);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -45,6 +45,27 @@ void test_basic()
     gre_destroy( gre );
 }
 
+void test_view()
+{
+    const uint8_t basic[] = {
+        0x81,
+            0xa3, 'g', 'r', 'e',
+                0x81,
+                    0xb7, 'p', 'r', 'i', 'm', 'a', 'r', 'y', '-', 'r', 'e', 'm', 'o', 't', 'e', '-', 'e', 'n', 'd', 'p', 'o', 'i', 'n', 't',
+                        0xa4, 'u', 'r', 'l', '1',
+    };
+    gre_t *gre;
+
+    gre = gre_convert_view( basic, sizeof(basic) );
+
+    CU_ASSERT_FATAL( NULL != gre );
+    CU_ASSERT( (const uint8_t*) gre->primary_remote_endpoint == &basic[sizeof(basic) - 4] );
+    CU_ASSERT( 4 == gre->primary_remote_endpoint_len );
+    CU_ASSERT( NULL == gre->secondary_remote_endpoint );
+
+    gre_destroy( gre );
+}
+
 void test_no_optional()
 {
     const uint8_t basic[] = {
@@ -69,6 +90,7 @@ void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Full", test_basic);
+    CU_add_test( *suite, "View", test_view);
     CU_add_test( *suite, "No Optionals", test_no_optional);
 }
 
@@ -14,10 +14,20 @@
   * limitations under the License.
   *
  */
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 
 #include <CUnit/Basic.h>
 #include "../src/http.h"
+#include "../src/http_cache.h"
+#include "loopback.h"
 
 void test_simple()
 {
@@ -47,11 +57,762 @@ void test_simple()
     http_destroy( &resp );
 }
 
+/* A keep-alive HTTP/1.1 server on the loopback.  Each connection is served
+ * by its own thread, answers every request with its path after delay_ms and
+ * is counted.  A path of /size/N is answered with N bytes instead, and
+ * /close/N with N bytes without a Content-Length.  /gzip is answered with
+ * the gzipped text if the client accepts it, and /headers with the request
+ * headers.  A path starting with /etag is answered with the path & the
+ * current etag, or 304 if the request already has it.  /resume is answered
+ * with the text, gzipped if the client accepts it, from the Range asked for
+ * if the If-Range matches its strong ETag. */
+typedef struct {
+    loopback_t l;
+    int delay_ms;
+    char etag[16];
+    pthread_mutex_t lock;
+} server_t;
+
+/* "webcfg " 200 times, gzipped. */
+static const uint8_t gzipped[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x2b, 0x4f, 0x4d,
+    0x4a, 0x4e, 0x4b, 0x57, 0x28, 0x1f, 0xa5, 0x46, 0xa9, 0x51, 0x6a, 0x94, 0x1a,
+    0xa5, 0xe8, 0x43, 0x01, 0x00, 0x7e, 0x9d, 0xb1, 0x0b, 0x78, 0x05, 0x00, 0x00
+};
+
+static void send_gzipped( int fd, const char *request )
+{
+    char head[128];
+    int len;
+
+    if( NULL == strstr(request, "gzip") ) {
+        len = snprintf( head, sizeof(head),
+                        "HTTP/1.1 406 Not Acceptable\r\nContent-Length: 0\r\n\r\n" );
+        send( fd, head, len, MSG_NOSIGNAL );
+        return;
+    }
+
+    len = snprintf( head, sizeof(head),
+                    "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\n"
+                    "Content-Length: %zu\r\n\r\n", sizeof(gzipped) );
+    send( fd, head, len, MSG_NOSIGNAL );
+    send( fd, gzipped, sizeof(gzipped), MSG_NOSIGNAL );
+}
+
+static void send_resumable( int fd, const char *request )
+{
+    const char *range = strstr( request, "\r\nRange: bytes=" );
+    bool gzip = (NULL != strstr(request, "gzip"));
+    char text[1400];
+    const void *body = text;
+    size_t len = sizeof(text), from = 0;
+    char head[256];
+    int head_len;
+
+    if( gzip ) {
+        body = gzipped;
+        len = sizeof(gzipped);
+    } else {
+        for( from = 0; from < sizeof(text); from += 7 ) {
+            memcpy( &text[from], "webcfg ", 7 );
+        }
+        from = 0;
+    }
+
+    if( (NULL != range) && (NULL != strstr(request, "\r\nIf-Range: \"text\"\r\n")) ) {
+        from = strtoul( &range[15], NULL, 10 );
+        if( len <= from ) {
+            from = 0;
+        }
+    }
+
+    if( 0 < from ) {
+        head_len = snprintf( head, sizeof(head),
+                             "HTTP/1.1 206 Partial Content\r\nETag: \"text\"\r\n%s"
+                             "Content-Range: bytes %zu-%zu/%zu\r\n"
+                             "Content-Length: %zu\r\n\r\n",
+                             gzip ? "Content-Encoding: gzip\r\n" : "",
+                             from, len - 1, len, len - from );
+    } else {
+        head_len = snprintf( head, sizeof(head),
+                             "HTTP/1.1 200 OK\r\nETag: \"text\"\r\n%s"
+                             "Content-Length: %zu\r\n\r\n",
+                             gzip ? "Content-Encoding: gzip\r\n" : "", len );
+    }
+    send( fd, head, head_len, MSG_NOSIGNAL );
+    send( fd, &((const char*) body)[from], len - from, MSG_NOSIGNAL );
+}
+
+static void send_sized( int fd, const char *path )
+{
+    bool no_length = ('c' == path[1]);
+    size_t size = strtoul( strchr(&path[1], '/') + 1, NULL, 10 );
+    char *body;
+    char head[128];
+    int len;
+
+    if( no_length ) {
+        len = snprintf( head, sizeof(head),
+                        "HTTP/1.1 200 OK\r\nConnection: close\r\n\r\n" );
+    } else {
+        len = snprintf( head, sizeof(head),
+                        "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", size );
+    }
+    send( fd, head, len, MSG_NOSIGNAL );
+
+    body = (char*) malloc( size );
+    memset( body, 'x', size );
+    send( fd, body, size, MSG_NOSIGNAL );
+    free( body );
+}
+
+static void send_tagged( server_t *s, int fd, const char *request, const char *path )
+{
+    char match[64];
+    char out[256];
+    int len;
+
+    pthread_mutex_lock( &s->lock );
+    snprintf( match, sizeof(match), "IF-NONE-MATCH: \"%s\"\r\n", s->etag );
+    if( NULL != strstr(request, match) ) {
+        len = snprintf( out, sizeof(out),
+                        "HTTP/1.1 304 Not Modified\r\nETag: \"%s\"\r\n\r\n", s->etag );
+    } else {
+        len = snprintf( out, sizeof(out),
+                        "HTTP/1.1 200 OK\r\nETag: \"%s\"\r\nContent-Length: %zu\r\n\r\n%s %s",
+                        s->etag, strlen(path) + 1 + strlen(s->etag), path, s->etag );
+    }
+    pthread_mutex_unlock( &s->lock );
+
+    send( fd, out, len, MSG_NOSIGNAL );
+}
+
+static void serve( void *user_data, int fd )
+{
+    server_t *s = (server_t*) user_data;
+    loopback_request_t r;
+    char out[4200];
+
+    r.got = 0;
+    r.len = 0;
+    while( 0 < loopback_recv(fd, &r) ) {
+        char path[256];
+        int len;
+
+        if( 1 != sscanf(r.buf, "GET %255s ", path) ) {
+            break;
+        }
+        if( 0 < s->delay_ms ) {
+            usleep( s->delay_ms * 1000 );
+        }
+        if( 0 == strcmp(path, "/headers") ) {
+            char *start = strstr( r.buf, "\r\n" ) + 2;
+            size_t headers = strlen( start ) - 2;
+
+            len = snprintf( out, sizeof(out),
+                            "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n%.*s",
+                            headers, (int) headers, start );
+            send( fd, out, len, MSG_NOSIGNAL );
+            continue;
+        }
+        if( 0 == strncmp(path, "/etag", 5) ) {
+            send_tagged( s, fd, r.buf, path );
+            continue;
+        }
+        if( 0 == strcmp(path, "/gzip") ) {
+            send_gzipped( fd, r.buf );
+            continue;
+        }
+        if( 0 == strcmp(path, "/resume") ) {
+            send_resumable( fd, r.buf );
+            continue;
+        }
+        if( (0 == strncmp(path, "/size/", 6)) || (0 == strncmp(path, "/close/", 7)) ) {
+            send_sized( fd, path );
+            break;
+        }
+        len = snprintf( out, sizeof(out),
+                        "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n%s",
+                        strlen(path), path );
+        if( len != send(fd, out, len, MSG_NOSIGNAL) ) {
+            break;
+        }
+    }
+}
+
+static int server_start( server_t *s, int delay_ms )
+{
+    s->delay_ms = delay_ms;
+    s->etag[0] = '\0';
+    pthread_mutex_init( &s->lock, NULL );
+
+    return loopback_start( &s->l, true, serve, s );
+}
+
+/* The clients must have closed their connections first. */
+static void server_stop( server_t *s )
+{
+    loopback_stop( &s->l );
+    pthread_mutex_destroy( &s->lock );
+}
+
+static uint64_t now_ms( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void test_reuse()
+{
+    http_request_t req    = {
+        .auth             = NULL,
+        .cfg_ver          = "v1",
+        .schema_ver       = "v1",
+        .fw               = "fw",
+        .status           = "amazing",
+        .trans_id         = "1234",
+        .timeout_s        = 5,
+    };
+    http_response_t resp;
+    http_client_t *client;
+    server_t server;
+    char url[64];
+    long connects;
+    int i;
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/api/v2", server.l.port );
+    req.url = url;
+
+    client = http_client_create();
+    CU_ASSERT_FATAL( NULL != client );
+    req.client = client;
+
+    /* The second request goes out on the connection of the first. */
+    for( i = 0; i < 2; i++ ) {
+        CU_ASSERT( 0 == http_request(&req, &resp) );
+        CU_ASSERT( CURLE_OK == resp.code );
+        CU_ASSERT( 200 == resp.http_status );
+        CU_ASSERT( 7 == resp.len );
+        CU_ASSERT( 0 == memcmp("/api/v2", resp.data, 7) );
+        CU_ASSERT( client == resp.client );
+        CU_ASSERT( CURLE_OK == curl_easy_getinfo(resp.curl, CURLINFO_NUM_CONNECTS, &connects) );
+        CU_ASSERT( (0 == i) ? (1 == connects) : (0 == connects) );
+        http_destroy( &resp );
+    }
+
+    /* Destroying the client closes its connection, and without a client
+     * every request connects again. */
+    http_client_destroy( client );
+    req.client = NULL;
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( NULL == resp.client );
+    http_destroy( &resp );
+
+    server_stop( &server );
+    CU_ASSERT( 2 == server.l.connections );
+}
+
+void test_body()
+{
+    http_request_t req    = {
+        .cfg_ver          = "v1",
+        .schema_ver       = "v1",
+        .fw               = "fw",
+        .status           = "amazing",
+        .trans_id         = "1234",
+        .timeout_s        = 5,
+    };
+    http_response_t resp;
+    server_t server;
+    char small[4];
+    char big[64];
+    char url[64];
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+
+    /* The whole body is reserved at once from the Content-Length. */
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/size/100000", server.l.port );
+    req.url = url;
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 100000 == resp.len );
+    CU_ASSERT( 100000 == resp.size );
+    http_destroy( &resp );
+
+    /* Without one the buffer grows geometrically. */
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/close/100000", server.l.port );
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 100000 == resp.len );
+    CU_ASSERT( 100000 <= resp.size );
+    CU_ASSERT( resp.size < 2 * 100000 );
+    CU_ASSERT( 'x' == ((char*) resp.data)[99999] );
+    http_destroy( &resp );
+
+    /* A body that fits stays in the caller's buffer... */
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/api/v2", server.l.port );
+    req.body_buf = big;
+    req.body_buf_size = sizeof(big);
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( big == resp.data );
+    CU_ASSERT( 7 == resp.len );
+    CU_ASSERT( 0 == memcmp("/api/v2", big, 7) );
+    http_destroy( &resp );
+
+    /* ...and one that does not is moved out of it. */
+    req.body_buf = small;
+    req.body_buf_size = sizeof(small);
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( small != resp.data );
+    CU_ASSERT( 7 == resp.len );
+    CU_ASSERT( 0 == memcmp("/api/v2", resp.data, 7) );
+    http_destroy( &resp );
+
+    server_stop( &server );
+}
+
+static bool has_header( http_response_t *resp, const char *line )
+{
+    char text[4096];
+
+    if( sizeof(text) <= resp->len ) {
+        return false;
+    }
+    memcpy( text, resp->data, resp->len );
+    text[resp->len] = '\0';
+
+    return NULL != strstr( text, line );
+}
+
+void test_headers()
+{
+    http_request_t req    = {
+        .auth             = "secret",
+        .cfg_ver          = "NONE",
+        .schema_ver       = "v1.0",
+        .fw               = "fw",
+        .status           = "online",
+        .trans_id         = "1",
+        .boot_unixtime    = 10,
+        .ready_unixtime   = 20,
+        .current_unixtime = 30,
+        .timeout_s        = 5,
+    };
+    http_response_t resp;
+    http_client_t *client;
+    server_t server;
+    char url[64];
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/headers", server.l.port );
+    req.url = url;
+
+    client = http_client_create();
+    CU_ASSERT_FATAL( NULL != client );
+    req.client = client;
+
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( has_header(&resp, "Authorization: Bearer secret\r\n") );
+    CU_ASSERT( has_header(&resp, "IF-NONE-MATCH: NONE\r\n") );
+    CU_ASSERT( has_header(&resp, "Schema-Version: v1.0\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Firmware-Version: fw\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Status: online\r\n") );
+    CU_ASSERT( has_header(&resp, "Transaction-Id: 1\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Boot-Time: 10\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Ready-Time: 20\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Current-Time: 30") );
+    http_destroy( &resp );
+
+    /* The next poll patches the same headers. */
+    req.auth = NULL;
+    req.cfg_ver = "0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+    req.trans_id = "2";
+    req.current_unixtime = 1234567890;
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( !has_header(&resp, "Authorization") );
+    CU_ASSERT( has_header(&resp, "IF-NONE-MATCH: 0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef\r\n") );
+    CU_ASSERT( has_header(&resp, "Transaction-Id: 2\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Boot-Time: 10\r\n") );
+    CU_ASSERT( has_header(&resp, "X-System-Current-Time: 1234567890") );
+    http_destroy( &resp );
+
+    /* A request without the required values is refused. */
+    req.fw = NULL;
+    CU_ASSERT( -2 == http_request(&req, &resp) );
+    req.client = NULL;
+    CU_ASSERT( -2 == http_request(&req, &resp) );
+
+    http_client_destroy( client );
+    server_stop( &server );
+}
+
+static int count_sink( void *user_data, const void *buf, size_t len )
+{
+    size_t *count = (size_t*) user_data;
+
+    (void) buf;
+    *count += len;
+
+    return 0;
+}
+
+void test_compressed()
+{
+    http_request_t req    = {
+        .cfg_ver          = "v1",
+        .schema_ver       = "v1",
+        .fw               = "fw",
+        .status           = "amazing",
+        .trans_id         = "1234",
+        .timeout_s        = 5,
+    };
+    http_response_t resp;
+    server_t server;
+    char url[64];
+    size_t count = 0;
+    size_t i;
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/gzip", server.l.port );
+    req.url = url;
+
+    /* The body is decompressed & both sizes are reported. */
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( sizeof(gzipped) == resp.wire_len );
+    CU_ASSERT( 1400 == resp.body_len );
+    CU_ASSERT_FATAL( 1400 == resp.len );
+    for( i = 0; i < 1400; i += 7 ) {
+        CU_ASSERT( 0 == memcmp("webcfg ", &((char*) resp.data)[i], 7) );
+    }
+    http_destroy( &resp );
+
+    /* The write_fn only sees the decompressed bytes too. */
+    req.write_fn = count_sink;
+    req.write_data = &count;
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 1400 == count );
+    CU_ASSERT( 1400 == resp.body_len );
+    CU_ASSERT( sizeof(gzipped) == resp.wire_len );
+    CU_ASSERT( NULL == resp.data );
+    http_destroy( &resp );
+
+    server_stop( &server );
+}
+
+/* Checks the bytes are the text from where the body left off. */
+typedef struct {
+    size_t at;
+    bool ok;
+} text_sink_t;
+
+static int text_sink( void *user_data, const void *buf, size_t len )
+{
+    text_sink_t *t = (text_sink_t*) user_data;
+    size_t i;
+
+    for( i = 0; i < len; i++, t->at++ ) {
+        if( ((const char*) buf)[i] != "webcfg "[t->at % 7] ) {
+            t->ok = false;
+        }
+    }
+
+    return 0;
+}
+
+void test_resume()
+{
+    http_request_t req    = {
+        .cfg_ver          = "v1",
+        .schema_ver       = "v1",
+        .fw               = "fw",
+        .status           = "amazing",
+        .trans_id         = "1234",
+        .timeout_s        = 5,
+    };
+    http_response_t resp;
+    server_t server;
+    text_sink_t t;
+    char url[64];
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/resume", server.l.port );
+    req.url = url;
+    req.write_fn = text_sink;
+    req.write_data = &t;
+
+    /* The whole body is sent gzipped. */
+    t.at = 0;
+    t.ok = true;
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( sizeof(gzipped) == resp.wire_len );
+    CU_ASSERT( 1400 == t.at );
+    CU_ASSERT( true == t.ok );
+    http_destroy( &resp );
+
+    /* The rest is asked for uncompressed, as a range of the gzipped bytes
+     * doesn't follow on from the decompressed ones held. */
+    t.at = 700;
+    t.ok = true;
+    req.resume_from = 700;
+    req.if_range = "\"text\"";
+    CU_ASSERT( 0 == http_request(&req, &resp) );
+    CU_ASSERT( CURLE_OK == resp.code );
+    CU_ASSERT( 206 == resp.http_status );
+    CU_ASSERT( 700 == resp.resumed_from );
+    CU_ASSERT( 700 == resp.wire_len );
+    CU_ASSERT( 1400 == t.at );
+    CU_ASSERT( true == t.ok );
+    http_destroy( &resp );
+
+    server_stop( &server );
+}
+
+#define FETCH_COUNT     8
+#define FETCH_DELAY_MS  200
+
+typedef struct {
+    int calls;
+    int ok[FETCH_COUNT];
+    char *kept;
+} fetch_t;
+
+static void fetch_done( void *user_data, size_t index, http_response_t *resp )
+{
+    fetch_t *f = (fetch_t*) user_data;
+    char path[32];
+
+    snprintf( path, sizeof(path), "/subsystem/%zu", index );
+    f->calls++;
+    f->ok[index] = (CURLE_OK == resp->code) && (200 == resp->http_status) &&
+                   (strlen(path) == resp->len) &&
+                   (0 == memcmp(path, resp->data, resp->len));
+
+    /* Take one of the bodies. */
+    if( 3 == index ) {
+        f->kept = (char*) resp->data;
+        resp->data = NULL;
+    }
+}
+
+void test_fetch()
+{
+    http_request_t reqs[FETCH_COUNT];
+    char urls[FETCH_COUNT][64];
+    http_client_t *client;
+    server_t server;
+    fetch_t f;
+    uint64_t start, took;
+    int i;
+
+    CU_ASSERT_FATAL( 0 == server_start(&server, FETCH_DELAY_MS) );
+
+    memset( reqs, 0, sizeof(reqs) );
+    for( i = 0; i < FETCH_COUNT; i++ ) {
+        snprintf( urls[i], sizeof(urls[i]), "http://127.0.0.1:%d/subsystem/%d",
+                  server.l.port, i );
+        reqs[i].url        = urls[i];
+        reqs[i].cfg_ver    = "v1";
+        reqs[i].schema_ver = "v1";
+        reqs[i].fw         = "fw";
+        reqs[i].status     = "amazing";
+        reqs[i].trans_id   = "1234";
+        reqs[i].timeout_s  = 5;
+    }
+
+    client = http_client_create();
+    CU_ASSERT_FATAL( NULL != client );
+
+    memset( &f, 0, sizeof(f) );
+    start = now_ms();
+    CU_ASSERT( 0 == http_fetch(client, reqs, FETCH_COUNT, fetch_done, &f) );
+    took = now_ms() - start;
+
+    /* Every request was answered once, and they were waited on together. */
+    CU_ASSERT( FETCH_COUNT == f.calls );
+    for( i = 0; i < FETCH_COUNT; i++ ) {
+        CU_ASSERT( 1 == f.ok[i] );
+    }
+    CU_ASSERT( took < (FETCH_COUNT * FETCH_DELAY_MS) / 2 );
+    CU_ASSERT_FATAL( NULL != f.kept );
+    CU_ASSERT( 0 == memcmp("/subsystem/3", f.kept, 12) );
+    free( f.kept );
+
+    /* The connections are kept for the next batch. */
+    memset( &f, 0, sizeof(f) );
+    CU_ASSERT( 0 == http_fetch(client, reqs, 2, fetch_done, &f) );
+    CU_ASSERT( 2 == f.calls );
+    CU_ASSERT( FETCH_COUNT >= server.l.connections );
+    free( f.kept );
+
+    /* Bad requests are refused before any are made. */
+    reqs[1].fw = NULL;
+    memset( &f, 0, sizeof(f) );
+    CU_ASSERT( -2 == http_fetch(client, reqs, FETCH_COUNT, fetch_done, &f) );
+    CU_ASSERT( 0 == f.calls );
+    CU_ASSERT( -1 == http_fetch(NULL, reqs, FETCH_COUNT, fetch_done, &f) );
+    CU_ASSERT( 0 == http_fetch(client, reqs, 0, fetch_done, &f) );
+
+    http_client_destroy( client );
+    server_stop( &server );
+}
+
+static void set_etag( server_t *s, const char *etag )
+{
+    pthread_mutex_lock( &s->lock );
+    snprintf( s->etag, sizeof(s->etag), "%s", etag );
+    pthread_mutex_unlock( &s->lock );
+}
+
+static bool is_body( http_response_t *resp, const char *body )
+{
+    return (CURLE_OK == resp->code) && (strlen(body) == resp->len) &&
+           (0 == memcmp(body, resp->data, resp->len));
+}
+
+typedef struct {
+    int calls;
+    int hits;
+    int ok;
+} cache_fetch_t;
+
+static void cache_done( void *user_data, size_t index, http_response_t *resp )
+{
+    cache_fetch_t *f = (cache_fetch_t*) user_data;
+    char body[32];
+
+    snprintf( body, sizeof(body), "/etag/%zu b", index );
+    f->calls++;
+    f->hits += resp->cached ? 1 : 0;
+    f->ok += is_body( resp, body ) ? 1 : 0;
+}
+
+void test_cache()
+{
+    http_request_t req    = {
+        .cfg_ver          = "NONE",
+        .schema_ver       = "v1",
+        .fw               = "fw",
+        .status           = "amazing",
+        .trans_id         = "1234",
+        .timeout_s        = 5,
+    };
+    http_request_t reqs[2];
+    http_response_t resp;
+    http_client_t *client;
+    http_cache_t *cache;
+    server_t server;
+    cache_fetch_t f;
+    char dir[] = "/tmp/test_http_cache.XXXXXX";
+    char url[64], urls[2][64];
+    int i;
+
+    CU_ASSERT_FATAL( NULL != mkdtemp(dir) );
+    CU_ASSERT_FATAL( 0 == server_start(&server, 0) );
+    set_etag( &server, "a" );
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/etag", server.l.port );
+    req.url = url;
+
+    client = http_client_create();
+    cache = http_cache_create( dir );
+    CU_ASSERT_FATAL( NULL != client );
+    CU_ASSERT_FATAL( NULL != cache );
+    req.client = client;
+
+    /* The first request downloads & stores the body... */
+    CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( !resp.cached );
+    CU_ASSERT( is_body(&resp, "/etag a") );
+    CU_ASSERT( (NULL != resp.etag) && (0 == strcmp("\"a\"", resp.etag)) );
+    http_destroy( &resp );
+
+    /* ...and the next ones get it from the cache, even in a new one. */
+    for( i = 0; i < 2; i++ ) {
+        CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+        CU_ASSERT( 304 == resp.http_status );
+        CU_ASSERT( resp.cached );
+        CU_ASSERT( 0 == resp.wire_len );
+        CU_ASSERT( is_body(&resp, "/etag a") );
+        http_destroy( &resp );
+
+        http_cache_destroy( cache );
+        cache = http_cache_create( dir );
+        CU_ASSERT_FATAL( NULL != cache );
+    }
+
+    /* A new version replaces the stored one. */
+    set_etag( &server, "b" );
+    CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( is_body(&resp, "/etag b") );
+    http_destroy( &resp );
+    CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+    CU_ASSERT( resp.cached );
+    CU_ASSERT( is_body(&resp, "/etag b") );
+
+    /* The body can outlive the response. */
+    {
+        void *map = resp.map;
+        size_t map_len = resp.map_len;
+        const void *data = resp.data;
+
+        resp.map = NULL;
+        resp.data = NULL;
+        http_destroy( &resp );
+        CU_ASSERT( 0 == memcmp("/etag b", data, 7) );
+        munmap( map, map_len );
+    }
+
+    /* Each URL of a fetch is conditional on its own copy. */
+    memset( reqs, 0, sizeof(reqs) );
+    for( i = 0; i < 2; i++ ) {
+        snprintf( urls[i], sizeof(urls[i]), "http://127.0.0.1:%d/etag/%d", server.l.port, i );
+        memcpy( &reqs[i], &req, sizeof(http_request_t) );
+        reqs[i].url = urls[i];
+    }
+    memset( &f, 0, sizeof(f) );
+    CU_ASSERT( 0 == http_cache_fetch(cache, client, reqs, 2, cache_done, &f) );
+    CU_ASSERT( (2 == f.calls) && (0 == f.hits) && (2 == f.ok) );
+    memset( &f, 0, sizeof(f) );
+    CU_ASSERT( 0 == http_cache_fetch(cache, client, reqs, 2, cache_done, &f) );
+    CU_ASSERT( (2 == f.calls) && (2 == f.hits) && (2 == f.ok) );
+
+    /* A body without an ETag is not kept. */
+    snprintf( url, sizeof(url), "http://127.0.0.1:%d/plain", server.l.port );
+    CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+    CU_ASSERT( 200 == resp.http_status );
+    CU_ASSERT( NULL == resp.etag );
+    http_destroy( &resp );
+    CU_ASSERT( 0 == http_cache_request(cache, &req, &resp) );
+    CU_ASSERT( !resp.cached );
+    http_destroy( &resp );
+
+    CU_ASSERT( NULL == http_cache_create(NULL) );
+    CU_ASSERT( -1 == http_cache_request(NULL, &req, &resp) );
+
+    http_cache_destroy( cache );
+    http_client_destroy( client );
+    server_stop( &server );
+
+    /* Three URLs were stored. */
+    CU_ASSERT( 3 == remove_dir(dir) );
+}
 
 void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Add header", test_simple);
+    CU_add_test( *suite, "Connection Reuse", test_reuse);
+    CU_add_test( *suite, "Fetch", test_fetch);
+    CU_add_test( *suite, "Body Buffer", test_body);
+    CU_add_test( *suite, "Compressed", test_compressed);
+    CU_add_test( *suite, "Resume", test_resume);
+    CU_add_test( *suite, "Headers", test_headers);
+    CU_add_test( *suite, "Cache", test_cache);
 }
 
 /*----------------------------------------------------------------------------*/
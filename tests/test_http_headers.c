@@ -15,6 +15,7 @@
   *
  */
 #include <stdint.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
 #include "../src/http_headers.h"
@@ -42,11 +43,48 @@ void test_add_header()
     CU_ASSERT( 0 == rv );
 }
 
+void test_header_slot()
+{
+    header_slot_t s;
+    char *buf;
+    char big[300];
+
+    CU_ASSERT_FATAL( 0 == header_slot_init(&s, "Transaction-Id: ") );
+    CU_ASSERT_STRING_EQUAL( "Transaction-Id: ", s.node.data );
+    CU_ASSERT( NULL == s.node.next );
+
+    CU_ASSERT( 0 == header_slot_set(&s, "1234") );
+    CU_ASSERT_STRING_EQUAL( "Transaction-Id: 1234", s.node.data );
+
+    /* Values that fit are written in place. */
+    buf = s.buf;
+    CU_ASSERT( 0 == header_slot_set(&s, "5") );
+    CU_ASSERT_STRING_EQUAL( "Transaction-Id: 5", s.node.data );
+    CU_ASSERT( buf == s.node.data );
+
+    CU_ASSERT( 0 == header_slot_set_u32(&s, 0) );
+    CU_ASSERT_STRING_EQUAL( "Transaction-Id: 0", s.node.data );
+    CU_ASSERT( 0 == header_slot_set_u32(&s, 4294967295u) );
+    CU_ASSERT_STRING_EQUAL( "Transaction-Id: 4294967295", s.node.data );
+    CU_ASSERT( buf == s.node.data );
+
+    /* Longer ones grow the buffer. */
+    memset( big, 'a', sizeof(big) - 1 );
+    big[sizeof(big) - 1] = '\0';
+    CU_ASSERT( 0 == header_slot_set(&s, big) );
+    CU_ASSERT( 0 == strncmp("Transaction-Id: aaa", s.node.data, 19) );
+    CU_ASSERT( strlen("Transaction-Id: ") + sizeof(big) - 1 == strlen(s.node.data) );
+    CU_ASSERT( s.buf == s.node.data );
+
+    header_slot_destroy( &s );
+    CU_ASSERT( NULL == s.buf );
+}
 
 void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Add header", test_add_header);
+    CU_add_test( *suite, "Header slot", test_header_slot);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -0,0 +1,135 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/pool.h"
+
+#define JOBS 1000
+
+static void job( void *arg, size_t i )
+{
+    size_t *out = (size_t*) arg;
+
+    out[i] += i + 1;
+}
+
+static void check( pool_t *p )
+{
+    size_t out[JOBS];
+    size_t i;
+
+    memset( out, 0, sizeof(out) );
+    pool_run( p, JOBS, job, out );
+    pool_run( p, JOBS, job, out );
+    for( i = 0; i < JOBS; i++ ) {
+        CU_ASSERT( 2 * (i + 1) == out[i] );
+    }
+
+    pool_run( p, 0, job, NULL );
+    pool_run( p, 1, job, out );
+    CU_ASSERT( 3 == out[0] );
+}
+
+void test_run()
+{
+    pool_t *p;
+
+    check( NULL );
+
+    p = pool_create( 0 );
+    CU_ASSERT_FATAL( NULL != p );
+    check( p );
+    pool_destroy( p );
+
+    p = pool_create( 4 );
+    CU_ASSERT_FATAL( NULL != p );
+    check( p );
+    pool_destroy( p );
+
+    pool_destroy( NULL );
+}
+
+static void* runner( void *arg )
+{
+    int i;
+
+    for( i = 0; i < 50; i++ ) {
+        check( (pool_t*) arg );
+    }
+
+    return NULL;
+}
+
+void test_shared()
+{
+    pthread_t threads[3];
+    pool_t *p;
+    int i;
+
+    p = pool_create( 2 );
+    CU_ASSERT_FATAL( NULL != p );
+
+    /* Batches from several threads take turns. */
+    for( i = 0; i < 3; i++ ) {
+        CU_ASSERT_FATAL( 0 == pthread_create(&threads[i], NULL, runner, p) );
+    }
+    for( i = 0; i < 3; i++ ) {
+        pthread_join( threads[i], NULL );
+    }
+
+    pool_destroy( p );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Run", test_run);
+    CU_add_test( *suite, "Shared", test_shared);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
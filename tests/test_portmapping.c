@@ -16,9 +16,12 @@
  */
 #include <stdint.h>
 #include <errno.h>
+#include <string.h>
 
 #include <CUnit/Basic.h>
+#include "../src/helpers.h"
 #include "../src/portmapping.h"
+#include "mp.h"
 
 void test_basic()
 {
@@ -62,6 +65,15 @@ void test_basic()
     CU_ASSERT_STRING_EQUAL( "tcp", pm->entries[0].protocol );
 
     portmapping_destroy( pm );
+
+    pm = portmapping_convert_view( basic, sizeof(basic) );
+    CU_ASSERT_FATAL( NULL != pm );
+    CU_ASSERT_FATAL( 2 == pm->entries_count );
+    CU_ASSERT( (const uint8_t*) pm->entries[0].protocol == &basic[26] );
+    CU_ASSERT( 3 == pm->entries[0].protocol_len );
+    CU_ASSERT( 0 == strncmp("udp", pm->entries[1].protocol, pm->entries[1].protocol_len) );
+
+    portmapping_destroy( pm );
 }
 
 void test_no_optional()
@@ -78,17 +90,121 @@ void test_no_optional()
 
     CU_ASSERT( 0 == pm->entries_count );
     CU_ASSERT( NULL == pm->entries );
+    CU_ASSERT( NULL == pm->index );
 
     portmapping_destroy( pm );
 }
 
+/* A port mapping entry's protocol & external port range. */
+typedef struct {
+    const char *protocol;
+    uint16_t first;
+    uint16_t last;
+} range_t;
+
+/* Builds a port-mapping with the entries given, each targeting its index. */
+static void build( mp_t *mp, const range_t *r, size_t count )
+{
+    size_t i;
+
+    mp->len = 0;
+    mp_map( mp, 1 );
+    mp_str( mp, "port-mapping" );
+    mp_array( mp, count );
+    for( i = 0; i < count; i++ ) {
+        mp_map( mp, 4 );
+        mp_str( mp, "protocol" );
+        mp_str( mp, r[i].protocol );
+        mp_str( mp, "external-port-range" );
+        mp_array( mp, 2 );
+        mp_uint( mp, r[i].first );
+        mp_uint( mp, r[i].last );
+        mp_str( mp, "target-port" );
+        mp_uint( mp, i );
+        mp_str( mp, "target-ipv4" );
+        mp_uint( mp, 0x0a000001 );
+    }
+}
 
+void test_index()
+{
+    range_t r[200];
+    portmapping_t *pm;
+    const pm_entry_t *e;
+    mp_t mp = { NULL, 0, 0 };
+    size_t a, b, i;
+
+    /* Enough tcp entries for a bitmap, in reverse order, & a few udp. */
+    for( i = 0; i < 100; i++ ) {
+        r[i].protocol = "tcp";
+        r[i].first = (uint16_t) (10000 - i * 10);
+        r[i].last = (uint16_t) (10000 - i * 10 + 4);
+    }
+    for( ; i < 103; i++ ) {
+        r[i].protocol = "udp";
+        r[i].first = (uint16_t) (i * 100);
+        r[i].last = (uint16_t) (i * 100 + 50);
+    }
+
+    build( &mp, r, 103 );
+    pm = portmapping_convert( mp.buf, mp.len );
+    CU_ASSERT_FATAL( NULL != pm );
+    CU_ASSERT_FATAL( NULL != pm->index );
+    CU_ASSERT( 2 == pm->index->protocols_count );
+    CU_ASSERT( NULL != pm->index->protocols[0].ports );
+    CU_ASSERT( NULL == pm->index->protocols[1].ports );
+
+    e = portmapping_lookup( pm, "tcp", 3, 9992 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 1 == e->target_port );
+    CU_ASSERT( NULL == portmapping_lookup(pm, "tcp", 3, 9995) );
+    CU_ASSERT( NULL == portmapping_lookup(pm, "tcp", 3, 10150) );
+    CU_ASSERT( NULL == portmapping_lookup(pm, "sctp", 4, 10000) );
+    e = portmapping_lookup( pm, "udp", 3, 10150 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 101 == e->target_port );
+
+    CU_ASSERT( false == portmapping_overlaps(pm, &a, &b) );
+    CU_ASSERT( 0 == portmapping_validate(pm) );
+    portmapping_destroy( pm );
+
+    /* A wide range covers the ones after it. */
+    r[103].protocol = "tcp";
+    r[103].first = 9000;
+    r[103].last = 9500;
+    build( &mp, r, 104 );
+    pm = portmapping_convert_view( mp.buf, mp.len );
+    CU_ASSERT_FATAL( NULL != pm );
+    CU_ASSERT( true == portmapping_overlaps(pm, &a, &b) );
+    CU_ASSERT( (103 == a) && (99 == b) );
+    CU_ASSERT( 0 != portmapping_validate(pm) );
+    CU_ASSERT_STRING_EQUAL( "Overlapping 'external-port-range' values.",
+                            portmapping_strerror(errno) );
+    e = portmapping_lookup( pm, "tcp", 3, 9498 );
+    CU_ASSERT_FATAL( NULL != e );
+    CU_ASSERT( 103 == e->target_port );
+    portmapping_destroy( pm );
+
+    /* A range the wrong way around. */
+    r[0].first = 10004;
+    r[0].last = 10000;
+    build( &mp, r, 1 );
+    pm = portmapping_convert( mp.buf, mp.len );
+    CU_ASSERT_FATAL( NULL != pm );
+    /* Without a bitmap the arena was sized for the index as well. */
+    CU_ASSERT( NULL == helper_ctx(pm)->blocks );
+    CU_ASSERT( 0 != portmapping_validate(pm) );
+    CU_ASSERT( NULL == portmapping_lookup(pm, "tcp", 3, 10002) );
+    portmapping_destroy( pm );
+    mp_free( &mp );
+}
 
 void add_suites( CU_pSuite *suite )
 {
     *suite = CU_add_suite( "tests", NULL, NULL );
     CU_add_test( *suite, "Full", test_basic);
     CU_add_test( *suite, "No Optionals", test_no_optional);
+    CU_add_test( *suite, "Index", test_index);
 }
 
 /*----------------------------------------------------------------------------*/
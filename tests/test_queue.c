@@ -0,0 +1,150 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/queue.h"
+
+static int released;
+
+static void release( void *item )
+{
+    (void) item;
+    released++;
+}
+
+void test_order()
+{
+    int items[5];
+    queue_t *q;
+    int i;
+
+    CU_ASSERT( NULL == queue_create(0) );
+
+    q = queue_create( 3 );
+    CU_ASSERT_FATAL( NULL != q );
+
+    /* First in, first out. */
+    for( i = 0; i < 3; i++ ) {
+        CU_ASSERT( NULL == queue_push(q, &items[i]) );
+    }
+    CU_ASSERT( &items[0] == queue_pop(q) );
+
+    /* A full queue pushes out the oldest item. */
+    CU_ASSERT( NULL == queue_push(q, &items[3]) );
+    CU_ASSERT( &items[1] == queue_push(q, &items[4]) );
+    CU_ASSERT( &items[2] == queue_pop(q) );
+    CU_ASSERT( &items[3] == queue_pop(q) );
+
+    /* A closed queue takes nothing & gives nothing. */
+    queue_close( q );
+    CU_ASSERT( NULL == queue_pop(q) );
+    CU_ASSERT( &items[0] == queue_push(q, &items[0]) );
+
+    released = 0;
+    queue_destroy( q, release );
+    CU_ASSERT( 1 == released );
+
+    queue_destroy( NULL, release );
+}
+
+#define SENT 10000
+
+static void* consumer( void *arg )
+{
+    queue_t *q = (queue_t*) arg;
+    uintptr_t last = 0;
+    uintptr_t item;
+    size_t *bad = (size_t*) malloc( sizeof(size_t) );
+
+    *bad = 0;
+    while( 0 != (item = (uintptr_t) queue_pop(q)) ) {
+        /* Items may be skipped but never reordered. */
+        if( item <= last ) {
+            (*bad)++;
+        }
+        last = item;
+    }
+
+    return bad;
+}
+
+void test_threads()
+{
+    pthread_t t;
+    queue_t *q;
+    uintptr_t i;
+    size_t dropped = 0;
+    void *bad;
+
+    q = queue_create( 4 );
+    CU_ASSERT_FATAL( NULL != q );
+    CU_ASSERT_FATAL( 0 == pthread_create(&t, NULL, consumer, q) );
+
+    for( i = 1; i <= SENT; i++ ) {
+        if( NULL != queue_push(q, (void*) i) ) {
+            dropped++;
+        }
+    }
+    queue_close( q );
+    pthread_join( t, &bad );
+
+    CU_ASSERT( 0 == *(size_t*) bad );
+    CU_ASSERT( dropped < SENT );
+    free( bad );
+    queue_destroy( q, NULL );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Order", test_order);
+    CU_add_test( *suite, "Threads", test_threads);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -0,0 +1,154 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include "../src/sha256.h"
+
+static void hex( const uint8_t *digest, char *out )
+{
+    int i;
+
+    for( i = 0; i < SHA256_SIZE; i++ ) {
+        sprintf( &out[2 * i], "%02x", digest[i] );
+    }
+}
+
+static void check( const void *buf, size_t len, const char *expect )
+{
+    uint8_t digest[SHA256_SIZE];
+    char txt[2 * SHA256_SIZE + 1];
+    sha256_t s;
+
+    sha256( buf, len, digest );
+    hex( digest, txt );
+    CU_ASSERT_STRING_EQUAL( expect, txt );
+
+    sha256_init_portable( &s );
+    sha256_update( &s, buf, len );
+    sha256_final( &s, digest );
+    hex( digest, txt );
+    CU_ASSERT_STRING_EQUAL( expect, txt );
+}
+
+void test_vectors()
+{
+    static uint8_t million[1000000];
+
+    check( "", 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" );
+    check( "abc", 3, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" );
+    check( "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56,
+           "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" );
+    check( "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmno"
+           "ijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu", 112,
+           "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" );
+
+    memset( million, 'a', sizeof(million) );
+    check( million, sizeof(million),
+           "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" );
+}
+
+void test_chunks()
+{
+    uint8_t buf[1000];
+    uint8_t expect[SHA256_SIZE];
+    size_t len, chunk;
+    uint32_t seed = 1;
+
+    for( len = 0; len < sizeof(buf); len++ ) {
+        seed = seed * 1103515245 + 12345;
+        buf[len] = (uint8_t) (seed >> 16);
+    }
+
+    /* Every length around the block & padding boundaries, split every way. */
+    for( len = 0; len < 200; len++ ) {
+        sha256_t portable;
+
+        sha256_init_portable( &portable );
+        sha256_update( &portable, buf, len );
+        sha256_final( &portable, expect );
+
+        for( chunk = 1; chunk <= 70; chunk++ ) {
+            uint8_t digest[SHA256_SIZE];
+            sha256_t s;
+            size_t i;
+
+            sha256_init( &s );
+            for( i = 0; i < len; i += chunk ) {
+                sha256_update( &s, &buf[i], (len - i < chunk) ? (len - i) : chunk );
+            }
+            sha256_final( &s, digest );
+            CU_ASSERT( 0 == memcmp(expect, digest, SHA256_SIZE) );
+        }
+    }
+
+    /* The state can be copied to continue the hash elsewhere. */
+    {
+        uint8_t digest[SHA256_SIZE];
+        sha256_t s, copy;
+
+        sha256( buf, sizeof(buf), expect );
+        sha256_init( &s );
+        sha256_update( &s, buf, 333 );
+        memcpy( &copy, &s, sizeof(sha256_t) );
+        memset( &s, 0, sizeof(sha256_t) );
+        sha256_update( &copy, &buf[333], sizeof(buf) - 333 );
+        sha256_final( &copy, digest );
+        CU_ASSERT( 0 == memcmp(expect, digest, SHA256_SIZE) );
+    }
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Vectors", test_vectors);
+    CU_add_test( *suite, "Chunks", test_chunks);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+
+    printf( "SHA instructions: %s\n", sha256_accelerated() ? "yes" : "no" );
+
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
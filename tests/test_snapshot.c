@@ -0,0 +1,402 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <CUnit/Basic.h>
+#include "../src/snapshot.h"
+
+#define PATH "test_snapshot.bin"
+
+static void fill( all_t *cfg )
+{
+    static envelope_t full_env, dhcp_env;
+    static dhcp_static_t fixed[2];
+    static dhcp_t dhcp;
+    static char *filters[] = { "a filter", "" };
+    static size_t filter_lens[] = { 8, 0 };
+    static firewall_t firewall;
+    static gre_t gre;
+    static pm_entry_t entries[2];
+    static portmapping_t pm;
+    static wifi_ap_t aps[1];
+    static wifi_t wifi;
+    static xdns_t xdns;
+
+    memset( cfg, 0, sizeof(all_t) );
+
+    full_env.schema.base = "full";
+    full_env.schema.base_len = 4;
+    full_env.schema.major = 1;
+    memset( full_env.sha256, 0xaa, sizeof(full_env.sha256) );
+    cfg->full_envelope = &full_env;
+
+    dhcp_env.schema.base = "dhcp";
+    dhcp_env.schema.base_len = 4;
+    dhcp_env.schema.minor = 2;
+    dhcp_env.schema.patch = 3;
+    memset( dhcp_env.sha256, 0x55, sizeof(dhcp_env.sha256) );
+    cfg->dhcp_envelope = &dhcp_env;
+
+    memcpy( fixed[0].mac, "\x01\x02\x03\x04\x05\x06", 6 );
+    fixed[0].ip = 0x0a000002;
+    memcpy( fixed[1].mac, "\x11\x12\x13\x14\x15\x16", 6 );
+    fixed[1].ip = 0x0a000003;
+    dhcp.router_ip = 0x0a000001;
+    dhcp.subnet_mask = 0xffffff00;
+    dhcp.pool_range[0] = 0x0a000064;
+    dhcp.pool_range[1] = 0x0a0000c8;
+    dhcp.lease_length = 3600;
+    dhcp.fixed = fixed;
+    dhcp.fixed_count = 2;
+    cfg->dhcp = &dhcp;
+
+    firewall.level = "high";
+    firewall.level_len = 4;
+    firewall.filters = filters;
+    firewall.filter_lens = filter_lens;
+    firewall.filters_count = 2;
+    cfg->firewall = &firewall;
+
+    gre.primary_remote_endpoint = "primary.example.com";
+    gre.primary_remote_endpoint_len = 19;
+    cfg->gre = &gre;
+
+    entries[0].protocol = "tcp";
+    entries[0].protocol_len = 3;
+    entries[0].port_range[0] = 80;
+    entries[0].port_range[1] = 88;
+    entries[0].target_port = 8080;
+    entries[0].ip_version = 4;
+    entries[0].ip.v4 = 0xc0a80001;
+    entries[1].protocol = "udp";
+    entries[1].protocol_len = 3;
+    entries[1].ip_version = 6;
+    memset( entries[1].ip.v6, 0xfe, 16 );
+    pm.entries = entries;
+    pm.entries_count = 2;
+    cfg->portmapping = &pm;
+
+    aps[0].name = "home";
+    aps[0].ssid = "ssid";
+    aps[0].security_mode = "wpa2";
+    wifi.config_5g.extension_channel = '+';
+    wifi.config_5g.channel = 36;
+    wifi.config_5g.bandwith = 80;
+    wifi.config_5g.standards = "ac";
+    wifi.config_5g.standards_count = 2;
+    wifi.config_5g.aps = aps;
+    wifi.config_5g.aps_count = 1;
+    wifi.config_5g.dfs_enabled = true;
+    wifi.config_5g.basic_rate = "6";
+    wifi.config_5g.tx_power = 100;
+    wifi.config_2g.channel = 6;
+    cfg->wifi = &wifi;
+
+    xdns.default_ipv4 = 0x08080808;
+    memset( xdns.default_ipv6, 0x20, 16 );
+    cfg->xdns = &xdns;
+}
+
+void test_roundtrip()
+{
+    const snapshot_t *s;
+    const snapshot_envelope_t *env;
+    const snapshot_dhcp_t *dhcp;
+    const dhcp_static_t *fixed;
+    const snapshot_firewall_t *fw;
+    const snapshot_str_t *filters;
+    const snapshot_gre_t *gre;
+    const snapshot_portmapping_t *pm;
+    const snapshot_pm_entry_t *entries;
+    const snapshot_wifi_t *wifi;
+    const snapshot_wifi_ap_t *aps;
+    const xdns_t *xdns;
+    all_t cfg;
+
+    fill( &cfg );
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    CU_ASSERT( 0 != access(PATH ".tmp", F_OK) );
+
+    s = snapshot_map( PATH );
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( SNAPSHOT_VERSION == s->version );
+    CU_ASSERT( s->strings + s->strings_size == s->size );
+
+    env = snapshot_at( s, s->full_envelope, sizeof(snapshot_envelope_t) );
+    CU_ASSERT_FATAL( NULL != env );
+    CU_ASSERT_STRING_EQUAL( "full", snapshot_str(s, env->base) );
+    CU_ASSERT( 1 == env->major );
+    CU_ASSERT( 0xaa == env->sha256[31] );
+
+    env = snapshot_at( s, s->dhcp.envelope, sizeof(snapshot_envelope_t) );
+    CU_ASSERT_FATAL( NULL != env );
+    CU_ASSERT_STRING_EQUAL( "dhcp", snapshot_str(s, env->base) );
+    CU_ASSERT( 2 == env->minor );
+    CU_ASSERT( 3 == env->patch );
+
+    dhcp = snapshot_at( s, s->dhcp.data, sizeof(snapshot_dhcp_t) );
+    CU_ASSERT_FATAL( NULL != dhcp );
+    CU_ASSERT( 0x0a000001 == dhcp->router_ip );
+    CU_ASSERT( 0xffffff00 == dhcp->subnet_mask );
+    CU_ASSERT( 0x0a0000c8 == dhcp->pool_range[1] );
+    CU_ASSERT( 3600 == dhcp->lease_length );
+    CU_ASSERT( 2 == dhcp->fixed.count );
+    fixed = snapshot_array( s, dhcp->fixed, sizeof(dhcp_static_t) );
+    CU_ASSERT_FATAL( NULL != fixed );
+    CU_ASSERT( 0 == memcmp("\x11\x12\x13\x14\x15\x16", fixed[1].mac, 6) );
+    CU_ASSERT( 0x0a000003 == fixed[1].ip );
+
+    fw = snapshot_at( s, s->firewall.data, sizeof(snapshot_firewall_t) );
+    CU_ASSERT_FATAL( NULL != fw );
+    CU_ASSERT( NULL == snapshot_at(s, s->firewall.envelope, sizeof(snapshot_envelope_t)) );
+    CU_ASSERT_STRING_EQUAL( "high", snapshot_str(s, fw->level) );
+    filters = snapshot_array( s, fw->filters, sizeof(snapshot_str_t) );
+    CU_ASSERT_FATAL( NULL != filters );
+    CU_ASSERT_STRING_EQUAL( "a filter", snapshot_str(s, filters[0]) );
+    CU_ASSERT_STRING_EQUAL( "", snapshot_str(s, filters[1]) );
+
+    gre = snapshot_at( s, s->gre.data, sizeof(snapshot_gre_t) );
+    CU_ASSERT_FATAL( NULL != gre );
+    CU_ASSERT_STRING_EQUAL( "primary.example.com", snapshot_str(s, gre->primary_remote_endpoint) );
+    CU_ASSERT( NULL == snapshot_str(s, gre->secondary_remote_endpoint) );
+
+    pm = snapshot_at( s, s->portmapping.data, sizeof(snapshot_portmapping_t) );
+    CU_ASSERT_FATAL( NULL != pm );
+    entries = snapshot_array( s, pm->entries, sizeof(snapshot_pm_entry_t) );
+    CU_ASSERT_FATAL( NULL != entries );
+    CU_ASSERT( 2 == pm->entries.count );
+    CU_ASSERT_STRING_EQUAL( "tcp", snapshot_str(s, entries[0].protocol) );
+    CU_ASSERT( 88 == entries[0].port_range[1] );
+    CU_ASSERT( 8080 == entries[0].target_port );
+    CU_ASSERT( 0xc0a80001 == entries[0].ip.v4 );
+    CU_ASSERT( 6 == entries[1].ip_version );
+    CU_ASSERT( 0xfe == entries[1].ip.v6[15] );
+
+    wifi = snapshot_at( s, s->wifi.data, sizeof(snapshot_wifi_t) );
+    CU_ASSERT_FATAL( NULL != wifi );
+    CU_ASSERT( '+' == wifi->config_5g.extension_channel );
+    CU_ASSERT( 36 == wifi->config_5g.channel );
+    CU_ASSERT( 1 == wifi->config_5g.dfs_enabled );
+    CU_ASSERT_STRING_EQUAL( "ac", snapshot_str(s, wifi->config_5g.standards) );
+    CU_ASSERT_STRING_EQUAL( "6", snapshot_str(s, wifi->config_5g.basic_rate) );
+    CU_ASSERT( 100 == wifi->config_5g.tx_power );
+    aps = snapshot_array( s, wifi->config_5g.aps, sizeof(snapshot_wifi_ap_t) );
+    CU_ASSERT_FATAL( NULL != aps );
+    CU_ASSERT_STRING_EQUAL( "ssid", snapshot_str(s, aps[0].ssid) );
+    CU_ASSERT( NULL == snapshot_str(s, aps[0].password) );
+    CU_ASSERT( 6 == wifi->config_2g.channel );
+    CU_ASSERT( NULL == snapshot_array(s, wifi->config_2g.aps, sizeof(snapshot_wifi_ap_t)) );
+
+    xdns = snapshot_at( s, s->xdns.data, sizeof(xdns_t) );
+    CU_ASSERT_FATAL( NULL != xdns );
+    CU_ASSERT( 0x08080808 == xdns->default_ipv4 );
+
+    /* References outside of the image. */
+    CU_ASSERT( NULL == snapshot_at(s, (uint32_t) s->size, 1) );
+    CU_ASSERT( NULL == snapshot_at(s, 8, (size_t) s->size) );
+    {
+        snapshot_array_t a = { .off = 8, .count = UINT32_MAX };
+        snapshot_str_t str = { .off = (uint32_t) s->size - 1, .len = 1 };
+
+        CU_ASSERT( NULL == snapshot_array(s, a, 64) );
+        CU_ASSERT( NULL == snapshot_str(s, str) );
+    }
+
+    snapshot_unmap( s );
+    snapshot_unmap( NULL );
+
+    /* An empty configuration & replacing the file. */
+    memset( &cfg, 0, sizeof(all_t) );
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    s = snapshot_map( PATH );
+    CU_ASSERT_FATAL( NULL != s );
+    CU_ASSERT( 0 == s->dhcp.data );
+    CU_ASSERT( NULL == snapshot_at(s, s->dhcp.data, sizeof(snapshot_dhcp_t)) );
+    snapshot_unmap( s );
+
+    unlink( PATH );
+}
+
+void test_rebuild()
+{
+    const snapshot_t *s;
+    all_t cfg, *all;
+
+    fill( &cfg );
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    s = snapshot_map( PATH );
+    CU_ASSERT_FATAL( NULL != s );
+
+    all = snapshot_all( s );
+    CU_ASSERT_FATAL( NULL != all );
+    CU_ASSERT( (void*) s == all->view );
+
+    CU_ASSERT_FATAL( NULL != all->full_envelope );
+    CU_ASSERT_STRING_EQUAL( "full", all->full_envelope->schema.base );
+    CU_ASSERT( 0xaa == all->full_envelope->sha256[31] );
+    CU_ASSERT( NULL == all->full_envelope->payload );
+    CU_ASSERT( 3 == all->dhcp_envelope->schema.patch );
+    CU_ASSERT( NULL == all->firewall_envelope );
+
+    CU_ASSERT_FATAL( NULL != all->dhcp );
+    CU_ASSERT( 3600 == all->dhcp->lease_length );
+    CU_ASSERT( 2 == all->dhcp->fixed_count );
+    /* The dhcp can be indexed like a decoded one. */
+    CU_ASSERT( 0 == dhcp_index(all->dhcp) );
+    CU_ASSERT_FATAL( NULL != all->dhcp->index );
+    CU_ASSERT( &all->dhcp->fixed[1] == dhcp_find_ip(all->dhcp, 0x0a000003) );
+    CU_ASSERT( &all->dhcp->fixed[0] == dhcp_find_mac(all->dhcp, (const uint8_t*) "\x01\x02\x03\x04\x05\x06") );
+
+    CU_ASSERT_FATAL( NULL != all->firewall );
+    CU_ASSERT_STRING_EQUAL( "high", all->firewall->level );
+    CU_ASSERT( 2 == all->firewall->filters_count );
+    CU_ASSERT( 8 == all->firewall->filter_lens[0] );
+    CU_ASSERT_STRING_EQUAL( "", all->firewall->filters[1] );
+
+    CU_ASSERT_FATAL( NULL != all->gre );
+    CU_ASSERT( 19 == all->gre->primary_remote_endpoint_len );
+    CU_ASSERT( NULL == all->gre->secondary_remote_endpoint );
+
+    CU_ASSERT_FATAL( NULL != all->portmapping );
+    CU_ASSERT( 2 == all->portmapping->entries_count );
+    CU_ASSERT( &all->portmapping->entries[0] == portmapping_lookup(all->portmapping, "tcp", 3, 84) );
+    CU_ASSERT( 0xfe == all->portmapping->entries[1].ip.v6[15] );
+
+    CU_ASSERT_FATAL( NULL != all->wifi );
+    CU_ASSERT( 2 == all->wifi->config_5g.standards_count );
+    CU_ASSERT( 1 == all->wifi->config_5g.aps_count );
+    CU_ASSERT_STRING_EQUAL( "wpa2", all->wifi->config_5g.aps[0].security_mode );
+    CU_ASSERT( NULL == all->wifi->config_5g.aps[0].password );
+    CU_ASSERT( true == all->wifi->config_5g.dfs_enabled );
+    CU_ASSERT( 0 == all->wifi->config_2g.aps_count );
+
+    CU_ASSERT_FATAL( NULL != all->xdns );
+    CU_ASSERT( 0x08080808 == all->xdns->default_ipv4 );
+
+    /* The image goes with the configuration. */
+    all_destroy( all );
+
+    /* An empty configuration. */
+    memset( &cfg, 0, sizeof(all_t) );
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    s = snapshot_map( PATH );
+    CU_ASSERT_FATAL( NULL != s );
+    all = snapshot_all( s );
+    CU_ASSERT_FATAL( NULL != all );
+    CU_ASSERT( NULL == all->full_envelope );
+    CU_ASSERT( NULL == all->dhcp );
+    all_destroy( all );
+
+    unlink( PATH );
+}
+
+static void corrupt( long offset, uint8_t value )
+{
+    FILE *f = fopen( PATH, "r+b" );
+
+    CU_ASSERT_FATAL( NULL != f );
+    fseek( f, offset, SEEK_SET );
+    fwrite( &value, 1, 1, f );
+    fclose( f );
+}
+
+void test_errors()
+{
+    all_t cfg;
+    int err;
+
+    fill( &cfg );
+
+    CU_ASSERT( NULL == snapshot_map("does-not-exist.bin") );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Unable to access the file.", snapshot_strerror(err) );
+
+    CU_ASSERT( 0 != snapshot_write("no-such-dir/test_snapshot.bin", &cfg) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Unable to access the file.", snapshot_strerror(err) );
+
+    /* Flipped bits anywhere after the header. */
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    corrupt( sizeof(snapshot_t) + 3, 0xff );
+    CU_ASSERT( NULL == snapshot_map(PATH) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "The checksum does not match.", snapshot_strerror(err) );
+
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    corrupt( 0, 'X' );
+    CU_ASSERT( NULL == snapshot_map(PATH) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "Invalid header.", snapshot_strerror(err) );
+
+    CU_ASSERT_FATAL( 0 == snapshot_write(PATH, &cfg) );
+    CU_ASSERT_FATAL( 0 == truncate(PATH, sizeof(snapshot_t) + 1) );
+    CU_ASSERT( NULL == snapshot_map(PATH) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "The file is the wrong size.", snapshot_strerror(err) );
+
+    CU_ASSERT_FATAL( 0 == truncate(PATH, 10) );
+    CU_ASSERT( NULL == snapshot_map(PATH) );
+    err = errno;
+    CU_ASSERT_STRING_EQUAL( "The file is the wrong size.", snapshot_strerror(err) );
+
+    unlink( PATH );
+
+    CU_ASSERT_STRING_EQUAL( "No errors.", snapshot_strerror(0) );
+    CU_ASSERT_STRING_EQUAL( "Unknown error.", snapshot_strerror(-1) );
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Round Trip", test_roundtrip);
+    CU_add_test( *suite, "Rebuild", test_rebuild);
+    CU_add_test( *suite, "Errors", test_errors);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+
+    }
+
+    return rv;
+}
@@ -0,0 +1,1022 @@
+ /**
+  * Copyright 2020 Comcast Cable Communications Management, LLC
+  *
+  * Licensed under the Apache License, Version 2.0 (the "License");
+  * you may not use this file except in compliance with the License.
+  * You may obtain a copy of the License at
+  *
+  *     http://www.apache.org/licenses/LICENSE-2.0
+  *
+  * Unless required by applicable law or agreed to in writing, software
+  * distributed under the License is distributed on an "AS IS" BASIS,
+  * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+  * See the License for the specific language governing permissions and
+  * limitations under the License.
+  *
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include <CUnit/Basic.h>
+#include "../src/webcfg.h"
+#include "../src/sha256.h"
+#include "loopback.h"
+#include "mp.h"
+
+static uint8_t xdns[] = {
+    0x81,
+        0xa4, 'x', 'd', 'n', 's',
+            0x82,
+                0xac, 'd', 'e', 'f', 'a', 'u', 'l', 't', '-', 'i', 'p', 'v', '4',
+                    0xce, 0x4c, 0x4c, 0x4c, 0x4c,
+                0xac, 'd', 'e', 'f', 'a', 'u', 'l', 't', '-', 'i', 'p', 'v', '6',
+                    0xc4, 0x10, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+};
+
+/* Where default-ipv4 is in xdns[], to make a different config. */
+#define XDNS_IPV4   21
+
+/* The config the server hands out & its version. */
+static mp_t config;
+static char config_ver[2 * SHA256_SIZE + 1];
+
+static const uint8_t gre[] = {
+    0x81,
+        0xa3, 'g', 'r', 'e',
+            0x80,
+};
+
+static void build_config( void )
+{
+    mp_t full = { NULL, 0, 0 }, sub = { NULL, 0, 0 }, sub2 = { NULL, 0, 0 };
+    uint8_t digest[SHA256_SIZE];
+    int i;
+
+    sha256( xdns, sizeof(xdns), digest );
+    mp_envelope( &sub, "xdns", xdns, sizeof(xdns), digest );
+    sha256( gre, sizeof(gre), digest );
+    mp_envelope( &sub2, "gre", gre, sizeof(gre), digest );
+
+    mp_map( &full, 1 );
+    mp_str( &full, "full" );
+    mp_map( &full, 1 );
+    mp_str( &full, "subsystems" );
+    mp_array( &full, 2 );
+    mp_map( &full, 2 );
+    mp_str( &full, "url" );
+    mp_str( &full, "http://example.com/xdns" );
+    mp_str( &full, "payload" );
+    mp_bin( &full, sub.buf, sub.len );
+    mp_map( &full, 2 );
+    mp_str( &full, "url" );
+    mp_str( &full, "http://example.com/gre" );
+    mp_str( &full, "payload" );
+    mp_bin( &full, sub2.buf, sub2.len );
+
+    sha256( full.buf, full.len, digest );
+    config.len = 0;
+    mp_envelope( &config, "full", full.buf, full.len, digest );
+    mp_free( &full );
+    mp_free( &sub );
+    mp_free( &sub2 );
+    for( i = 0; i < SHA256_SIZE; i++ ) {
+        sprintf( &config_ver[2 * i], "%02x", digest[i] );
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/* A single connection HTTP/1.1 server on the loopback.  It answers with the  */
+/* config & its version as the ETag, or a 304 when asked for the version it  */
+/* already has.  Ranges are honoured while the If-Range matches the ETag.     */
+/*----------------------------------------------------------------------------*/
+typedef struct {
+    loopback_t l;
+    int requests;
+    int not_modified;
+    int bodies;
+    int partial;                /* 206 responses. */
+    size_t sent;                /* Body bytes sent. */
+    size_t drop_after;          /* Cut the next body short after this many bytes. */
+    int generation;             /* Part of the ETag. */
+    bool stall;                 /* Send no body until the client gives up. */
+} server_t;
+
+static void serve( void *user_data, int c )
+{
+    server_t *s = (server_t*) user_data;
+    loopback_request_t r;
+    char head[256];
+    char etag[128];
+    char v[256];
+
+    r.got = 0;
+    r.len = 0;
+    while( 0 < loopback_recv(c, &r) ) {
+        size_t from = 0, count;
+        int len;
+
+        s->requests++;
+        snprintf( etag, sizeof(etag), "\"%s.%d\"", config_ver, s->generation );
+
+        if( loopback_header(r.buf, "\r\nIF-NONE-MATCH: ", v, sizeof(v)) && (NULL != strstr(v, config_ver)) ) {
+            s->not_modified++;
+            len = snprintf( head, sizeof(head),
+                            "HTTP/1.1 304 Not Modified\r\nETag: %s\r\n"
+                            "Content-Length: 0\r\n\r\n", etag );
+            send( c, head, len, MSG_NOSIGNAL );
+        } else {
+            if( loopback_header(r.buf, "\r\nRange: bytes=", v, sizeof(v)) ) {
+                from = strtoul( v, NULL, 10 );
+                if( !loopback_header(r.buf, "\r\nIf-Range: ", v, sizeof(v)) || (0 != strcmp(v, etag)) ||
+                    (config.len <= from) )
+                {
+                    from = 0;
+                }
+            }
+
+            count = config.len - from;
+            if( 0 < from ) {
+                s->partial++;
+                len = snprintf( head, sizeof(head),
+                                "HTTP/1.1 206 Partial Content\r\nETag: %s\r\n"
+                                "Content-Range: bytes %zu-%zu/%zu\r\n"
+                                "Content-Length: %zu\r\n\r\n",
+                                etag, from, config.len - 1, config.len, count );
+            } else {
+                s->bodies++;
+                len = snprintf( head, sizeof(head),
+                                "HTTP/1.1 200 OK\r\nETag: %s\r\n"
+                                "Content-Length: %zu\r\n\r\n", etag, count );
+            }
+            send( c, head, len, MSG_NOSIGNAL );
+
+            if( s->stall ) {
+                while( 0 < recv(c, r.buf, sizeof(r.buf), 0) ) {
+                }
+                return;
+            }
+            if( (0 < s->drop_after) && (s->drop_after < count) ) {
+                send( c, &config.buf[from], s->drop_after, MSG_NOSIGNAL );
+                s->sent += s->drop_after;
+                s->drop_after = 0;
+                return;
+            }
+            send( c, &config.buf[from], count, MSG_NOSIGNAL );
+            s->sent += count;
+        }
+    }
+}
+
+static int server_start( server_t *s )
+{
+    memset( s, 0, sizeof(server_t) );
+
+    return loopback_start( &s->l, false, serve, s );
+}
+
+static void server_stop( server_t *s )
+{
+    loopback_stop( &s->l );
+}
+
+/*----------------------------------------------------------------------------*/
+/* The caller's side: a poll() loop & the callbacks.                          */
+/*----------------------------------------------------------------------------*/
+#define MAX_FDS 8
+
+typedef struct {
+    struct pollfd fds[MAX_FDS];
+    int count;
+    long timeout_ms;
+    int updates;
+    int watch_calls;
+    uint32_t default_ipv4;
+    bool mapped;
+} host_t;
+
+static int update_config( const all_t *cfg, void *user_data )
+{
+    host_t *h = (host_t*) user_data;
+
+    h->updates++;
+    h->mapped = (NULL != cfg->view);
+    if( NULL != cfg->xdns ) {
+        h->default_ipv4 = cfg->xdns->default_ipv4;
+    }
+    webcfg_free( (all_t*) cfg );
+
+    return 0;
+}
+
+static char* get_auth( void *user_data )
+{
+    (void) user_data;
+
+    return strdup( "token" );
+}
+
+static void watch_fd( int fd, int events, void *user_data )
+{
+    host_t *h = (host_t*) user_data;
+    int i;
+
+    h->watch_calls++;
+    for( i = 0; i < h->count; i++ ) {
+        if( fd == h->fds[i].fd ) {
+            break;
+        }
+    }
+
+    if( 0 == events ) {
+        if( i < h->count ) {
+            h->fds[i] = h->fds[--h->count];
+        }
+        return;
+    }
+
+    if( i == h->count ) {
+        CU_ASSERT_FATAL( h->count < MAX_FDS );
+        h->count++;
+    }
+    h->fds[i].fd = fd;
+    h->fds[i].events = ((WEBCFG_EVENT_IN & events) ? POLLIN : 0) |
+                       ((WEBCFG_EVENT_OUT & events) ? POLLOUT : 0);
+}
+
+static void watch_timeout( long timeout_ms, void *user_data )
+{
+    host_t *h = (host_t*) user_data;
+
+    h->timeout_ms = timeout_ms;
+}
+
+/* Runs the loop until the server has seen the requests and there is nothing
+ * left to wait for. */
+static void run( host_t *h, server_t *s, int requests )
+{
+    int loops = 0;
+
+    while( (s->requests < requests) || (0 < h->count) || (-1 != h->timeout_ms) ) {
+        int n, i;
+
+        CU_ASSERT_FATAL( loops++ < 10000 );
+
+        /* Wait for the socket or the timeout, not in a callback. */
+        n = poll( h->fds, h->count, (-1 == h->timeout_ms) ? 100 : h->timeout_ms );
+        if( 0 == n ) {
+            /* The timeout only fires once. */
+            if( -1 != h->timeout_ms ) {
+                h->timeout_ms = -1;
+                CU_ASSERT( 0 == webcfg_process(WEBCFG_TIMEOUT, 0) );
+            }
+            continue;
+        }
+
+        for( i = 0; i < h->count; i++ ) {
+            struct pollfd p = h->fds[i];
+            int events = 0;
+
+            if( 0 == p.revents ) {
+                continue;
+            }
+            if( POLLIN & p.revents )  events |= WEBCFG_EVENT_IN;
+            if( POLLOUT & p.revents ) events |= WEBCFG_EVENT_OUT;
+            if( (POLLERR | POLLHUP) & p.revents ) events |= WEBCFG_EVENT_ERR;
+
+            CU_ASSERT( 0 == webcfg_process(p.fd, events) );
+            break;
+        }
+    }
+}
+
+static void fill_opts( struct webcfg_opts *opts, host_t *h, char *url, size_t len,
+                       int port )
+{
+    snprintf( url, len, "http://127.0.0.1:%d/api/v2/device/config", port );
+
+    memset( opts, 0, sizeof(struct webcfg_opts) );
+    opts->url = url;
+    opts->firmware = "fw";
+    opts->user_data = h;
+    opts->update_config = update_config;
+    opts->get_auth = get_auth;
+}
+
+void test_nonblocking()
+{
+    struct webcfg_opts opts;
+    server_t server;
+    host_t h;
+    char url[128];
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &h, 0, sizeof(h) );
+    h.timeout_ms = -1;
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.watch_fd = watch_fd;
+    opts.watch_timeout = watch_timeout;
+
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+
+    /* Starting a check does not block or call anything back yet. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 0 == h.updates );
+    CU_ASSERT( 0 != webcfg_sync() );
+
+    run( &h, &server, 1 );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+    CU_ASSERT( 0 < h.watch_calls );
+
+    /* The applied version is sent with the next check. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    run( &h, &server, 2 );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 1 == server.not_modified );
+
+    webcfg_shutdown();
+    server_stop( &server );
+}
+
+void test_blocking()
+{
+    struct webcfg_opts opts;
+    server_t server;
+    host_t h;
+    char url[128];
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 != webcfg_init(&opts) );
+    CU_ASSERT( 0 != webcfg_process(WEBCFG_TIMEOUT, 0) );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( false == h.mapped );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 1 == server.not_modified );
+
+    webcfg_shutdown();
+    server_stop( &server );
+}
+
+void test_download()
+{
+    struct webcfg_opts opts;
+    server_t server;
+    host_t h;
+    char url[128];
+    char dir[] = "/tmp/test_webcfg.XXXXXX";
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+    CU_ASSERT_FATAL( NULL != mkdtemp(dir) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.tmp_path = dir;
+
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+
+    /* The config is decoded from the mapped download. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 1 == server.not_modified );
+
+    /* A body that is not an envelope is abandoned as it arrives, & not
+     * kept to be resumed. */
+    config.buf[0] = 0xc1;
+    config_ver[0] = 'x';
+    webcfg_sync();
+    webcfg_sync();
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 0 == server.partial );
+    build_config();
+
+    webcfg_shutdown();
+    server_stop( &server );
+
+    /* Nothing is left behind. */
+    CU_ASSERT( 0 == rmdir(dir) );
+
+    /* A directory that can't be written to fails the check. */
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.tmp_path = dir;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 != webcfg_sync() );
+    webcfg_shutdown();
+}
+
+void test_durable()
+{
+    struct webcfg_opts opts;
+    const all_t *cfg;
+    server_t server;
+    host_t h;
+    char url[128];
+    char dir[] = "/tmp/test_webcfg.XXXXXX";
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+    CU_ASSERT_FATAL( NULL != mkdtemp(dir) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.durable_path = dir;
+
+    /* The first check downloads the config & keeps it. */
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+
+    /* An unchanged config is not applied again. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 1 == server.not_modified );
+    webcfg_shutdown();
+
+    /* After a restart the config applied is current before any check... */
+    h.default_ipv4 = 0;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    cfg = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != cfg );
+    CU_ASSERT( 0x4c4c4c4c == cfg->xdns->default_ipv4 );
+    CU_ASSERT( NULL != cfg->gre );
+    webcfg_release( cfg );
+
+    /* ...and the kept body is applied once the server confirms it, straight
+     * from the mapped file. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+    CU_ASSERT( 2 == server.not_modified );
+    webcfg_shutdown();
+
+    /* The same without blocking. */
+    h.timeout_ms = -1;
+    opts.watch_fd = watch_fd;
+    opts.watch_timeout = watch_timeout;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    run( &h, &server, 4 );
+    CU_ASSERT( 3 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    CU_ASSERT( 3 == server.not_modified );
+    webcfg_shutdown();
+
+    /* Only the first check carried the body. */
+    CU_ASSERT( 1 == server.bodies );
+    server_stop( &server );
+
+    CU_ASSERT( 0 <= remove_dir(dir) );
+}
+
+void test_durable_download()
+{
+    struct webcfg_opts opts;
+    server_t server;
+    host_t h;
+    char url[128];
+    char tmp[] = "/tmp/test_webcfg.XXXXXX";
+    char dir[] = "/tmp/test_webcfg.XXXXXX";
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+    CU_ASSERT_FATAL( NULL != mkdtemp(tmp) );
+    CU_ASSERT_FATAL( NULL != mkdtemp(dir) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.tmp_path = tmp;
+    opts.durable_path = dir;
+
+    /* The download is decoded in place & then kept. */
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    webcfg_shutdown();
+
+    /* So after a restart it is applied without downloading it again. */
+    h.default_ipv4 = 0;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+    CU_ASSERT( 1 == server.not_modified );
+    CU_ASSERT( 1 == server.bodies );
+    webcfg_shutdown();
+
+    server_stop( &server );
+
+    /* The download was moved, not left behind. */
+    CU_ASSERT( 0 == rmdir(tmp) );
+    CU_ASSERT( 0 <= remove_dir(dir) );
+}
+
+void test_resume()
+{
+    struct webcfg_opts opts;
+    server_t server;
+    host_t h;
+    char url[128];
+    char dir[] = "/tmp/test_webcfg.XXXXXX";
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+    CU_ASSERT_FATAL( NULL != mkdtemp(dir) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.tmp_path = dir;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+
+    /* A body cut short is kept... */
+    server.drop_after = 50;
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 0 == h.updates );
+    CU_ASSERT( 50 == server.sent );
+
+    /* ...and only the rest is asked for next time. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( true == h.mapped );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+    CU_ASSERT( 1 == server.bodies );
+    CU_ASSERT( 1 == server.partial );
+    CU_ASSERT( config.len == server.sent );
+    webcfg_shutdown();
+
+    /* A partial body that has changed on the server is sent in full. */
+    h.updates = 0;
+    server.sent = 0;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    server.drop_after = 50;
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 0 == h.updates );
+    server.generation++;
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == h.updates );
+    CU_ASSERT( 0x4c4c4c4c == h.default_ipv4 );
+    CU_ASSERT( 3 == server.bodies );
+    CU_ASSERT( 1 == server.partial );
+    CU_ASSERT( 50 + config.len == server.sent );
+    webcfg_shutdown();
+
+    server_stop( &server );
+
+    /* Nothing is left behind. */
+    CU_ASSERT( 0 == rmdir(dir) );
+}
+
+/* The background engine calls this from its own thread. */
+static int bg_update( const all_t *cfg, void *user_data )
+{
+    host_t *h = (host_t*) user_data;
+
+    __atomic_add_fetch( &h->updates, 1, __ATOMIC_SEQ_CST );
+    webcfg_free( (all_t*) cfg );
+
+    return 0;
+}
+
+/* Waits up to 5s for a counter another thread bumps to reach a value. */
+static bool wait_for( int *v, int want )
+{
+    int i;
+
+    for( i = 0; i < 500; i++ ) {
+        if( want <= __atomic_load_n(v, __ATOMIC_SEQ_CST) ) {
+            return true;
+        }
+        usleep( 10000 );
+    }
+
+    return false;
+}
+
+void test_background()
+{
+    struct webcfg_opts opts;
+    struct timespec start, end;
+    server_t server;
+    host_t h;
+    char url[128];
+
+    build_config();
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+    opts.update_config = bg_update;
+    opts.poll_interval_s = 60;
+
+    /* The first check happens at once. */
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( wait_for(&h.updates, 1) );
+
+    /* A sync doesn't wait for the interval, and sends the applied version. */
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( wait_for(&server.not_modified, 1) );
+    CU_ASSERT( 2 == __atomic_load_n(&server.requests, __ATOMIC_SEQ_CST) );
+    CU_ASSERT( 1 == __atomic_load_n(&h.updates, __ATOMIC_SEQ_CST) );
+
+    /* A check that never completes doesn't hold up the shutdown. */
+    server.stall = true;
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( wait_for(&server.requests, 3) );
+
+    clock_gettime( CLOCK_MONOTONIC, &start );
+    webcfg_shutdown();
+    clock_gettime( CLOCK_MONOTONIC, &end );
+    CU_ASSERT( end.tv_sec - start.tv_sec < 3 );
+
+    server_stop( &server );
+}
+
+static void set_ipv4( uint8_t b )
+{
+    memset( &xdns[XDNS_IPV4], b, 4 );
+    build_config();
+}
+
+/* Takes & checks snapshots until told to stop. */
+static void* reader( void *arg )
+{
+    bool *stop = (bool*) arg;
+    int bad = 0;
+
+    while( !__atomic_load_n(stop, __ATOMIC_SEQ_CST) ) {
+        const all_t *cfg = webcfg_get_current();
+
+        if( NULL != cfg ) {
+            uint32_t ip = cfg->xdns->default_ipv4;
+
+            if( (0x4c4c4c4c != ip) && (0x08080808 != ip) ) {
+                bad++;
+            }
+            webcfg_release( cfg );
+        }
+    }
+
+    return (void*) (intptr_t) bad;
+}
+
+void test_current()
+{
+    struct webcfg_opts opts;
+    const all_t *first, *second;
+    server_t server;
+    pthread_t readers[4];
+    bool stop = false;
+    void *bad;
+    host_t h;
+    char url[128];
+    int i;
+
+    set_ipv4( 0x4c );
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( NULL == webcfg_get_current() );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    first = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != first );
+    CU_ASSERT( 0x4c4c4c4c == first->xdns->default_ipv4 );
+
+    /* A snapshot is unchanged by a newer config. */
+    set_ipv4( 0x08 );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == h.updates );
+    second = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != second );
+    CU_ASSERT( first != second );
+    CU_ASSERT( 0x08080808 == second->xdns->default_ipv4 );
+    CU_ASSERT( 0x4c4c4c4c == first->xdns->default_ipv4 );
+    webcfg_release( first );
+
+    /* Readers keep going while the config changes under them. */
+    for( i = 0; i < 4; i++ ) {
+        CU_ASSERT_FATAL( 0 == pthread_create(&readers[i], NULL, reader, &stop) );
+    }
+    for( i = 0; i < 20; i++ ) {
+        set_ipv4( (i & 1) ? 0x08 : 0x4c );
+        CU_ASSERT( 0 == webcfg_sync() );
+    }
+    __atomic_store_n( &stop, true, __ATOMIC_SEQ_CST );
+    for( i = 0; i < 4; i++ ) {
+        pthread_join( readers[i], &bad );
+        CU_ASSERT( NULL == bad );
+    }
+    CU_ASSERT( 22 == h.updates );
+
+    /* A snapshot outlives the library. */
+    webcfg_shutdown();
+    CU_ASSERT( 0x08080808 == second->xdns->default_ipv4 );
+    webcfg_release( second );
+
+    set_ipv4( 0x4c );
+    server_stop( &server );
+}
+
+void test_actual()
+{
+    struct webcfg_opts opts;
+    const all_t *first, *cfg;
+    all_t *local;
+    server_t server;
+    host_t h;
+    char url[128];
+
+    set_ipv4( 0x4c );
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &h, 0, sizeof(h) );
+    fill_opts( &opts, &h, url, sizeof(url), server.l.port );
+
+    CU_ASSERT( 0 != webcfg_update_actual(NULL) );
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 != webcfg_update_actual(NULL) );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    first = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != first );
+
+    set_ipv4( 0x08 );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == h.updates );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == h.updates );
+
+    /* The first config is back in effect, so it is the current one & the
+     * server's is sent again. */
+    CU_ASSERT( 0 == webcfg_update_actual(first) );
+    cfg = webcfg_get_current();
+    CU_ASSERT( first == cfg );
+    webcfg_release( cfg );
+
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 3 == h.updates );
+    cfg = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != cfg );
+    CU_ASSERT( 0x08080808 == cfg->xdns->default_ipv4 );
+    webcfg_release( cfg );
+
+    /* One the caller decoded only changes the version asked with. */
+    set_ipv4( 0x4c );
+    local = all_convert( config.buf, config.len, NULL, NULL );
+    CU_ASSERT_FATAL( NULL != local );
+    CU_ASSERT( 0 == webcfg_update_actual(local) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 3 == h.updates );
+    cfg = webcfg_get_current();
+    CU_ASSERT( 0x08080808 == cfg->xdns->default_ipv4 );
+    webcfg_release( cfg );
+    all_destroy( local );
+
+    webcfg_release( first );
+    webcfg_shutdown();
+    server_stop( &server );
+}
+
+/* When each subsystem was applied, in ms since the test started. */
+typedef struct {
+    host_t h;
+    struct timespec t0;
+    long start[WEBCFG_SUBSYSTEMS];
+    long end[WEBCFG_SUBSYSTEMS];
+    int rv[WEBCFG_SUBSYSTEMS];
+    int results[WEBCFG_SUBSYSTEMS];
+    int reports;
+} applier_t;
+
+static long ms_since( const struct timespec *t0 )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return (now.tv_sec - t0->tv_sec) * 1000 + (now.tv_nsec - t0->tv_nsec) / 1000000;
+}
+
+static int apply_sub( applier_t *a, int s )
+{
+    a->start[s] = ms_since( &a->t0 );
+    usleep( 100000 );
+    a->end[s] = ms_since( &a->t0 );
+
+    return a->rv[s];
+}
+
+static int apply_gre( const all_t *cfg, void *user_data )
+{
+    CU_ASSERT( NULL != cfg->gre );
+    return apply_sub( (applier_t*) user_data, WEBCFG_GRE );
+}
+
+static int apply_xdns( const all_t *cfg, void *user_data )
+{
+    CU_ASSERT( NULL != cfg->xdns );
+    return apply_sub( (applier_t*) user_data, WEBCFG_XDNS );
+}
+
+static int apply_dhcp( const all_t *cfg, void *user_data )
+{
+    (void) cfg;
+    (void) user_data;
+
+    /* Not in the config, so never called. */
+    CU_FAIL( "dhcp applied" );
+    return -1;
+}
+
+static void report( const int results[WEBCFG_SUBSYSTEMS], void *user_data )
+{
+    applier_t *a = (applier_t*) user_data;
+
+    memcpy( a->results, results, sizeof(a->results) );
+    a->reports++;
+}
+
+void test_subsystems()
+{
+    struct webcfg_opts opts;
+    const all_t *cfg;
+    server_t server;
+    applier_t a;
+    char url[128];
+
+    set_ipv4( 0x4c );
+    CU_ASSERT_FATAL( 0 == server_start(&server) );
+
+    memset( &a, 0, sizeof(a) );
+    clock_gettime( CLOCK_MONOTONIC, &a.t0 );
+    fill_opts( &opts, &a.h, url, sizeof(url), server.l.port );
+    opts.user_data = &a;
+    opts.update_config = NULL;
+    opts.apply[WEBCFG_GRE].apply = apply_gre;
+    opts.apply[WEBCFG_XDNS].apply = apply_xdns;
+    opts.apply[WEBCFG_DHCP].apply = apply_dhcp;
+    opts.report = report;
+
+    /* Independent subsystems are applied at the same time. */
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 1 == a.reports );
+    CU_ASSERT( 0 == a.results[WEBCFG_GRE] );
+    CU_ASSERT( 0 == a.results[WEBCFG_XDNS] );
+    CU_ASSERT( 0 == a.results[WEBCFG_DHCP] );
+    CU_ASSERT( a.start[WEBCFG_XDNS] < a.end[WEBCFG_GRE] );
+    CU_ASSERT( a.start[WEBCFG_GRE] < a.end[WEBCFG_XDNS] );
+
+    /* Only what changed is applied again. */
+    a.start[WEBCFG_GRE] = -1;
+    a.start[WEBCFG_XDNS] = -1;
+    set_ipv4( 0x08 );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 2 == a.reports );
+    CU_ASSERT( -1 == a.start[WEBCFG_GRE] );
+    CU_ASSERT( -1 != a.start[WEBCFG_XDNS] );
+    CU_ASSERT( 0 == a.results[WEBCFG_GRE] );
+    CU_ASSERT( 0 == a.results[WEBCFG_XDNS] );
+
+    cfg = webcfg_get_current();
+    CU_ASSERT_FATAL( NULL != cfg );
+    CU_ASSERT( 0x08080808 == cfg->xdns->default_ipv4 );
+    webcfg_release( cfg );
+    webcfg_shutdown();
+    set_ipv4( 0x4c );
+
+    /* A dependency is applied first. */
+    opts.apply[WEBCFG_XDNS].after = WEBCFG_BIT( WEBCFG_GRE );
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 3 == a.reports );
+    CU_ASSERT( a.end[WEBCFG_GRE] <= a.start[WEBCFG_XDNS] );
+    webcfg_shutdown();
+
+    /* And what depends on a failure is skipped, so the config is not
+     * applied. */
+    a.rv[WEBCFG_GRE] = -7;
+    a.start[WEBCFG_XDNS] = -1;
+    CU_ASSERT_FATAL( 0 == webcfg_init(&opts) );
+    CU_ASSERT( 0 == webcfg_sync() );
+    CU_ASSERT( 4 == a.reports );
+    CU_ASSERT( -7 == a.results[WEBCFG_GRE] );
+    CU_ASSERT( WEBCFG_SKIPPED == a.results[WEBCFG_XDNS] );
+    CU_ASSERT( -1 == a.start[WEBCFG_XDNS] );
+    CU_ASSERT( NULL == webcfg_get_current() );
+    webcfg_shutdown();
+
+    server_stop( &server );
+}
+
+void test_bad_opts()
+{
+    struct webcfg_opts opts;
+    host_t h;
+    char url[128];
+
+    CU_ASSERT( 0 != webcfg_init(NULL) );
+
+    fill_opts( &opts, &h, url, sizeof(url), 80 );
+    opts.watch_fd = watch_fd;
+    CU_ASSERT( 0 != webcfg_init(&opts) );
+
+    fill_opts( &opts, &h, url, sizeof(url), 80 );
+    opts.watch_fd = watch_fd;
+    opts.watch_timeout = watch_timeout;
+    opts.poll_interval_s = 1;
+    CU_ASSERT( 0 != webcfg_init(&opts) );
+
+    /* The subsystems can't be applied after each other. */
+    fill_opts( &opts, &h, url, sizeof(url), 80 );
+    opts.apply[WEBCFG_GRE].apply = apply_gre;
+    opts.apply[WEBCFG_GRE].after = WEBCFG_BIT( WEBCFG_XDNS );
+    opts.apply[WEBCFG_XDNS].after = WEBCFG_BIT( WEBCFG_GRE );
+    CU_ASSERT( 0 != webcfg_init(&opts) );
+
+    fill_opts( &opts, &h, url, sizeof(url), 80 );
+    opts.update_config = NULL;
+    CU_ASSERT( 0 != webcfg_init(&opts) );
+
+    CU_ASSERT( 0 != webcfg_sync() );
+    webcfg_shutdown();
+}
+
+void add_suites( CU_pSuite *suite )
+{
+    *suite = CU_add_suite( "tests", NULL, NULL );
+    CU_add_test( *suite, "Non-blocking", test_nonblocking);
+    CU_add_test( *suite, "Blocking", test_blocking);
+    CU_add_test( *suite, "Download", test_download);
+    CU_add_test( *suite, "Durable", test_durable);
+    CU_add_test( *suite, "Durable Download", test_durable_download);
+    CU_add_test( *suite, "Resume", test_resume);
+    CU_add_test( *suite, "Background", test_background);
+    CU_add_test( *suite, "Current", test_current);
+    CU_add_test( *suite, "Actual", test_actual);
+    CU_add_test( *suite, "Subsystems", test_subsystems);
+    CU_add_test( *suite, "Bad Options", test_bad_opts);
+}
+
+/*----------------------------------------------------------------------------*/
+/*                             External Functions                             */
+/*----------------------------------------------------------------------------*/
+int main( int argc, char *argv[] )
+{
+    unsigned rv = 1;
+    CU_pSuite suite = NULL;
+ 
+    (void ) argc;
+    (void ) argv;
+    
+    if( CUE_SUCCESS == CU_initialize_registry() ) {
+        add_suites( &suite );
+
+        if( NULL != suite ) {
+            CU_basic_set_mode( CU_BRM_VERBOSE );
+            CU_basic_run_tests();
+            printf( "\n" );
+            CU_basic_show_failures( CU_get_failure_list() );
+            printf( "\n\n" );
+            rv = CU_get_number_of_tests_failed();
+        }
+
+        CU_cleanup_registry();
+        mp_free( &config );
+
+    }
+
+    return rv;
+}